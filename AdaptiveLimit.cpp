@@ -0,0 +1,56 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   AdaptiveLimit.cpp
+//! \brief  The AdaptiveLimit class definition.
+//! \author Chris Oldwood
+
+#include "Common.hpp"
+#include "AdaptiveLimit.hpp"
+#include <algorithm>
+
+////////////////////////////////////////////////////////////////////////////////
+//! Constructor.
+
+AdaptiveLimit::AdaptiveLimit(size_t initial, size_t minimum, size_t maximum, DWORD targetLatency)
+	: m_limit(std::min(std::max(initial, minimum), maximum))
+	, m_minimum(minimum)
+	, m_maximum(maximum)
+	, m_target(targetLatency)
+	, m_generation(0)
+	, m_latencies()
+{
+	ASSERT((minimum != 0) && (minimum <= maximum));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Record the latency (ms) of some work started in the given generation. The
+//! limit is reconsidered once there is a latency for each unit of work that
+//! the current limit allows, i.e. roughly once per round trip.
+
+void AdaptiveLimit::addLatency(DWORD latency, size_t generation)
+{
+	if (generation != m_generation)
+		return;
+
+	m_latencies.push_back(latency);
+
+	const size_t numSamples = (m_limit > MIN_SAMPLES) ? m_limit : MIN_SAMPLES;
+
+	if (m_latencies.size() < numSamples)
+		return;
+
+	const size_t percentile = ((m_latencies.size() * 95) + 99) / 100 - 1;
+
+	std::nth_element(m_latencies.begin(), m_latencies.begin() + percentile, m_latencies.end());
+
+	if (m_latencies[percentile] <= m_target)
+	{
+		m_limit = std::min(m_limit + 1, m_maximum);
+	}
+	else
+	{
+		m_limit = std::max(m_limit / 2, m_minimum);
+		++m_generation;
+	}
+
+	m_latencies.clear();
+}
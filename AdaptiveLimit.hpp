@@ -0,0 +1,75 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   AdaptiveLimit.hpp
+//! \brief  The AdaptiveLimit class declaration.
+//! \author Chris Oldwood
+
+// Check for previous inclusion
+#ifndef APP_ADAPTIVELIMIT_HPP
+#define APP_ADAPTIVELIMIT_HPP
+
+#if _MSC_VER > 1000
+#pragma once
+#endif
+
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+//! A concurrency limit that adapts to the latency of the work it admits. Once
+//! enough latencies have been seen the 95th percentile is compared with the
+//! target. If it's within the target the limit is raised by one, otherwise it
+//! is halved (AIMD). Latencies for work which was started before the last cut
+//! are ignored as they reflect the load that caused it.
+
+class AdaptiveLimit
+{
+public:
+	//! Constructor.
+	AdaptiveLimit(size_t initial, size_t minimum, size_t maximum, DWORD targetLatency);
+
+	//! Get the current limit.
+	size_t limit() const;
+
+	//! Get the number of times the limit has been cut.
+	size_t generation() const;
+
+	//! Record the latency (ms) of some work started in the given generation.
+	void addLatency(DWORD latency, size_t generation);
+
+	//
+	// Constants.
+	//
+
+	//! The fewest latencies used to decide whether to change the limit.
+	static const size_t MIN_SAMPLES = 5;
+
+private:
+	typedef std::vector<DWORD> Latencies;
+
+	//
+	// Members.
+	//
+	size_t		m_limit;		//!< The current limit.
+	size_t		m_minimum;		//!< The lowest the limit can go.
+	size_t		m_maximum;		//!< The highest the limit can go.
+	DWORD		m_target;		//!< The target 95th percentile latency (ms).
+	size_t		m_generation;	//!< The number of times the limit has been cut.
+	Latencies	m_latencies;	//!< The latencies since the limit last changed.
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! Get the current limit.
+
+inline size_t AdaptiveLimit::limit() const
+{
+	return m_limit;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Get the number of times the limit has been cut.
+
+inline size_t AdaptiveLimit::generation() const
+{
+	return m_generation;
+}
+
+#endif // APP_ADAPTIVELIMIT_HPP
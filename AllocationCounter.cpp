@@ -0,0 +1,251 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   AllocationCounter.cpp
+//! \brief  A hook on the global allocator that counts heap allocations.
+//! \author Chris Oldwood
+
+#include "Common.hpp"
+#include "AllocationCounter.hpp"
+#include <new>
+#include <malloc.h>
+#include <intrin.h>
+
+#pragma intrinsic(_InterlockedCompareExchange64)
+
+//! Is the counting enabled?
+static volatile bool s_enabled = false;
+
+//! The number of calls made to the global operator new during each stage.
+static volatile __int64 s_counts[NUM_ALLOCATION_STAGES] = { 0 };
+
+//! The number of bytes requested during each stage.
+static volatile __int64 s_bytes[NUM_ALLOCATION_STAGES] = { 0 };
+
+//! The stage the current thread is in.
+static __declspec(thread) AllocationStage s_stage = OTHER_STAGE;
+
+//! The names of the stages.
+static const tchar* s_stageNames[NUM_ALLOCATION_STAGES] =
+{
+	TXT("other"),
+	TXT("hosts-file"),
+	TXT("fetch"),
+	TXT("format"),
+	TXT("output"),
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! Atomically reset a 64-bit counter to zero.
+
+static void atomicReset(volatile __int64* counter)
+{
+	__int64 current = *counter;
+
+	for (;;)
+	{
+		const __int64 previous = _InterlockedCompareExchange64(counter, 0, current);
+
+		if (previous == current)
+			break;
+
+		current = previous;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Atomically read a 64-bit counter.
+
+static __int64 atomicRead(volatile __int64* counter)
+{
+	return _InterlockedCompareExchange64(counter, 0, 0);
+}
+
+#ifdef APP_COUNT_ALLOCATIONS
+
+////////////////////////////////////////////////////////////////////////////////
+//! Atomically add to a 64-bit counter. The 32-bit SDK has no 64-bit add and so
+//! it's built on the compare-exchange, which also fixes up a torn first read.
+
+static void atomicAdd(volatile __int64* counter, __int64 amount)
+{
+	__int64 current = *counter;
+
+	for (;;)
+	{
+		const __int64 previous = _InterlockedCompareExchange64(counter, current + amount, current);
+
+		if (previous == current)
+			break;
+
+		current = previous;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Allocate a block of memory and, if enabled, count the allocation against
+//! the current thread's stage.
+
+static void* countedAlloc(size_t size)
+{
+	if (s_enabled)
+	{
+		atomicAdd(&s_counts[s_stage], 1);
+		atomicAdd(&s_bytes[s_stage], static_cast<__int64>(size));
+	}
+
+	void* block = ::malloc((size != 0) ? size : 1);
+
+	if (block == nullptr)
+		throw std::bad_alloc();
+
+	return block;
+}
+
+#endif // APP_COUNT_ALLOCATIONS
+
+////////////////////////////////////////////////////////////////////////////////
+//! Is the allocation counting built in?
+
+bool isAllocationCountingAvailable()
+{
+#ifdef APP_COUNT_ALLOCATIONS
+	return true;
+#else
+	return false;
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Start or stop counting the allocations.
+
+void enableAllocationCounting(bool enable)
+{
+	s_enabled = enable;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Reset the allocations counted for every stage to zero.
+
+void resetAllocationStats()
+{
+	for (size_t i = 0; i != NUM_ALLOCATION_STAGES; ++i)
+	{
+		atomicReset(&s_counts[i]);
+		atomicReset(&s_bytes[i]);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Get the number of calls made to the global operator new whilst counting has
+//! been enabled.
+
+size_t allocationCount()
+{
+	uint64 count = 0;
+
+	for (size_t i = 0; i != NUM_ALLOCATION_STAGES; ++i)
+		count += static_cast<uint64>(atomicRead(&s_counts[i]));
+
+	return static_cast<size_t>(count);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Get the allocations made during the stage whilst counting has been enabled.
+
+AllocationStats getAllocationStats(AllocationStage stage)
+{
+	ASSERT(stage < NUM_ALLOCATION_STAGES);
+
+	AllocationStats stats;
+
+	stats.m_count = static_cast<uint64>(atomicRead(&s_counts[stage]));
+	stats.m_bytes = static_cast<uint64>(atomicRead(&s_bytes[stage]));
+
+	return stats;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Get the name of the stage for display.
+
+const tchar* getStageName(AllocationStage stage)
+{
+	ASSERT(stage < NUM_ALLOCATION_STAGES);
+
+	return s_stageNames[stage];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Constructor.
+
+AllocationScope::AllocationScope(AllocationStage stage)
+	: m_previous(s_stage)
+{
+	s_stage = stage;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Destructor.
+
+AllocationScope::~AllocationScope()
+{
+	s_stage = m_previous;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Constructor. The counts are reset first when counting is enabled.
+
+AllocationCounting::AllocationCounting(bool enable)
+	: m_counting(enable)
+{
+	if (m_counting)
+	{
+		resetAllocationStats();
+		enableAllocationCounting(true);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Destructor.
+
+AllocationCounting::~AllocationCounting()
+{
+	stop();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Stop counting the allocations. The counts are kept for reporting.
+
+void AllocationCounting::stop()
+{
+	if (m_counting)
+	{
+		enableAllocationCounting(false);
+		m_counting = false;
+	}
+}
+
+#ifdef APP_COUNT_ALLOCATIONS
+
+////////////////////////////////////////////////////////////////////////////////
+// The global allocator replacements.
+
+void* operator new(size_t size)
+{
+	return countedAlloc(size);
+}
+
+void* operator new[](size_t size)
+{
+	return countedAlloc(size);
+}
+
+void operator delete(void* block)
+{
+	::free(block);
+}
+
+void operator delete[](void* block)
+{
+	::free(block);
+}
+
+#endif // APP_COUNT_ALLOCATIONS
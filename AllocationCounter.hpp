@@ -0,0 +1,124 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   AllocationCounter.hpp
+//! \brief  A hook on the global allocator that counts heap allocations.
+//! \author Chris Oldwood
+
+// Check for previous inclusion
+#ifndef APP_ALLOCATIONCOUNTER_HPP
+#define APP_ALLOCATIONCOUNTER_HPP
+
+#if _MSC_VER > 1000
+#pragma once
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+//! The stages of a query that allocations are attributed to. Each thread is
+//! in one stage at a time.
+
+enum AllocationStage
+{
+	OTHER_STAGE,		//!< Anything not attributed to a stage below.
+	HOSTS_FILE_STAGE,	//!< Loading the hosts file.
+	FETCH_STAGE,		//!< Querying the hosts and fetching the properties.
+	FORMAT_STAGE,		//!< Formatting the property values.
+	OUTPUT_STAGE,		//!< Encoding and writing the output.
+
+	NUM_ALLOCATION_STAGES
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! The allocations made during a stage.
+
+struct AllocationStats
+{
+	uint64	m_count;	//!< The number of calls to operator new.
+	uint64	m_bytes;	//!< The number of bytes requested.
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Is the allocation counting built in? The global operator new is only
+// replaced when APP_COUNT_ALLOCATIONS is defined, otherwise nothing is counted.
+
+bool isAllocationCountingAvailable();
+
+////////////////////////////////////////////////////////////////////////////////
+// Start or stop counting the allocations. The counting is off by default so
+// that it costs nothing unless someone is looking at the numbers.
+
+void enableAllocationCounting(bool enable);
+
+////////////////////////////////////////////////////////////////////////////////
+// Reset the allocations counted for every stage to zero.
+
+void resetAllocationStats();
+
+////////////////////////////////////////////////////////////////////////////////
+// Get the number of calls made to the global operator new whilst counting has
+// been enabled. Tests compare two snapshots to assert an allocation budget.
+
+size_t allocationCount();
+
+////////////////////////////////////////////////////////////////////////////////
+// Get the allocations made during the stage whilst counting has been enabled.
+
+AllocationStats getAllocationStats(AllocationStage stage);
+
+////////////////////////////////////////////////////////////////////////////////
+// Get the name of the stage for display.
+
+const tchar* getStageName(AllocationStage stage);
+
+////////////////////////////////////////////////////////////////////////////////
+//! Attributes the allocations made by the current thread to a stage for the
+//! lifetime of the object. The previous stage is restored afterwards so that
+//! scopes can be nested.
+
+class AllocationScope
+{
+public:
+	//! Constructor.
+	explicit AllocationScope(AllocationStage stage);
+
+	//! Destructor.
+	~AllocationScope();
+
+private:
+	//
+	// Members.
+	//
+	AllocationStage	m_previous;	//!< The thread's stage before this one.
+
+	// NotCopyable.
+	AllocationScope(const AllocationScope&);
+	AllocationScope& operator=(const AllocationScope&);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! Counts the allocations, from zero, for the lifetime of the object, or until
+//! it's stopped, so that the counting is always turned off again. The counts
+//! are for the whole process and so only one should exist at a time.
+
+class AllocationCounting
+{
+public:
+	//! Constructor.
+	explicit AllocationCounting(bool enable);
+
+	//! Destructor.
+	~AllocationCounting();
+
+	//! Stop counting the allocations.
+	void stop();
+
+private:
+	//
+	// Members.
+	//
+	bool	m_counting;	//!< Is the counting still enabled?
+
+	// NotCopyable.
+	AllocationCounting(const AllocationCounting&);
+	AllocationCounting& operator=(const AllocationCounting&);
+};
+
+#endif // APP_ALLOCATIONCOUNTER_HPP
@@ -0,0 +1,310 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   AsyncFileWriter.cpp
+//! \brief  The AsyncFileWriter class definition.
+//! \author Chris Oldwood
+
+#include "Common.hpp"
+#include "AsyncFileWriter.hpp"
+#include "Utf8Encoding.hpp"
+#include "AllocationCounter.hpp"
+#include <WCL/Win32Exception.hpp>
+#include <Core/RuntimeException.hpp>
+#include <Core/StringUtils.hpp>
+#include <algorithm>
+#include <cstring>
+
+////////////////////////////////////////////////////////////////////////////////
+//! Constructor.
+
+AsyncFileWriter::AsyncFileWriter(const tstring& filename, Compression compression, int level)
+	: m_filename(filename)
+	, m_file(INVALID_HANDLE_VALUE)
+	, m_encoder()
+	, m_filling()
+	, m_fillingSize(0)
+	, m_draining()
+	, m_drainingSize(0)
+	, m_compressed()
+	, m_size(0)
+	, m_finishing(false)
+	, m_filled(Event::AUTO_RESET)
+	, m_drained(Event::AUTO_RESET)
+	, m_closed(false)
+	, m_ioFailed(FALSE)
+	, m_ioError()
+{
+	if (compression == GZIP_COMPRESSION)
+		m_encoder = GzipEncoderPtr(new GzipEncoder(level));
+
+	open(CREATE_ALWAYS, 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Construct a writer which appends to an existing uncompressed file. The file
+//! is first truncated at the offset, which must not be past its end, so that
+//! anything written after it is discarded. The file is created if it doesn't
+//! exist.
+
+AsyncFileWriter::AsyncFileWriter(const tstring& filename, uint64 offset)
+	: m_filename(filename)
+	, m_file(INVALID_HANDLE_VALUE)
+	, m_encoder()
+	, m_filling()
+	, m_fillingSize(0)
+	, m_draining()
+	, m_drainingSize(0)
+	, m_compressed()
+	, m_size(offset)
+	, m_finishing(false)
+	, m_filled(Event::AUTO_RESET)
+	, m_drained(Event::AUTO_RESET)
+	, m_closed(false)
+	, m_ioFailed(FALSE)
+	, m_ioError()
+{
+	open(OPEN_ALWAYS, offset);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Destructor. If the file hasn't been closed the queued data is still
+//! written, but any error is lost.
+
+AsyncFileWriter::~AsyncFileWriter()
+{
+	if (!m_closed)
+	{
+		try
+		{
+			close();
+		}
+		catch (const Core::Exception& /*e*/)
+		{
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Open the file, move to the offset, and start the thread.
+
+void AsyncFileWriter::open(DWORD disposition, uint64 offset)
+{
+	m_filling.resize(BUFFER_SIZE);
+	m_draining.resize(BUFFER_SIZE);
+
+	m_file = ::CreateFile(m_filename.c_str(), GENERIC_WRITE, 0, nullptr, disposition,
+	                      FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+	if (m_file == INVALID_HANDLE_VALUE)
+		throw WCL::Win32Exception(::GetLastError(), Core::fmt(TXT("Failed to create the output file '%s'"), m_filename.c_str()));
+
+	LARGE_INTEGER position;
+
+	position.QuadPart = static_cast<LONGLONG>(offset);
+
+	if (!::SetFilePointerEx(m_file, position, nullptr, FILE_BEGIN) || !::SetEndOfFile(m_file))
+	{
+		const DWORD error = ::GetLastError();
+
+		::CloseHandle(m_file);
+		throw WCL::Win32Exception(error, Core::fmt(TXT("Failed to truncate the output file '%s'"), m_filename.c_str()));
+	}
+
+	// The thread starts out owning an empty buffer.
+	m_drained.set();
+
+	try
+	{
+		start();
+	}
+	catch (...)
+	{
+		::CloseHandle(m_file);
+		throw;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Queue the data to be written. This only blocks when the buffer is full and
+//! the thread has not finished with the previous one. Any error from writing
+//! an earlier buffer is reported here rather than waiting until it's closed.
+
+void AsyncFileWriter::write(const void* data, size_t size)
+{
+	ASSERT(!m_closed);
+
+	if (m_ioFailed)
+		throw Core::RuntimeException(m_ioError);
+
+	if (size == 0)
+		return;
+
+	std::memcpy(reserve(size), data, size);
+	m_fillingSize += size;
+	m_size += size;
+
+	if (m_fillingSize >= BUFFER_SIZE)
+		handOver(false);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Queue the text to be written as UTF-8. The text is encoded straight into
+//! the buffer rather than via an intermediate copy. A surrogate pair must not
+//! be split across calls. Any error from writing an earlier buffer is reported
+//! here.
+
+void AsyncFileWriter::writeUtf8(const wchar_t* text, size_t length)
+{
+	ASSERT(!m_closed);
+
+	if (m_ioFailed)
+		throw Core::RuntimeException(m_ioError);
+
+	if (length == 0)
+		return;
+
+	const size_t encoded = encodeUtf8(text, length, reserve(length * MAX_UTF8_BYTES_PER_UNIT));
+
+	m_fillingSize += encoded;
+	m_size += encoded;
+
+	if (m_fillingSize >= BUFFER_SIZE)
+		handOver(false);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Get the space for the next bytes in the caller's buffer. The buffer only
+//! grows when a write would overflow it, which is at most a single write's
+//! worth past its nominal size, and it's then kept at that size.
+
+byte* AsyncFileWriter::reserve(size_t size)
+{
+	if ((m_fillingSize + size) > m_filling.size())
+		m_filling.resize(m_fillingSize + size);
+
+	return &m_filling[m_fillingSize];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Write any queued data and close the file. This waits for the thread to
+//! finish and throws if any of the data could not be written.
+
+void AsyncFileWriter::close()
+{
+	ASSERT(!m_closed);
+
+	m_closed = true;
+
+	handOver(true);
+	join();
+
+	::CloseHandle(m_file);
+	m_file = INVALID_HANDLE_VALUE;
+
+	if (m_ioFailed)
+		throw Core::RuntimeException(m_ioError);
+
+	if (failed())
+		throw Core::RuntimeException(error());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Hand the caller's buffer over to the thread, once it has finished with the
+//! previous one, and then continue with the thread's old buffer. Any error
+//! from writing an earlier buffer is reported here.
+
+void AsyncFileWriter::handOver(bool finish)
+{
+	m_drained.wait();
+
+	if (m_ioFailed && !finish)
+	{
+		m_drained.set();
+		throw Core::RuntimeException(m_ioError);
+	}
+
+	std::swap(m_filling, m_draining);
+	std::swap(m_fillingSize, m_drainingSize);
+	m_finishing = finish;
+
+	m_filled.set();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Compress and write each buffer as it is handed over. After a failure the
+//! buffers are still accepted, but discarded, so that the caller never blocks.
+
+void AsyncFileWriter::run()
+{
+	AllocationScope scope(OUTPUT_STAGE);
+
+	bool finish = false;
+
+	while (!finish)
+	{
+		m_filled.wait();
+
+		finish = m_finishing;
+
+		if (!m_ioFailed)
+		{
+			try
+			{
+				writeBuffer(&m_draining[0], m_drainingSize, finish);
+			}
+			catch (const Core::Exception& e)
+			{
+				m_ioError = e.twhat();
+				::InterlockedExchange(&m_ioFailed, TRUE);
+			}
+			catch (const std::exception& e)
+			{
+				m_ioError = Core::fmt(TXT("Unexpected exception: %hs"), e.what());
+				::InterlockedExchange(&m_ioFailed, TRUE);
+			}
+		}
+
+		m_drainingSize = 0;
+		m_drained.set();
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Compress and write a single buffer.
+
+void AsyncFileWriter::writeBuffer(const byte* data, size_t size, bool finish)
+{
+	if (m_encoder.get() == nullptr)
+	{
+		writeFile(data, size);
+		return;
+	}
+
+	m_compressed.clear();
+
+	if (size != 0)
+		m_encoder->write(data, size, m_compressed);
+
+	if (finish)
+		m_encoder->finish(m_compressed);
+
+	if (!m_compressed.empty())
+		writeFile(&m_compressed[0], m_compressed.size());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Write the data to the file. A write that stops short, e.g. because the disk
+//! is full, is treated as a failure.
+
+void AsyncFileWriter::writeFile(const byte* data, size_t size)
+{
+	if (size == 0)
+		return;
+
+	DWORD written = 0;
+
+	if (!::WriteFile(m_file, data, static_cast<DWORD>(size), &written, nullptr))
+		throw WCL::Win32Exception(::GetLastError(), Core::fmt(TXT("Failed to write to the output file '%s'"), m_filename.c_str()));
+
+	if (written != size)
+		throw Core::RuntimeException(Core::fmt(TXT("Failed to write all of the output file '%s'"), m_filename.c_str()));
+}
@@ -0,0 +1,130 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   AsyncFileWriter.hpp
+//! \brief  The AsyncFileWriter class declaration.
+//! \author Chris Oldwood
+
+// Check for previous inclusion
+#ifndef APP_ASYNCFILEWRITER_HPP
+#define APP_ASYNCFILEWRITER_HPP
+
+#if _MSC_VER > 1000
+#pragma once
+#endif
+
+#include "Threading.hpp"
+#include "GzipEncoder.hpp"
+#include <Core/SharedPtr.hpp>
+
+//! How the output file is compressed.
+enum Compression
+{
+	NO_COMPRESSION,		//!< The data is written as is.
+	GZIP_COMPRESSION,	//!< The data is written as a gzip stream.
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! Writes data to a file on a dedicated thread, optionally compressing it. The
+//! writer is double-buffered: the caller fills one buffer whilst the thread
+//! compresses and writes the other, and they are swapped when the caller's
+//! buffer is full. The caller only blocks if it gets a whole buffer ahead. The
+//! buffers are allocated once and their used sizes tracked separately, so that
+//! queuing data never has to initialise the space it's about to overwrite.
+
+class AsyncFileWriter : private Thread
+{
+public:
+	//! Constructor.
+	AsyncFileWriter(const tstring& filename, Compression compression, int level);
+
+	//! Construct a writer which appends to an existing uncompressed file.
+	AsyncFileWriter(const tstring& filename, uint64 offset);
+
+	//! Destructor.
+	virtual ~AsyncFileWriter();
+
+	//! Queue the data to be written.
+	void write(const void* data, size_t size);
+
+	//! Queue the text to be written as UTF-8.
+	void writeUtf8(const wchar_t* text, size_t length);
+
+	//! Write any queued data and close the file.
+	void close();
+
+	//! Get the number of bytes written, or queued, so far.
+	uint64 size() const;
+
+	//
+	// Constants.
+	//
+
+	//! The size each buffer grows to before it is handed to the thread.
+	static const size_t BUFFER_SIZE = 256*1024;
+
+private:
+	//! The shared pointer type for the encoder.
+	typedef Core::SharedPtr<GzipEncoder> GzipEncoderPtr;
+
+	//
+	// Members.
+	//
+	tstring			m_filename;		//!< The name of the file being written.
+	HANDLE			m_file;			//!< The file handle.
+	GzipEncoderPtr	m_encoder;		//!< The compressor, if enabled.
+	ByteBuffer		m_filling;		//!< The buffer being filled by the caller.
+	size_t			m_fillingSize;	//!< The number of bytes used in m_filling.
+	ByteBuffer		m_draining;		//!< The buffer being written by the thread.
+	size_t			m_drainingSize;	//!< The number of bytes used in m_draining.
+	ByteBuffer		m_compressed;	//!< The compressed output.
+	uint64			m_size;			//!< The number of bytes queued so far.
+	bool			m_finishing;	//!< Is m_draining the final buffer?
+	Event			m_filled;		//!< Signalled when m_draining is ready.
+	Event			m_drained;		//!< Signalled when m_draining has been written.
+	bool			m_closed;		//!< Has the file been closed?
+	volatile LONG	m_ioFailed;		//!< Did writing the file fail?
+	tstring			m_ioError;		//!< The reason writing the file failed.
+
+	//
+	// Thread methods.
+	//
+
+	//! Compress and write each buffer as it is handed over.
+	virtual void run();
+
+	//
+	// Internal methods.
+	//
+
+	//! Open the file and start the thread.
+	void open(DWORD disposition, uint64 offset);
+
+	//! Get the space for the next bytes in the caller's buffer.
+	byte* reserve(size_t size);
+
+	//! Hand the caller's buffer over to the thread.
+	void handOver(bool finish);
+
+	//! Compress and write a single buffer.
+	void writeBuffer(const byte* data, size_t size, bool finish);
+
+	//! Write the data to the file.
+	void writeFile(const byte* data, size_t size);
+
+	// NotCopyable.
+	AsyncFileWriter(const AsyncFileWriter&);
+	AsyncFileWriter& operator=(const AsyncFileWriter&);
+};
+
+//! The default AsyncFileWriter smart-pointer type.
+typedef Core::SharedPtr<AsyncFileWriter> AsyncFileWriterPtr;
+
+////////////////////////////////////////////////////////////////////////////////
+//! Get the number of bytes written, or queued, so far. When the file isn't
+//! compressed this is its size once the queued data has been written.
+
+inline uint64 AsyncFileWriter::size() const
+{
+	return m_size;
+}
+
+#endif // APP_ASYNCFILEWRITER_HPP
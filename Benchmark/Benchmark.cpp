@@ -0,0 +1,814 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   Benchmark.cpp
+//! \brief  The end-to-end throughput benchmark for the query command.
+//! \author Chris Oldwood
+
+#include "Common.hpp"
+#include <tchar.h>
+#include "QueryCmd.hpp"
+#include <Core/StringUtils.hpp>
+#include <Core/RuntimeException.hpp>
+#include <Core/CmdLineException.hpp>
+#include <Core/AnsiWide.hpp>
+#include <WCL/Win32Exception.hpp>
+#include <fstream>
+#include <sstream>
+#include <iterator>
+#include <map>
+#include <algorithm>
+#include <psapi.h>
+
+////////////////////////////////////////////////////////////////////////////////
+//! The shape of the results returned by the fake backend.
+
+struct Scenario
+{
+	const tchar*	m_name;				//!< The name used in the report and baseline.
+	size_t			m_numHosts;			//!< The number of hosts queried.
+	size_t			m_rowsPerHost;		//!< The number of objects returned per host.
+	size_t			m_numProperties;	//!< The number of properties per object.
+	size_t			m_arrayLength;		//!< The length of any array values, 0 for none.
+	bool			m_textOnly;			//!< Are all the values plain strings?
+};
+
+//! The scenarios, in the order they are run.
+static const Scenario s_scenarios[] =
+{
+	{ TXT("many-small-hosts"),	2000,	5,		8,		0,	false	},
+	{ TXT("one-huge-result"),	1,		500000,	8,		0,	false	},
+	{ TXT("wide-class"),		1,		20000,	200,	0,	false	},
+	{ TXT("array-heavy"),		1,		50000,	8,		32,	false	},
+	{ TXT("text-heavy"),		1,		100000,	32,		0,	true	},
+};
+
+//! The number of distinct objects the fake backend cycles through.
+static const size_t NUM_TEMPLATES = 16;
+
+//! The default number of times each scenario is run.
+static const size_t DEFAULT_RUNS = 3;
+
+//! The default allowed drop in throughput, or growth in memory, in percent.
+static const double DEFAULT_THRESHOLD = 10.0;
+
+//! The default baseline file.
+static const tchar* DEFAULT_BASELINE = TXT("Baseline.json");
+
+//! The measurements for a scenario, or the baseline, keyed by name.
+typedef std::map<tstring, double> Metrics;
+
+////////////////////////////////////////////////////////////////////////////////
+//! Create a unique name for a temporary file.
+
+static tstring createTempFilename(const tchar* suffix)
+{
+	tchar folder[MAX_PATH+1] = { 0 };
+
+	::GetTempPath(MAX_PATH, folder);
+
+	return Core::fmt(TXT("%sWMICmdBenchmark-%u%s"), folder, ::GetCurrentProcessId(), suffix);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Attach a new one-dimensional array of integers to the value.
+
+static void createIntegerArray(WCL::Variant& value, size_t count, size_t seed)
+{
+	SAFEARRAY* array = ::SafeArrayCreateVector(VT_I4, 0, static_cast<ULONG>(count));
+	int32*     data = nullptr;
+
+	::SafeArrayAccessData(array, reinterpret_cast<void**>(&data));
+
+	for (size_t i = 0; i != count; ++i)
+		data[i] = static_cast<int32>((seed + i) * 7919);
+
+	::SafeArrayUnaccessData(array);
+
+	::VariantClear(&value);
+	V_VT(&value) = VT_ARRAY | VT_I4;
+	V_ARRAY(&value) = array;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Attach a new one-dimensional array of strings to the value.
+
+static void createStringArray(WCL::Variant& value, size_t count, size_t seed)
+{
+	SAFEARRAY* array = ::SafeArrayCreateVector(VT_BSTR, 0, static_cast<ULONG>(count));
+
+	for (LONG i = 0; i != static_cast<LONG>(count); ++i)
+	{
+		const tstring text = Core::fmt(TXT("C:\\Program Files\\Vendor %u\\bin"), static_cast<unsigned>(seed + i));
+		BSTR          item = ::SysAllocString(T2W(text.c_str()));
+
+		::SafeArrayPutElement(array, &i, item);
+		::SysFreeString(item);
+	}
+
+	::VariantClear(&value);
+	V_VT(&value) = VT_ARRAY | VT_BSTR;
+	V_ARRAY(&value) = array;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! The fake backend. It stands in for the WMI queries on each host, below the
+//! query command's own sources, so that the hosts are still scheduled and
+//! queried concurrently as they would be for real. Each host returns the same
+//! number of objects for every query, cycling through a small set of prebuilt
+//! objects so that generating them costs no more than copying the properties
+//! of a real one. The values mix the types WMI returns: strings, integers,
+//! 64-bit integers and datetimes as strings, booleans and, optionally, arrays,
+//! unless they are all plain text.
+
+class FakeBackend : public HostSourceFactory
+{
+public:
+	//! Constructor.
+	FakeBackend(const Scenario& scenario, const Queries& queries, bool showHost, bool showQuery,
+	            bool applyFormatting, size_t maxItems, volatile LONG& numRows);
+
+	//! Create the source of the objects for the host.
+	virtual ObjectSourcePtr createSource(const tstring& host) const;
+
+private:
+	//! The prebuilt objects.
+	typedef std::vector<PropertyValues> Templates;
+
+	//
+	// Members.
+	//
+	const Scenario&				m_scenario;			//!< The shape of the results.
+	Queries						m_queries;			//!< The queries being faked.
+	bool						m_showHost;			//!< Output a heading for each host?
+	bool						m_showQuery;		//!< Output a heading for each query?
+	bool						m_applyFormatting;	//!< Format the output?
+	size_t						m_maxItems;			//!< The limit on objects per query.
+	volatile LONG&				m_numRows;			//!< The number of objects returned.
+	WMI::Object::PropertyNames	m_names;			//!< The property names.
+	Templates					m_templates;		//!< The objects to cycle through.
+
+	friend class FakeSource;
+
+	// NotCopyable.
+	FakeBackend(const FakeBackend&);
+	FakeBackend& operator=(const FakeBackend&);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! The fake results for a single host. A heading is returned at the start of
+//! the host and each query, like the real sources.
+
+class FakeSource : public ObjectSource
+{
+public:
+	//! Constructor.
+	FakeSource(const FakeBackend& backend, const tstring& host);
+
+	//! Fill the snapshot with the next object or heading.
+	virtual bool next(ObjectSnapshot& snapshot);
+
+private:
+	//
+	// Members.
+	//
+	const FakeBackend&	m_backend;		//!< The shared backend.
+	tstring				m_host;			//!< The host being faked.
+	size_t				m_numRows;		//!< The number of objects per query.
+	bool				m_started;		//!< Has the host heading been returned?
+	size_t				m_nextQuery;	//!< The index of the next query.
+	size_t				m_nextRow;		//!< The index of the query's next object.
+
+	//! Fill the snapshot with a heading, which is left empty if not shown.
+	void setHeading(ObjectSnapshot& snapshot, bool show, const tchar* label, const tstring& value);
+
+	// NotCopyable.
+	FakeSource(const FakeSource&);
+	FakeSource& operator=(const FakeSource&);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! Constructor.
+
+FakeBackend::FakeBackend(const Scenario& scenario, const Queries& queries, bool showHost, bool showQuery,
+                         bool applyFormatting, size_t maxItems, volatile LONG& numRows)
+	: m_scenario(scenario)
+	, m_queries(queries)
+	, m_showHost(showHost)
+	, m_showQuery(showQuery)
+	, m_applyFormatting(applyFormatting)
+	, m_maxItems(maxItems)
+	, m_numRows(numRows)
+	, m_names()
+	, m_templates(NUM_TEMPLATES)
+{
+	for (size_t i = 0; i != scenario.m_numProperties; ++i)
+		m_names.push_back(Core::fmt(TXT("Property%u"), static_cast<unsigned>(i)));
+
+	for (size_t t = 0; t != NUM_TEMPLATES; ++t)
+	{
+		PropertyValues& values = m_templates[t];
+
+		values.resize(scenario.m_numProperties);
+
+		for (size_t i = 0; i != values.size(); ++i)
+		{
+			const size_t seed = (t * scenario.m_numProperties) + i;
+
+			if ( (scenario.m_arrayLength != 0) && ((i % 2) == 1) )
+			{
+				if ((i % 4) == 1)
+					createIntegerArray(values[i], scenario.m_arrayLength, seed);
+				else
+					createStringArray(values[i], scenario.m_arrayLength, seed);
+
+				continue;
+			}
+
+			if (scenario.m_textOnly)
+			{
+				values[i] = WCL::Variant(Core::fmt(TXT("Service %u (%s)"), static_cast<unsigned>(seed), ((i % 2) == 0) ? TXT("Running") : TXT("Stopped")).c_str());
+				continue;
+			}
+
+			switch (i % 6)
+			{
+				case 0:	values[i] = WCL::Variant(Core::fmt(TXT("process%u.exe"), static_cast<unsigned>(seed)).c_str());
+						break;
+				case 1:	values[i] = WCL::Variant(static_cast<int32>(seed * 4));
+						break;
+				case 2:	values[i] = WCL::Variant(Core::fmt(TXT("%u000000"), static_cast<unsigned>(seed * 65536)).c_str());
+						break;
+				case 3:	values[i] = WCL::Variant(TXT("20101008181758.546000+060"));
+						break;
+				case 4:	V_VT(&values[i]) = VT_BOOL;
+						V_BOOL(&values[i]) = ((seed % 2) == 0) ? VARIANT_TRUE : VARIANT_FALSE;
+						break;
+				case 5:	values[i] = WCL::Variant(Core::fmt(TXT("C:\\Windows\\system32\\svchost.exe -k netsvcs -p -s Task%u"), static_cast<unsigned>(seed)).c_str());
+						break;
+			}
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Create the source of the objects for the host. This is called from the
+//! query threads and so only reads the prebuilt objects.
+
+ObjectSourcePtr FakeBackend::createSource(const tstring& host) const
+{
+	return ObjectSourcePtr(new FakeSource(*this, host));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Constructor.
+
+FakeSource::FakeSource(const FakeBackend& backend, const tstring& host)
+	: m_backend(backend)
+	, m_host(host)
+	, m_numRows(std::min(backend.m_scenario.m_rowsPerHost, backend.m_maxItems))
+	, m_started(false)
+	, m_nextQuery(0)
+	, m_nextRow(m_numRows)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Fill the snapshot with the next object or heading. The objects are copied
+//! property by property, as a real object's are, and counted as they go.
+
+bool FakeSource::next(ObjectSnapshot& snapshot)
+{
+	if (!m_started)
+	{
+		setHeading(snapshot, m_backend.m_showHost, TXT("Host"), m_host);
+		m_started = true;
+		return true;
+	}
+
+	if (m_nextRow == m_numRows)
+	{
+		if (m_nextQuery == m_backend.m_queries.size())
+			return false;
+
+		setHeading(snapshot, m_backend.m_showQuery, TXT("Query"), m_backend.m_queries[m_nextQuery].m_name);
+		++m_nextQuery;
+		m_nextRow = 0;
+		return true;
+	}
+
+	const size_t          row = static_cast<size_t>(::InterlockedIncrement(&m_backend.m_numRows));
+	const PropertyValues& values = m_backend.m_templates[row % NUM_TEMPLATES];
+
+	snapshot.m_heading.erase();
+	snapshot.m_isObject = true;
+	snapshot.m_names = m_backend.m_names;
+	snapshot.m_values.resize(values.size());
+
+	for (size_t i = 0; i != values.size(); ++i)
+		snapshot.m_values[i] = values[i];
+
+	++m_nextRow;
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Fill the snapshot with a heading, e.g. "Host: <hostname>". A heading that
+//! isn't shown is left empty.
+
+void FakeSource::setHeading(ObjectSnapshot& snapshot, bool show, const tchar* label, const tstring& value)
+{
+	snapshot.m_heading.erase();
+
+	if (show)
+		snapshot.m_heading = Core::fmt(m_backend.m_applyFormatting ? TXT("\n%s: %s\n") : TXT("%s: %s\n"), label, value.c_str());
+
+	snapshot.m_isObject = false;
+	snapshot.m_names.clear();
+	snapshot.m_values.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! The query command with its WMI backend replaced by the fake one. Only the
+//! per-host queries are replaced, so the command still builds its own sources
+//! and schedules the hosts over them.
+
+class BenchmarkCmd : public QueryCmd
+{
+public:
+	//! Constructor.
+	BenchmarkCmd(int argc, tchar* argv[], const Scenario& scenario)
+		: QueryCmd(argc, argv)
+		, m_scenario(scenario)
+		, m_numRows(0)
+	{
+	}
+
+	//! Get the number of objects returned by the fake backend.
+	size_t numRows() const
+	{
+		return static_cast<size_t>(m_numRows);
+	}
+
+private:
+	//
+	// Members.
+	//
+	const Scenario&			m_scenario;		//!< The shape of the results.
+	mutable volatile LONG	m_numRows;		//!< The number of objects returned.
+
+	//! Create the fake backend for the hosts.
+	virtual HostSourceFactoryPtr createHostSources(ConnectionPool& /*connections*/, const Queries& queries, bool showHost,
+	                                               bool showQuery, bool applyFormatting, size_t maxItems) const
+	{
+		return HostSourceFactoryPtr(new FakeBackend(m_scenario, queries, showHost, showQuery, applyFormatting, maxItems, m_numRows));
+	}
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! Get the size of a file in bytes.
+
+static uint64 getFileSize(const tstring& filename)
+{
+	WIN32_FILE_ATTRIBUTE_DATA attributes = { 0 };
+
+	if (!::GetFileAttributesEx(filename.c_str(), GetFileExInfoStandard, &attributes))
+		throw Core::RuntimeException(Core::fmt(TXT("Failed to query the size of '%s'"), filename.c_str()));
+
+	return (static_cast<uint64>(attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Get the peak working set of the process in MB. Each scenario is run in its
+//! own process and so this only covers that scenario.
+
+static double getPeakRssMB()
+{
+	PROCESS_MEMORY_COUNTERS counters = { 0 };
+
+	counters.cb = sizeof(counters);
+
+	if (!::GetProcessMemoryInfo(::GetCurrentProcess(), &counters, sizeof(counters)))
+		return 0.0;
+
+	return static_cast<double>(counters.PeakWorkingSetSize) / (1024.0 * 1024.0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Run the query command once against the scenario's fake backend, writing the
+//! output to a file, and add the throughput to the metrics. The best of the
+//! runs is kept. This is only called in the scenario's own process.
+
+static void runScenario(const Scenario& scenario, Metrics& metrics)
+{
+	const tstring hostsFile = createTempFilename(TXT("-hosts.txt"));
+	const tstring outputFile = createTempFilename(TXT("-output.txt"));
+
+	{
+		std::ofstream hosts(hostsFile.c_str());
+
+		for (size_t i = 0; i != scenario.m_numHosts; ++i)
+			hosts << "HOST" << i << "\n";
+	}
+
+	tstring args[] = { TXT("Benchmark.exe"), TXT("query"), TXT("select * from Win32_Benchmark"), TXT("--hostsfile"), hostsFile,
+	                   TXT("--showhost"), TXT("--output-file"), outputFile };
+	tchar*  argv[ARRAY_SIZE(args)];
+
+	for (size_t i = 0; i != ARRAY_SIZE(args); ++i)
+		argv[i] = const_cast<tchar*>(args[i].c_str());
+
+	BenchmarkCmd   command(ARRAY_SIZE(argv), argv, scenario);
+	tostringstream out, err;
+	LARGE_INTEGER  frequency, start, finish;
+
+	::QueryPerformanceFrequency(&frequency);
+	::QueryPerformanceCounter(&start);
+
+	const int result = command.execute(out, err);
+
+	::QueryPerformanceCounter(&finish);
+
+	const uint64 bytes = getFileSize(outputFile);
+
+	::DeleteFile(hostsFile.c_str());
+	::DeleteFile(outputFile.c_str());
+
+	if (result != EXIT_SUCCESS)
+		throw Core::RuntimeException(Core::fmt(TXT("The %s scenario failed: %s"), scenario.m_name, err.str().c_str()));
+
+	const double seconds = static_cast<double>(finish.QuadPart - start.QuadPart) / static_cast<double>(frequency.QuadPart);
+	const double rowsPerSec = static_cast<double>(command.numRows()) / seconds;
+	const double mbPerSec = (static_cast<double>(bytes) / (1024.0 * 1024.0)) / seconds;
+
+	const tstring prefix = scenario.m_name;
+
+	metrics[prefix + TXT(".rowsPerSec")] = std::max(metrics[prefix + TXT(".rowsPerSec")], rowsPerSec);
+	metrics[prefix + TXT(".mbPerSec")] = std::max(metrics[prefix + TXT(".mbPerSec")], mbPerSec);
+	metrics[prefix + TXT(".peakRssMB")] = getPeakRssMB();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Run the scenario in a child process, so that the peak working set isn't
+//! inflated by any of the scenarios run before it, and read back its metrics.
+//! The child writes each metric on its own line as "<name> <value>".
+
+static void runChildProcess(const Scenario& scenario, size_t runs, Metrics& metrics)
+{
+	tchar program[MAX_PATH+1] = { 0 };
+
+	if (::GetModuleFileName(nullptr, program, MAX_PATH) == 0)
+		throw WCL::Win32Exception(::GetLastError(), TXT("Failed to get the path of the benchmark"));
+
+	const tstring commandLine = Core::fmt(TXT("\"%s\" --child %s --runs %u"), program, scenario.m_name, static_cast<unsigned>(runs));
+
+	SECURITY_ATTRIBUTES security = { static_cast<DWORD>(sizeof(security)), nullptr, TRUE };
+	HANDLE              readPipe = nullptr;
+	HANDLE              writePipe = nullptr;
+
+	if (!::CreatePipe(&readPipe, &writePipe, &security, 0))
+		throw WCL::Win32Exception(::GetLastError(), TXT("Failed to create the pipe for the scenario's output"));
+
+	::SetHandleInformation(readPipe, HANDLE_FLAG_INHERIT, 0);
+
+	STARTUPINFO         startup = { static_cast<DWORD>(sizeof(startup)) };
+	PROCESS_INFORMATION process = { 0 };
+
+	startup.dwFlags = STARTF_USESTDHANDLES;
+	startup.hStdInput = ::GetStdHandle(STD_INPUT_HANDLE);
+	startup.hStdOutput = writePipe;
+	startup.hStdError = writePipe;
+
+	// The command line buffer can be modified by CreateProcess().
+	std::vector<tchar> buffer(commandLine.begin(), commandLine.end());
+
+	buffer.push_back(TXT('\0'));
+
+	const BOOL  started = ::CreateProcess(nullptr, &buffer[0], nullptr, nullptr, TRUE, 0, nullptr, nullptr, &startup, &process);
+	const DWORD error = ::GetLastError();
+
+	::CloseHandle(writePipe);
+
+	if (!started)
+	{
+		::CloseHandle(readPipe);
+		throw WCL::Win32Exception(error, Core::fmt(TXT("Failed to start the %s scenario"), scenario.m_name));
+	}
+
+	std::string output;
+	char        chunk[4096];
+	DWORD       numRead = 0;
+
+	while (::ReadFile(readPipe, chunk, sizeof(chunk), &numRead, nullptr) && (numRead != 0))
+		output.append(chunk, numRead);
+
+	::CloseHandle(readPipe);
+	::WaitForSingleObject(process.hProcess, INFINITE);
+
+	DWORD exitCode = EXIT_FAILURE;
+
+	::GetExitCodeProcess(process.hProcess, &exitCode);
+	::CloseHandle(process.hThread);
+	::CloseHandle(process.hProcess);
+
+	if (exitCode != EXIT_SUCCESS)
+		throw Core::RuntimeException(Core::fmt(TXT("The %s scenario failed: %hs"), scenario.m_name, output.c_str()));
+
+	std::istringstream lines(output);
+	std::string        name;
+	double             value = 0.0;
+
+	while (lines >> name >> value)
+		metrics[tstring(A2T(name.c_str()))] = value;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! The body of the child process for a scenario. It runs the scenario and
+//! writes the metrics to stdout for the parent.
+
+static int runChild(const Scenario& scenario, size_t runs)
+{
+	Metrics metrics;
+
+	for (size_t i = 0; i != runs; ++i)
+		runScenario(scenario, metrics);
+
+	for (Metrics::const_iterator it = metrics.begin(); it != metrics.end(); ++it)
+		tcout << Core::fmt(TXT("%s %.3f"), it->first.c_str(), it->second) << std::endl;
+
+	return EXIT_SUCCESS;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Read the baseline metrics. The file is a flat JSON object of numbers, e.g.
+//! { "one-huge-result.rowsPerSec": 250000 }. A missing file is treated as an
+//! empty baseline, which only fails the scenarios if a baseline is required.
+
+static Metrics readBaseline(const tstring& filename)
+{
+	Metrics       baseline;
+	std::ifstream file(filename.c_str());
+
+	if (!file.is_open())
+		return baseline;
+
+	const std::string json((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	size_t            pos = 0;
+
+	while ((pos = json.find('"', pos)) != std::string::npos)
+	{
+		const size_t end = json.find('"', pos+1);
+		const size_t colon = json.find_first_not_of(" \t\r\n", end+1);
+
+		if ( (end == std::string::npos) || (colon == std::string::npos) || (json[colon] != ':') )
+			throw Core::RuntimeException(Core::fmt(TXT("Invalid baseline file '%s'"), filename.c_str()));
+
+		const std::string name = json.substr(pos+1, end-pos-1);
+		const char*       number = json.c_str() + colon + 1;
+		char*             numberEnd = nullptr;
+		const double      value = strtod(number, &numberEnd);
+
+		if (numberEnd == number)
+			throw Core::RuntimeException(Core::fmt(TXT("Invalid value for '%hs' in baseline file '%s'"), name.c_str(), filename.c_str()));
+
+		baseline[tstring(A2T(name.c_str()))] = value;
+		pos = numberEnd - json.c_str();
+	}
+
+	return baseline;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Write the metrics as the new baseline.
+
+static void writeBaseline(const tstring& filename, const Metrics& metrics)
+{
+	std::ofstream file(filename.c_str());
+
+	if (!file.is_open())
+		throw Core::RuntimeException(Core::fmt(TXT("Failed to create the baseline file '%s'"), filename.c_str()));
+
+	file << "{";
+
+	for (Metrics::const_iterator it = metrics.begin(); it != metrics.end(); ++it)
+	{
+		file << ((it == metrics.begin()) ? "\n" : ",\n");
+		file << "\t\"" << T2A(it->first.c_str()) << "\": " << static_cast<uint64>(it->second + 0.5);
+	}
+
+	file << "\n}\n";
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Check if the baseline has a value for the metric. A value of zero is only a
+//! placeholder and so doesn't count.
+
+static bool hasBaseline(const tstring& name, const Metrics& baseline)
+{
+	Metrics::const_iterator it = baseline.find(name);
+
+	return (it != baseline.end()) && (it->second != 0.0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Compare a metric with the baseline. Throughput regresses when it drops and
+//! memory when it grows by more than the threshold. The metric must be in the
+//! baseline.
+
+static bool hasRegressed(const tstring& name, double value, const Metrics& baseline, double threshold)
+{
+	Metrics::const_iterator it = baseline.find(name);
+
+	ASSERT(hasBaseline(name, baseline));
+
+	const double change = ((value - it->second) / it->second) * 100.0;
+	const bool   isMemory = (name.find(TXT(".peakRssMB")) != tstring::npos);
+
+	return (isMemory) ? (change > threshold) : (-change > threshold);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Display the program usage.
+
+static void showUsage(tostream& out)
+{
+	out << TXT("USAGE: Benchmark [--baseline <file>] [--save-baseline] [--require-baseline] [--threshold <percent>] [--runs <count>] [scenario ...]") << std::endl;
+	out << std::endl;
+	out << TXT("Scenarios:") << std::endl;
+
+	for (size_t i = 0; i != ARRAY_SIZE(s_scenarios); ++i)
+		out << TXT("  ") << s_scenarios[i].m_name << std::endl;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Run the scenarios and compare the results with the baseline. Each scenario
+//! is run in its own process. Returns EXIT_FAILURE if any of them have
+//! regressed, or are missing from the baseline when one is required, unless a
+//! new baseline is being saved.
+
+static int runBenchmark(int argc, tchar* argv[])
+{
+	tstring                     baselineFile = DEFAULT_BASELINE;
+	bool                        saveBaseline = false;
+	bool                        requireBaseline = false;
+	double                      threshold = DEFAULT_THRESHOLD;
+	size_t                      runs = DEFAULT_RUNS;
+	bool                        isChild = false;
+	std::vector<const Scenario*> scenarios;
+
+	for (int i = 1; i != argc; ++i)
+	{
+		const tstring arg = argv[i];
+		const bool    hasValue = ((i+1) != argc);
+
+		if ( (arg == TXT("--baseline")) && hasValue )
+		{
+			baselineFile = argv[++i];
+		}
+		else if (arg == TXT("--save-baseline"))
+		{
+			saveBaseline = true;
+		}
+		else if (arg == TXT("--require-baseline"))
+		{
+			requireBaseline = true;
+		}
+		else if ( (arg == TXT("--threshold")) && hasValue )
+		{
+			threshold = Core::parse<double>(argv[++i]);
+		}
+		else if ( (arg == TXT("--runs")) && hasValue )
+		{
+			runs = Core::parse<size_t>(argv[++i]);
+		}
+		else if (arg == TXT("--child"))
+		{
+			isChild = true;
+		}
+		else if ( (arg == TXT("--help")) || (arg == TXT("-?")) )
+		{
+			showUsage(tcout);
+			return EXIT_SUCCESS;
+		}
+		else
+		{
+			const Scenario* scenario = nullptr;
+
+			for (size_t s = 0; s != ARRAY_SIZE(s_scenarios); ++s)
+			{
+				if (arg == s_scenarios[s].m_name)
+					scenario = &s_scenarios[s];
+			}
+
+			if (scenario == nullptr)
+				throw Core::CmdLineException(Core::fmt(TXT("Invalid argument '%s'"), arg.c_str()));
+
+			scenarios.push_back(scenario);
+		}
+	}
+
+	if (runs == 0)
+		throw Core::CmdLineException(TXT("--runs must be at least 1"));
+
+	if (isChild)
+	{
+		if (scenarios.size() != 1)
+			throw Core::CmdLineException(TXT("--child requires a single scenario"));
+
+		return runChild(*scenarios.front(), runs);
+	}
+
+	if (scenarios.empty())
+	{
+		for (size_t s = 0; s != ARRAY_SIZE(s_scenarios); ++s)
+			scenarios.push_back(&s_scenarios[s]);
+	}
+
+	const Metrics baseline = readBaseline(baselineFile);
+	Metrics       metrics;
+	bool          regressed = false;
+	bool          unbaselined = false;
+
+	tcout << Core::fmt(TXT("%-18s %12s %10s %14s"), TXT("Scenario"), TXT("Rows/s"), TXT("MB/s"), TXT("Peak RSS (MB)")) << std::endl;
+
+	for (size_t s = 0; s != scenarios.size(); ++s)
+	{
+		const Scenario& scenario = *scenarios[s];
+		const tstring   prefix = scenario.m_name;
+
+		runChildProcess(scenario, runs, metrics);
+
+		const double rowsPerSec = metrics[prefix + TXT(".rowsPerSec")];
+		const double mbPerSec = metrics[prefix + TXT(".mbPerSec")];
+		const double peakRssMB = metrics[prefix + TXT(".peakRssMB")];
+
+		const bool missing = !hasBaseline(prefix + TXT(".rowsPerSec"), baseline)
+		                  || !hasBaseline(prefix + TXT(".mbPerSec"), baseline)
+		                  || !hasBaseline(prefix + TXT(".peakRssMB"), baseline);
+		const bool slower = !missing && ( hasRegressed(prefix + TXT(".rowsPerSec"), rowsPerSec, baseline, threshold)
+		                               || hasRegressed(prefix + TXT(".mbPerSec"), mbPerSec, baseline, threshold) );
+		const bool bigger = !missing && hasRegressed(prefix + TXT(".peakRssMB"), peakRssMB, baseline, threshold);
+
+		tcout << Core::fmt(TXT("%-18s %12.0f %10.1f %14.1f"), scenario.m_name, rowsPerSec, mbPerSec, peakRssMB);
+
+		if (missing)
+			tcout << TXT("  NO BASELINE");
+
+		if (slower)
+			tcout << TXT("  REGRESSED (throughput)");
+
+		if (bigger)
+			tcout << TXT("  REGRESSED (memory)");
+
+		tcout << std::endl;
+
+		regressed = regressed || slower || bigger;
+		unbaselined = unbaselined || missing;
+	}
+
+	if (saveBaseline)
+	{
+		writeBaseline(baselineFile, metrics);
+		tcout << TXT("Baseline saved to '") << baselineFile << TXT("'") << std::endl;
+		return EXIT_SUCCESS;
+	}
+
+	if (unbaselined && requireBaseline)
+	{
+		tcout << Core::fmt(TXT("FAILED: No baseline for some scenarios in '%s', record one with --save-baseline"), baselineFile.c_str()) << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	if (regressed)
+	{
+		tcout << Core::fmt(TXT("FAILED: Regressed by more than %.0f%% against '%s'"), threshold, baselineFile.c_str()) << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! The benchmark entry point.
+
+int _tmain(int argc, _TCHAR* argv[])
+{
+	try
+	{
+		return runBenchmark(argc, argv);
+	}
+	catch (const Core::CmdLineException& e)
+	{
+		tcerr << TXT("ERROR: ") << e.twhat() << std::endl;
+		showUsage(tcerr);
+	}
+	catch (const Core::Exception& e)
+	{
+		tcerr << TXT("ERROR: ") << e.twhat() << std::endl;
+	}
+	catch (const std::exception& e)
+	{
+		tcerr << TXT("ERROR: ") << e.what() << std::endl;
+	}
+
+	return EXIT_FAILURE;
+}
@@ -0,0 +1,176 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   BoundedQueue.hpp
+//! \brief  The BoundedQueue class declaration.
+//! \author Chris Oldwood
+
+// Check for previous inclusion
+#ifndef APP_BOUNDEDQUEUE_HPP
+#define APP_BOUNDEDQUEUE_HPP
+
+#if _MSC_VER > 1000
+#pragma once
+#endif
+
+#include "Threading.hpp"
+#include <deque>
+
+////////////////////////////////////////////////////////////////////////////////
+//! A fixed capacity FIFO queue for passing items between threads. Producers
+//! block when the queue is full and consumers block when it is empty. Once the
+//! queue has been closed, and drained, pop() returns false to every consumer.
+
+template <typename T>
+class BoundedQueue
+{
+public:
+	//! Constructor.
+	explicit BoundedQueue(size_t capacity);
+
+	//! Destructor.
+	~BoundedQueue();
+
+	//! Append an item, waiting for space if the queue is full.
+	void push(const T& item);
+
+	//! Remove the next item, waiting for one if the queue is empty. Returns
+	//! false if the queue has been closed and is empty.
+	bool pop(T& item);
+
+	//! Remove the next item if there is one available without waiting.
+	bool tryPop(T& item);
+
+	//! Mark the end of the items. No more items can be pushed.
+	void close();
+
+private:
+	//
+	// Members.
+	//
+	CriticalSection	m_lock;		//!< The lock for the items.
+	std::deque<T>	m_items;	//!< The queued items.
+	bool			m_closed;	//!< Has the queue been closed?
+	Semaphore		m_space;	//!< The number of free slots.
+	Semaphore		m_ready;	//!< The number of items, plus one once closed.
+
+	//
+	// Internal methods.
+	//
+
+	//! Remove the next item, after the caller has claimed it.
+	bool take(T& item);
+
+	// NotCopyable.
+	BoundedQueue(const BoundedQueue&);
+	BoundedQueue& operator=(const BoundedQueue&);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! Constructor.
+
+template <typename T>
+inline BoundedQueue<T>::BoundedQueue(size_t capacity)
+	: m_lock()
+	, m_items()
+	, m_closed(false)
+	, m_space(static_cast<LONG>(capacity))
+	, m_ready(0)
+{
+	ASSERT(capacity != 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Destructor.
+
+template <typename T>
+inline BoundedQueue<T>::~BoundedQueue()
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Append an item, waiting for space if the queue is full.
+
+template <typename T>
+inline void BoundedQueue<T>::push(const T& item)
+{
+	m_space.wait();
+
+	{
+		AutoLock lock(m_lock);
+
+		ASSERT(!m_closed);
+
+		m_items.push_back(item);
+	}
+
+	m_ready.release();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Remove the next item, waiting for one if the queue is empty. Returns false
+//! if the queue has been closed and is empty.
+
+template <typename T>
+inline bool BoundedQueue<T>::pop(T& item)
+{
+	m_ready.wait();
+
+	return take(item);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Remove the next item if there is one available without waiting.
+
+template <typename T>
+inline bool BoundedQueue<T>::tryPop(T& item)
+{
+	if (!m_ready.wait(0))
+		return false;
+
+	return take(item);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Mark the end of the items. The extra count on the ready semaphore is passed
+//! on by each consumer that sees an empty queue so that they all wake up.
+
+template <typename T>
+inline void BoundedQueue<T>::close()
+{
+	{
+		AutoLock lock(m_lock);
+
+		m_closed = true;
+	}
+
+	m_ready.release();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Remove the next item, after the caller has claimed it.
+
+template <typename T>
+inline bool BoundedQueue<T>::take(T& item)
+{
+	{
+		AutoLock lock(m_lock);
+
+		if (!m_items.empty())
+		{
+			item = m_items.front();
+			m_items.pop_front();
+		}
+		else
+		{
+			ASSERT(m_closed);
+
+			m_ready.release();
+			return false;
+		}
+	}
+
+	m_space.release();
+
+	return true;
+}
+
+#endif // APP_BOUNDEDQUEUE_HPP
@@ -27,6 +27,35 @@ enum CmdLineArgType
 	ALIGN			= 8,	//!< Align the output.
 	HOSTSFILE		= 9,	//!< The file with a list of hostnames.
 	TOP				= 10,	//!< Only show the first N items
+	NAMESPACE		= 11,	//!< The namespace to start crawling from.
+	THREADS			= 12,	//!< The number of worker threads.
+	CACHE			= 13,	//!< The file used to cache results.
+	REFRESH			= 14,	//!< Ignore any cached results.
+	PIPE			= 15,	//!< The name of the server pipe.
+	OUTPUT_FILE		= 16,	//!< The file to write the output to.
+	COMPRESS		= 17,	//!< The method used to compress the output file.
+	LEVEL			= 18,	//!< The compression level.
+	QUERY_FILE		= 19,	//!< The file with a list of queries.
+	SAMPLE			= 20,	//!< The number of objects to sample.
+	SEED			= 21,	//!< The seed for choosing the sample.
+	SAMPLE_SCOPE	= 22,	//!< Sample per host or across all hosts.
+	MAX_HOSTS		= 23,	//!< The most hosts queried at once.
+	TARGET_LATENCY	= 24,	//!< The target p95 latency for a host.
+	KEY				= 25,	//!< The property which identifies an object.
+	MAX_MEMORY		= 26,	//!< The memory budget in MB.
+	COOK			= 27,	//!< Cook raw performance counters.
+	INTERVAL		= 28,	//!< The time between samples.
+	REPEAT			= 29,	//!< The number of cooked samples.
+	TABLE			= 30,	//!< Output the results as a table.
+	TABLE_SAMPLE	= 31,	//!< The rows used to size the table's columns.
+	MAX_WIDTH		= 32,	//!< The widest a table column can be.
+	WRAP			= 33,	//!< Wrap, rather than truncate, wide values.
+	OUTPUT_DIR		= 34,	//!< The folder to write a file per host to.
+	MAX_OPEN_FILES	= 35,	//!< The most host files written at once.
+	JOURNAL			= 36,	//!< The file to record the completed hosts in.
+	RESUME			= 37,	//!< Skip the hosts already completed.
+	MEMSTATS		= 38,	//!< Report the allocations made by each stage.
+	FILTER			= 39,	//!< Only output the objects that match an expression.
 	MANUAL			= 99,	//!< Show the manual.
 };
 
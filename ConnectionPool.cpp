@@ -0,0 +1,124 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   ConnectionPool.cpp
+//! \brief  The ConnectionPool class definition.
+//! \author Chris Oldwood
+
+#include "Common.hpp"
+#include "ConnectionPool.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+//! Constructor.
+
+ConnectionPool::ConnectionPool(size_t maxIdlePerHost, DWORD maxIdleTime)
+	: m_maxIdlePerHost(maxIdlePerHost)
+	, m_maxIdleTime(maxIdleTime)
+	, m_lock()
+	, m_connections()
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Destructor.
+
+ConnectionPool::~ConnectionPool()
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Take an idle connection to the host from the pool or open a new one.
+
+ConnectionPtr ConnectionPool::acquire(const tstring& host, const tstring& user, const tstring& password)
+{
+	const tstring key = makeKey(host, user, password);
+	const DWORD   now = ::GetTickCount();
+
+	{
+		AutoLock lock(m_lock);
+
+		HostConnections::iterator it = m_connections.find(key);
+
+		if (it != m_connections.end())
+		{
+			IdleConnections& idle = it->second;
+
+			// Use the most recently returned connection first so that the
+			// stale ones age out from the front.
+			while (!idle.empty() && ((now - idle.front().m_released) > m_maxIdleTime))
+				idle.pop_front();
+
+			if (!idle.empty())
+			{
+				ConnectionPtr connection = idle.back().m_connection;
+
+				idle.pop_back();
+
+				return connection;
+			}
+		}
+	}
+
+	// Open the connection outside the lock as authentication can be slow.
+	ConnectionPtr connection(new WMI::Connection);
+
+	if (host == WMI::Connection::LOCALHOST)
+		connection->open();
+	else
+		connection->open(host, user, password);
+
+	return connection;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Return a healthy connection to the pool.
+
+void ConnectionPool::release(const tstring& host, const tstring& user, const tstring& password, const ConnectionPtr& connection)
+{
+	if (m_maxIdlePerHost == 0)
+		return;
+
+	const tstring key = makeKey(host, user, password);
+
+	IdleConnection idle;
+
+	idle.m_connection = connection;
+	idle.m_released = ::GetTickCount();
+
+	AutoLock lock(m_lock);
+
+	IdleConnections& connections = m_connections[key];
+
+	if (connections.size() == m_maxIdlePerHost)
+		connections.pop_front();
+
+	connections.push_back(idle);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Get the number of idle connections in the pool.
+
+size_t ConnectionPool::numIdle() const
+{
+	AutoLock lock(m_lock);
+
+	size_t count = 0;
+
+	for (HostConnections::const_iterator it = m_connections.begin(); it != m_connections.end(); ++it)
+		count += it->second.size();
+
+	return count;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Create the key used to look up connections.
+
+tstring ConnectionPool::makeKey(const tstring& host, const tstring& user, const tstring& password)
+{
+	tstring key(host);
+
+	key += TXT('\n');
+	key += user;
+	key += TXT('\n');
+	key += password;
+
+	return key;
+}
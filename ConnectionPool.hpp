@@ -0,0 +1,86 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   ConnectionPool.hpp
+//! \brief  The ConnectionPool class declaration.
+//! \author Chris Oldwood
+
+// Check for previous inclusion
+#ifndef APP_CONNECTIONPOOL_HPP
+#define APP_CONNECTIONPOOL_HPP
+
+#if _MSC_VER > 1000
+#pragma once
+#endif
+
+#include "Threading.hpp"
+#include <WMI/Connection.hpp>
+#include <Core/SharedPtr.hpp>
+#include <deque>
+#include <map>
+
+//! The default connection smart-pointer type.
+typedef Core::SharedPtr<WMI::Connection> ConnectionPtr;
+
+////////////////////////////////////////////////////////////////////////////////
+//! A pool of open, authenticated connections keyed on the host and credentials.
+//! A connection is taken out of the pool for the duration of a query and only
+//! returned once the query has succeeded, so a connection that failed is never
+//! reused. Connections that have sat idle for too long are discarded as the
+//! remote end may well have gone away in the meantime.
+
+class ConnectionPool
+{
+public:
+	//! Constructor.
+	ConnectionPool(size_t maxIdlePerHost, DWORD maxIdleTime);
+
+	//! Destructor.
+	~ConnectionPool();
+
+	//! Take an idle connection to the host from the pool or open a new one.
+	ConnectionPtr acquire(const tstring& host, const tstring& user, const tstring& password);
+
+	//! Return a healthy connection to the pool.
+	void release(const tstring& host, const tstring& user, const tstring& password, const ConnectionPtr& connection);
+
+	//! Get the number of idle connections in the pool.
+	size_t numIdle() const;
+
+	//
+	// Constants.
+	//
+
+	//! The default time (ms) a connection can be idle before it's discarded.
+	static const DWORD DEFAULT_MAX_IDLE_TIME = 5 * 60 * 1000;
+
+private:
+	//! An idle connection.
+	struct IdleConnection
+	{
+		ConnectionPtr	m_connection;	//!< The connection.
+		DWORD			m_released;		//!< When it was returned to the pool.
+	};
+
+	typedef std::deque<IdleConnection> IdleConnections;
+	typedef std::map<tstring, IdleConnections> HostConnections;
+
+	//
+	// Members.
+	//
+	size_t					m_maxIdlePerHost;	//!< The limit on idle connections per host.
+	DWORD					m_maxIdleTime;		//!< The time after which they're discarded.
+	mutable CriticalSection	m_lock;				//!< The lock protecting the pool.
+	HostConnections			m_connections;		//!< The idle connections by host.
+
+	//
+	// Internal methods.
+	//
+
+	//! Create the key used to look up connections.
+	static tstring makeKey(const tstring& host, const tstring& user, const tstring& password);
+
+	// NotCopyable.
+	ConnectionPool(const ConnectionPool&);
+	ConnectionPool& operator=(const ConnectionPool&);
+};
+
+#endif // APP_CONNECTIONPOOL_HPP
@@ -0,0 +1,272 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   CookingSource.cpp
+//! \brief  The CookingSource class definition.
+//! \author Chris Oldwood
+
+#include "Common.hpp"
+#include "CookingSource.hpp"
+#include <Core/StringUtils.hpp>
+
+//! The property which identifies an instance of a counter class.
+static const tchar* INSTANCE_PROPERTY = TXT("Name");
+
+//! The label at the start of a host heading.
+static const tchar HOST_LABEL[] = TXT("Host: ");
+
+//! The length of the host heading label.
+static const size_t HOST_LABEL_LENGTH = ARRAY_SIZE(HOST_LABEL) - 1;
+
+//! The label at the start of a query heading.
+static const tchar QUERY_LABEL[] = TXT("Query: ");
+
+//! The length of the query heading label.
+static const size_t QUERY_LABEL_LENGTH = ARRAY_SIZE(QUERY_LABEL) - 1;
+
+//! The label at the start of an error heading.
+static const tchar ERROR_LABEL[] = TXT("Error: ");
+
+//! The length of the error heading label.
+static const size_t ERROR_LABEL_LENGTH = ARRAY_SIZE(ERROR_LABEL) - 1;
+
+//! The query index used before the host's first query heading.
+static const size_t NO_QUERY = static_cast<size_t>(-1);
+
+////////////////////////////////////////////////////////////////////////////////
+//! Constructor.
+
+CookingSource::CookingSource(const tstring& user, const tstring& password,
+                             const Queries& queries, bool showHost, bool showQuery, bool showSample, bool applyFormatting)
+	: m_user(user)
+	, m_password(password)
+	, m_queries(queries)
+	, m_showHost(showHost)
+	, m_showQuery(showQuery)
+	, m_showSample(showSample)
+	, m_applyFormatting(applyFormatting)
+	, m_source(nullptr)
+	, m_numSamples(0)
+	, m_headingDue(false)
+	, m_host()
+	, m_query(NO_QUERY)
+	, m_schemas()
+	, m_previous()
+	, m_cooked()
+	, m_key()
+{
+	ASSERT(!m_queries.empty());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Destructor.
+
+CookingSource::~CookingSource()
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Start reading the next sample from the source. The source must query the
+//! same hosts and queries, in the same order, each time. The objects that were
+//! missing from the previous sample are forgotten first.
+
+void CookingSource::startSample(ObjectSource& source)
+{
+	forgetMissingObjects();
+
+	m_source = &source;
+	m_headingDue = m_showSample && (m_numSamples != 0);
+	m_host.erase();
+	m_query = NO_QUERY;
+
+	++m_numSamples;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Fill the snapshot with the next cooked object or heading. Only the errors
+//! are passed on from the first sample. An object that is new in this sample is
+//! skipped as there is nothing to cook it against yet.
+
+bool CookingSource::next(ObjectSnapshot& snapshot)
+{
+	ASSERT(m_source != nullptr);
+
+	const bool isFirstSample = (m_numSamples == 1);
+
+	for (;;)
+	{
+		if (m_headingDue)
+		{
+			m_headingDue = false;
+
+			snapshot.m_heading.erase();
+
+			if (m_applyFormatting)
+				snapshot.m_heading += TXT('\n');
+
+			snapshot.m_heading += Core::fmt(TXT("Sample: %u\n"), static_cast<unsigned>(m_numSamples-1));
+			snapshot.m_isObject = false;
+			snapshot.m_names.clear();
+			snapshot.m_values.clear();
+
+			return true;
+		}
+
+		if (!m_source->next(snapshot))
+			return false;
+
+		if (!snapshot.m_isObject)
+		{
+			if (processHeading(snapshot.m_heading))
+				return true;
+
+			continue;
+		}
+
+		if (m_query == NO_QUERY)
+			continue;
+
+		m_key = Core::fmt(TXT("%s/%u/"), m_host.c_str(), static_cast<unsigned>(m_query));
+
+		for (size_t i = 0; i != snapshot.m_names.size(); ++i)
+		{
+			if (snapshot.m_names[i] == INSTANCE_PROPERTY)
+			{
+				m_key += snapshot.m_values[i].format();
+				break;
+			}
+		}
+
+		Sample& previous = m_previous[m_key];
+
+		const bool isCooked = !isFirstSample && !previous.m_snapshot.m_names.empty()
+		                   && cookObject(getCounterTypes(), previous.m_snapshot, snapshot, m_cooked);
+
+		// Keep the raw values for cooking the next sample.
+		previous.m_snapshot.swap(snapshot);
+		previous.m_sample = m_numSamples;
+
+		if (isCooked)
+		{
+			snapshot.swap(m_cooked);
+			return true;
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Track the current host and query from a heading and empty it if it isn't
+//! shown. An error heading names the host when the host's own heading isn't
+//! shown, which includes every host in the first sample. Returns false if the
+//! heading is not to be passed on.
+
+bool CookingSource::processHeading(tstring& heading)
+{
+	const bool isFirstSample = (m_numSamples == 1);
+
+	tstring text = heading;
+
+	Core::trim(text);
+
+	if (text.compare(0, HOST_LABEL_LENGTH, HOST_LABEL) == 0)
+	{
+		m_host = text.substr(HOST_LABEL_LENGTH);
+		m_query = NO_QUERY;
+
+		if (!m_showHost)
+			heading.erase();
+
+		return !isFirstSample;
+	}
+
+	if (text.compare(0, QUERY_LABEL_LENGTH, QUERY_LABEL) == 0)
+	{
+		m_query = findQuery(text.substr(QUERY_LABEL_LENGTH));
+
+		if (!m_showQuery)
+			heading.erase();
+
+		return !isFirstSample;
+	}
+
+	if (text.compare(0, ERROR_LABEL_LENGTH, ERROR_LABEL) == 0)
+	{
+		if (isFirstSample || !m_showHost)
+		{
+			heading.erase();
+
+			if (m_applyFormatting)
+				heading += TXT('\n');
+
+			heading += ERROR_LABEL + m_host + TXT(": ") + text.substr(ERROR_LABEL_LENGTH) + TXT('\n');
+		}
+
+		return true;
+	}
+
+	return !isFirstSample;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Find the query with the given name. The queries are run in order and so the
+//! search starts after the current one, as the same name may be used twice.
+//! Returns NO_QUERY if there is no such query.
+
+size_t CookingSource::findQuery(const tstring& name) const
+{
+	const size_t first = (m_query == NO_QUERY) ? 0 : m_query+1;
+
+	for (size_t i = first; i != m_queries.size(); ++i)
+	{
+		if (m_queries[i].m_name == name)
+			return i;
+	}
+
+	for (size_t i = 0; i != first; ++i)
+	{
+		if (m_queries[i].m_name == name)
+			return i;
+	}
+
+	return NO_QUERY;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Get the counter types for the current query's class. The schema is read
+//! from the first host that returns an object of the class.
+
+const CounterTypes& CookingSource::getCounterTypes()
+{
+	const tstring className = getQueryClass(m_queries[m_query].m_text);
+
+	Schemas::iterator it = m_schemas.find(className);
+
+	if (it == m_schemas.end())
+	{
+		CounterTypes types;
+
+		if (!className.empty())
+			readCounterTypes(m_host, m_user, m_password, className, types);
+
+		it = m_schemas.insert(Schemas::value_type(className, types)).first;
+	}
+
+	return it->second;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Forget the objects that were missing from the last sample, so that the
+//! objects which come and go, such as processes, don't accumulate when the
+//! counters are sampled indefinitely. An object is also forgotten if the sample
+//! wasn't read to the end before it was reached.
+
+void CookingSource::forgetMissingObjects()
+{
+	Samples::iterator it = m_previous.begin();
+
+	while (it != m_previous.end())
+	{
+		if (it->second.m_sample != m_numSamples)
+			m_previous.erase(it++);
+		else
+			++it;
+	}
+}
@@ -0,0 +1,99 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   CookingSource.hpp
+//! \brief  The CookingSource class declaration.
+//! \author Chris Oldwood
+
+// Check for previous inclusion
+#ifndef APP_COOKINGSOURCE_HPP
+#define APP_COOKINGSOURCE_HPP
+
+#if _MSC_VER > 1000
+#pragma once
+#endif
+
+#include "FormattingPipeline.hpp"
+#include "PerfCounters.hpp"
+#include "Queries.hpp"
+#include <map>
+
+////////////////////////////////////////////////////////////////////////////////
+//! A source which turns repeated samples of raw performance counters, such as
+//! the Win32_PerfRawData classes, into their displayable values. Each sample is
+//! read from a fresh source for the same hosts and queries. The objects from
+//! the first sample are only remembered and each later sample is cooked against
+//! the one before it. An object is matched with its previous sample by its
+//! host, query and "Name" property, and an object that is missing from a sample
+//! is forgotten, e.g. a process that has exited. The host and query are taken
+//! from the text of their headings, and so the source must always label them;
+//! the headings that aren't to be shown are emptied here. The CounterType
+//! qualifiers of each class are read once and then shared by all the hosts.
+
+class CookingSource : public ObjectSource
+{
+public:
+	//! Constructor.
+	CookingSource(const tstring& user, const tstring& password,
+	              const Queries& queries, bool showHost, bool showQuery, bool showSample, bool applyFormatting);
+
+	//! Destructor.
+	virtual ~CookingSource();
+
+	//! Start reading the next sample from the source.
+	void startSample(ObjectSource& source);
+
+	//! Fill the snapshot with the next cooked object or heading.
+	virtual bool next(ObjectSnapshot& snapshot);
+
+private:
+	//! The previous sample of an object.
+	struct Sample
+	{
+		ObjectSnapshot	m_snapshot;	//!< The raw values.
+		size_t			m_sample;	//!< The sample the object was last seen in.
+	};
+
+	typedef std::map<tstring, Sample> Samples;
+	typedef std::map<tstring, CounterTypes> Schemas;
+
+	//
+	// Members.
+	//
+	tstring			m_user;				//!< The login for remote hosts.
+	tstring			m_password;			//!< The password for remote hosts.
+	Queries			m_queries;			//!< The WQL queries.
+	bool			m_showHost;			//!< Output the host headings?
+	bool			m_showQuery;		//!< Output the query headings?
+	bool			m_showSample;		//!< Output a heading for each sample?
+	bool			m_applyFormatting;	//!< Format the output?
+	ObjectSource*	m_source;			//!< The source of the current sample.
+	size_t			m_numSamples;		//!< The number of samples started.
+	bool			m_headingDue;		//!< Is the sample's heading still to be output?
+	tstring			m_host;				//!< The current host.
+	size_t			m_query;			//!< The index of the current query.
+	Schemas			m_schemas;			//!< The counter types by class name.
+	Samples			m_previous;			//!< The previous sample of each object.
+	ObjectSnapshot	m_cooked;			//!< The cooked object.
+	tstring			m_key;				//!< The key of the current object.
+
+	//
+	// Internal methods.
+	//
+
+	//! Track the current host and query from a heading.
+	bool processHeading(tstring& heading);
+
+	//! Find the query with the given name.
+	size_t findQuery(const tstring& name) const;
+
+	//! Get the counter types for the current query's class.
+	const CounterTypes& getCounterTypes();
+
+	//! Forget the objects that were missing from the last sample.
+	void forgetMissingObjects();
+
+	// NotCopyable.
+	CookingSource(const CookingSource&);
+	CookingSource& operator=(const CookingSource&);
+};
+
+#endif // APP_COOKINGSOURCE_HPP
@@ -0,0 +1,119 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   DiffCmd.cpp
+//! \brief  The DiffCmd class definition.
+//! \author Chris Oldwood
+
+#include "Common.hpp"
+#include "DiffCmd.hpp"
+#include "CmdLineArgs.hpp"
+#include <Core/CmdLineException.hpp>
+#include <Core/StringUtils.hpp>
+#include <WCL/Win32Exception.hpp>
+#include "ResultDiff.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+//! The table of command specific command line switches.
+
+static Core::CmdLineSwitch s_switches[] = 
+{
+	{ USAGE,		TXT("?"),	NULL,				Core::CmdLineSwitch::ONCE,	Core::CmdLineSwitch::NONE,		NULL,				TXT("Display the command syntax")						},
+	{ USAGE,		NULL,		TXT("help"),		Core::CmdLineSwitch::ONCE,	Core::CmdLineSwitch::NONE,		NULL,				TXT("Display the command syntax")						},
+	{ KEY,			TXT("k"),	TXT("key"),			Core::CmdLineSwitch::ONCE,	Core::CmdLineSwitch::SINGLE,	TXT("property"),	TXT("The property which identifies each object")		},
+	{ MAX_MEMORY,	TXT("mm"),	TXT("max-memory"),	Core::CmdLineSwitch::ONCE,	Core::CmdLineSwitch::SINGLE,	TXT("MB"),			TXT("The memory to use before spilling to disk (default: 256)")	},
+};
+static size_t s_switchCount = ARRAY_SIZE(s_switches);
+
+//! The default memory budget in MB.
+static const uint64 DEFAULT_MAX_MEMORY = 256;
+
+////////////////////////////////////////////////////////////////////////////////
+//! Get the size of a file.
+
+static uint64 getFileSize(const tstring& filename)
+{
+	WIN32_FILE_ATTRIBUTE_DATA info = { 0 };
+
+	if (!::GetFileAttributesEx(filename.c_str(), GetFileExInfoStandard, &info))
+		throw WCL::Win32Exception(::GetLastError(), Core::fmt(TXT("Failed to open the file '%s'"), filename.c_str()));
+
+	return (static_cast<uint64>(info.nFileSizeHigh) << 32) | info.nFileSizeLow;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Constructor.
+
+DiffCmd::DiffCmd(int argc, tchar* argv[])
+	: WCL::ConsoleCmd(s_switches, s_switches+s_switchCount, argc, argv, USAGE)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Destructor.
+
+DiffCmd::~DiffCmd()
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Get the description of the command.
+
+const tchar* DiffCmd::getDescription()
+{
+	return TXT("Compare the saved output of two queries");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Get the expected command usage.
+
+const tchar* DiffCmd::getUsage()
+{
+	return TXT("USAGE: WMICmd diff <old file> <new file> --key <property> [--max-memory <MB>]");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! The implementation of the command.
+
+int DiffCmd::doExecute(tostream& out, tostream& err)
+{
+	ASSERT(m_parser.getUnnamedArgs().at(0) == TXT("diff"));
+
+	// Validate and extract the command line arguments.
+	if (m_parser.getUnnamedArgs().size() != 3)
+		throw Core::CmdLineException(TXT("Both the old and new result files must be specified"));
+
+	if (!m_parser.isSwitchSet(KEY))
+		throw Core::CmdLineException(TXT("No --key property specified"));
+
+	const tstring oldFile = m_parser.getUnnamedArgs().at(1);
+	const tstring newFile = m_parser.getUnnamedArgs().at(2);
+	const tstring key     = m_parser.getSwitchValue(KEY);
+	uint64        maxMemory = DEFAULT_MAX_MEMORY;
+
+	if (m_parser.isSwitchSet(MAX_MEMORY))
+		maxMemory = Core::parse<uint64>(m_parser.getSwitchValue(MAX_MEMORY));
+
+	if (maxMemory == 0)
+		throw Core::CmdLineException(TXT("--max-memory must be at least 1"));
+
+	// Size the join by the smaller of the two files.
+	const uint64 oldSize = getFileSize(oldFile);
+	const uint64 newSize = getFileSize(newFile);
+	const bool   buildFromOld = (oldSize <= newSize);
+	const size_t numPartitions = ResultDiff::choosePartitions((buildFromOld) ? oldSize : newSize, maxMemory * 1024 * 1024);
+
+	ResultSetReader oldReader(oldFile, key);
+	ResultSetReader newReader(newFile, key);
+	ResultDiff      diff(key, numPartitions);
+
+	diff.run(oldReader, newReader, buildFromOld, out);
+
+	out << Core::fmt(TXT("%u added, %u removed, %u changed"), static_cast<unsigned>(diff.numAdded()),
+	                 static_cast<unsigned>(diff.numRemoved()), static_cast<unsigned>(diff.numChanged())) << std::endl;
+
+	const size_t numUnkeyed = oldReader.numUnkeyed() + newReader.numUnkeyed();
+
+	if (numUnkeyed != 0)
+		err << TXT("WARNING: Skipped ") << numUnkeyed << TXT(" object(s) without the property '") << key << TXT("'") << std::endl;
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,44 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   DiffCmd.hpp
+//! \brief  The DiffCmd class declaration.
+//! \author Chris Oldwood
+
+// Check for previous inclusion
+#ifndef APP_DIFFCMD_HPP
+#define APP_DIFFCMD_HPP
+
+#if _MSC_VER > 1000
+#pragma once
+#endif
+
+#include <WCL/ConsoleCmd.hpp>
+
+////////////////////////////////////////////////////////////////////////////////
+//! The command used to compare the saved output of two queries, such as the
+//! same query run on different days.
+
+class DiffCmd : public WCL::ConsoleCmd
+{
+public:
+	//! Constructor.
+	DiffCmd(int argc, tchar* argv[]);
+
+	//! Destructor.
+	virtual ~DiffCmd();
+	
+private:
+	//
+	// Command methods.
+	//
+
+	//! Get the description of the command.
+	virtual const tchar* getDescription();
+
+	//! Get the expected command usage.
+	virtual const tchar* getUsage();
+
+	//! The implementation of the command.
+	virtual int doExecute(tostream& out, tostream& err);
+};
+
+#endif // APP_DIFFCMD_HPP
@@ -0,0 +1,1357 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   Filter.cpp
+//! \brief  The Filter class definition.
+//! \author Chris Oldwood
+
+#include "Common.hpp"
+#include "Filter.hpp"
+#include <Core/CmdLineException.hpp>
+#include <Core/StringUtils.hpp>
+#include <Core/AnsiWide.hpp>
+#include <stdlib.h>
+#include <wctype.h>
+
+////////////////////////////////////////////////////////////////////////////////
+// Constants.
+
+//! The length of a WMI datetime string, e.g. 20101008181758.546000+060.
+static const size_t WMI_DATETIME_LENGTH = 25;
+
+//! The lengths of a datetime literal, i.e. YYYY-MM-DD [HH:MM[:SS]].
+static const size_t DATE_LENGTH = 10;
+static const size_t DATE_MINUTES_LENGTH = 16;
+static const size_t DATE_SECONDS_LENGTH = 19;
+
+////////////////////////////////////////////////////////////////////////////////
+//! A number taken from a literal or a value. Integers are compared exactly and
+//! so an unsigned value that's too big for an int64 has its own type.
+
+struct Number
+{
+	//! The type of number.
+	enum Type
+	{
+		INTEGER,	//!< A signed 64-bit integer.
+		LARGE,		//!< An unsigned 64-bit integer above the signed range.
+		REAL		//!< A floating point number.
+	};
+
+	Type	m_type;		//!< The type of number.
+	int64	m_integer;	//!< The value, if an INTEGER.
+	uint64	m_large;	//!< The value, if LARGE.
+	double	m_real;		//!< The value, if REAL.
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! A datetime in a form that can be compared, i.e. the number of seconds since
+//! a fixed epoch and the microseconds. The value is always in UTC so that two
+//! datetimes with different timezone offsets compare correctly.
+
+struct DateTime
+{
+	uint64	m_seconds;	//!< The seconds since 1st March in the year -400, in UTC.
+	uint64	m_micros;	//!< The microseconds.
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! A literal value in the expression. A string is stored as wide characters so
+//! that it can be compared directly with a BSTR.
+
+struct Literal
+{
+	//! The type of literal.
+	enum Type
+	{
+		NUMBER,		//!< A number.
+		STRING,		//!< A quoted string.
+		BOOLEAN		//!< TRUE or FALSE.
+	};
+
+	Type			m_type;			//!< The type of literal.
+	Number			m_number;		//!< The value, if a NUMBER.
+	std::wstring	m_string;		//!< The value, if a STRING.
+	bool			m_isDateTime;	//!< Is the STRING also a datetime?
+	DateTime		m_datetime;		//!< The datetime, if it is.
+	bool			m_boolean;		//!< The value, if a BOOLEAN.
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! The comparison operators.
+
+enum Operator
+{
+	EQUAL,
+	NOT_EQUAL,
+	LESS,
+	LESS_EQUAL,
+	GREATER,
+	GREATER_EQUAL
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! A single character, or sequence of them, in a LIKE pattern. The characters
+//! are stored in upper case.
+
+struct LikeElement
+{
+	//! The type of element.
+	enum Type
+	{
+		ANY_SEQUENCE,	//!< %, i.e. zero or more characters.
+		ANY_CHAR,		//!< _, i.e. any single character.
+		CHARACTER,		//!< A literal character.
+		CHARACTER_SET	//!< [...], i.e. one of a set of characters.
+	};
+
+	Type			m_type;		//!< The type of element.
+	wchar_t			m_char;		//!< The character, if a CHARACTER.
+	std::wstring	m_ranges;	//!< The first and last character of each range in the set.
+	bool			m_negated;	//!< Does the set match the characters not in it?
+};
+
+//! A compiled LIKE pattern.
+typedef std::vector<LikeElement> LikePattern;
+
+////////////////////////////////////////////////////////////////////////////////
+//! Convert a string to wide characters.
+
+static std::wstring toWide(const tstring& value)
+{
+#ifdef _UNICODE
+	return value;
+#else
+	return std::wstring(T2W(value.c_str()));
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Check if the character is a decimal digit.
+
+static inline bool isDigit(wchar_t c)
+{
+	return (c >= L'0') && (c <= L'9');
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Compare two values, returning -1, 0 or +1.
+
+template<typename T>
+static inline int compare(const T& lhs, const T& rhs)
+{
+	if (lhs < rhs)
+		return -1;
+
+	if (rhs < lhs)
+		return 1;
+
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Set the number to a signed integer.
+
+static void setSigned(Number& number, int64 value)
+{
+	number.m_type = Number::INTEGER;
+	number.m_integer = value;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Set the number to an unsigned integer.
+
+static void setUnsigned(Number& number, uint64 value)
+{
+	if (value > static_cast<uint64>(_I64_MAX))
+	{
+		number.m_type = Number::LARGE;
+		number.m_large = value;
+	}
+	else
+	{
+		setSigned(number, static_cast<int64>(value));
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Set the number to a floating point value.
+
+static void setReal(Number& number, double value)
+{
+	number.m_type = Number::REAL;
+	number.m_real = value;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Get the number as a floating point value.
+
+static double toReal(const Number& number)
+{
+	switch (number.m_type)
+	{
+		case Number::INTEGER:	return static_cast<double>(number.m_integer);
+		case Number::LARGE:		return static_cast<double>(number.m_large);
+		default:				return number.m_real;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Compare two numbers. They are compared as floating point values only if
+//! either of them is one.
+
+static int compareNumbers(const Number& lhs, const Number& rhs)
+{
+	if ( (lhs.m_type == Number::REAL) || (rhs.m_type == Number::REAL) )
+		return compare(toReal(lhs), toReal(rhs));
+
+	if ( (lhs.m_type == Number::LARGE) && (rhs.m_type == Number::LARGE) )
+		return compare(lhs.m_large, rhs.m_large);
+
+	if (lhs.m_type == Number::LARGE)
+		return 1;
+
+	if (rhs.m_type == Number::LARGE)
+		return -1;
+
+	return compare(lhs.m_integer, rhs.m_integer);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Try and parse the whole string as a number, e.g. "-42", "18446744073709551615"
+//! or "1.5". The string must be null terminated at the end. It is parsed in
+//! place so that it can be used directly on a BSTR.
+
+static bool tryParseNumber(const wchar_t* begin, const wchar_t* end, Number& number)
+{
+	const wchar_t* it = begin;
+	const bool     negative = (it != end) && (*it == L'-');
+
+	if (negative)
+		++it;
+
+	uint64 magnitude = 0;
+	bool   overflow = false;
+	bool   hasDigits = false;
+	bool   isInteger = true;
+
+	for (; (it != end) && isDigit(*it); ++it)
+	{
+		const uint64 digit = static_cast<uint64>(*it - L'0');
+
+		if (magnitude > ((_UI64_MAX - digit) / 10))
+			overflow = true;
+		else
+			magnitude = (magnitude * 10) + digit;
+
+		hasDigits = true;
+	}
+
+	if ( (it != end) && (*it == L'.') )
+	{
+		isInteger = false;
+
+		for (++it; (it != end) && isDigit(*it); ++it)
+			hasDigits = true;
+	}
+
+	if ( (it != end) || !hasDigits )
+		return false;
+
+	if (isInteger && !overflow)
+	{
+		if (!negative)
+		{
+			setUnsigned(number, magnitude);
+			return true;
+		}
+
+		if (magnitude <= (static_cast<uint64>(_I64_MAX) + 1))
+		{
+			setSigned(number, static_cast<int64>(0 - magnitude));
+			return true;
+		}
+	}
+
+	wchar_t* stop = nullptr;
+
+	setReal(number, ::wcstod(begin, &stop));
+
+	return (stop == end);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Read a fixed number of decimal digits.
+
+static bool readDigits(const wchar_t* it, size_t count, uint64& value)
+{
+	value = 0;
+
+	for (size_t i = 0; i != count; ++i, ++it)
+	{
+		if (!isDigit(*it))
+			return false;
+
+		value = (value * 10) + static_cast<uint64>(*it - L'0');
+	}
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Calculate the number of days since 1st March in the year -400 for a date in
+//! the proleptic Gregorian calendar. The year is shifted by 400 years so that
+//! the calculation never goes negative.
+
+static uint64 daysSinceEpoch(uint64 year, uint64 month, uint64 day)
+{
+	const uint64 shiftedYear = year + 400 - ((month <= 2) ? 1 : 0);
+	const uint64 era = shiftedYear / 400;
+	const uint64 yearOfEra = shiftedYear - (era * 400);
+	const uint64 dayOfYear = ((153 * ((month > 2) ? (month - 3) : (month + 9)) + 2) / 5) + (day - 1);
+	const uint64 dayOfEra = (yearOfEra * 365) + (yearOfEra / 4) - (yearOfEra / 100) + dayOfYear;
+
+	return (era * 146097) + dayOfEra;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Try and parse the string as either a WMI datetime, which has the format
+//! YYYYMMDDHHMMSS.FFFFFF+TZO, or a datetime literal, YYYY-MM-DD [HH:MM[:SS]].
+//! The WMI timezone offset, in minutes, is removed to give the time in UTC. A
+//! literal has no offset and so is taken to already be in UTC.
+
+static bool tryParseDateTime(const wchar_t* value, size_t length, DateTime& datetime)
+{
+	uint64 date = 0;
+	uint64 time = 0;
+	uint64 micros = 0;
+	uint64 offset = 0;
+	bool   behindUtc = false;
+
+	if (length == WMI_DATETIME_LENGTH)
+	{
+		if ( !readDigits(value, 8, date) || !readDigits(value+8, 6, time) || (value[14] != L'.')
+		  || !readDigits(value+15, 6, micros) || ((value[21] != L'+') && (value[21] != L'-'))
+		  || !readDigits(value+22, 3, offset) )
+			return false;
+
+		behindUtc = (value[21] == L'-');
+	}
+	else if ( (length == DATE_LENGTH) || (length == DATE_MINUTES_LENGTH) || (length == DATE_SECONDS_LENGTH) )
+	{
+		uint64 year, month, day;
+		uint64 hours = 0, minutes = 0, seconds = 0;
+
+		if ( !readDigits(value, 4, year) || (value[4] != L'-') || !readDigits(value+5, 2, month)
+		  || (value[7] != L'-') || !readDigits(value+8, 2, day) )
+			return false;
+
+		if ( (length != DATE_LENGTH)
+		  && ( ((value[10] != L' ') && (value[10] != L'T')) || !readDigits(value+11, 2, hours)
+		    || (value[13] != L':') || !readDigits(value+14, 2, minutes) ) )
+			return false;
+
+		if ( (length == DATE_SECONDS_LENGTH) && ((value[16] != L':') || !readDigits(value+17, 2, seconds)) )
+			return false;
+
+		date = (year * 10000) + (month * 100) + day;
+		time = (hours * 10000) + (minutes * 100) + seconds;
+	}
+	else
+	{
+		return false;
+	}
+
+	const uint64 year = date / 10000;
+	const uint64 month = (date / 100) % 100;
+	const uint64 day = date % 100;
+	const uint64 hours = time / 10000;
+	const uint64 minutes = (time / 100) % 100;
+	const uint64 seconds = time % 100;
+
+	if ( (month < 1) || (month > 12) || (day < 1) || (day > 31)
+	  || (hours > 23) || (minutes > 59) || (seconds > 60) )
+		return false;
+
+	const uint64 local = (daysSinceEpoch(year, month, day) * 86400) + (hours * 3600) + (minutes * 60) + seconds;
+
+	datetime.m_seconds = (behindUtc) ? (local + (offset * 60)) : (local - (offset * 60));
+	datetime.m_micros = micros;
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Compare two datetimes.
+
+static int compareDateTimes(const DateTime& lhs, const DateTime& rhs)
+{
+	const int result = compare(lhs.m_seconds, rhs.m_seconds);
+
+	return (result != 0) ? result : compare(lhs.m_micros, rhs.m_micros);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Try and get the value as a number. A string holding a number, such as the
+//! 64-bit integers that WMI returns as strings, is parsed in place.
+
+static bool tryGetNumber(const WCL::Variant& value, Number& number)
+{
+	switch (V_VT(&value))
+	{
+		case VT_I1:		setSigned(number, V_I1(&value));		return true;
+		case VT_I2:		setSigned(number, V_I2(&value));		return true;
+		case VT_I4:		setSigned(number, V_I4(&value));		return true;
+		case VT_I8:		setSigned(number, V_I8(&value));		return true;
+		case VT_INT:	setSigned(number, V_INT(&value));		return true;
+		case VT_UI1:	setUnsigned(number, V_UI1(&value));		return true;
+		case VT_UI2:	setUnsigned(number, V_UI2(&value));		return true;
+		case VT_UI4:	setUnsigned(number, V_UI4(&value));		return true;
+		case VT_UI8:	setUnsigned(number, V_UI8(&value));		return true;
+		case VT_UINT:	setUnsigned(number, V_UINT(&value));	return true;
+		case VT_R4:		setReal(number, V_R4(&value));			return true;
+		case VT_R8:		setReal(number, V_R8(&value));			return true;
+		case VT_BSTR:
+		{
+			const BSTR bstr = V_BSTR(&value);
+
+			return (bstr != nullptr) && tryParseNumber(bstr, bstr + ::SysStringLen(bstr), number);
+		}
+		default:
+			return false;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Compare the value with the literal. Returns false if the value cannot be
+//! compared with it, e.g. it's null, an array or of a different kind.
+
+static bool compareValue(const WCL::Variant& value, const Literal& literal, int& result)
+{
+	if (literal.m_type == Literal::NUMBER)
+	{
+		Number number;
+
+		if (!tryGetNumber(value, number))
+			return false;
+
+		result = compareNumbers(number, literal.m_number);
+		return true;
+	}
+
+	if (literal.m_type == Literal::STRING)
+	{
+		if (V_VT(&value) != VT_BSTR)
+			return false;
+
+		const BSTR     bstr = V_BSTR(&value);
+		const wchar_t* string = (bstr != nullptr) ? bstr : L"";
+		DateTime       datetime;
+
+		if (literal.m_isDateTime && tryParseDateTime(string, ::SysStringLen(bstr), datetime))
+			result = compareDateTimes(datetime, literal.m_datetime);
+		else
+			result = ::_wcsicmp(string, literal.m_string.c_str());
+
+		return true;
+	}
+
+	ASSERT(literal.m_type == Literal::BOOLEAN);
+
+	if (V_VT(&value) != VT_BOOL)
+		return false;
+
+	result = compare<bool>(V_BOOL(&value) != VARIANT_FALSE, literal.m_boolean);
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Apply the operator to the result of a comparison.
+
+static bool applyOperator(Operator op, int result)
+{
+	switch (op)
+	{
+		case EQUAL:			return (result == 0);
+		case NOT_EQUAL:		return (result != 0);
+		case LESS:			return (result < 0);
+		case LESS_EQUAL:	return (result <= 0);
+		case GREATER:		return (result > 0);
+		default:			return (result >= 0);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Compile a LIKE pattern. The wildcards are % for any sequence of characters,
+//! _ for any one character and [...] for any one of a set of characters, or
+//! [^...] for any one character not in the set. A set can contain ranges,
+//! e.g. [a-f].
+
+static LikePattern compileLikePattern(const std::wstring& pattern)
+{
+	LikePattern elements;
+
+	for (size_t i = 0; i != pattern.length(); ++i)
+	{
+		LikeElement element;
+
+		element.m_char = 0;
+		element.m_negated = false;
+
+		if (pattern[i] == L'%')
+		{
+			// Consecutive %s are the same as one.
+			if (!elements.empty() && (elements.back().m_type == LikeElement::ANY_SEQUENCE))
+				continue;
+
+			element.m_type = LikeElement::ANY_SEQUENCE;
+		}
+		else if (pattern[i] == L'_')
+		{
+			element.m_type = LikeElement::ANY_CHAR;
+		}
+		else if (pattern[i] == L'[')
+		{
+			const size_t last = pattern.find(L']', i+1);
+
+			if (last == std::wstring::npos)
+				throw Core::CmdLineException(TXT("Invalid filter, a LIKE pattern has an unterminated '['"));
+
+			size_t j = i+1;
+
+			element.m_type = LikeElement::CHARACTER_SET;
+
+			if ( (j != last) && (pattern[j] == L'^') )
+			{
+				element.m_negated = true;
+				++j;
+			}
+
+			for (; j != last; ++j)
+			{
+				const wchar_t first = static_cast<wchar_t>(::towupper(pattern[j]));
+
+				element.m_ranges += first;
+
+				if ( ((j+2) < last) && (pattern[j+1] == L'-') )
+				{
+					element.m_ranges += static_cast<wchar_t>(::towupper(pattern[j+2]));
+					j += 2;
+				}
+				else
+				{
+					element.m_ranges += first;
+				}
+			}
+
+			i = last;
+		}
+		else
+		{
+			element.m_type = LikeElement::CHARACTER;
+			element.m_char = static_cast<wchar_t>(::towupper(pattern[i]));
+		}
+
+		elements.push_back(element);
+	}
+
+	return elements;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Check if the upper case character matches a single character element.
+
+static bool matchesChar(const LikeElement& element, wchar_t c)
+{
+	switch (element.m_type)
+	{
+		case LikeElement::ANY_CHAR:
+			return true;
+
+		case LikeElement::CHARACTER:
+			return (c == element.m_char);
+
+		case LikeElement::CHARACTER_SET:
+		{
+			bool found = false;
+
+			for (size_t i = 0; (i != element.m_ranges.length()) && !found; i += 2)
+				found = (c >= element.m_ranges[i]) && (c <= element.m_ranges[i+1]);
+
+			return (found != element.m_negated);
+		}
+
+		default:
+			return false;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Check if the string matches the LIKE pattern. On a mismatch the matching
+//! is restarted one character further on from the last % seen, if any.
+
+static bool matchesLike(const LikePattern& pattern, const wchar_t* string, size_t length)
+{
+	const size_t none = static_cast<size_t>(-1);
+
+	size_t element = 0;
+	size_t index = 0;
+	size_t retryElement = none;
+	size_t retryIndex = 0;
+
+	while (index != length)
+	{
+		if ( (element != pattern.size()) && (pattern[element].m_type == LikeElement::ANY_SEQUENCE) )
+		{
+			retryElement = ++element;
+			retryIndex = index;
+		}
+		else if ( (element != pattern.size()) && matchesChar(pattern[element], static_cast<wchar_t>(::towupper(string[index]))) )
+		{
+			++element;
+			++index;
+		}
+		else if (retryElement != none)
+		{
+			element = retryElement;
+			index = ++retryIndex;
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	while ( (element != pattern.size()) && (pattern[element].m_type == LikeElement::ANY_SEQUENCE) )
+		++element;
+
+	return (element == pattern.size());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! A node in the compiled expression. The properties are referred to by their
+//! index in the filter's list of properties, which maps onto the columns.
+
+class FilterPredicate
+{
+public:
+	//! Destructor.
+	virtual ~FilterPredicate() {}
+
+	//! Does the object match?
+	virtual bool matches(const PropertyValues& values, const Filter::Columns& columns) const = 0;
+};
+
+//! The default predicate smart-pointer type.
+typedef Core::SharedPtr<FilterPredicate> PredicatePtr;
+
+////////////////////////////////////////////////////////////////////////////////
+//! Find the value of the property in the object. Returns nullptr if the object
+//! does not have the property, which is then treated as if it were null.
+
+static const WCL::Variant* findValue(const PropertyValues& values, const Filter::Columns& columns, size_t property)
+{
+	const size_t column = columns[property];
+
+	return (column != Filter::NO_COLUMN) ? &values[column] : nullptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Matches an object that matches both predicates.
+
+class AndPredicate : public FilterPredicate
+{
+public:
+	AndPredicate(PredicatePtr lhs, PredicatePtr rhs)
+		: m_lhs(lhs), m_rhs(rhs)
+	{
+	}
+
+	virtual bool matches(const PropertyValues& values, const Filter::Columns& columns) const
+	{
+		return m_lhs->matches(values, columns) && m_rhs->matches(values, columns);
+	}
+
+private:
+	PredicatePtr	m_lhs;	//!< The left hand side.
+	PredicatePtr	m_rhs;	//!< The right hand side.
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! Matches an object that matches either predicate.
+
+class OrPredicate : public FilterPredicate
+{
+public:
+	OrPredicate(PredicatePtr lhs, PredicatePtr rhs)
+		: m_lhs(lhs), m_rhs(rhs)
+	{
+	}
+
+	virtual bool matches(const PropertyValues& values, const Filter::Columns& columns) const
+	{
+		return m_lhs->matches(values, columns) || m_rhs->matches(values, columns);
+	}
+
+private:
+	PredicatePtr	m_lhs;	//!< The left hand side.
+	PredicatePtr	m_rhs;	//!< The right hand side.
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! Matches an object that doesn't match the predicate.
+
+class NotPredicate : public FilterPredicate
+{
+public:
+	explicit NotPredicate(PredicatePtr operand)
+		: m_operand(operand)
+	{
+	}
+
+	virtual bool matches(const PropertyValues& values, const Filter::Columns& columns) const
+	{
+		return !m_operand->matches(values, columns);
+	}
+
+private:
+	PredicatePtr	m_operand;	//!< The predicate to negate.
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! Matches an object whose property compares with the literal, e.g. "x > 5".
+
+class ComparisonPredicate : public FilterPredicate
+{
+public:
+	ComparisonPredicate(size_t property, Operator op, const Literal& literal)
+		: m_property(property), m_operator(op), m_literal(literal)
+	{
+	}
+
+	virtual bool matches(const PropertyValues& values, const Filter::Columns& columns) const
+	{
+		const WCL::Variant* value = findValue(values, columns, m_property);
+		int                 result = 0;
+
+		return (value != nullptr) && compareValue(*value, m_literal, result) && applyOperator(m_operator, result);
+	}
+
+private:
+	size_t		m_property;	//!< The property to compare.
+	Operator	m_operator;	//!< The comparison.
+	Literal		m_literal;	//!< The value to compare with.
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! Matches an object whose property is within an inclusive range, e.g. "x
+//! BETWEEN 1 AND 10".
+
+class BetweenPredicate : public FilterPredicate
+{
+public:
+	BetweenPredicate(size_t property, const Literal& low, const Literal& high)
+		: m_property(property), m_low(low), m_high(high)
+	{
+	}
+
+	virtual bool matches(const PropertyValues& values, const Filter::Columns& columns) const
+	{
+		const WCL::Variant* value = findValue(values, columns, m_property);
+		int                 result = 0;
+
+		return (value != nullptr)
+		    && compareValue(*value, m_low, result) && (result >= 0)
+		    && compareValue(*value, m_high, result) && (result <= 0);
+	}
+
+private:
+	size_t	m_property;	//!< The property to compare.
+	Literal	m_low;		//!< The lowest value in the range.
+	Literal	m_high;		//!< The highest value in the range.
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! Matches an object whose string property matches a pattern, e.g. "x LIKE
+//! 'svc%'".
+
+class LikePredicate : public FilterPredicate
+{
+public:
+	LikePredicate(size_t property, const LikePattern& pattern)
+		: m_property(property), m_pattern(pattern)
+	{
+	}
+
+	virtual bool matches(const PropertyValues& values, const Filter::Columns& columns) const
+	{
+		const WCL::Variant* value = findValue(values, columns, m_property);
+
+		if ((value == nullptr) || (V_VT(value) != VT_BSTR))
+			return false;
+
+		const BSTR bstr = V_BSTR(value);
+
+		return matchesLike(m_pattern, (bstr != nullptr) ? bstr : L"", ::SysStringLen(bstr));
+	}
+
+private:
+	size_t		m_property;	//!< The property to match.
+	LikePattern	m_pattern;	//!< The compiled pattern.
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! Matches an object whose property is null or empty, or that does not have
+//! the property at all.
+
+class NullPredicate : public FilterPredicate
+{
+public:
+	explicit NullPredicate(size_t property)
+		: m_property(property)
+	{
+	}
+
+	virtual bool matches(const PropertyValues& values, const Filter::Columns& columns) const
+	{
+		const WCL::Variant* value = findValue(values, columns, m_property);
+
+		if (value == nullptr)
+			return true;
+
+		const VARTYPE type = V_VT(value);
+
+		return (type == VT_NULL) || (type == VT_EMPTY);
+	}
+
+private:
+	size_t	m_property;	//!< The property to test.
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! The parser for the filter expression. It's a recursive descent parser with
+//! one token of lookahead, where AND binds more tightly than OR.
+
+class FilterParser
+{
+public:
+	//! Constructor.
+	FilterParser(const tstring& expression, Filter::Properties& properties);
+
+	//! Parse the expression.
+	PredicatePtr parse();
+
+private:
+	//! The types of token.
+	enum TokenType
+	{
+		END,		//!< The end of the expression.
+		NAME,		//!< A property name or keyword.
+		NUMBER,		//!< A number.
+		STRING,		//!< A quoted string.
+		OPERATOR,	//!< A comparison operator.
+		OPEN,		//!< An opening parenthesis.
+		CLOSE		//!< A closing parenthesis.
+	};
+
+	//
+	// Members.
+	//
+	const tstring&		m_expression;	//!< The expression being parsed.
+	Filter::Properties&	m_properties;	//!< The properties referenced.
+	size_t				m_next;			//!< The position after the current token.
+	size_t				m_start;		//!< The position of the current token.
+	TokenType			m_type;			//!< The type of the current token.
+	tstring				m_token;		//!< The text of the current token.
+
+	//
+	// Internal methods.
+	//
+
+	//! Read the next token.
+	void readToken();
+
+	//! Check if the current token is the keyword.
+	bool isKeyword(const tchar* keyword) const;
+
+	//! Parse a sequence of conditions separated by OR.
+	PredicatePtr parseOr();
+
+	//! Parse a sequence of conditions separated by AND.
+	PredicatePtr parseAnd();
+
+	//! Parse a negated or parenthesised condition.
+	PredicatePtr parseUnary();
+
+	//! Parse a condition on a single property.
+	PredicatePtr parseCondition();
+
+	//! Parse a literal value.
+	Literal parseLiteral();
+
+	//! Get the index of the property, adding it if it's new.
+	size_t addProperty(const tstring& name);
+
+	//! Report a syntax error at the current token.
+	void throwError(const tchar* message) const;
+
+	// NotCopyable.
+	FilterParser(const FilterParser&);
+	FilterParser& operator=(const FilterParser&);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! Constructor.
+
+FilterParser::FilterParser(const tstring& expression, Filter::Properties& properties)
+	: m_expression(expression)
+	, m_properties(properties)
+	, m_next(0)
+	, m_start(0)
+	, m_type(END)
+	, m_token()
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Parse the expression.
+
+PredicatePtr FilterParser::parse()
+{
+	readToken();
+
+	PredicatePtr root = parseOr();
+
+	if (m_type != END)
+		throwError(TXT("expected AND or OR"));
+
+	return root;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Read the next token. A quote inside a string is written as two quotes.
+
+void FilterParser::readToken()
+{
+	const size_t length = m_expression.length();
+
+	while ( (m_next != length) && ((m_expression[m_next] == TXT(' ')) || (m_expression[m_next] == TXT('\t'))) )
+		++m_next;
+
+	m_start = m_next;
+	m_token.erase();
+
+	if (m_next == length)
+	{
+		m_type = END;
+		return;
+	}
+
+	const tchar c = m_expression[m_next];
+
+	if ( (c == TXT('(')) || (c == TXT(')')) )
+	{
+		m_type = (c == TXT('(')) ? OPEN : CLOSE;
+		m_token = c;
+		++m_next;
+	}
+	else if ( (c == TXT('\'')) || (c == TXT('"')) )
+	{
+		m_type = STRING;
+
+		for (++m_next; ; ++m_next)
+		{
+			if (m_next == length)
+				throwError(TXT("unterminated string"));
+
+			if (m_expression[m_next] == c)
+			{
+				if ( ((m_next+1) == length) || (m_expression[m_next+1] != c) )
+					break;
+
+				++m_next;
+			}
+
+			m_token += m_expression[m_next];
+		}
+
+		++m_next;
+	}
+	else if ( ((c >= TXT('0')) && (c <= TXT('9'))) || (c == TXT('-')) || (c == TXT('.')) )
+	{
+		m_type = NUMBER;
+
+		do
+		{
+			m_token += m_expression[m_next++];
+		}
+		while ( (m_next != length) && (((m_expression[m_next] >= TXT('0')) && (m_expression[m_next] <= TXT('9')))
+		                            || (m_expression[m_next] == TXT('.'))) );
+	}
+	else if ( ((c >= TXT('A')) && (c <= TXT('Z'))) || ((c >= TXT('a')) && (c <= TXT('z'))) || (c == TXT('_')) )
+	{
+		m_type = NAME;
+
+		while ( (m_next != length) && (((m_expression[m_next] >= TXT('A')) && (m_expression[m_next] <= TXT('Z')))
+		                            || ((m_expression[m_next] >= TXT('a')) && (m_expression[m_next] <= TXT('z')))
+		                            || ((m_expression[m_next] >= TXT('0')) && (m_expression[m_next] <= TXT('9')))
+		                            || (m_expression[m_next] == TXT('_'))) )
+			m_token += m_expression[m_next++];
+	}
+	else if ( (c == TXT('=')) || (c == TXT('<')) || (c == TXT('>')) || (c == TXT('!')) )
+	{
+		m_type = OPERATOR;
+		m_token = m_expression[m_next++];
+
+		if ( (m_next != length) && ((m_expression[m_next] == TXT('=')) || ((c == TXT('<')) && (m_expression[m_next] == TXT('>')))) )
+			m_token += m_expression[m_next++];
+
+		if (m_token == TXT("!"))
+			throwError(TXT("expected '!='"));
+	}
+	else
+	{
+		throwError(TXT("unexpected character"));
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Check if the current token is the keyword. Keywords are not case sensitive.
+
+bool FilterParser::isKeyword(const tchar* keyword) const
+{
+	return (m_type == NAME) && (tstricmp(m_token.c_str(), keyword) == 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Parse a sequence of conditions separated by OR.
+
+PredicatePtr FilterParser::parseOr()
+{
+	PredicatePtr lhs = parseAnd();
+
+	while (isKeyword(TXT("OR")))
+	{
+		readToken();
+
+		PredicatePtr rhs = parseAnd();
+
+		lhs = PredicatePtr(new OrPredicate(lhs, rhs));
+	}
+
+	return lhs;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Parse a sequence of conditions separated by AND.
+
+PredicatePtr FilterParser::parseAnd()
+{
+	PredicatePtr lhs = parseUnary();
+
+	while (isKeyword(TXT("AND")))
+	{
+		readToken();
+
+		PredicatePtr rhs = parseUnary();
+
+		lhs = PredicatePtr(new AndPredicate(lhs, rhs));
+	}
+
+	return lhs;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Parse a negated or parenthesised condition.
+
+PredicatePtr FilterParser::parseUnary()
+{
+	if (isKeyword(TXT("NOT")))
+	{
+		readToken();
+
+		return PredicatePtr(new NotPredicate(parseUnary()));
+	}
+
+	if (m_type == OPEN)
+	{
+		readToken();
+
+		PredicatePtr predicate = parseOr();
+
+		if (m_type != CLOSE)
+			throwError(TXT("expected ')'"));
+
+		readToken();
+
+		return predicate;
+	}
+
+	return parseCondition();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Parse a condition on a single property, e.g. "x = 1", "x LIKE 'a%'", "x
+//! BETWEEN 1 AND 10" or "x IS NULL", any of which bar the first can be negated.
+
+PredicatePtr FilterParser::parseCondition()
+{
+	if (m_type != NAME)
+		throwError(TXT("expected a property name"));
+
+	const size_t property = addProperty(m_token);
+
+	readToken();
+
+	bool         negated = false;
+	PredicatePtr predicate;
+
+	if (isKeyword(TXT("IS")))
+	{
+		readToken();
+
+		if (isKeyword(TXT("NOT")))
+		{
+			negated = true;
+			readToken();
+		}
+
+		if (!isKeyword(TXT("NULL")))
+			throwError(TXT("expected NULL"));
+
+		readToken();
+
+		predicate = PredicatePtr(new NullPredicate(property));
+	}
+	else
+	{
+		if (isKeyword(TXT("NOT")))
+		{
+			negated = true;
+			readToken();
+		}
+
+		if (isKeyword(TXT("LIKE")))
+		{
+			readToken();
+
+			if (m_type != STRING)
+				throwError(TXT("expected a quoted LIKE pattern"));
+
+			const LikePattern pattern = compileLikePattern(toWide(m_token));
+
+			readToken();
+
+			predicate = PredicatePtr(new LikePredicate(property, pattern));
+		}
+		else if (isKeyword(TXT("BETWEEN")))
+		{
+			readToken();
+
+			const Literal low = parseLiteral();
+
+			if (!isKeyword(TXT("AND")))
+				throwError(TXT("expected AND"));
+
+			readToken();
+
+			const Literal high = parseLiteral();
+
+			predicate = PredicatePtr(new BetweenPredicate(property, low, high));
+		}
+		else if ( (m_type == OPERATOR) && !negated )
+		{
+			Operator op = EQUAL;
+
+			if ( (m_token == TXT("<>")) || (m_token == TXT("!=")) )
+				op = NOT_EQUAL;
+			else if (m_token == TXT("<"))
+				op = LESS;
+			else if (m_token == TXT("<="))
+				op = LESS_EQUAL;
+			else if (m_token == TXT(">"))
+				op = GREATER;
+			else if (m_token == TXT(">="))
+				op = GREATER_EQUAL;
+
+			readToken();
+
+			predicate = PredicatePtr(new ComparisonPredicate(property, op, parseLiteral()));
+		}
+		else
+		{
+			throwError((negated) ? TXT("expected LIKE or BETWEEN") : TXT("expected a comparison"));
+		}
+	}
+
+	if (negated)
+		predicate = PredicatePtr(new NotPredicate(predicate));
+
+	return predicate;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Parse a literal value. A string that's also a valid datetime remembers the
+//! datetime so that it can be compared with WMI datetimes.
+
+Literal FilterParser::parseLiteral()
+{
+	Literal literal;
+
+	literal.m_type = Literal::STRING;
+	literal.m_isDateTime = false;
+	literal.m_boolean = false;
+
+	if (m_type == NUMBER)
+	{
+		const std::wstring number = toWide(m_token);
+
+		literal.m_type = Literal::NUMBER;
+
+		if (!tryParseNumber(number.c_str(), number.c_str() + number.length(), literal.m_number))
+			throwError(TXT("invalid number"));
+	}
+	else if (m_type == STRING)
+	{
+		literal.m_type = Literal::STRING;
+		literal.m_string = toWide(m_token);
+		literal.m_isDateTime = tryParseDateTime(literal.m_string.c_str(), literal.m_string.length(), literal.m_datetime);
+	}
+	else if (isKeyword(TXT("TRUE")) || isKeyword(TXT("FALSE")))
+	{
+		literal.m_type = Literal::BOOLEAN;
+		literal.m_boolean = isKeyword(TXT("TRUE"));
+	}
+	else
+	{
+		throwError(TXT("expected a number, string, TRUE or FALSE"));
+	}
+
+	readToken();
+
+	return literal;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Get the index of the property, adding it if it's new. Property names are
+//! not case sensitive.
+
+size_t FilterParser::addProperty(const tstring& name)
+{
+	for (size_t i = 0; i != m_properties.size(); ++i)
+	{
+		if (tstricmp(m_properties[i].c_str(), name.c_str()) == 0)
+			return i;
+	}
+
+	m_properties.push_back(name);
+
+	return m_properties.size()-1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Report a syntax error at the current token.
+
+void FilterParser::throwError(const tchar* message) const
+{
+	throw Core::CmdLineException(Core::fmt(TXT("Invalid filter, %s at character %u of '%s'"),
+	                                       message, static_cast<unsigned>(m_start+1), m_expression.c_str()));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Constructor. The expression is parsed and compiled straight away.
+
+Filter::Filter(const tstring& expression)
+	: m_root()
+	, m_properties()
+	, m_columns()
+	, m_boundNames()
+	, m_numColumns(0)
+	, m_bound(false)
+	, m_anyMissing(false)
+	, m_objectNames()
+{
+	FilterParser parser(expression, m_properties);
+
+	m_root = parser.parse();
+
+	m_columns.resize(m_properties.size());
+	m_boundNames.resize(m_properties.size());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Destructor.
+
+Filter::~Filter()
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Does the object match the filter? The columns are only looked up again if
+//! the object's properties have changed.
+
+bool Filter::matches(const WMI::Object::PropertyNames& names, const PropertyValues& values)
+{
+	ASSERT(names.size() == values.size());
+
+	if (!isBound(names))
+		bind(names);
+
+	return m_root->matches(values, m_columns);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Check if the columns still refer to the same properties. Only the columns
+//! in the expression are checked, unless a property was missing, in which case
+//! all the names are checked as the property may now be in any column.
+
+bool Filter::isBound(const WMI::Object::PropertyNames& names) const
+{
+	if (!m_bound || (names.size() != m_numColumns))
+		return false;
+
+	if (m_anyMissing)
+		return (names == m_objectNames);
+
+	for (size_t i = 0; i != m_columns.size(); ++i)
+	{
+		if (names[m_columns[i]] != m_boundNames[i])
+			return false;
+	}
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Look up the column of each property. A property that the object does not
+//! have is given no column so that it's treated as null.
+
+void Filter::bind(const WMI::Object::PropertyNames& names)
+{
+	m_bound = false;
+	m_anyMissing = false;
+	m_objectNames.clear();
+
+	for (size_t i = 0; i != m_properties.size(); ++i)
+	{
+		size_t column = 0;
+
+		while ( (column != names.size()) && (tstricmp(names[column].c_str(), m_properties[i].c_str()) != 0) )
+			++column;
+
+		if (column == names.size())
+		{
+			m_columns[i] = NO_COLUMN;
+			m_boundNames[i].erase();
+			m_anyMissing = true;
+			continue;
+		}
+
+		m_columns[i] = column;
+		m_boundNames[i] = names[column];
+	}
+
+	if (m_anyMissing)
+		m_objectNames = names;
+
+	m_numColumns = names.size();
+	m_bound = true;
+}
@@ -0,0 +1,98 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   Filter.hpp
+//! \brief  The Filter class declaration.
+//! \author Chris Oldwood
+
+// Check for previous inclusion
+#ifndef APP_FILTER_HPP
+#define APP_FILTER_HPP
+
+#if _MSC_VER > 1000
+#pragma once
+#endif
+
+#include "FormattingPipeline.hpp"
+#include <WMI/Object.hpp>
+#include <Core/SharedPtr.hpp>
+#include <vector>
+
+// Forward declarations.
+class FilterPredicate;
+
+////////////////////////////////////////////////////////////////////////////////
+//! A WQL style expression used to filter the objects on the client, e.g.
+//! "State = 'Running' AND ProcessId BETWEEN 100 AND 200". The expression is
+//! parsed once into a tree of predicates that refer to the properties by their
+//! column in the object. The columns are looked up from the first object and
+//! only looked up again when the properties change. The values are compared
+//! in their native form, with strings that hold 64-bit integers or datetimes
+//! compared as numbers or datetimes, and so no value is ever formatted. A
+//! property that an object does not have is treated as null, so that one
+//! filter can be applied to objects of different classes.
+//!
+//! The expression supports the comparison operators =, <>, !=, <, <=, > and
+//! >=, along with LIKE, BETWEEN, IS [NOT] NULL, AND, OR, NOT and parentheses.
+//! A literal is a number, a quoted string, TRUE or FALSE. A quoted string in
+//! the form YYYY-MM-DD [HH:MM[:SS]] is also compared as a datetime, in UTC.
+//! A WMI datetime is converted to UTC using its timezone offset before being
+//! compared. Strings are compared without regard to case.
+
+class Filter
+{
+public:
+	//! Constructor.
+	explicit Filter(const tstring& expression);
+
+	//! Destructor.
+	~Filter();
+
+	//! Does the object match the filter?
+	bool matches(const WMI::Object::PropertyNames& names, const PropertyValues& values);
+
+	//! The properties referenced by the expression.
+	typedef std::vector<tstring> Properties;
+	//! The column of each property referenced by the expression.
+	typedef std::vector<size_t> Columns;
+
+	//
+	// Constants.
+	//
+
+	//! The column of a property that the object does not have.
+	static const size_t NO_COLUMN = static_cast<size_t>(-1);
+
+private:
+	//! The default predicate smart-pointer type.
+	typedef Core::SharedPtr<FilterPredicate> PredicatePtr;
+
+	//
+	// Members.
+	//
+	PredicatePtr				m_root;			//!< The compiled expression.
+	Properties					m_properties;	//!< The properties referenced.
+	Columns						m_columns;		//!< The column of each property.
+	Properties					m_boundNames;	//!< The object's name for each property.
+	size_t						m_numColumns;	//!< The number of properties in the object.
+	bool						m_bound;		//!< Have the columns been looked up?
+	bool						m_anyMissing;	//!< Is any property missing from the object?
+	WMI::Object::PropertyNames	m_objectNames;	//!< The object's names, if any are missing.
+
+	//
+	// Internal methods.
+	//
+
+	//! Check if the columns still refer to the same properties.
+	bool isBound(const WMI::Object::PropertyNames& names) const;
+
+	//! Look up the column of each property.
+	void bind(const WMI::Object::PropertyNames& names);
+
+	// NotCopyable.
+	Filter(const Filter&);
+	Filter& operator=(const Filter&);
+};
+
+//! The default filter smart-pointer type.
+typedef Core::SharedPtr<Filter> FilterPtr;
+
+#endif // APP_FILTER_HPP
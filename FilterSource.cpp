@@ -0,0 +1,68 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   FilterSource.cpp
+//! \brief  The FilterSource class definition.
+//! \author Chris Oldwood
+
+#include "Common.hpp"
+#include "FilterSource.hpp"
+#include "Filter.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+//! Constructor.
+
+FilterSource::FilterSource(ObjectSource& source, Filter* filter, size_t maxItems)
+	: m_source(source)
+	, m_filter(filter)
+	, m_maxItems(maxItems)
+	, m_count(0)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Fill the snapshot with the next matching object or heading.
+
+bool FilterSource::next(ObjectSnapshot& snapshot)
+{
+	return advance(snapshot, true);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Move past the next matching object without copying its properties.
+
+bool FilterSource::skip(ObjectSnapshot& snapshot)
+{
+	return advance(snapshot, false);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Move to the next matching object or heading. Each heading starts a new
+//! result set. Once a result set has reached the limit the source is told to
+//! end it and any of its objects that still arrive are skipped without copying
+//! their properties. An object still has to be copied to test it against the
+//! filter.
+
+bool FilterSource::advance(ObjectSnapshot& snapshot, bool copyObject)
+{
+	for (;;)
+	{
+		const bool full = (m_count == m_maxItems);
+		const bool copy = !full && (copyObject || (m_filter != nullptr));
+
+		if (!((copy) ? m_source.next(snapshot) : m_source.skip(snapshot)))
+			return false;
+
+		if (!snapshot.m_isObject)
+		{
+			m_count = 0;
+			return true;
+		}
+
+		if ( !full && ((m_filter == nullptr) || m_filter->matches(snapshot.m_names, snapshot.m_values)) )
+		{
+			if (++m_count == m_maxItems)
+				m_source.endResultSet();
+
+			return true;
+		}
+	}
+}
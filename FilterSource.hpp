@@ -0,0 +1,58 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   FilterSource.hpp
+//! \brief  The FilterSource class declaration.
+//! \author Chris Oldwood
+
+// Check for previous inclusion
+#ifndef APP_FILTERSOURCE_HPP
+#define APP_FILTERSOURCE_HPP
+
+#if _MSC_VER > 1000
+#pragma once
+#endif
+
+#include "FormattingPipeline.hpp"
+
+// Forward declarations.
+class Filter;
+
+////////////////////////////////////////////////////////////////////////////////
+//! A source which only passes on the objects from another source that match a
+//! filter, and all of the headings. As the filter is applied on the client the
+//! limit on the number of objects in each result set is applied here too, once
+//! the objects have been filtered. Without a filter every object is passed on.
+
+class FilterSource : public ObjectSource
+{
+public:
+	//! Constructor.
+	FilterSource(ObjectSource& source, Filter* filter, size_t maxItems);
+
+	//! Fill the snapshot with the next matching object or heading.
+	virtual bool next(ObjectSnapshot& snapshot);
+
+	//! Move past the next matching object without copying its properties.
+	virtual bool skip(ObjectSnapshot& snapshot);
+
+private:
+	//
+	// Members.
+	//
+	ObjectSource&	m_source;	//!< The source of the objects.
+	Filter*			m_filter;	//!< The filter, if any.
+	size_t			m_maxItems;	//!< The limit on objects per result set.
+	size_t			m_count;	//!< The objects passed on from the result set.
+
+	//
+	// Internal methods.
+	//
+
+	//! Move to the next matching object or heading, optionally copying it.
+	bool advance(ObjectSnapshot& snapshot, bool copyObject);
+
+	// NotCopyable.
+	FilterSource(const FilterSource&);
+	FilterSource& operator=(const FilterSource&);
+};
+
+#endif // APP_FILTERSOURCE_HPP
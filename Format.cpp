@@ -7,11 +7,29 @@
 #include "Format.hpp"
 #include <Core/StringUtils.hpp>
 #include <WMI/DateTime.hpp>
-#include <WCL/VariantVector.hpp>
 #include <Core/AnsiWide.hpp>
 #include <malloc.h.>
+#include <algorithm>
 
-static tstring formatIntegerValue(const WCL::Variant& value, bool applyFormatting);
+////////////////////////////////////////////////////////////////////////////////
+// Constants.
+
+//! The length of a WMI datetime string, e.g. 20101008181758.546000+060.
+static const size_t DATETIME_LENGTH = 25;
+
+//! The maximum number of characters required for a 64-bit integer's digits.
+static const size_t MAX_INTEGER_DIGITS = 20;
+
+//! The maximum number of array elements displayed when formatting is enabled.
+static const size_t MAX_ARRAY_ITEMS = 100;
+
+//! The range of years converted in place. A datetime outside this range is
+//! rare and so is handed to the WMI library parser instead.
+static const WORD MIN_YEAR = 1970;
+static const WORD MAX_YEAR = 2037;
+
+//! The size of the buffers used to format the date and time parts.
+static const size_t MAX_DATETIME_CHARS = 64;
 
 ////////////////////////////////////////////////////////////////////////////////
 //! Get the string used to separate groups of digits in a number.
@@ -29,204 +47,931 @@ static tstring getGroupSeparator()
 	return buffer;
 }
 
+//! The locale's digit group separator. This is looked up once up front as the
+//! locale lookup is far too expensive to repeat for every integer value.
+static const tstring s_groupSeparator = getGroupSeparator();
+
 ////////////////////////////////////////////////////////////////////////////////
-//! Try and convert a string into a datetime. The format of a WMI datetime is:-
-//! YYYYMMDDHHMMSS.FFFFFF+TZO e.g. 20101008181758.546000+060
+//! Append the string to the buffer, converting from the BSTR character type
+//! in the process if required.
 
-bool tryConvertDateTime(const tstring& value, tstring& datetime)
+static void appendWideString(tstring& buffer, const wchar_t* value, size_t length)
 {
-	CDateTime parsed;
-	tstring   offset;
+#ifdef _UNICODE
+	buffer.append(value, length);
+#else
+	buffer.append(W2T(std::wstring(value, length).c_str()));
+#endif
+}
 
-	if (!WMI::tryParseDateTime(value, parsed, offset))
-		return false;
+////////////////////////////////////////////////////////////////////////////////
+//! Append the integer to the buffer, optionally grouping the digits. The
+//! digits are generated in place rather than via an intermediate string.
 
-	datetime = Core::fmt(TXT("%s %s"), parsed.ToString().c_str(), offset.c_str());
+static void appendInteger(tstring& buffer, uint64 magnitude, bool negative, bool groupDigits)
+{
+	tchar  digits[MAX_INTEGER_DIGITS];
+	size_t numDigits = 0;
 
-	return true;
+	do
+	{
+		digits[numDigits++] = static_cast<tchar>(TXT('0') + (magnitude % 10));
+		magnitude /= 10;
+	}
+	while (magnitude != 0);
+
+	if (negative)
+		buffer += TXT('-');
+
+	for (size_t i = numDigits; i != 0; --i)
+	{
+		buffer += digits[i-1];
+
+		if ( groupDigits && (i != 1) && (((i-1) % 3) == 0) )
+			buffer += s_groupSeparator;
+	}
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-//! Try and convert a string into a 64-bit integer. WMI appears to return sint64
-//! and uint64 values as strings (VT_BSTR).
+//! Append the signed integer to the buffer, optionally grouping the digits.
 
-bool tryConvert64BitInteger(const tstring& value, tstring& integer)
+static inline void appendSignedInteger(tstring& buffer, int64 value, bool groupDigits)
+{
+	const bool   negative = (value < 0);
+	const uint64 magnitude = (negative) ? (0 - static_cast<uint64>(value)) : static_cast<uint64>(value);
+
+	appendInteger(buffer, magnitude, negative, groupDigits);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Try and parse a string of decimal digits, with an optional leading minus
+//! sign, as a 64-bit integer. The string is parsed in place so that it can be
+//! used directly on the BSTR inside a VARIANT.
+
+static bool tryParse64BitInteger(const tchar* it, const tchar* end, uint64& magnitude, bool& negative)
 {
-	tstring::const_iterator it = value.begin();
-	tstring::const_iterator end = value.end();
-	bool isSigned = false;
+	negative = false;
+	magnitude = 0;
+
+	if ( (it != end) && (*it == TXT('-')) )
+	{
+		negative = true;
+		++it;
+	}
 
 	if (it == end)
 		return false;
 
-	if (*it == TXT('-'))
+	const uint64 maxMagnitude = (negative) ? static_cast<uint64>(_I64_MAX) + 1 : _UI64_MAX;
+
+	for (; it != end; ++it)
 	{
-		isSigned = true;
-		++it;
+		if ( (*it < TXT('0')) || (*it > TXT('9')) )
+			return false;
+
+		const uint64 digit = static_cast<uint64>(*it - TXT('0'));
+
+		if (magnitude > ((maxMagnitude - digit) / 10))
+			return false;
+
+		magnitude = (magnitude * 10) + digit;
 	}
 
-	while (it != end)
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Check if the string has the shape of a WMI datetime. This is a cheap test
+//! used to avoid the cost of a full parse for the vast majority of strings.
+
+static bool looksLikeDateTime(const tchar* value, size_t length)
+{
+	return (length == DATETIME_LENGTH) && (value[14] == TXT('.'))
+		&& ((value[21] == TXT('+')) || (value[21] == TXT('-')));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Parse a fixed number of decimal digits.
+
+static bool tryParseDigits(const tchar* it, size_t count, WORD& value)
+{
+	value = 0;
+
+	for (const tchar* end = it + count; it != end; ++it)
 	{
-		if (!isdigit(*it))
+		if ( (*it < TXT('0')) || (*it > TXT('9')) )
 			return false;
 
-		++it;
-	}	
+		value = static_cast<WORD>((value * 10) + (*it - TXT('0')));
+	}
 
-	if (isSigned)
-		integer = formatIntegerValue(WCL::Variant(Core::parse<int64>(value)), true);
-	else
-		integer = formatIntegerValue(WCL::Variant(Core::parse<uint64>(value)), true);
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Get the number of days in the month.
+
+static WORD daysInMonth(WORD year, WORD month)
+{
+	static const WORD days[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+
+	const bool isLeapYear = ((year % 4) == 0) && (((year % 100) != 0) || ((year % 400) == 0));
+
+	return ((month == 2) && isLeapYear) ? 29 : days[month-1];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Try and parse the date and time parts of a WMI datetime in place. The
+//! fraction of a second and timezone offset are validated but not returned.
+//! The year is not range checked as that depends on how it's formatted.
+
+static bool tryParseDateTime(const tchar* value, size_t length, SYSTEMTIME& datetime)
+{
+	WORD fraction, offset;
+
+	if (!looksLikeDateTime(value, length))
+		return false;
+
+	if ( !tryParseDigits(value,      4, datetime.wYear)   || !tryParseDigits(value +  4, 2, datetime.wMonth)
+	  || !tryParseDigits(value +  6, 2, datetime.wDay)    || !tryParseDigits(value +  8, 2, datetime.wHour)
+	  || !tryParseDigits(value + 10, 2, datetime.wMinute) || !tryParseDigits(value + 12, 2, datetime.wSecond)
+	  || !tryParseDigits(value + 15, 3, fraction)         || !tryParseDigits(value + 18, 3, fraction)
+	  || !tryParseDigits(value + 22, 3, offset) )
+		return false;
+
+	if ( (datetime.wMonth < 1) || (datetime.wMonth > 12)
+	  || (datetime.wDay < 1) || (datetime.wDay > daysInMonth(datetime.wYear, datetime.wMonth))
+	  || (datetime.wHour > 23) || (datetime.wMinute > 59) || (datetime.wSecond > 59) )
+		return false;
+
+	datetime.wDayOfWeek = 0;
+	datetime.wMilliseconds = 0;
 
 	return true;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-//! Format an empty/null value.
+//! Append a WMI datetime to the buffer using the WMI library parser. This is
+//! the slow path for the years outside those converted in place.
 
-static tstring formatEmptyValue(const WCL::Variant& value, bool applyFormatting)
+static bool appendLibraryDateTime(tstring& buffer, const tchar* value, size_t length)
 {
-	tstring result;
+	CDateTime parsed;
+	tstring   offset;
+
+	if (!WMI::tryParseDateTime(tstring(value, length), parsed, offset))
+		return false;
+
+	buffer += Core::fmt(TXT("%s %s"), parsed.ToString().c_str(), offset.c_str());
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Append a WMI datetime to the buffer as a locale formatted date and time,
+//! followed by the timezone offset. The value is parsed and formatted in place
+//! so that no temporary strings are created. Returns false if the value is not
+//! a valid datetime.
+
+static bool appendDateTime(tstring& buffer, const tchar* value, size_t length)
+{
+	SYSTEMTIME datetime;
+	tchar      date[MAX_DATETIME_CHARS];
+	tchar      time[MAX_DATETIME_CHARS];
 
+	if (!tryParseDateTime(value, length, datetime))
+		return false;
+
+	if ( (datetime.wYear < MIN_YEAR) || (datetime.wYear > MAX_YEAR) )
+		return appendLibraryDateTime(buffer, value, length);
+
+	if ( (::GetDateFormat(LOCALE_USER_DEFAULT, DATE_SHORTDATE, &datetime, nullptr, date, MAX_DATETIME_CHARS) == 0)
+	  || (::GetTimeFormat(LOCALE_USER_DEFAULT, 0, &datetime, nullptr, time, MAX_DATETIME_CHARS) == 0) )
+		return false;
+
+	buffer += date;
+	buffer += TXT(' ');
+	buffer += time;
+	buffer += TXT(' ');
+	buffer.append(value + 21, DATETIME_LENGTH - 21);
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Try and convert a string into a datetime. The format of a WMI datetime is:-
+//! YYYYMMDDHHMMSS.FFFFFF+TZO e.g. 20101008181758.546000+060
+
+bool tryConvertDateTime(const tstring& value, tstring& datetime)
+{
+	datetime.erase();
+
+	return appendDateTime(datetime, value.data(), value.length());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Try and convert a string into a 64-bit integer. WMI appears to return sint64
+//! and uint64 values as strings (VT_BSTR).
+
+bool tryConvert64BitInteger(const tstring& value, tstring& integer)
+{
+	const tchar* begin = value.data();
+	const tchar* end = begin + value.length();
+	uint64       magnitude;
+	bool         negative;
+
+	if (!tryParse64BitInteger(begin, end, magnitude, negative))
+		return false;
+
+	integer.erase();
+	appendInteger(integer, magnitude, negative, true);
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Format an empty/null value.
+
+static void appendEmptyValue(tstring& buffer, const WCL::Variant& value, bool applyFormatting)
+{
 	if (applyFormatting)
 	{
 		ASSERT((value.type() == VT_EMPTY) || (value.type() == VT_NULL));
 
 		if (value.type() == VT_EMPTY)
 		{
-			result = TXT("<empty>");
+			buffer += TXT("<empty>");
 		}
 		else if (value.type() == VT_NULL)
 		{
-			result = TXT("<null>");
+			buffer += TXT("<null>");
 		}
 	}
-
-	return result;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-//! Format a string value. If enabled it will look for strings that appear to be
-//! WMI style datetimes and reformat them as a normal datetime.
+//! Format a string. If enabled it will look for strings that appear to be
+//! WMI style datetimes and reformat them as a normal datetime. The string is
+//! classified directly from the BSTR and only copied once into the buffer.
+//! The digits of a 64-bit integer are only grouped when requested. Returns
+//! true if the string was converted.
 
-static tstring formatStringValue(const WCL::Variant& value, bool applyFormatting)
+static bool appendString(tstring& buffer, const BSTR bstr, bool applyFormatting, bool groupDigits)
 {
-	tstring result = value.format();
+	const size_t length = ::SysStringLen(bstr);
 
 	if (applyFormatting)
 	{
-		tstring converted;
+#ifdef _UNICODE
+		const tchar* begin = (bstr != nullptr) ? bstr : TXT("");
+		const tchar* end = begin + length;
+		uint64       magnitude;
+		bool         negative;
 
-		if (tryConvertDateTime(result, converted))
+		if (looksLikeDateTime(begin, length))
+		{
+			if (appendDateTime(buffer, begin, length))
+				return true;
+		}
+		else if (tryParse64BitInteger(begin, end, magnitude, negative))
 		{
-			result = converted;
+			appendInteger(buffer, magnitude, negative, groupDigits);
+			return true;
 		}
-		else if (tryConvert64BitInteger(result, converted))
+#else
+		const tstring string = (bstr != nullptr) ? tstring(W2T(bstr)) : tstring();
+		const tchar*  begin = string.data();
+		const tchar*  end = begin + string.length();
+		uint64        magnitude;
+		bool          negative;
+
+		if (appendDateTime(buffer, begin, string.length()))
+			return true;
+
+		if (tryParse64BitInteger(begin, end, magnitude, negative))
 		{
-			result = converted;
+			appendInteger(buffer, magnitude, negative, groupDigits);
+			return true;
 		}
+#endif
 	}
 
-	return result;
+	if (bstr != nullptr)
+		appendWideString(buffer, bstr, length);
+
+	return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Format a string value.
+
+static void appendStringValue(tstring& buffer, const WCL::Variant& value, bool applyFormatting)
+{
+	appendString(buffer, V_BSTR(&value), applyFormatting, applyFormatting);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 //! Format an integer value.
 
-static tstring formatIntegerValue(const WCL::Variant& value, bool applyFormatting)
+static void appendIntegerValue(tstring& buffer, const WCL::Variant& value, bool applyFormatting)
 {
-	tstring result;
+	uint64 magnitude = 0;
+	int64  signedValue = 0;
+	bool   isSigned = true;
 
-	if (applyFormatting)
+	switch (value.type())
 	{
-		typedef tstring::reverse_iterator rev_iter;
-		typedef tstring::const_reverse_iterator c_rev_iter;
+		case VT_I1:		signedValue = V_I1(&value);		break;
+		case VT_I2:		signedValue = V_I2(&value);		break;
+		case VT_I4:		signedValue = V_I4(&value);		break;
+		case VT_I8:		signedValue = V_I8(&value);		break;
+		case VT_UI1:	magnitude = V_UI1(&value);	isSigned = false;	break;
+		case VT_UI2:	magnitude = V_UI2(&value);	isSigned = false;	break;
+		case VT_UI4:	magnitude = V_UI4(&value);	isSigned = false;	break;
+		case VT_UI8:	magnitude = V_UI8(&value);	isSigned = false;	break;
+		default:		ASSERT_FALSE();								break;
+	}
 
-		const tstring rawResult = value.format();
+	const bool negative = isSigned && (signedValue < 0);
 
-		const size_t  numDigits = (rawResult[0] != TXT('-')) ? rawResult.length() : (rawResult.length()-1);
-		const tstring separator = getGroupSeparator();
-		const size_t  numSeps = (numDigits-1) / 3;
-		const size_t  total = rawResult.length() + (numSeps * separator.length());
+	if (isSigned)
+		magnitude = (negative) ? (0 - static_cast<uint64>(signedValue)) : static_cast<uint64>(signedValue);
 
-		result = tstring(total, TXT(' '));
+	appendInteger(buffer, magnitude, negative, applyFormatting);
+}
 
-		c_rev_iter it = rawResult.rbegin();
-		c_rev_iter end = rawResult.rend();
+////////////////////////////////////////////////////////////////////////////////
+//! Helper class to lock a SAFEARRAY's data for direct access for the lifetime
+//! of the object.
 
-		size_t   digits = 0;
-		size_t   seps = 0;
-		rev_iter output = result.rbegin();
+class SafeArrayLock
+{
+public:
+	//! Constructor.
+	SafeArrayLock(SAFEARRAY* array)
+		: m_array(array)
+		, m_data(nullptr)
+		, m_result(::SafeArrayAccessData(array, &m_data))
+	{
+	}
 
-		while (it != end)
-		{
-			*output++ = *it++;
+	//! Destructor.
+	~SafeArrayLock()
+	{
+		if (SUCCEEDED(m_result))
+			::SafeArrayUnaccessData(m_array);
+	}
 
-			if ( ((++digits % 3) == 0) && (seps++ != numSeps) )
-				output = std::copy(separator.rbegin(), separator.rend(), output);
-		}
+	//! Check if the data was successfully locked.
+	bool isLocked() const
+	{
+		return SUCCEEDED(m_result);
 	}
-	else
+
+	//! Get the array data as the specified element type.
+	template<typename T>
+	const T* data() const
 	{
-		result = value.format();
+		return static_cast<const T*>(m_data);
 	}
 
-	return result;
+private:
+	//
+	// Members.
+	//
+	SAFEARRAY*	m_array;	//!< The array being accessed.
+	void*		m_data;		//!< The locked array data.
+	HRESULT		m_result;	//!< The result of locking the array.
+
+	// NotCopyable.
+	SafeArrayLock(const SafeArrayLock&);
+	SafeArrayLock& operator=(const SafeArrayLock&);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! Append the separator that goes between array elements. This is the same
+//! as the original string array output regardless of the formatting.
+
+static inline void appendItemSeparator(tstring& buffer)
+{
+	buffer += TXT(',');
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-//! Format a VARIANT type value.
+//! Format an array of signed integers. The digits are never grouped as the
+//! group separator would be confused with the item separator.
 
-tstring formatValue(const WCL::Variant& value, bool applyFormatting)
+template<typename T>
+static void appendSignedItems(tstring& buffer, const T* items, size_t count)
+{
+	buffer.reserve(buffer.length() + (count * (MAX_INTEGER_DIGITS + 2)));
+
+	for (size_t i = 0; i != count; ++i)
+	{
+		if (i != 0)
+			appendItemSeparator(buffer);
+
+		appendSignedInteger(buffer, items[i], false);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Format an array of unsigned integers. The digits are never grouped.
+
+template<typename T>
+static void appendUnsignedItems(tstring& buffer, const T* items, size_t count)
+{
+	buffer.reserve(buffer.length() + (count * (MAX_INTEGER_DIGITS + 2)));
+
+	for (size_t i = 0; i != count; ++i)
+	{
+		if (i != 0)
+			appendItemSeparator(buffer);
+
+		appendInteger(buffer, items[i], false, false);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Format an array of floating-point values. The precision matches the number
+//! of significant digits the type can represent.
+
+template<typename T>
+static void appendRealItems(tstring& buffer, const T* items, size_t count, int precision)
+{
+	const size_t MAX_CHARS = 32;
+
+	tchar item[MAX_CHARS+1];
+
+	buffer.reserve(buffer.length() + (count * 8));
+
+	for (size_t i = 0; i != count; ++i)
+	{
+		if (i != 0)
+			appendItemSeparator(buffer);
+
+		int length = _sntprintf_s(item, MAX_CHARS+1, MAX_CHARS, TXT("%.*g"), precision, static_cast<double>(items[i]));
+
+		if (length > 0)
+			buffer.append(item, length);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Format an array of booleans.
+
+static void appendBoolItems(tstring& buffer, const VARIANT_BOOL* items, size_t count)
+{
+	buffer.reserve(buffer.length() + (count * 7));
+
+	for (size_t i = 0; i != count; ++i)
+	{
+		if (i != 0)
+			appendItemSeparator(buffer);
+
+		buffer += (items[i] != VARIANT_FALSE) ? TXT("True") : TXT("False");
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Format an array of strings. When formatting is enabled each element is
+//! subject to the same datetime detection as a scalar, but the digits of a
+//! 64-bit integer are not grouped.
+
+static void appendStringItems(tstring& buffer, const BSTR* items, size_t count, bool applyFormatting)
+{
+	size_t total = 0;
+
+	for (size_t i = 0; i != count; ++i)
+		total += ::SysStringLen(items[i]) + 2;
+
+	buffer.reserve(buffer.length() + total);
+
+	for (size_t i = 0; i != count; ++i)
+	{
+		if (i != 0)
+			appendItemSeparator(buffer);
+
+		appendString(buffer, items[i], applyFormatting, false);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Format an array value. The elements are read directly from the locked
+//! SAFEARRAY. When formatting is enabled large arrays are truncated to the
+//! first MAX_ARRAY_ITEMS elements.
+
+static void appendArrayValue(tstring& buffer, const WCL::Variant& value, bool applyFormatting)
+{
+	const VARTYPE valueType = value.valueType();
+	SAFEARRAY*    safeArray = V_ARRAY(&value);
+
+	if ( (safeArray == nullptr) || (::SafeArrayGetDim(safeArray) != 1) )
+	{
+		buffer += Core::fmt(TXT("<array of %s>"), WCL::Variant::formatType(valueType));
+		return;
+	}
+
+	const size_t  length = safeArray->rgsabound[0].cElements;
+	const size_t  count = (applyFormatting) ? std::min(length, MAX_ARRAY_ITEMS) : length;
+	SafeArrayLock lock(safeArray);
+
+	if (!lock.isLocked())
+	{
+		buffer += TXT("<conversion failed>");
+		return;
+	}
+
+	switch (valueType)
+	{
+		case VT_I1:		appendSignedItems(buffer, lock.data<CHAR>(), count);					break;
+		case VT_I2:		appendSignedItems(buffer, lock.data<SHORT>(), count);					break;
+		case VT_I4:		appendSignedItems(buffer, lock.data<LONG>(), count);					break;
+		case VT_I8:		appendSignedItems(buffer, lock.data<LONGLONG>(), count);				break;
+		case VT_INT:	appendSignedItems(buffer, lock.data<INT>(), count);						break;
+		case VT_UI1:	appendUnsignedItems(buffer, lock.data<BYTE>(), count);					break;
+		case VT_UI2:	appendUnsignedItems(buffer, lock.data<USHORT>(), count);				break;
+		case VT_UI4:	appendUnsignedItems(buffer, lock.data<ULONG>(), count);					break;
+		case VT_UI8:	appendUnsignedItems(buffer, lock.data<ULONGLONG>(), count);				break;
+		case VT_UINT:	appendUnsignedItems(buffer, lock.data<UINT>(), count);					break;
+		case VT_R4:		appendRealItems(buffer, lock.data<FLOAT>(), count, 7);					break;
+		case VT_R8:		appendRealItems(buffer, lock.data<DOUBLE>(), count, 15);				break;
+		case VT_BOOL:	appendBoolItems(buffer, lock.data<VARIANT_BOOL>(), count);				break;
+		case VT_BSTR:	appendStringItems(buffer, lock.data<BSTR>(), count, applyFormatting);	break;
+
+		default:
+		{
+			buffer += Core::fmt(TXT("<array of %s>"), WCL::Variant::formatType(valueType));
+			return;
+		}
+	}
+
+	if (count != length)
+		buffer += Core::fmt(TXT(",... (%lu more)"), static_cast<unsigned long>(length - count));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Append the formatted VARIANT type value to the buffer.
+
+void appendValue(tstring& buffer, const WCL::Variant& value, bool applyFormatting)
 {
-	tstring result;
 	VARTYPE type = value.type();
 
 	if ( (type == VT_EMPTY) || (type == VT_NULL))
 	{
-		result = formatEmptyValue(value, applyFormatting);
+		appendEmptyValue(buffer, value, applyFormatting);
 	}
 	else if (type == VT_BSTR)
 	{
-		result = formatStringValue(value, applyFormatting);
+		appendStringValue(buffer, value, applyFormatting);
 	}
 	else if ( (type == VT_I1 ) || (type == VT_I2 ) || (type == VT_I4 ) || (type == VT_I8 )
 		   || (type == VT_UI1) || (type == VT_UI2) || (type == VT_UI4) || (type == VT_UI8) )
 	{
-		result = formatIntegerValue(value, applyFormatting);
+		appendIntegerValue(buffer, value, applyFormatting);
+	}
+	else if (value.isArray())
+	{
+		appendArrayValue(buffer, value, applyFormatting);
 	}
 	else
 	{
-		if (value.isArray())
-		{
-			VARTYPE valueType = value.valueType();
-
-			if (valueType == VT_BSTR)
-			{
-				typedef WCL::VariantVector<BSTR>::const_iterator c_iter;
-
-				SAFEARRAY*               safeArray = V_ARRAY(&value);
-				WCL::VariantVector<BSTR> array(safeArray, VT_BSTR, false);
-
-				for (c_iter it = array.begin(); it != array.end(); ++it)
-				{
-					if (it != array.begin())
-						result += TXT(',');
-
-					result += W2T(*it);
-				}
-			}
-			else
-			{
-				result = Core::fmt(TXT("<array of %s>"), WCL::Variant::formatType(valueType));
-			}
-		}
+		tstring result;
+
+		if (value.tryFormat(result))
+			buffer += result;
 		else
+			buffer += TXT("<conversion failed>");
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Format a VARIANT type value.
+
+tstring formatValue(const WCL::Variant& value, bool applyFormatting)
+{
+	tstring result;
+
+	appendValue(result, value, applyFormatting);
+
+	return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Append the output line for a single property to the buffer. The property
+//! type is only formatted when it's going to be displayed.
+
+void appendProperty(tstring& buffer, const tstring& name, size_t nameWidth, const WCL::Variant& value, bool showTypes, bool applyFormatting)
+{
+	buffer += name;
+
+	if (nameWidth > name.length())
+		buffer.append(nameWidth - name.length(), TXT(' '));
+
+	if (showTypes)
+	{
+		buffer += TXT(" [");
+		buffer += WCL::Variant::formatFullType(value);
+		buffer += TXT("]");
+	}
+
+	buffer += TXT(": ");
+	appendValue(buffer, value, applyFormatting);
+	buffer += TXT('\n');
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// The value formatters used by ColumnFormatter.
+
+//! The plain string count of a column that has held a converted string.
+static const size_t MIXED_STRINGS = static_cast<size_t>(-1);
+
+////////////////////////////////////////////////////////////////////////////////
+//! Formats a value of a single type, with or without formatting applied. The
+//! general case handles a value of any type and is used for the types that
+//! don't have a specialisation, e.g. arrays.
+
+template<VARTYPE Type, bool ApplyFormatting>
+struct ValueFormatter
+{
+	static void append(tstring& buffer, const WCL::Variant& value, size_t& /*numPlainStrings*/)
+	{
+		appendValue(buffer, value, ApplyFormatting);
+	}
+};
+
+//! Formats an empty value.
+template<>
+struct ValueFormatter<VT_EMPTY, true>
+{
+	static void append(tstring& buffer, const WCL::Variant& /*value*/, size_t& /*numPlainStrings*/)
+	{
+		buffer += TXT("<empty>");
+	}
+};
+
+//! Formats a null value.
+template<>
+struct ValueFormatter<VT_NULL, true>
+{
+	static void append(tstring& buffer, const WCL::Variant& /*value*/, size_t& /*numPlainStrings*/)
+	{
+		buffer += TXT("<null>");
+	}
+};
+
+//! Formats an empty value without any formatting, i.e. as nothing.
+template<>
+struct ValueFormatter<VT_EMPTY, false>
+{
+	static void append(tstring& /*buffer*/, const WCL::Variant& /*value*/, size_t& /*numPlainStrings*/)
+	{
+	}
+};
+
+//! Formats a null value without any formatting, i.e. as nothing.
+template<>
+struct ValueFormatter<VT_NULL, false>
+{
+	static void append(tstring& /*buffer*/, const WCL::Variant& /*value*/, size_t& /*numPlainStrings*/)
+	{
+	}
+};
+
+//! Formats a string value, trying to convert it to a datetime or 64-bit integer.
+//! The column's count of plain strings is updated.
+template<>
+struct ValueFormatter<VT_BSTR, true>
+{
+	static void append(tstring& buffer, const WCL::Variant& value, size_t& numPlainStrings)
+	{
+		const bool converted = appendString(buffer, V_BSTR(&value), true, true);
+
+		if (numPlainStrings != MIXED_STRINGS)
+			numPlainStrings = (converted) ? MIXED_STRINGS : numPlainStrings+1;
+	}
+};
+
+//! Formats a string value as is.
+template<>
+struct ValueFormatter<VT_BSTR, false>
+{
+	static void append(tstring& buffer, const WCL::Variant& value, size_t& /*numPlainStrings*/)
+	{
+		appendString(buffer, V_BSTR(&value), false, false);
+	}
+};
+
+//! Formats a signed 8-bit integer value.
+template<bool ApplyFormatting>
+struct ValueFormatter<VT_I1, ApplyFormatting>
+{
+	static void append(tstring& buffer, const WCL::Variant& value, size_t& /*numPlainStrings*/)
+	{
+		appendSignedInteger(buffer, V_I1(&value), ApplyFormatting);
+	}
+};
+
+//! Formats a signed 16-bit integer value.
+template<bool ApplyFormatting>
+struct ValueFormatter<VT_I2, ApplyFormatting>
+{
+	static void append(tstring& buffer, const WCL::Variant& value, size_t& /*numPlainStrings*/)
+	{
+		appendSignedInteger(buffer, V_I2(&value), ApplyFormatting);
+	}
+};
+
+//! Formats a signed 32-bit integer value.
+template<bool ApplyFormatting>
+struct ValueFormatter<VT_I4, ApplyFormatting>
+{
+	static void append(tstring& buffer, const WCL::Variant& value, size_t& /*numPlainStrings*/)
+	{
+		appendSignedInteger(buffer, V_I4(&value), ApplyFormatting);
+	}
+};
+
+//! Formats a signed 64-bit integer value.
+template<bool ApplyFormatting>
+struct ValueFormatter<VT_I8, ApplyFormatting>
+{
+	static void append(tstring& buffer, const WCL::Variant& value, size_t& /*numPlainStrings*/)
+	{
+		appendSignedInteger(buffer, V_I8(&value), ApplyFormatting);
+	}
+};
+
+//! Formats an unsigned 8-bit integer value.
+template<bool ApplyFormatting>
+struct ValueFormatter<VT_UI1, ApplyFormatting>
+{
+	static void append(tstring& buffer, const WCL::Variant& value, size_t& /*numPlainStrings*/)
+	{
+		appendInteger(buffer, V_UI1(&value), false, ApplyFormatting);
+	}
+};
+
+//! Formats an unsigned 16-bit integer value.
+template<bool ApplyFormatting>
+struct ValueFormatter<VT_UI2, ApplyFormatting>
+{
+	static void append(tstring& buffer, const WCL::Variant& value, size_t& /*numPlainStrings*/)
+	{
+		appendInteger(buffer, V_UI2(&value), false, ApplyFormatting);
+	}
+};
+
+//! Formats an unsigned 32-bit integer value.
+template<bool ApplyFormatting>
+struct ValueFormatter<VT_UI4, ApplyFormatting>
+{
+	static void append(tstring& buffer, const WCL::Variant& value, size_t& /*numPlainStrings*/)
+	{
+		appendInteger(buffer, V_UI4(&value), false, ApplyFormatting);
+	}
+};
+
+//! Formats an unsigned 64-bit integer value.
+template<bool ApplyFormatting>
+struct ValueFormatter<VT_UI8, ApplyFormatting>
+{
+	static void append(tstring& buffer, const WCL::Variant& value, size_t& /*numPlainStrings*/)
+	{
+		appendInteger(buffer, V_UI8(&value), false, ApplyFormatting);
+	}
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! Could the string be converted? Both WMI datetimes and 64-bit integers start
+//! with a digit, or a minus sign, and so any other string is plain text.
+
+static inline bool startsLikeNumber(const BSTR bstr)
+{
+	return (bstr != nullptr) && ( ((bstr[0] >= L'0') && (bstr[0] <= L'9')) || (bstr[0] == L'-') );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Format a string value in a column that has only held plain text. Only a
+//! string that could be converted is passed on to the detecting formatter, so
+//! the output is the same as if the column had never stopped detecting. This
+//! matters as the workers in the formatting pipeline each see different rows.
+
+static void appendPlainString(tstring& buffer, const WCL::Variant& value, size_t& numPlainStrings)
+{
+	const BSTR bstr = V_BSTR(&value);
+
+	if (startsLikeNumber(bstr))
+		ValueFormatter<VT_BSTR, true>::append(buffer, value, numPlainStrings);
+	else if (bstr != nullptr)
+		appendWideString(buffer, bstr, ::SysStringLen(bstr));
+}
+
+//! An entry in the table of value formatters.
+struct FormatterEntry
+{
+	VARTYPE						m_type;			//!< The value type.
+	ColumnFormatter::AppendFn	m_formatted;	//!< The formatter when formatting is applied.
+	ColumnFormatter::AppendFn	m_raw;			//!< The formatter for raw values.
+};
+
+//! The table of formatters specialised by type. Any other type is handled by
+//! the general formatter.
+static const FormatterEntry s_formatters[] =
+{
+	{ VT_EMPTY,	&ValueFormatter<VT_EMPTY, true>::append,	&ValueFormatter<VT_EMPTY, false>::append	},
+	{ VT_NULL,	&ValueFormatter<VT_NULL, true>::append,		&ValueFormatter<VT_NULL, false>::append		},
+	{ VT_BSTR,	&ValueFormatter<VT_BSTR, true>::append,		&ValueFormatter<VT_BSTR, false>::append		},
+	{ VT_I1,	&ValueFormatter<VT_I1, true>::append,		&ValueFormatter<VT_I1, false>::append		},
+	{ VT_I2,	&ValueFormatter<VT_I2, true>::append,		&ValueFormatter<VT_I2, false>::append		},
+	{ VT_I4,	&ValueFormatter<VT_I4, true>::append,		&ValueFormatter<VT_I4, false>::append		},
+	{ VT_I8,	&ValueFormatter<VT_I8, true>::append,		&ValueFormatter<VT_I8, false>::append		},
+	{ VT_UI1,	&ValueFormatter<VT_UI1, true>::append,		&ValueFormatter<VT_UI1, false>::append		},
+	{ VT_UI2,	&ValueFormatter<VT_UI2, true>::append,		&ValueFormatter<VT_UI2, false>::append		},
+	{ VT_UI4,	&ValueFormatter<VT_UI4, true>::append,		&ValueFormatter<VT_UI4, false>::append		},
+	{ VT_UI8,	&ValueFormatter<VT_UI8, true>::append,		&ValueFormatter<VT_UI8, false>::append		},
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! Constructor. The formatter is chosen when the first value is formatted.
+
+ColumnFormatter::ColumnFormatter(bool showTypes, bool applyFormatting)
+	: m_showTypes(showTypes)
+	, m_applyFormatting(applyFormatting)
+	, m_type(VT_ILLEGAL)
+	, m_append(nullptr)
+	, m_typeName()
+	, m_numPlainStrings(0)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Append the formatted value to the buffer. This gives the same output as
+//! appendValue().
+
+void ColumnFormatter::appendValue(tstring& buffer, const WCL::Variant& value)
+{
+	if (V_VT(&value) != m_type)
+		bind(value);
+
+	m_append(buffer, value, m_numPlainStrings);
+
+	// The column has only held plain text so far.
+	if (m_numPlainStrings == DETECTION_SAMPLE)
+	{
+		m_append = &appendPlainString;
+		++m_numPlainStrings;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Append the output line for the property to the buffer. This gives the same
+//! output as appendProperty() but the type is only formatted when it changes.
+
+void ColumnFormatter::appendProperty(tstring& buffer, const tstring& name, size_t nameWidth, const WCL::Variant& value)
+{
+	if (V_VT(&value) != m_type)
+		bind(value);
+
+	buffer += name;
+
+	if (nameWidth > name.length())
+		buffer.append(nameWidth - name.length(), TXT(' '));
+
+	if (m_showTypes)
+	{
+		buffer += TXT(" [");
+		buffer += m_typeName;
+		buffer += TXT("]");
+	}
+
+	buffer += TXT(": ");
+	appendValue(buffer, value);
+	buffer += TXT('\n');
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Choose the formatter for the value's type. A string column that has already
+//! stopped detecting carries on where it left off.
+
+void ColumnFormatter::bind(const WCL::Variant& value)
+{
+	m_type = V_VT(&value);
+	m_append = (m_applyFormatting) ? &ValueFormatter<VT_VARIANT, true>::append : &ValueFormatter<VT_VARIANT, false>::append;
+
+	for (size_t i = 0; i != ARRAY_SIZE(s_formatters); ++i)
+	{
+		if (s_formatters[i].m_type == m_type)
 		{
-			if (!value.tryFormat(result))
-				result = TXT("<conversion failed>");
+			m_append = (m_applyFormatting) ? s_formatters[i].m_formatted : s_formatters[i].m_raw;
+			break;
 		}
 	}
 
-	return result;
+	if ( (m_type == VT_BSTR) && m_applyFormatting
+	  && (m_numPlainStrings > DETECTION_SAMPLE) && (m_numPlainStrings != MIXED_STRINGS) )
+		m_append = &appendPlainString;
+
+	if (m_showTypes)
+		m_typeName = WCL::Variant::formatFullType(value);
 }
@@ -12,6 +12,7 @@
 #endif
 
 #include <WCL/Variant.hpp>
+#include <vector>
 
 ////////////////////////////////////////////////////////////////////////////////
 // Try and convert a string into a datetime. The format of a WMI datetime is:-
@@ -31,4 +32,69 @@ bool tryConvert64BitInteger(const tstring& value, tstring& integer);
 
 tstring formatValue(const WCL::Variant& value, bool detectDates);
 
+////////////////////////////////////////////////////////////////////////////////
+// Append the formatted value to the buffer. Once the buffer has grown to its
+// working size this does not allocate for strings, integers or empty values.
+
+void appendValue(tstring& buffer, const WCL::Variant& value, bool applyFormatting);
+
+////////////////////////////////////////////////////////////////////////////////
+// Append the output line for a single property, i.e. "name [type]: value", to
+// the buffer. The name is padded to nameWidth characters.
+
+void appendProperty(tstring& buffer, const tstring& name, size_t nameWidth, const WCL::Variant& value, bool showTypes, bool applyFormatting);
+
+////////////////////////////////////////////////////////////////////////////////
+//! Formats the values of a single property across many objects, i.e. a column.
+//! The function used to format a value is taken from a table of formatters
+//! specialised by type and whether formatting is applied, and is only looked
+//! up again when the type changes, e.g. for a null. A string column stops
+//! trying to convert its values once the first DETECTION_SAMPLE have all been
+//! plain text.
+
+class ColumnFormatter
+{
+public:
+	//! Constructor.
+	ColumnFormatter(bool showTypes, bool applyFormatting);
+
+	//! Append the formatted value to the buffer.
+	void appendValue(tstring& buffer, const WCL::Variant& value);
+
+	//! Append the output line for the property to the buffer.
+	void appendProperty(tstring& buffer, const tstring& name, size_t nameWidth, const WCL::Variant& value);
+
+	//
+	// Constants.
+	//
+
+	//! The number of plain strings after which a string column stops detecting.
+	static const size_t DETECTION_SAMPLE = 32;
+
+	//! The type of a function that formats a value. The count of plain strings
+	//! is only used by the string formatters.
+	typedef void (*AppendFn)(tstring& buffer, const WCL::Variant& value, size_t& numPlainStrings);
+
+private:
+	//
+	// Members.
+	//
+	bool		m_showTypes;		//!< Append the type to the property name?
+	bool		m_applyFormatting;	//!< Format the values?
+	VARTYPE		m_type;				//!< The type the formatter was chosen for.
+	AppendFn	m_append;			//!< The formatter for the type.
+	tstring		m_typeName;			//!< The formatted type, if shown.
+	size_t		m_numPlainStrings;	//!< The number of plain strings seen so far.
+
+	//
+	// Internal methods.
+	//
+
+	//! Choose the formatter for the value's type.
+	void bind(const WCL::Variant& value);
+};
+
+//! The formatters for the properties of an object.
+typedef std::vector<ColumnFormatter> ColumnFormatters;
+
 #endif // APP_FORMAT_HPP
@@ -0,0 +1,424 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   FormattingPipeline.cpp
+//! \brief  The FormattingPipeline class definition.
+//! \author Chris Oldwood
+
+#include "Common.hpp"
+#include "FormattingPipeline.hpp"
+#include "Format.hpp"
+#include "AllocationCounter.hpp"
+#include <Core/RuntimeException.hpp>
+#include <Core/StringUtils.hpp>
+#include <algorithm>
+
+////////////////////////////////////////////////////////////////////////////////
+//! Exchange the contents with another snapshot without copying them.
+
+void ObjectSnapshot::swap(ObjectSnapshot& rhs)
+{
+	std::swap(m_sequence, rhs.m_sequence);
+	m_heading.swap(rhs.m_heading);
+	std::swap(m_isObject, rhs.m_isObject);
+	m_names.swap(rhs.m_names);
+	m_values.swap(rhs.m_values);
+	m_text.swap(rhs.m_text);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Format the heading and object in the snapshot into its text buffer. As the
+//! formatters only last for the one snapshot they have no chance to adapt.
+
+void formatSnapshot(ObjectSnapshot& snapshot, bool showTypes, bool applyFormatting, bool align)
+{
+	SnapshotFormatter formatter(showTypes, applyFormatting, align);
+
+	formatter.format(snapshot);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Constructor.
+
+SnapshotFormatter::SnapshotFormatter(bool showTypes, bool applyFormatting, bool align)
+	: m_showTypes(showTypes)
+	, m_applyFormatting(applyFormatting)
+	, m_align(align)
+	, m_names()
+	, m_columns()
+	, m_nameWidth(0)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Format the heading and object in the snapshot into its text buffer.
+
+void SnapshotFormatter::format(ObjectSnapshot& snapshot)
+{
+	ASSERT(snapshot.m_names.size() == snapshot.m_values.size());
+
+	snapshot.m_text = snapshot.m_heading;
+
+	if (!snapshot.m_isObject)
+		return;
+
+	if (snapshot.m_names != m_names)
+		startColumns(snapshot.m_names);
+
+	if (m_applyFormatting)
+		snapshot.m_text += TXT('\n');
+
+	for (size_t i = 0; i != snapshot.m_names.size(); ++i)
+		m_columns[i].appendProperty(snapshot.m_text, snapshot.m_names[i], m_nameWidth, snapshot.m_values[i]);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Start formatting a new set of columns. Each column starts with a fresh
+//! formatter and the name width is only calculated once.
+
+void SnapshotFormatter::startColumns(const WMI::Object::PropertyNames& names)
+{
+	typedef WMI::Object::PropertyNames::const_iterator PropNameIter;
+
+	m_names = names;
+	m_columns.assign(names.size(), ColumnFormatter(m_showTypes, m_applyFormatting));
+
+	size_t maxNameLength = 0;
+
+	for (PropNameIter it = names.begin(); it != names.end(); ++it)
+		maxNameLength = std::max(it->length(), maxNameLength);
+
+	m_nameWidth = (m_align) ? maxNameLength : 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Check if the snapshot holds an embedded object, or an array of them. These
+//! belong to the apartment of the thread that read them and so must not be
+//! touched by another thread.
+
+static bool holdsEmbeddedObject(const ObjectSnapshot& snapshot)
+{
+	for (PropertyValues::const_iterator it = snapshot.m_values.begin(); it != snapshot.m_values.end(); ++it)
+	{
+		const VARTYPE type = static_cast<VARTYPE>(V_VT(&*it) & VT_TYPEMASK);
+
+		if ( (type == VT_UNKNOWN) || (type == VT_DISPATCH) )
+			return true;
+	}
+
+	return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Constructor.
+
+FormattingPipeline::FormattingPipeline(size_t numWorkers, bool showTypes, bool applyFormatting, bool align)
+	: m_numWorkers(numWorkers)
+	, m_showTypes(showTypes)
+	, m_applyFormatting(applyFormatting)
+	, m_align(align)
+	, m_snapshots()
+	, m_free(numWorkers * SNAPSHOTS_PER_WORKER)
+	, m_unformatted(numWorkers * SNAPSHOTS_PER_WORKER)
+	, m_formatted(numWorkers * SNAPSHOTS_PER_WORKER)
+	, m_lock()
+	, m_error()
+	, m_sinkFailed(FALSE)
+{
+	ASSERT(numWorkers != 0);
+
+	for (size_t i = 0; i != (numWorkers * SNAPSHOTS_PER_WORKER); ++i)
+	{
+		m_snapshots.push_back(new ObjectSnapshot());
+		m_free.push(m_snapshots.back());
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Destructor.
+
+FormattingPipeline::~FormattingPipeline()
+{
+	for (Snapshots::iterator it = m_snapshots.begin(); it != m_snapshots.end(); ++it)
+		delete *it;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Format all the objects from the source and write them to the stream.
+
+void FormattingPipeline::run(ObjectSource& source, tostream& out)
+{
+	StreamSink sink(out);
+
+	run(source, sink);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Format all the objects from the source and write them to the sink. The
+//! source is read on the calling thread. If the source throws, the objects
+//! already read are still written before the exception is passed on. If the
+//! sink fails, the source is not read any further. The pipeline can only be
+//! run once.
+
+void FormattingPipeline::run(ObjectSource& source, SnapshotSink& sink)
+{
+	SnapshotFormatter formatter(m_showTypes, m_applyFormatting, m_align);
+	Threads           workers;
+	Writer*           writer = nullptr;
+
+	try
+	{
+		for (size_t i = 0; i != m_numWorkers; ++i)
+		{
+			workers.push_back(new Worker(*this));
+			workers.back()->start();
+		}
+
+		writer = new Writer(*this, sink);
+		writer->start();
+
+		for (size_t sequence = 0; ; ++sequence)
+		{
+			ObjectSnapshot* snapshot = nullptr;
+
+			m_free.pop(snapshot);
+
+			if (m_sinkFailed || !source.next(*snapshot))
+			{
+				m_free.push(snapshot);
+				break;
+			}
+
+			snapshot->m_sequence = sequence;
+
+			if (holdsEmbeddedObject(*snapshot))
+			{
+				formatSnapshot(formatter, *snapshot);
+				m_formatted.push(snapshot);
+			}
+			else
+			{
+				m_unformatted.push(snapshot);
+			}
+		}
+	}
+	catch (...)
+	{
+		stopThreads(workers, writer);
+		throw;
+	}
+
+	stopThreads(workers, writer);
+
+	if (!m_error.empty())
+		throw Core::RuntimeException(m_error);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Stop the threads once they have drained the queues. The writer can only be
+//! told there is nothing more to come once all the workers have finished.
+
+void FormattingPipeline::stopThreads(Threads& workers, Thread* writer)
+{
+	m_unformatted.close();
+
+	for (Threads::iterator it = workers.begin(); it != workers.end(); ++it)
+	{
+		(*it)->join();
+		delete *it;
+	}
+
+	workers.clear();
+
+	m_formatted.close();
+
+	if (writer != nullptr)
+	{
+		writer->join();
+		delete writer;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Format a snapshot. A snapshot that fails to format is left without any text
+//! so that it can still be passed on and the writer never waits for it.
+
+void FormattingPipeline::formatSnapshot(SnapshotFormatter& formatter, ObjectSnapshot& snapshot)
+{
+	try
+	{
+		formatter.format(snapshot);
+	}
+	catch (const Core::Exception& e)
+	{
+		snapshot.m_text.erase();
+		setError(e.twhat());
+	}
+	catch (const std::exception& e)
+	{
+		snapshot.m_text.erase();
+		setError(Core::fmt(TXT("Unexpected exception: %hs"), e.what()));
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! The formatting thread's main loop.
+
+void FormattingPipeline::formatSnapshots()
+{
+	SnapshotFormatter formatter(m_showTypes, m_applyFormatting, m_align);
+	ObjectSnapshot*   snapshot = nullptr;
+
+	while (m_unformatted.pop(snapshot))
+	{
+		formatSnapshot(formatter, *snapshot);
+
+		m_formatted.push(snapshot);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! The writer thread's main loop. The snapshots arrive in any order and are
+//! held until the next one in sequence turns up. As there can be no more than
+//! the total number of snapshots in flight, a snapshot's slot in the reorder
+//! buffer is its sequence number modulo that. The sink is flushed whenever
+//! the writer catches up with the workers. After the sink fails the source is
+//! told to stop and the snapshots still in flight are taken, but discarded, so
+//! that the source never blocks.
+
+void FormattingPipeline::writeSnapshots(SnapshotSink& sink)
+{
+	const size_t numSlots = m_snapshots.size();
+
+	Snapshots reorder(numSlots, nullptr);
+	size_t    next = 0;
+	bool      sinkFailed = false;
+
+	for (;;)
+	{
+		ObjectSnapshot* snapshot = nullptr;
+
+		if (!m_formatted.tryPop(snapshot))
+		{
+			if (!sinkFailed)
+				sinkFailed = !flushSink(sink);
+
+			if (!m_formatted.pop(snapshot))
+				break;
+		}
+
+		reorder[snapshot->m_sequence % numSlots] = snapshot;
+
+		for (ObjectSnapshot* ready = reorder[next % numSlots]; ready != nullptr; ready = reorder[next % numSlots])
+		{
+			ASSERT(ready->m_sequence == next);
+
+			if (!sinkFailed)
+				sinkFailed = !writeSink(sink, *ready);
+
+			reorder[next % numSlots] = nullptr;
+			++next;
+
+			m_free.push(ready);
+		}
+	}
+
+	if (!sinkFailed)
+		flushSink(sink);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Write a snapshot to the sink. Returns false, after recording the error and
+//! telling the source to stop, if the sink failed.
+
+bool FormattingPipeline::writeSink(SnapshotSink& sink, const ObjectSnapshot& snapshot)
+{
+	try
+	{
+		sink.write(snapshot);
+		return true;
+	}
+	catch (const Core::Exception& e)
+	{
+		setError(e.twhat());
+	}
+	catch (const std::exception& e)
+	{
+		setError(Core::fmt(TXT("Unexpected exception: %hs"), e.what()));
+	}
+
+	::InterlockedExchange(&m_sinkFailed, TRUE);
+
+	return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Flush the sink. Returns false, after recording the error and telling the
+//! source to stop, if the sink failed.
+
+bool FormattingPipeline::flushSink(SnapshotSink& sink)
+{
+	try
+	{
+		sink.flush();
+		return true;
+	}
+	catch (const Core::Exception& e)
+	{
+		setError(e.twhat());
+	}
+	catch (const std::exception& e)
+	{
+		setError(Core::fmt(TXT("Unexpected exception: %hs"), e.what()));
+	}
+
+	::InterlockedExchange(&m_sinkFailed, TRUE);
+
+	return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Record the first error from a thread.
+
+void FormattingPipeline::setError(const tstring& error)
+{
+	AutoLock lock(m_lock);
+
+	if (m_error.empty())
+		m_error = error;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Constructor.
+
+FormattingPipeline::Worker::Worker(FormattingPipeline& pipeline)
+	: m_pipeline(pipeline)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! The thread's body.
+
+void FormattingPipeline::Worker::run()
+{
+	AllocationScope scope(FORMAT_STAGE);
+
+	m_pipeline.formatSnapshots();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Constructor.
+
+FormattingPipeline::Writer::Writer(FormattingPipeline& pipeline, SnapshotSink& sink)
+	: m_pipeline(pipeline)
+	, m_sink(sink)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! The thread's body.
+
+void FormattingPipeline::Writer::run()
+{
+	AllocationScope scope(OUTPUT_STAGE);
+
+	m_pipeline.writeSnapshots(m_sink);
+}
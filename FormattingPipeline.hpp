@@ -0,0 +1,273 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   FormattingPipeline.hpp
+//! \brief  The FormattingPipeline class declaration.
+//! \author Chris Oldwood
+
+// Check for previous inclusion
+#ifndef APP_FORMATTINGPIPELINE_HPP
+#define APP_FORMATTINGPIPELINE_HPP
+
+#if _MSC_VER > 1000
+#pragma once
+#endif
+
+#include "BoundedQueue.hpp"
+#include "Format.hpp"
+#include <WCL/Variant.hpp>
+#include <WMI/Object.hpp>
+#include <Core/tiostream.hpp>
+#include <Core/SharedPtr.hpp>
+#include <vector>
+
+//! The values of an object's properties.
+typedef std::vector<WCL::Variant> PropertyValues;
+
+////////////////////////////////////////////////////////////////////////////////
+//! A copy of an object's properties taken on the enumerating thread so that
+//! it can be formatted on another thread. A snapshot can instead just hold a
+//! heading, such as the hostname. Snapshots are recycled so that their buffers
+//! are reused.
+
+struct ObjectSnapshot
+{
+	size_t						m_sequence;	//!< The position in the output.
+	tstring						m_heading;	//!< Any text to output before the object.
+	bool						m_isObject;	//!< Does the snapshot hold an object?
+	WMI::Object::PropertyNames	m_names;	//!< The property names.
+	PropertyValues				m_values;	//!< The property values.
+	tstring						m_text;		//!< The formatted output.
+
+	//! Exchange the contents with another snapshot without copying them.
+	void swap(ObjectSnapshot& rhs);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! The source of the objects to format.
+
+class ObjectSource
+{
+public:
+	//! Destructor.
+	virtual ~ObjectSource() {}
+
+	//! Fill the snapshot with the next object or heading. Returns false when
+	//! there are no more.
+	virtual bool next(ObjectSnapshot& snapshot) = 0;
+
+	//! Move past the next object without copying its properties. A heading is
+	//! still returned in full. Returns false when there are no more.
+	virtual bool skip(ObjectSnapshot& snapshot)
+	{
+		return next(snapshot);
+	}
+
+	//! Stop reading the current result set as none of its remaining objects are
+	//! wanted. A source may still return some of them and so the caller must
+	//! skip any objects up to the next heading.
+	virtual void endResultSet()
+	{
+	}
+};
+
+//! The default object source smart-pointer type.
+typedef Core::SharedPtr<ObjectSource> ObjectSourcePtr;
+
+////////////////////////////////////////////////////////////////////////////////
+//! The destination for the formatted snapshots, which are written in order.
+
+class SnapshotSink
+{
+public:
+	//! Destructor.
+	virtual ~SnapshotSink() {}
+
+	//! Write the snapshot's formatted text.
+	virtual void write(const ObjectSnapshot& snapshot) = 0;
+
+	//! Flush any buffered output.
+	virtual void flush() = 0;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! A sink which writes the snapshots to a single stream.
+
+class StreamSink : public SnapshotSink
+{
+public:
+	//! Constructor.
+	explicit StreamSink(tostream& out)
+		: m_out(out)
+	{
+	}
+
+	//! Write the snapshot's formatted text.
+	virtual void write(const ObjectSnapshot& snapshot)
+	{
+		m_out.write(snapshot.m_text.data(), snapshot.m_text.length());
+	}
+
+	//! Flush any buffered output.
+	virtual void flush()
+	{
+		m_out.flush();
+	}
+
+private:
+	tostream&	m_out;	//!< The stream to write to.
+
+	// NotCopyable.
+	StreamSink(const StreamSink&);
+	StreamSink& operator=(const StreamSink&);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Format the heading and object in the snapshot into its text buffer.
+
+void formatSnapshot(ObjectSnapshot& snapshot, bool showTypes, bool applyFormatting, bool align);
+
+////////////////////////////////////////////////////////////////////////////////
+//! Formats a sequence of snapshots, keeping a formatter for each property so
+//! that each one can adapt to the values it sees. The properties are treated
+//! as the same columns for as long as their names are unchanged.
+
+class SnapshotFormatter
+{
+public:
+	//! Constructor.
+	SnapshotFormatter(bool showTypes, bool applyFormatting, bool align);
+
+	//! Format the heading and object in the snapshot into its text buffer.
+	void format(ObjectSnapshot& snapshot);
+
+private:
+	//
+	// Members.
+	//
+	bool						m_showTypes;		//!< Show the value types?
+	bool						m_applyFormatting;	//!< Format the values?
+	bool						m_align;			//!< Align the values?
+	WMI::Object::PropertyNames	m_names;			//!< The names of the columns.
+	ColumnFormatters			m_columns;			//!< The formatter for each column.
+	size_t						m_nameWidth;		//!< The width the names are padded to.
+
+	//
+	// Internal methods.
+	//
+
+	//! Start formatting a new set of columns.
+	void startColumns(const WMI::Object::PropertyNames& names);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! Formats the objects from a source on a pool of worker threads. The source
+//! is read on the calling thread, as the objects belong to its COM apartment,
+//! and a snapshot of each one is queued for the workers. A snapshot that holds
+//! an embedded object is formatted on the calling thread instead as formatting
+//! it may call into the object. A writer thread puts the formatted snapshots
+//! back into their original order and writes them out. The number of snapshots
+//! is fixed and so the source can only get so far ahead of the writer.
+
+class FormattingPipeline
+{
+public:
+	//! Constructor.
+	FormattingPipeline(size_t numWorkers, bool showTypes, bool applyFormatting, bool align);
+
+	//! Destructor.
+	~FormattingPipeline();
+
+	//! Format all the objects from the source and write them to the stream.
+	void run(ObjectSource& source, tostream& out);
+
+	//! Format all the objects from the source and write them to the sink.
+	void run(ObjectSource& source, SnapshotSink& sink);
+
+	//
+	// Constants.
+	//
+
+	//! The number of snapshots allocated for each worker.
+	static const size_t SNAPSHOTS_PER_WORKER = 32;
+
+private:
+	//! The queue type used to link the stages.
+	typedef BoundedQueue<ObjectSnapshot*> SnapshotQueue;
+
+	//! A thread that formats snapshots.
+	class Worker : public Thread
+	{
+	public:
+		//! Constructor.
+		explicit Worker(FormattingPipeline& pipeline);
+
+	private:
+		//! The thread's body.
+		virtual void run();
+
+		FormattingPipeline&	m_pipeline;	//!< The owning pipeline.
+	};
+
+	//! The thread that writes the formatted snapshots in order.
+	class Writer : public Thread
+	{
+	public:
+		//! Constructor.
+		Writer(FormattingPipeline& pipeline, SnapshotSink& sink);
+
+	private:
+		//! The thread's body.
+		virtual void run();
+
+		FormattingPipeline&	m_pipeline;	//!< The owning pipeline.
+		SnapshotSink&		m_sink;		//!< The sink to write to.
+	};
+
+	typedef std::vector<ObjectSnapshot*> Snapshots;
+	typedef std::vector<Thread*> Threads;
+
+	//
+	// Members.
+	//
+	size_t			m_numWorkers;		//!< The number of formatting threads.
+	bool			m_showTypes;		//!< Show the value types?
+	bool			m_applyFormatting;	//!< Format the values?
+	bool			m_align;			//!< Align the values?
+	Snapshots		m_snapshots;		//!< All the snapshots.
+	SnapshotQueue	m_free;				//!< The snapshots available to the source.
+	SnapshotQueue	m_unformatted;		//!< The snapshots waiting to be formatted.
+	SnapshotQueue	m_formatted;		//!< The snapshots waiting to be written.
+	CriticalSection	m_lock;				//!< The lock for the error.
+	tstring			m_error;			//!< The first error from a worker or the writer.
+	volatile LONG	m_sinkFailed;		//!< Has the sink failed?
+
+	//
+	// Internal methods.
+	//
+
+	//! Format a snapshot, recording any error.
+	void formatSnapshot(SnapshotFormatter& formatter, ObjectSnapshot& snapshot);
+
+	//! The formatting thread's main loop.
+	void formatSnapshots();
+
+	//! The writer thread's main loop.
+	void writeSnapshots(SnapshotSink& sink);
+
+	//! Write a snapshot to the sink.
+	bool writeSink(SnapshotSink& sink, const ObjectSnapshot& snapshot);
+
+	//! Flush the sink.
+	bool flushSink(SnapshotSink& sink);
+
+	//! Record the first error from a thread.
+	void setError(const tstring& error);
+
+	//! Stop the threads once they have drained the queues.
+	void stopThreads(Threads& workers, Thread* writer);
+
+	// NotCopyable.
+	FormattingPipeline(const FormattingPipeline&);
+	FormattingPipeline& operator=(const FormattingPipeline&);
+};
+
+#endif // APP_FORMATTINGPIPELINE_HPP
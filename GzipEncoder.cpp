@@ -0,0 +1,794 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   GzipEncoder.cpp
+//! \brief  The GzipEncoder class definition.
+//! \author Chris Oldwood
+
+#include "Common.hpp"
+#include "GzipEncoder.hpp"
+#include <algorithm>
+#include <queue>
+#include <functional>
+
+namespace
+{
+
+//! The size of the LZ77 window.
+const size_t WINDOW_SIZE = 32768;
+//! The mask used to index the hash chains.
+const size_t WINDOW_MASK = WINDOW_SIZE-1;
+//! The shortest match that can be encoded.
+const size_t MIN_MATCH = 3;
+//! The longest match that can be encoded.
+const size_t MAX_MATCH = 258;
+//! The number of hash chains.
+const size_t HASH_SIZE = 32768;
+//! The amount of input buffered before the matcher runs.
+const size_t CHUNK_SIZE = 65536;
+//! The number of symbols in a single block.
+const size_t MAX_BLOCK_SYMBOLS = 16384;
+
+//! The literal/length symbol that marks the end of a block.
+const size_t END_OF_BLOCK = 256;
+//! The number of literal/length codes that can be used.
+const size_t NUM_LITLEN_CODES = 286;
+//! The number of literal/length codes used by the fixed codes.
+const size_t NUM_FIXED_LITLEN_CODES = 288;
+//! The number of distance codes.
+const size_t NUM_DIST_CODES = 30;
+//! The number of code length codes.
+const size_t NUM_CODELEN_CODES = 19;
+//! The longest literal/length or distance code.
+const size_t MAX_CODE_BITS = 15;
+//! The longest code length code.
+const size_t MAX_CODELEN_BITS = 7;
+
+//! The block type for fixed Huffman codes.
+const uint32 FIXED_BLOCK = 1;
+//! The block type for dynamic Huffman codes.
+const uint32 DYNAMIC_BLOCK = 2;
+
+//! The base match length for each length code.
+const uint16 LENGTH_BASE[] =
+{ 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+
+//! The number of extra bits for each length code.
+const byte LENGTH_EXTRA[] =
+{ 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+
+//! The base distance for each distance code.
+const uint16 DIST_BASE[] =
+{ 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+
+//! The number of extra bits for each distance code.
+const byte DIST_EXTRA[] =
+{ 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+//! The order the code length code lengths are written in.
+const byte CODELEN_ORDER[] =
+{ 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+//! The matcher settings for each compression level.
+struct LevelSettings
+{
+	size_t	m_maxChain;		//!< The longest hash chain searched.
+	size_t	m_niceLength;	//!< A match length that stops the search.
+	bool	m_lazy;			//!< Defer a match if the next one is longer?
+};
+
+//! The matcher settings, indexed by level-1.
+const LevelSettings LEVELS[] =
+{
+	{    4,   8, false },
+	{    8,  16, false },
+	{   16,  32, false },
+	{   16,  32, true  },
+	{   32,  64, true  },
+	{  128, 128, true  },
+	{  256, 128, true  },
+	{ 1024, 258, true  },
+	{ 4096, 258, true  },
+};
+
+//! A set of Huffman codes, stored bit reversed ready for writing.
+struct HuffmanCodes
+{
+	std::vector<byte>	m_lengths;	//!< The length of each code.
+	std::vector<uint16>	m_codes;	//!< The bit reversed codes.
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! Assign the canonical codes for a set of code lengths.
+
+void assignCodes(HuffmanCodes& codes)
+{
+	const size_t count = codes.m_lengths.size();
+
+	uint16 lengthCount[MAX_CODE_BITS+1] = { 0 };
+	uint16 nextCode[MAX_CODE_BITS+1] = { 0 };
+
+	for (size_t i = 0; i != count; ++i)
+		++lengthCount[codes.m_lengths[i]];
+
+	lengthCount[0] = 0;
+
+	uint16 code = 0;
+
+	for (size_t bits = 1; bits <= MAX_CODE_BITS; ++bits)
+	{
+		code = static_cast<uint16>((code + lengthCount[bits-1]) << 1);
+		nextCode[bits] = code;
+	}
+
+	codes.m_codes.assign(count, 0);
+
+	for (size_t i = 0; i != count; ++i)
+	{
+		const size_t length = codes.m_lengths[i];
+
+		if (length == 0)
+			continue;
+
+		uint16 value = nextCode[length]++;
+		uint16 reversed = 0;
+
+		for (size_t bit = 0; bit != length; ++bit, value >>= 1)
+			reversed = static_cast<uint16>((reversed << 1) | (value & 1));
+
+		codes.m_codes[i] = reversed;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Try and build the Huffman code lengths for the symbol frequencies. Returns
+//! false if the longest code exceeds maxBits.
+
+bool tryBuildLengths(const std::vector<uint32>& freqs, size_t maxBits, std::vector<byte>& lengths)
+{
+	typedef std::pair<uint32, size_t> Node;
+	typedef std::priority_queue<Node, std::vector<Node>, std::greater<Node> > Queue;
+
+	const size_t count = freqs.size();
+
+	lengths.assign(count, 0);
+
+	std::vector<size_t> parent(count);
+	Queue queue;
+
+	for (size_t i = 0; i != count; ++i)
+	{
+		if (freqs[i] != 0)
+			queue.push(Node(freqs[i], i));
+	}
+
+	if (queue.empty())
+		return true;
+
+	if (queue.size() == 1)
+	{
+		lengths[queue.top().second] = 1;
+		return true;
+	}
+
+	// Repeatedly merge the two least frequent nodes.
+	while (queue.size() > 1)
+	{
+		const Node first = queue.top(); queue.pop();
+		const Node second = queue.top(); queue.pop();
+
+		const size_t node = parent.size();
+
+		parent.push_back(0);
+		parent[first.second] = node;
+		parent[second.second] = node;
+
+		queue.push(Node(first.first + second.first, node));
+	}
+
+	// A parent is always created after its children so the depths can be
+	// calculated by walking down from the root.
+	const size_t root = parent.size()-1;
+	std::vector<size_t> depth(parent.size(), 0);
+
+	for (size_t node = root; node-- != 0; )
+	{
+		if ((node < count) && (freqs[node] == 0))
+			continue;
+
+		depth[node] = depth[parent[node]] + 1;
+
+		if ((node < count) && (depth[node] > maxBits))
+			return false;
+	}
+
+	for (size_t i = 0; i != count; ++i)
+		lengths[i] = static_cast<byte>(depth[i]);
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Build the Huffman codes for the symbol frequencies, limiting the length of
+//! the longest code. If the limit is exceeded the frequencies are flattened
+//! and the tree rebuilt, which is not optimal but is rarely needed.
+
+void buildCodes(const std::vector<uint32>& freqs, size_t maxBits, HuffmanCodes& codes)
+{
+	std::vector<uint32> scaled(freqs);
+
+	while (!tryBuildLengths(scaled, maxBits, codes.m_lengths))
+	{
+		for (size_t i = 0; i != scaled.size(); ++i)
+		{
+			if (scaled[i] != 0)
+				scaled[i] = (scaled[i] >> 1) | 1;
+		}
+	}
+
+	assignCodes(codes);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! The tables that are calculated once at start-up.
+
+struct StaticTables
+{
+	//! Constructor.
+	StaticTables();
+
+	HuffmanCodes	m_fixedLitLen;					//!< The fixed literal/length codes.
+	HuffmanCodes	m_fixedDist;					//!< The fixed distance codes.
+	byte			m_lengthCode[MAX_MATCH+1];		//!< The length code for each match length.
+	byte			m_distCode[WINDOW_SIZE+1];		//!< The distance code for each distance.
+	uint32			m_crc[256];						//!< The CRC-32 lookup table.
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! Constructor.
+
+StaticTables::StaticTables()
+{
+	m_fixedLitLen.m_lengths.assign(NUM_FIXED_LITLEN_CODES, 8);
+	std::fill(m_fixedLitLen.m_lengths.begin()+144, m_fixedLitLen.m_lengths.begin()+256, 9);
+	std::fill(m_fixedLitLen.m_lengths.begin()+256, m_fixedLitLen.m_lengths.begin()+280, 7);
+	assignCodes(m_fixedLitLen);
+
+	m_fixedDist.m_lengths.assign(NUM_DIST_CODES, 5);
+	assignCodes(m_fixedDist);
+
+	for (size_t code = 0; code != ARRAY_SIZE(LENGTH_BASE); ++code)
+	{
+		for (size_t length = LENGTH_BASE[code]; (length <= MAX_MATCH) && (length < LENGTH_BASE[code] + (1u << LENGTH_EXTRA[code])); ++length)
+			m_lengthCode[length] = static_cast<byte>(code);
+	}
+
+	for (size_t code = 0; code != ARRAY_SIZE(DIST_BASE); ++code)
+	{
+		for (size_t dist = DIST_BASE[code]; (dist <= WINDOW_SIZE) && (dist < DIST_BASE[code] + (1u << DIST_EXTRA[code])); ++dist)
+			m_distCode[dist] = static_cast<byte>(code);
+	}
+
+	for (uint32 i = 0; i != 256; ++i)
+	{
+		uint32 crc = i;
+
+		for (size_t bit = 0; bit != 8; ++bit)
+			crc = (crc & 1) ? (0xEDB88320 ^ (crc >> 1)) : (crc >> 1);
+
+		m_crc[i] = crc;
+	}
+}
+
+//! The tables, built during static initialisation so that encoders can be
+//! used on multiple threads.
+const StaticTables s_tables;
+
+//! A sequence of code length symbols and their extra bits.
+typedef std::vector<std::pair<byte, byte> > CodeLengthSymbols;
+
+////////////////////////////////////////////////////////////////////////////////
+//! Run-length encode the literal/length and distance code lengths using the
+//! code length alphabet.
+
+void encodeCodeLengths(const std::vector<byte>& lengths, CodeLengthSymbols& symbols)
+{
+	const size_t count = lengths.size();
+
+	for (size_t i = 0; i != count; )
+	{
+		const byte length = lengths[i];
+		size_t run = 1;
+
+		while ((i + run != count) && (lengths[i + run] == length))
+			++run;
+
+		i += run;
+
+		if (length == 0)
+		{
+			while (run >= 11)
+			{
+				const size_t repeat = std::min<size_t>(run, 138);
+
+				symbols.push_back(std::make_pair(byte(18), static_cast<byte>(repeat - 11)));
+				run -= repeat;
+			}
+
+			if (run >= 3)
+			{
+				symbols.push_back(std::make_pair(byte(17), static_cast<byte>(run - 3)));
+				run = 0;
+			}
+		}
+		else
+		{
+			symbols.push_back(std::make_pair(length, byte(0)));
+			--run;
+
+			while (run >= 3)
+			{
+				const size_t repeat = std::min<size_t>(run, 6);
+
+				symbols.push_back(std::make_pair(byte(16), static_cast<byte>(repeat - 3)));
+				run -= repeat;
+			}
+		}
+
+		for (; run != 0; --run)
+			symbols.push_back(std::make_pair(length, byte(0)));
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Calculate the number of extra bits that follow a code length symbol.
+
+inline size_t codeLengthExtraBits(size_t symbol)
+{
+	return (symbol == 16) ? 2 : (symbol == 17) ? 3 : (symbol == 18) ? 7 : 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Calculate the number of bits needed to encode the symbols with the codes.
+
+size_t calculateSize(const std::vector<uint32>& litLenFreqs, const std::vector<uint32>& distFreqs,
+                     const HuffmanCodes& litLen, const HuffmanCodes& dist)
+{
+	size_t bits = 0;
+
+	for (size_t i = 0; i != NUM_LITLEN_CODES; ++i)
+	{
+		bits += litLenFreqs[i] * litLen.m_lengths[i];
+
+		if (i > END_OF_BLOCK)
+			bits += litLenFreqs[i] * LENGTH_EXTRA[i - END_OF_BLOCK - 1];
+	}
+
+	for (size_t i = 0; i != NUM_DIST_CODES; ++i)
+		bits += distFreqs[i] * (dist.m_lengths[i] + DIST_EXTRA[i]);
+
+	return bits;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Calculate the hash of the 3 bytes at the position.
+
+inline size_t hashBytes(const byte* data)
+{
+	return ((data[0] << 10) ^ (data[1] << 5) ^ data[2]) & (HASH_SIZE-1);
+}
+
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Constructor.
+
+GzipEncoder::GzipEncoder(int level)
+	: m_maxChain()
+	, m_niceLength()
+	, m_lazy()
+	, m_window()
+	, m_pos(0)
+	, m_hashed(0)
+	, m_head(HASH_SIZE, 0)
+	, m_prev(WINDOW_SIZE, 0)
+	, m_symbols()
+	, m_crc(0xFFFFFFFF)
+	, m_size(0)
+	, m_bitBuffer(0)
+	, m_bitCount(0)
+	, m_started(false)
+{
+	ASSERT((level >= MIN_LEVEL) && (level <= MAX_LEVEL));
+
+	const LevelSettings& settings = LEVELS[level-MIN_LEVEL];
+
+	m_maxChain   = settings.m_maxChain;
+	m_niceLength = settings.m_niceLength;
+	m_lazy       = settings.m_lazy;
+
+	m_window.reserve(2*WINDOW_SIZE + 2*CHUNK_SIZE);
+	m_symbols.reserve(MAX_BLOCK_SYMBOLS);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Destructor.
+
+GzipEncoder::~GzipEncoder()
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Compress the data, appending any output generated so far. The input is
+//! buffered until there is enough to make running the matcher worthwhile.
+
+void GzipEncoder::write(const byte* data, size_t size, ByteBuffer& output)
+{
+	if (!m_started)
+		writeHeader(output);
+
+	uint32 crc = m_crc;
+
+	for (size_t i = 0; i != size; ++i)
+		crc = s_tables.m_crc[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+
+	m_crc = crc;
+	m_size += static_cast<uint32>(size);
+
+	while (size != 0)
+	{
+		const size_t chunk = std::min(size, CHUNK_SIZE);
+
+		m_window.insert(m_window.end(), data, data+chunk);
+		data += chunk;
+		size -= chunk;
+
+		if ((m_window.size() - m_pos) >= CHUNK_SIZE)
+			deflate(false, output);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Compress any remaining data and append the end of the stream. The blocks
+//! written so far are never marked as final and so the stream is terminated
+//! with an empty final block.
+
+void GzipEncoder::finish(ByteBuffer& output)
+{
+	if (!m_started)
+		writeHeader(output);
+
+	deflate(true, output);
+	writeBlock(output);
+
+	writeBits(1, 1, output);
+	writeBits(FIXED_BLOCK, 2, output);
+	writeBits(s_tables.m_fixedLitLen.m_codes[END_OF_BLOCK], s_tables.m_fixedLitLen.m_lengths[END_OF_BLOCK], output);
+	alignToByte(output);
+
+	const uint32 trailer[] = { ~m_crc, m_size };
+
+	for (size_t i = 0; i != ARRAY_SIZE(trailer); ++i)
+	{
+		for (size_t shift = 0; shift != 32; shift += 8)
+			output.push_back(static_cast<byte>(trailer[i] >> shift));
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Write the gzip header. There is no file name or modification time.
+
+void GzipEncoder::writeHeader(ByteBuffer& output)
+{
+	const byte extraFlags = (m_maxChain == LEVELS[MAX_LEVEL-MIN_LEVEL].m_maxChain) ? 2
+	                      : (m_maxChain == LEVELS[0].m_maxChain) ? 4 : 0;
+
+	const byte header[] = { 0x1F, 0x8B, 8, 0, 0, 0, 0, 0, extraFlags, 11 };
+
+	output.insert(output.end(), header, header+ARRAY_SIZE(header));
+
+	m_started = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Find matches in the window and generate the symbols. Unless flushing, the
+//! last MAX_MATCH bytes are kept back so that a match can use them all.
+
+void GzipEncoder::deflate(bool flush, ByteBuffer& output)
+{
+	if (m_pos >= 2*WINDOW_SIZE)
+		slideWindow();
+
+	const size_t end = m_window.size();
+	const size_t limit = (flush) ? end : (end > MAX_MATCH) ? end - MAX_MATCH : 0;
+
+	size_t deferredPos = static_cast<size_t>(-1);
+	size_t deferredLength = 0;
+	size_t deferredDistance = 0;
+
+	while (m_pos < limit)
+	{
+		size_t distance = 0;
+		size_t length = 0;
+
+		if (m_pos == deferredPos)
+		{
+			length = deferredLength;
+			distance = deferredDistance;
+		}
+		else
+		{
+			length = findMatch(m_pos, end, distance);
+		}
+
+		// Prefer a literal if the next position has a longer match.
+		if ( m_lazy && (length >= MIN_MATCH) && (length < m_niceLength) && (m_pos+1 < limit) )
+		{
+			size_t nextDistance = 0;
+			const size_t nextLength = findMatch(m_pos+1, end, nextDistance);
+
+			if (nextLength > length)
+			{
+				deferredPos = m_pos+1;
+				deferredLength = nextLength;
+				deferredDistance = nextDistance;
+				length = 0;
+			}
+		}
+
+		Symbol symbol;
+
+		if (length >= MIN_MATCH)
+		{
+			symbol.m_litLen = static_cast<uint16>(length);
+			symbol.m_dist = static_cast<uint16>(distance);
+			m_pos += length;
+		}
+		else
+		{
+			symbol.m_litLen = m_window[m_pos];
+			symbol.m_dist = 0;
+			++m_pos;
+		}
+
+		m_symbols.push_back(symbol);
+
+		if (m_symbols.size() == MAX_BLOCK_SYMBOLS)
+			writeBlock(output);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Discard the part of the window that is too old to be matched. A multiple
+//! of the window size is removed so that the hash chain slots are unchanged.
+
+void GzipEncoder::slideWindow()
+{
+	const size_t discard = ((m_pos / WINDOW_SIZE) - 1) * WINDOW_SIZE;
+	const uint32 offset = static_cast<uint32>(discard);
+
+	m_window.erase(m_window.begin(), m_window.begin()+discard);
+	m_pos -= discard;
+	m_hashed -= discard;
+
+	for (Positions::iterator it = m_head.begin(); it != m_head.end(); ++it)
+		*it = (*it > offset) ? *it - offset : 0;
+
+	for (Positions::iterator it = m_prev.begin(); it != m_prev.end(); ++it)
+		*it = (*it > offset) ? *it - offset : 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Find the longest match for the position. Any earlier positions are added
+//! to the hash chains first. The chains hold the position+1 so that 0 can be
+//! used to terminate them.
+
+size_t GzipEncoder::findMatch(size_t pos, size_t end, size_t& distance)
+{
+	const byte* data = &m_window[0];
+
+	for (; (m_hashed < pos) && (m_hashed + MIN_MATCH <= end); ++m_hashed)
+	{
+		const size_t bucket = hashBytes(data + m_hashed);
+
+		m_prev[m_hashed & WINDOW_MASK] = m_head[bucket];
+		m_head[bucket] = static_cast<uint32>(m_hashed + 1);
+	}
+
+	if (pos + MIN_MATCH > end)
+		return 0;
+
+	const size_t maxLength = std::min(MAX_MATCH, end - pos);
+	size_t best = MIN_MATCH-1;
+	size_t chain = m_maxChain;
+	uint32 candidate = m_head[hashBytes(data + pos)];
+
+	while ( (candidate != 0) && (chain-- != 0) )
+	{
+		const size_t start = candidate - 1;
+		const size_t offset = pos - start;
+
+		if (offset >= WINDOW_SIZE)
+			break;
+
+		if (data[start + best] == data[pos + best])
+		{
+			size_t length = 0;
+
+			while ( (length != maxLength) && (data[start + length] == data[pos + length]) )
+				++length;
+
+			if (length > best)
+			{
+				best = length;
+				distance = offset;
+
+				if ( (length >= m_niceLength) || (length == maxLength) )
+					break;
+			}
+		}
+
+		const uint32 next = m_prev[start & WINDOW_MASK];
+
+		if (next >= candidate)
+			break;
+
+		candidate = next;
+	}
+
+	return (best >= MIN_MATCH) ? best : 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Huffman code the pending symbols as a single block, using whichever of the
+//! fixed or dynamic codes produces the smaller output.
+
+void GzipEncoder::writeBlock(ByteBuffer& output)
+{
+	if (m_symbols.empty())
+		return;
+
+	std::vector<uint32> litLenFreqs(NUM_LITLEN_CODES, 0);
+	std::vector<uint32> distFreqs(NUM_DIST_CODES, 0);
+
+	for (Symbols::const_iterator it = m_symbols.begin(); it != m_symbols.end(); ++it)
+	{
+		if (it->m_dist == 0)
+		{
+			++litLenFreqs[it->m_litLen];
+		}
+		else
+		{
+			++litLenFreqs[END_OF_BLOCK + 1 + s_tables.m_lengthCode[it->m_litLen]];
+			++distFreqs[s_tables.m_distCode[it->m_dist]];
+		}
+	}
+
+	++litLenFreqs[END_OF_BLOCK];
+
+	HuffmanCodes litLen;
+	HuffmanCodes dist;
+
+	buildCodes(litLenFreqs, MAX_CODE_BITS, litLen);
+	buildCodes(distFreqs, MAX_CODE_BITS, dist);
+
+	// At least one distance code must be sent.
+	if (std::count(distFreqs.begin(), distFreqs.end(), 0u) == static_cast<ptrdiff_t>(NUM_DIST_CODES))
+	{
+		dist.m_lengths[0] = 1;
+		assignCodes(dist);
+	}
+
+	size_t numLitLen = NUM_LITLEN_CODES;
+	size_t numDist = NUM_DIST_CODES;
+
+	while (litLen.m_lengths[numLitLen-1] == 0)
+		--numLitLen;
+
+	while (dist.m_lengths[numDist-1] == 0)
+		--numDist;
+
+	std::vector<byte> lengths(litLen.m_lengths.begin(), litLen.m_lengths.begin()+numLitLen);
+	lengths.insert(lengths.end(), dist.m_lengths.begin(), dist.m_lengths.begin()+numDist);
+
+	CodeLengthSymbols codeLengthSymbols;
+	encodeCodeLengths(lengths, codeLengthSymbols);
+
+	std::vector<uint32> codeLengthFreqs(NUM_CODELEN_CODES, 0);
+
+	for (CodeLengthSymbols::const_iterator it = codeLengthSymbols.begin(); it != codeLengthSymbols.end(); ++it)
+		++codeLengthFreqs[it->first];
+
+	HuffmanCodes codeLength;
+	buildCodes(codeLengthFreqs, MAX_CODELEN_BITS, codeLength);
+
+	size_t numCodeLength = NUM_CODELEN_CODES;
+
+	while (codeLength.m_lengths[CODELEN_ORDER[numCodeLength-1]] == 0)
+		--numCodeLength;
+
+	// The decoder rejects an incomplete set of code length codes.
+	const bool canUseDynamic = (std::count(codeLengthFreqs.begin(), codeLengthFreqs.end(), 0u)
+	                            < static_cast<ptrdiff_t>(NUM_CODELEN_CODES-1));
+
+	size_t dynamicSize = 5 + 5 + 4 + (3 * numCodeLength);
+
+	for (CodeLengthSymbols::const_iterator it = codeLengthSymbols.begin(); it != codeLengthSymbols.end(); ++it)
+		dynamicSize += codeLength.m_lengths[it->first] + codeLengthExtraBits(it->first);
+
+	dynamicSize += calculateSize(litLenFreqs, distFreqs, litLen, dist);
+
+	const size_t fixedSize = calculateSize(litLenFreqs, distFreqs, s_tables.m_fixedLitLen, s_tables.m_fixedDist);
+
+	const bool useDynamic = (canUseDynamic && (dynamicSize < fixedSize));
+	const HuffmanCodes& litLenCodes = (useDynamic) ? litLen : s_tables.m_fixedLitLen;
+	const HuffmanCodes& distCodes = (useDynamic) ? dist : s_tables.m_fixedDist;
+
+	writeBits(0, 1, output);
+	writeBits((useDynamic) ? DYNAMIC_BLOCK : FIXED_BLOCK, 2, output);
+
+	if (useDynamic)
+	{
+		writeBits(static_cast<uint32>(numLitLen - 257), 5, output);
+		writeBits(static_cast<uint32>(numDist - 1), 5, output);
+		writeBits(static_cast<uint32>(numCodeLength - 4), 4, output);
+
+		for (size_t i = 0; i != numCodeLength; ++i)
+			writeBits(codeLength.m_lengths[CODELEN_ORDER[i]], 3, output);
+
+		for (CodeLengthSymbols::const_iterator it = codeLengthSymbols.begin(); it != codeLengthSymbols.end(); ++it)
+		{
+			writeBits(codeLength.m_codes[it->first], codeLength.m_lengths[it->first], output);
+			writeBits(it->second, codeLengthExtraBits(it->first), output);
+		}
+	}
+
+	for (Symbols::const_iterator it = m_symbols.begin(); it != m_symbols.end(); ++it)
+	{
+		if (it->m_dist == 0)
+		{
+			writeBits(litLenCodes.m_codes[it->m_litLen], litLenCodes.m_lengths[it->m_litLen], output);
+		}
+		else
+		{
+			const size_t lengthCode = s_tables.m_lengthCode[it->m_litLen];
+			const size_t litLenSymbol = END_OF_BLOCK + 1 + lengthCode;
+			const size_t distCode = s_tables.m_distCode[it->m_dist];
+
+			writeBits(litLenCodes.m_codes[litLenSymbol], litLenCodes.m_lengths[litLenSymbol], output);
+			writeBits(it->m_litLen - LENGTH_BASE[lengthCode], LENGTH_EXTRA[lengthCode], output);
+			writeBits(distCodes.m_codes[distCode], distCodes.m_lengths[distCode], output);
+			writeBits(it->m_dist - DIST_BASE[distCode], DIST_EXTRA[distCode], output);
+		}
+	}
+
+	writeBits(litLenCodes.m_codes[END_OF_BLOCK], litLenCodes.m_lengths[END_OF_BLOCK], output);
+
+	m_symbols.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Write bits to the output, least significant bit first.
+
+void GzipEncoder::writeBits(uint32 value, size_t count, ByteBuffer& output)
+{
+	m_bitBuffer |= value << m_bitCount;
+	m_bitCount += count;
+
+	while (m_bitCount >= 8)
+	{
+		output.push_back(static_cast<byte>(m_bitBuffer));
+		m_bitBuffer >>= 8;
+		m_bitCount -= 8;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Flush any partial byte.
+
+void GzipEncoder::alignToByte(ByteBuffer& output)
+{
+	if (m_bitCount != 0)
+		output.push_back(static_cast<byte>(m_bitBuffer));
+
+	m_bitBuffer = 0;
+	m_bitCount = 0;
+}
@@ -0,0 +1,113 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   GzipEncoder.hpp
+//! \brief  The GzipEncoder class declaration.
+//! \author Chris Oldwood
+
+// Check for previous inclusion
+#ifndef APP_GZIPENCODER_HPP
+#define APP_GZIPENCODER_HPP
+
+#if _MSC_VER > 1000
+#pragma once
+#endif
+
+#include <vector>
+
+//! The buffer type used for compressed and uncompressed data.
+typedef std::vector<byte> ByteBuffer;
+
+////////////////////////////////////////////////////////////////////////////////
+//! A streaming compressor that produces a gzip (RFC 1952) format stream. The
+//! data is compressed with DEFLATE (RFC 1951) using LZ77 over a 32K window,
+//! with hash chains whose length depends on the compression level, and each
+//! block is Huffman coded with either the fixed or a dynamic set of codes,
+//! whichever is smaller.
+
+class GzipEncoder
+{
+public:
+	//! Constructor.
+	explicit GzipEncoder(int level = DEFAULT_LEVEL);
+
+	//! Destructor.
+	~GzipEncoder();
+
+	//! Compress the data, appending any output generated so far.
+	void write(const byte* data, size_t size, ByteBuffer& output);
+
+	//! Compress any remaining data and append the end of the stream.
+	void finish(ByteBuffer& output);
+
+	//
+	// Constants.
+	//
+
+	//! The fastest compression level.
+	static const int MIN_LEVEL = 1;
+
+	//! The default compression level.
+	static const int DEFAULT_LEVEL = 6;
+
+	//! The best compression level.
+	static const int MAX_LEVEL = 9;
+
+private:
+	//! A literal or a match waiting to be Huffman coded.
+	struct Symbol
+	{
+		uint16	m_litLen;	//!< The literal byte or match length.
+		uint16	m_dist;		//!< The match distance or 0 for a literal.
+	};
+
+	typedef std::vector<Symbol> Symbols;
+	typedef std::vector<uint32> Positions;
+
+	//
+	// Members.
+	//
+	size_t		m_maxChain;		//!< The longest hash chain searched.
+	size_t		m_niceLength;	//!< A match length that stops the search.
+	bool		m_lazy;			//!< Defer a match if the next one is longer?
+	ByteBuffer	m_window;		//!< The sliding window and pending input.
+	size_t		m_pos;			//!< The next position in m_window to encode.
+	size_t		m_hashed;		//!< The next position to insert into the hash chains.
+	Positions	m_head;			//!< The most recent position for each hash.
+	Positions	m_prev;			//!< The previous position with the same hash.
+	Symbols		m_symbols;		//!< The symbols for the current block.
+	uint32		m_crc;			//!< The CRC of the uncompressed data.
+	uint32		m_size;			//!< The size of the uncompressed data.
+	uint32		m_bitBuffer;	//!< The bits not yet written.
+	size_t		m_bitCount;		//!< The number of bits in m_bitBuffer.
+	bool		m_started;		//!< Has the header been written?
+
+	//
+	// Internal methods.
+	//
+
+	//! Find matches in the window and generate the symbols.
+	void deflate(bool flush, ByteBuffer& output);
+
+	//! Discard the part of the window that is too old to be matched.
+	void slideWindow();
+
+	//! Find the longest match for the position.
+	size_t findMatch(size_t pos, size_t end, size_t& distance);
+
+	//! Write the gzip header.
+	void writeHeader(ByteBuffer& output);
+
+	//! Huffman code the pending symbols as a single block.
+	void writeBlock(ByteBuffer& output);
+
+	//! Write bits to the output, least significant bit first.
+	void writeBits(uint32 value, size_t count, ByteBuffer& output);
+
+	//! Flush any partial byte.
+	void alignToByte(ByteBuffer& output);
+
+	// NotCopyable.
+	GzipEncoder(const GzipEncoder&);
+	GzipEncoder& operator=(const GzipEncoder&);
+};
+
+#endif // APP_GZIPENCODER_HPP
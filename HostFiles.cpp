@@ -0,0 +1,472 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   HostFiles.cpp
+//! \brief  The HostFiles class definition.
+//! \author Chris Oldwood
+
+#include "Common.hpp"
+#include "HostFiles.hpp"
+#include "Utf8Encoding.hpp"
+#include "AllocationCounter.hpp"
+#include <WCL/Win32Exception.hpp>
+#include <Core/RuntimeException.hpp>
+#include <Core/StringUtils.hpp>
+#include <WMI/Connection.hpp>
+#include <algorithm>
+
+//! The label at the start of a host heading.
+static const tchar HOST_LABEL[] = TXT("Host: ");
+
+//! The length of the host heading label.
+static const size_t HOST_LABEL_LENGTH = ARRAY_SIZE(HOST_LABEL) - 1;
+
+//! The extension of the output files.
+static const tchar FILE_EXTENSION[] = TXT(".txt");
+
+//! The suffix added to a file's name whilst it's being written.
+static const tchar TEMP_SUFFIX[] = TXT(".tmp");
+
+//! The characters which cannot appear in a filename.
+static const tchar INVALID_CHARS[] = TXT("\\/:*?\"<>|");
+
+//! The end of the characters which cannot appear in a filename.
+static const tchar* const INVALID_CHARS_END = INVALID_CHARS + ARRAY_SIZE(INVALID_CHARS) - 1;
+
+////////////////////////////////////////////////////////////////////////////////
+//! Get the filename in lowercase, as filenames are compared without regard to
+//! case.
+
+static tstring toLower(const tstring& filename)
+{
+	tstring lower = filename;
+
+	if (!lower.empty())
+		::CharLowerBuff(&lower[0], static_cast<DWORD>(lower.length()));
+
+	return lower;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Constructor. The directory is created if it doesn't already exist.
+
+HostFiles::HostFiles(const tstring& directory, bool showHost, size_t numWriters, size_t maxOpenFiles)
+	: m_directory(directory)
+	, m_showHost(showHost)
+	, m_chunks()
+	, m_free(numWriters * CHUNKS_PER_WRITER)
+	, m_queues()
+	, m_writers()
+	, m_openFiles(static_cast<LONG>(maxOpenFiles))
+	, m_current(nullptr)
+	, m_numFiles(0)
+	, m_hosts()
+	, m_closed(false)
+	, m_lock()
+	, m_error()
+	, m_failed(FALSE)
+{
+	ASSERT(numWriters != 0);
+	ASSERT(maxOpenFiles != 0);
+
+	if (!::CreateDirectory(directory.c_str(), nullptr) && (::GetLastError() != ERROR_ALREADY_EXISTS))
+		throw WCL::Win32Exception(::GetLastError(), Core::fmt(TXT("Failed to create the output folder '%s'"), directory.c_str()));
+
+	for (size_t i = 0; i != (numWriters * CHUNKS_PER_WRITER); ++i)
+	{
+		m_chunks.push_back(new Chunk());
+		m_chunks.back()->m_data.reserve(CHUNK_SIZE);
+		m_free.push(m_chunks.back());
+	}
+
+	try
+	{
+		for (size_t i = 0; i != numWriters; ++i)
+		{
+			m_queues.push_back(new ChunkQueue(CHUNKS_PER_WRITER * numWriters));
+			m_writers.push_back(new Writer(*this, *m_queues.back()));
+			m_writers.back()->start();
+		}
+	}
+	catch (...)
+	{
+		stopWriters();
+		throw;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Destructor. If the files haven't been closed the queued data is still
+//! written, but any error is lost.
+
+HostFiles::~HostFiles()
+{
+	if (!m_closed)
+	{
+		try
+		{
+			close();
+		}
+		catch (const Core::Exception& /*e*/)
+		{
+		}
+	}
+
+	for (ChunkQueues::iterator it = m_queues.begin(); it != m_queues.end(); ++it)
+		delete *it;
+
+	for (Chunks::iterator it = m_chunks.begin(); it != m_chunks.end(); ++it)
+		delete *it;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Write the snapshot's formatted text to its host's file. A host heading
+//! starts the host's file and is only written to it if requested. Any error
+//! from a writer is reported here, rather than waiting until they're closed.
+
+void HostFiles::write(const ObjectSnapshot& snapshot)
+{
+	ASSERT(!m_closed);
+
+	if (m_failed)
+		checkError();
+
+	if (!snapshot.m_isObject)
+	{
+		tstring heading = snapshot.m_heading;
+
+		Core::trim(heading);
+
+		if (heading.compare(0, HOST_LABEL_LENGTH, HOST_LABEL) == 0)
+		{
+			startFile(heading.substr(HOST_LABEL_LENGTH));
+
+			if (!m_showHost)
+				return;
+		}
+	}
+
+	if (snapshot.m_text.empty())
+		return;
+
+	if (m_current == nullptr)
+		throw Core::RuntimeException(TXT("The output cannot be written to a host file as it has no host heading"));
+
+	append(snapshot.m_text);
+
+	if (m_current->m_data.size() >= CHUNK_SIZE)
+		handOver(false);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Flush any buffered output. This does nothing as a chunk is only handed over
+//! once it's full, or its host is complete, to keep the writes large.
+
+void HostFiles::flush()
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Finish the last file and wait for all the files to be written. This throws
+//! if any of the files could not be written.
+
+void HostFiles::close()
+{
+	ASSERT(!m_closed);
+
+	m_closed = true;
+
+	try
+	{
+		finishFile();
+	}
+	catch (...)
+	{
+		stopWriters();
+		throw;
+	}
+
+	stopWriters();
+
+	checkError();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Get the name of the file for the host. Any characters which are not valid
+//! in a filename are replaced with an underscore.
+
+tstring HostFiles::getFilename(const tstring& host)
+{
+	tstring filename = (host == WMI::Connection::LOCALHOST) ? TXT("localhost") : host;
+
+	for (tstring::iterator it = filename.begin(); it != filename.end(); ++it)
+	{
+		if ( (static_cast<uint32>(*it) < 0x20) || (std::find(INVALID_CHARS, INVALID_CHARS_END, *it) != INVALID_CHARS_END) )
+			*it = TXT('_');
+	}
+
+	return filename + FILE_EXTENSION;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Check that no two hosts would be written to the same file, either because a
+//! host is listed twice or because two hosts only differ by case or by the
+//! characters which are replaced, e.g. "a:b" and "a_b". This allows a sweep to
+//! be rejected before any of the hosts are queried.
+
+void HostFiles::checkFilenames(const Hostnames& hosts)
+{
+	HostsByFile files;
+
+	for (Hostnames::const_iterator it = hosts.begin(); it != hosts.end(); ++it)
+		addFile(files, *it);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Record the host's file and return its name. This throws if another host has
+//! already been given the same file.
+
+tstring HostFiles::addFile(HostsByFile& files, const tstring& host)
+{
+	const tstring filename = getFilename(host);
+
+	std::pair<HostsByFile::iterator, bool> result = files.insert(HostsByFile::value_type(toLower(filename), host));
+
+	if (!result.second)
+	{
+		throw Core::RuntimeException(Core::fmt(TXT("The hosts '%s' and '%s' would both be written to the output file '%s'"),
+		                                       result.first->second.c_str(), host.c_str(), filename.c_str()));
+	}
+
+	return filename;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Finish the current file and start the host's. This waits if the maximum
+//! number of files are already in progress. A host whose file has already been
+//! written by another host is rejected.
+
+void HostFiles::startFile(const tstring& host)
+{
+	const tstring filename = addFile(m_hosts, host);
+
+	finishFile();
+
+	m_openFiles.wait();
+
+	HostFile* file = new HostFile();
+
+	file->m_finalName = m_directory + TXT("\\") + filename;
+	file->m_tempName  = file->m_finalName + TEMP_SUFFIX;
+	file->m_writer    = m_numFiles++ % m_writers.size();
+	file->m_handle    = INVALID_HANDLE_VALUE;
+	file->m_failed    = false;
+
+	m_free.pop(m_current);
+
+	m_current->m_file = file;
+	m_current->m_last = false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Hand the current file's last chunk to its writer.
+
+void HostFiles::finishFile()
+{
+	if (m_current != nullptr)
+		handOver(true);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Hand the current chunk to its file's writer. Unless it's the last one the
+//! caller then continues with a free chunk, waiting for one if necessary.
+
+void HostFiles::handOver(bool last)
+{
+	ASSERT(m_current != nullptr);
+
+	Chunk*    chunk = m_current;
+	HostFile* file = chunk->m_file;
+
+	chunk->m_last = last;
+	m_current = nullptr;
+
+	m_queues[file->m_writer]->push(chunk);
+
+	if (!last)
+	{
+		m_free.pop(m_current);
+
+		m_current->m_file = file;
+		m_current->m_last = false;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Append the text to the current chunk as UTF-8. The text is encoded straight
+//! into the chunk.
+
+void HostFiles::append(const tstring& text)
+{
+	appendUtf8(text, m_current->m_data);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! The writer thread's main loop. Each chunk is returned to the free queue
+//! once written, even if writing it failed, so that the caller never blocks.
+
+void HostFiles::writeChunks(ChunkQueue& queue)
+{
+	Chunk* chunk = nullptr;
+
+	while (queue.pop(chunk))
+	{
+		writeChunk(*chunk);
+
+		chunk->m_data.clear();
+		m_free.push(chunk);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Write a single chunk and, if it's the last, rename the file. After a failure
+//! the file is deleted and the rest of its chunks discarded.
+
+void HostFiles::writeChunk(Chunk& chunk)
+{
+	HostFile& file = *chunk.m_file;
+
+	if (!file.m_failed)
+	{
+		try
+		{
+			writeData(file, chunk);
+		}
+		catch (const Core::Exception& e)
+		{
+			abandonFile(file);
+			setError(e.twhat());
+		}
+		catch (const std::exception& e)
+		{
+			abandonFile(file);
+			setError(Core::fmt(TXT("Unexpected exception: %hs"), e.what()));
+		}
+	}
+
+	if (chunk.m_last)
+	{
+		delete &file;
+		m_openFiles.release();
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Write the chunk's data, opening the file first if necessary. Once the last
+//! chunk has been written the file is closed and renamed.
+
+void HostFiles::writeData(HostFile& file, const Chunk& chunk)
+{
+	if (file.m_handle == INVALID_HANDLE_VALUE)
+	{
+		file.m_handle = ::CreateFile(file.m_tempName.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+		                             FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+		if (file.m_handle == INVALID_HANDLE_VALUE)
+			throw WCL::Win32Exception(::GetLastError(), Core::fmt(TXT("Failed to create the output file '%s'"), file.m_tempName.c_str()));
+	}
+
+	if (!chunk.m_data.empty())
+	{
+		DWORD written = 0;
+
+		if (!::WriteFile(file.m_handle, &chunk.m_data[0], static_cast<DWORD>(chunk.m_data.size()), &written, nullptr))
+			throw WCL::Win32Exception(::GetLastError(), Core::fmt(TXT("Failed to write to the output file '%s'"), file.m_tempName.c_str()));
+
+		if (written != chunk.m_data.size())
+			throw Core::RuntimeException(Core::fmt(TXT("Failed to write all of the output file '%s'"), file.m_tempName.c_str()));
+	}
+
+	if (chunk.m_last)
+	{
+		::CloseHandle(file.m_handle);
+		file.m_handle = INVALID_HANDLE_VALUE;
+
+		if (!::MoveFileEx(file.m_tempName.c_str(), file.m_finalName.c_str(), MOVEFILE_REPLACE_EXISTING))
+			throw WCL::Win32Exception(::GetLastError(), Core::fmt(TXT("Failed to rename the output file '%s'"), file.m_tempName.c_str()));
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Close and delete a file that could not be written.
+
+void HostFiles::abandonFile(HostFile& file)
+{
+	file.m_failed = true;
+
+	if (file.m_handle != INVALID_HANDLE_VALUE)
+	{
+		::CloseHandle(file.m_handle);
+		file.m_handle = INVALID_HANDLE_VALUE;
+	}
+
+	::DeleteFile(file.m_tempName.c_str());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Record the first error from a writer.
+
+void HostFiles::setError(const tstring& error)
+{
+	AutoLock lock(m_lock);
+
+	if (m_error.empty())
+		m_error = error;
+
+	::InterlockedExchange(&m_failed, TRUE);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Throw the first error from a writer, if any.
+
+void HostFiles::checkError()
+{
+	AutoLock lock(m_lock);
+
+	if (!m_error.empty())
+		throw Core::RuntimeException(m_error);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Stop the writers once they have drained their queues.
+
+void HostFiles::stopWriters()
+{
+	for (ChunkQueues::iterator it = m_queues.begin(); it != m_queues.end(); ++it)
+		(*it)->close();
+
+	for (Writers::iterator it = m_writers.begin(); it != m_writers.end(); ++it)
+	{
+		(*it)->join();
+		delete *it;
+	}
+
+	m_writers.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Constructor.
+
+HostFiles::Writer::Writer(HostFiles& files, ChunkQueue& queue)
+	: m_files(files)
+	, m_queue(queue)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! The thread's body.
+
+void HostFiles::Writer::run()
+{
+	AllocationScope scope(OUTPUT_STAGE);
+
+	m_files.writeChunks(m_queue);
+}
@@ -0,0 +1,178 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   HostFiles.hpp
+//! \brief  The HostFiles class declaration.
+//! \author Chris Oldwood
+
+// Check for previous inclusion
+#ifndef APP_HOSTFILES_HPP
+#define APP_HOSTFILES_HPP
+
+#if _MSC_VER > 1000
+#pragma once
+#endif
+
+#include "FormattingPipeline.hpp"
+#include "GzipEncoder.hpp"
+#include "Hosts.hpp"
+#include <map>
+
+////////////////////////////////////////////////////////////////////////////////
+//! A sink which writes each host's results to its own UTF-8 file in a
+//! directory, e.g. "out\<host>.txt". The hosts are told apart by their
+//! headings, which must therefore be present in the snapshots.
+//!
+//! The text is encoded into large chunks which are written by a small pool of
+//! writer threads. All of a file's chunks go to the same writer so that they
+//! stay in order. Each file is written under a temporary name and only renamed
+//! once the host is complete, so that a partial file is never visible. The
+//! number of files in progress is capped and the caller waits if it gets that
+//! many files ahead of the writers. Two hosts which would be written to the
+//! same file, such as a duplicate host, are rejected rather than one of them
+//! being silently overwritten.
+
+class HostFiles : public SnapshotSink
+{
+public:
+	//! Constructor.
+	HostFiles(const tstring& directory, bool showHost, size_t numWriters, size_t maxOpenFiles);
+
+	//! Destructor.
+	virtual ~HostFiles();
+
+	//! Write the snapshot's formatted text to its host's file.
+	virtual void write(const ObjectSnapshot& snapshot);
+
+	//! Flush any buffered output.
+	virtual void flush();
+
+	//! Finish the last file and wait for all the files to be written.
+	void close();
+
+	//! Get the name of the file for the host.
+	static tstring getFilename(const tstring& host);
+
+	//! Check that no two hosts would be written to the same file.
+	static void checkFilenames(const Hostnames& hosts);
+
+	//
+	// Constants.
+	//
+
+	//! The default number of writer threads.
+	static const size_t DEFAULT_WRITERS = 4;
+
+	//! The default number of files in progress at once.
+	static const size_t DEFAULT_MAX_OPEN_FILES = 64;
+
+	//! The size a chunk grows to before it is handed to a writer.
+	static const size_t CHUNK_SIZE = 256*1024;
+
+	//! The number of chunks allocated for each writer.
+	static const size_t CHUNKS_PER_WRITER = 4;
+
+private:
+	//! A file being written.
+	struct HostFile
+	{
+		tstring	m_tempName;		//!< The name it's written under.
+		tstring	m_finalName;	//!< The name it's renamed to.
+		size_t	m_writer;		//!< The index of the writer.
+		HANDLE	m_handle;		//!< The file handle, once opened.
+		bool	m_failed;		//!< Has writing the file failed?
+	};
+
+	//! A block of a file's contents.
+	struct Chunk
+	{
+		HostFile*	m_file;		//!< The file it belongs to.
+		ByteBuffer	m_data;		//!< The UTF-8 encoded text.
+		bool		m_last;		//!< Is it the file's final chunk?
+	};
+
+	//! The queue type used to pass chunks between threads.
+	typedef BoundedQueue<Chunk*> ChunkQueue;
+
+	//! A thread that writes chunks to their files.
+	class Writer : public Thread
+	{
+	public:
+		//! Constructor.
+		Writer(HostFiles& files, ChunkQueue& queue);
+
+	private:
+		//! The thread's body.
+		virtual void run();
+
+		HostFiles&	m_files;	//!< The owning sink.
+		ChunkQueue&	m_queue;	//!< The chunks to write.
+	};
+
+	typedef std::vector<Chunk*> Chunks;
+	typedef std::vector<ChunkQueue*> ChunkQueues;
+	typedef std::vector<Writer*> Writers;
+	typedef std::map<tstring, tstring> HostsByFile;
+
+	//
+	// Members.
+	//
+	tstring			m_directory;	//!< The directory to write the files to.
+	bool			m_showHost;		//!< Keep the host headings in the files?
+	Chunks			m_chunks;		//!< All the chunks.
+	ChunkQueue		m_free;			//!< The chunks available to the caller.
+	ChunkQueues		m_queues;		//!< The chunks waiting for each writer.
+	Writers			m_writers;		//!< The writer threads.
+	Semaphore		m_openFiles;	//!< The number of files that can be started.
+	Chunk*			m_current;		//!< The chunk being filled, if any.
+	size_t			m_numFiles;		//!< The number of files started.
+	HostsByFile		m_hosts;		//!< The host of each file started, by lowercase filename.
+	bool			m_closed;		//!< Have the files been closed?
+	CriticalSection	m_lock;			//!< The lock for the error.
+	tstring			m_error;		//!< The first error from a writer.
+	volatile LONG	m_failed;		//!< Has a writer failed?
+
+	//
+	// Internal methods.
+	//
+
+	//! Record the host's file and return its name.
+	static tstring addFile(HostsByFile& files, const tstring& host);
+
+	//! Finish the current file and start the host's.
+	void startFile(const tstring& host);
+
+	//! Hand the current file's last chunk to its writer.
+	void finishFile();
+
+	//! Hand the current chunk to its file's writer.
+	void handOver(bool last);
+
+	//! Append the text to the current chunk as UTF-8.
+	void append(const tstring& text);
+
+	//! The writer thread's main loop.
+	void writeChunks(ChunkQueue& queue);
+
+	//! Write a single chunk and, if it's the last, rename the file.
+	void writeChunk(Chunk& chunk);
+
+	//! Write the chunk's data, opening the file first if necessary.
+	void writeData(HostFile& file, const Chunk& chunk);
+
+	//! Close and delete a file that could not be written.
+	void abandonFile(HostFile& file);
+
+	//! Record the first error from a writer.
+	void setError(const tstring& error);
+
+	//! Throw the first error from a writer, if any.
+	void checkError();
+
+	//! Stop the writers once they have drained their queues.
+	void stopWriters();
+
+	// NotCopyable.
+	HostFiles(const HostFiles&);
+	HostFiles& operator=(const HostFiles&);
+};
+
+#endif // APP_HOSTFILES_HPP
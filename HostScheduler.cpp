@@ -0,0 +1,125 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   HostScheduler.cpp
+//! \brief  The HostScheduler class definition.
+//! \author Chris Oldwood
+
+#include "Common.hpp"
+#include "HostScheduler.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+//! Constructor. A host belongs to a site's group if it's annotated with the
+//! site and to a subnet's group if it's an IPv4 address within the subnet.
+
+HostScheduler::HostScheduler(const Hostnames& hostnames, const HostAnnotations& annotations, const AdaptiveLimit& limit)
+	: m_groups()
+	, m_hosts(hostnames.size())
+	, m_pending()
+	, m_inFlight(0)
+	, m_limit(limit)
+{
+	for (GroupLimits::const_iterator it = annotations.m_limits.begin(); it != annotations.m_limits.end(); ++it)
+	{
+		Group group = { it->m_max, 0 };
+
+		m_groups.push_back(group);
+	}
+
+	for (size_t i = 0; i != hostnames.size(); ++i)
+	{
+		HostSites::const_iterator siteIter = annotations.m_sites.find(hostnames[i]);
+		uint32                    address = 0;
+		const bool                isAddress = tryParseIPv4(hostnames[i], address);
+
+		for (size_t j = 0; j != annotations.m_limits.size(); ++j)
+		{
+			const GroupLimit& group = annotations.m_limits[j];
+
+			if (group.m_isSubnet)
+			{
+				if ( (isAddress) && ((address & group.m_mask) == group.m_network) )
+					m_hosts[i].m_groups.push_back(j);
+			}
+			else if ( (siteIter != annotations.m_sites.end()) && (siteIter->second == group.m_site) )
+			{
+				m_hosts[i].m_groups.push_back(j);
+			}
+		}
+
+		m_hosts[i].m_generation = 0;
+		m_pending.push_back(i);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Get the next host that can be started, if any. The first pending host with
+//! room in all its groups is chosen.
+
+bool HostScheduler::tryStart(size_t& host)
+{
+	return tryStart(host, m_hosts.size());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Get the next host before the given one that can be started, if any. This
+//! stops the hosts getting too far ahead of the one whose output is next.
+
+bool HostScheduler::tryStart(size_t& host, size_t end)
+{
+	if (m_inFlight >= m_limit.limit())
+		return false;
+
+	for (Pending::iterator it = m_pending.begin(); (it != m_pending.end()) && (*it < end); ++it)
+	{
+		Host& candidate = m_hosts[*it];
+
+		if (!hasRoom(candidate))
+			continue;
+
+		for (size_t i = 0; i != candidate.m_groups.size(); ++i)
+			++m_groups[candidate.m_groups[i]].m_inFlight;
+
+		candidate.m_generation = m_limit.generation();
+		++m_inFlight;
+
+		host = *it;
+		m_pending.erase(it);
+
+		return true;
+	}
+
+	return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Record that a host has finished and how long it took (ms) to connect to and
+//! query. A host that failed still counts as its latency reflects the load.
+
+void HostScheduler::finish(size_t host, DWORD latency)
+{
+	ASSERT(m_inFlight != 0);
+
+	const Host& finished = m_hosts[host];
+
+	for (size_t i = 0; i != finished.m_groups.size(); ++i)
+		--m_groups[finished.m_groups[i]].m_inFlight;
+
+	--m_inFlight;
+
+	m_limit.addLatency(latency, finished.m_generation);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Does every group the host belongs to have room for it?
+
+bool HostScheduler::hasRoom(const Host& host) const
+{
+	for (size_t i = 0; i != host.m_groups.size(); ++i)
+	{
+		const Group& group = m_groups[host.m_groups[i]];
+
+		if (group.m_inFlight >= group.m_max)
+			return false;
+	}
+
+	return true;
+}
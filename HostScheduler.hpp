@@ -0,0 +1,122 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   HostScheduler.hpp
+//! \brief  The HostScheduler class declaration.
+//! \author Chris Oldwood
+
+// Check for previous inclusion
+#ifndef APP_HOSTSCHEDULER_HPP
+#define APP_HOSTSCHEDULER_HPP
+
+#if _MSC_VER > 1000
+#pragma once
+#endif
+
+#include "Hosts.hpp"
+#include "AdaptiveLimit.hpp"
+#include <list>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+//! Decides which hosts can be queried and when. The number of hosts in flight
+//! is bounded by an adaptive limit, which is driven by how long each host took
+//! to connect to and query, and by any caps on the hosts in a site or subnet.
+//! Hosts are started in the order given unless an earlier one is held back by
+//! a cap. This class is not thread-safe.
+
+class HostScheduler
+{
+public:
+	//! Constructor.
+	HostScheduler(const Hostnames& hostnames, const HostAnnotations& annotations, const AdaptiveLimit& limit);
+
+	//! Get the next host that can be started, if any.
+	bool tryStart(size_t& host);
+
+	//! Get the next host before the given one that can be started, if any.
+	bool tryStart(size_t& host, size_t end);
+
+	//! Record that a host has finished and how long it took (ms).
+	void finish(size_t host, DWORD latency);
+
+	//! Have all the hosts finished?
+	bool isDone() const;
+
+	//! Get the number of hosts in flight.
+	size_t numInFlight() const;
+
+	//! Get the first host that has yet to be started.
+	size_t firstPending() const;
+
+	//! Get the current limit on the number of hosts in flight.
+	size_t limit() const;
+
+private:
+	//! The hosts in a capped site or subnet.
+	struct Group
+	{
+		size_t	m_max;		//!< The maximum number of hosts in flight.
+		size_t	m_inFlight;	//!< The number of hosts in flight.
+	};
+
+	//! The state of a single host.
+	struct Host
+	{
+		std::vector<size_t>	m_groups;		//!< The groups the host belongs to.
+		size_t				m_generation;	//!< The limit's generation when started.
+	};
+
+	typedef std::vector<Group> Groups;
+	typedef std::vector<Host> Hosts;
+	typedef std::list<size_t> Pending;
+
+	//
+	// Members.
+	//
+	Groups			m_groups;		//!< The capped sites and subnets.
+	Hosts			m_hosts;		//!< The hosts to query.
+	Pending			m_pending;		//!< The hosts waiting to be started.
+	size_t			m_inFlight;		//!< The number of hosts in flight.
+	AdaptiveLimit	m_limit;		//!< The limit on the number of hosts in flight.
+
+	//
+	// Internal methods.
+	//
+
+	//! Does every group the host belongs to have room for it?
+	bool hasRoom(const Host& host) const;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! Have all the hosts finished?
+
+inline bool HostScheduler::isDone() const
+{
+	return m_pending.empty() && (m_inFlight == 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Get the number of hosts in flight.
+
+inline size_t HostScheduler::numInFlight() const
+{
+	return m_inFlight;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Get the first host that has yet to be started, or the number of hosts if
+//! they have all been started.
+
+inline size_t HostScheduler::firstPending() const
+{
+	return (!m_pending.empty()) ? m_pending.front() : m_hosts.size();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Get the current limit on the number of hosts in flight.
+
+inline size_t HostScheduler::limit() const
+{
+	return m_limit.limit();
+}
+
+#endif // APP_HOSTSCHEDULER_HPP
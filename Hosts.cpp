@@ -0,0 +1,212 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   Hosts.cpp
+//! \brief  Helper functions for building the list of hosts to query.
+//! \author Chris Oldwood
+
+#include "Common.hpp"
+#include "Hosts.hpp"
+#include <Core/TextFileIterator.hpp>
+#include <Core/StringUtils.hpp>
+#include <Core/RuntimeException.hpp>
+#include <WMI/Connection.hpp>
+#include <Core/tiostream.hpp>
+
+////////////////////////////////////////////////////////////////////////////////
+//! Parse a dotted IPv4 address, e.g. 10.1.2.3.
+
+bool tryParseIPv4(const tstring& text, uint32& address)
+{
+	uint32 result = 0;
+	size_t numParts = 0;
+	size_t pos = 0;
+
+	while (numParts != 4)
+	{
+		size_t numDigits = 0;
+		uint32 part = 0;
+
+		while ( (pos != text.length()) && (text[pos] >= TXT('0')) && (text[pos] <= TXT('9')) && (numDigits != 3) )
+		{
+			part = (part * 10) + static_cast<uint32>(text[pos] - TXT('0'));
+			++pos;
+			++numDigits;
+		}
+
+		if ( (numDigits == 0) || (part > 255) )
+			return false;
+
+		result = (result << 8) | part;
+
+		if (++numParts != 4)
+		{
+			if ( (pos == text.length()) || (text[pos] != TXT('.')) )
+				return false;
+
+			++pos;
+		}
+	}
+
+	if (pos != text.length())
+		return false;
+
+	address = result;
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Parse a "@limit site=<name> <max>" or "@limit subnet=<a.b.c.d/n> <max>" line.
+
+static GroupLimit parseLimit(const tstring& line)
+{
+	const tstring prefix(TXT("@limit"));
+	const tstring sitePrefix(TXT("site="));
+	const tstring subnetPrefix(TXT("subnet="));
+
+	tistringstream stream(line.substr(prefix.length()));
+	tstring        group, extra;
+	int            max = 0;
+	GroupLimit     limit = { false, tstring(), 0, 0, 0 };
+
+	if ( (line.compare(0, prefix.length(), prefix) != 0) || !(stream >> group >> max) || (stream >> extra) || (max < 1) )
+		throw Core::RuntimeException(Core::fmt(TXT("Invalid host limit '%s'"), line.c_str()));
+
+	limit.m_max = static_cast<size_t>(max);
+
+	if (group.compare(0, sitePrefix.length(), sitePrefix) == 0)
+	{
+		limit.m_site = group.substr(sitePrefix.length());
+
+		if (limit.m_site.empty())
+			throw Core::RuntimeException(Core::fmt(TXT("Invalid host limit '%s'"), line.c_str()));
+	}
+	else if (group.compare(0, subnetPrefix.length(), subnetPrefix) == 0)
+	{
+		const tstring subnet = group.substr(subnetPrefix.length());
+		const size_t  slash = subnet.find(TXT('/'));
+		int           bits = -1;
+
+		if (slash != tstring::npos)
+		{
+			tistringstream bitsStream(subnet.substr(slash+1));
+
+			if (!(bitsStream >> bits) || !bitsStream.eof())
+				bits = -1;
+		}
+
+		if ( (bits < 0) || (bits > 32) || !tryParseIPv4(subnet.substr(0, slash), limit.m_network) )
+			throw Core::RuntimeException(Core::fmt(TXT("Invalid subnet in host limit '%s'"), line.c_str()));
+
+		limit.m_isSubnet = true;
+		limit.m_mask = (bits == 0) ? 0 : (0xFFFFFFFFu << (32 - bits));
+		limit.m_network &= limit.m_mask;
+	}
+	else
+	{
+		throw Core::RuntimeException(Core::fmt(TXT("Invalid host limit '%s'"), line.c_str()));
+	}
+
+	return limit;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Read the list of hostnames from a text file. Empty lines are ignored as are
+//! comments which start with the # character. A hostname can be followed by
+//! "site=<name>" and a line of the form "@limit site=<name> <max>" or "@limit
+//! subnet=<a.b.c.d/n> <max>" caps the hosts in a site or subnet.
+
+Hostnames readHostsFile(const tstring& filename, HostAnnotations& annotations)
+{
+	Hostnames hosts;
+
+	Core::TextFileIterator end;
+	Core::TextFileIterator it(filename);
+
+	const tstring sitePrefix(TXT("site="));
+
+	for (; it != end; ++it)
+	{
+		tstring line(*it);
+
+		size_t pos = line.find_first_of(TXT('#'));
+
+		if (pos != tstring::npos)
+			line.erase(pos);
+
+		Core::trim(line);
+
+		if (line.empty())
+			continue;
+
+		if (line[0] == TXT('@'))
+		{
+			annotations.m_limits.push_back(parseLimit(line));
+			continue;
+		}
+
+		tistringstream stream(line);
+		tstring        host, annotation;
+
+		stream >> host;
+
+		while (stream >> annotation)
+		{
+			if (annotation.compare(0, sitePrefix.length(), sitePrefix) != 0)
+				throw Core::RuntimeException(Core::fmt(TXT("Invalid annotation for host '%s'"), line.c_str()));
+
+			annotations.m_sites[host] = annotation.substr(sitePrefix.length());
+		}
+
+		hosts.push_back(host);
+	}
+
+	return hosts;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Read the list of hostnames from a text file, ignoring any annotations.
+
+Hostnames readHostsFile(const tstring& filename)
+{
+	HostAnnotations annotations;
+
+	return readHostsFile(filename, annotations);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Build the list of hosts from the --hosts and --hostsfile switches. If neither
+//! is specified the list contains just the local host.
+
+Hostnames getHostnames(const Core::CmdLineParser& parser, int hostsSwitch, int hostsFileSwitch, HostAnnotations& annotations)
+{
+	Hostnames hostnames;
+
+	if (parser.isSwitchSet(hostsSwitch))
+	{
+		const Hostnames& args = parser.getNamedArgs().find(hostsSwitch)->second;
+
+		hostnames.insert(hostnames.end(), args.begin(), args.end());
+	}
+
+	if (parser.isSwitchSet(hostsFileSwitch))
+	{
+		tstring   hostsFile = parser.getSwitchValue(hostsFileSwitch);
+		Hostnames args = readHostsFile(hostsFile, annotations);
+
+		hostnames.insert(hostnames.end(), args.begin(), args.end());
+	}
+
+	if (hostnames.empty())
+		hostnames.push_back(WMI::Connection::LOCALHOST);
+
+	return hostnames;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Build the list of hosts, ignoring any annotations in the hosts file.
+
+Hostnames getHostnames(const Core::CmdLineParser& parser, int hostsSwitch, int hostsFileSwitch)
+{
+	HostAnnotations annotations;
+
+	return getHostnames(parser, hostsSwitch, hostsFileSwitch, annotations);
+}
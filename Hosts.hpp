@@ -0,0 +1,77 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   Hosts.hpp
+//! \brief  Helper functions for building the list of hosts to query.
+//! \author Chris Oldwood
+
+// Check for previous inclusion
+#ifndef APP_HOSTS_HPP
+#define APP_HOSTS_HPP
+
+#if _MSC_VER > 1000
+#pragma once
+#endif
+
+#include <Core/CmdLineParser.hpp>
+#include <map>
+#include <vector>
+
+//! The list of hostnames.
+typedef Core::CmdLineParser::StringVector Hostnames;
+
+//! The site each host belongs to, keyed by hostname.
+typedef std::map<tstring, tstring> HostSites;
+
+////////////////////////////////////////////////////////////////////////////////
+//! A cap on the number of hosts in a site or subnet that are queried at once.
+
+struct GroupLimit
+{
+	bool	m_isSubnet;	//!< Is the group a subnet rather than a site?
+	tstring	m_site;		//!< The site name.
+	uint32	m_network;	//!< The subnet's network address.
+	uint32	m_mask;		//!< The subnet's mask.
+	size_t	m_max;		//!< The maximum number of hosts queried at once.
+};
+
+//! The list of site and subnet caps.
+typedef std::vector<GroupLimit> GroupLimits;
+
+////////////////////////////////////////////////////////////////////////////////
+//! The annotations from a hosts file.
+
+struct HostAnnotations
+{
+	HostSites	m_sites;	//!< The site each host belongs to.
+	GroupLimits	m_limits;	//!< The caps on hosts queried at once.
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Parse a dotted IPv4 address, e.g. 10.1.2.3.
+
+bool tryParseIPv4(const tstring& text, uint32& address);
+
+////////////////////////////////////////////////////////////////////////////////
+// Read the list of hostnames from a text file. Empty lines are ignored as are
+// comments which start with the # character. A hostname can be followed by
+// "site=<name>" and a line of the form "@limit site=<name> <max>" or "@limit
+// subnet=<a.b.c.d/n> <max>" caps the hosts in a site or subnet.
+
+Hostnames readHostsFile(const tstring& filename, HostAnnotations& annotations);
+
+////////////////////////////////////////////////////////////////////////////////
+// Read the list of hostnames from a text file, ignoring any annotations.
+
+Hostnames readHostsFile(const tstring& filename);
+
+////////////////////////////////////////////////////////////////////////////////
+// Build the list of hosts from the --hosts and --hostsfile switches. If neither
+// is specified the list contains just the local host.
+
+Hostnames getHostnames(const Core::CmdLineParser& parser, int hostsSwitch, int hostsFileSwitch, HostAnnotations& annotations);
+
+////////////////////////////////////////////////////////////////////////////////
+// Build the list of hosts, ignoring any annotations in the hosts file.
+
+Hostnames getHostnames(const Core::CmdLineParser& parser, int hostsSwitch, int hostsFileSwitch);
+
+#endif // APP_HOSTS_HPP
@@ -0,0 +1,158 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   Inventory.cpp
+//! \brief  The types used to describe the namespaces and classes on hosts.
+//! \author Chris Oldwood
+
+#include "Common.hpp"
+#include "Inventory.hpp"
+#include <Core/TextFileIterator.hpp>
+#include <Core/StringUtils.hpp>
+#include <Core/RuntimeException.hpp>
+#include <algorithm>
+#include <fstream>
+
+////////////////////////////////////////////////////////////////////////////////
+// The cache file is a text file with one tab separated record per line. Each
+// namespace record is followed by the records for its classes:-
+//
+// N <host> <namespace> <error>
+// C <class> <property count>
+
+//! The field separator.
+static const tchar SEPARATOR = TXT('\t');
+
+//! The fields of a cache file record.
+typedef std::vector<tstring> Fields;
+
+////////////////////////////////////////////////////////////////////////////////
+//! Split a cache file record into its fields.
+
+static void splitRecord(const tstring& record, Fields& fields)
+{
+	size_t begin = 0;
+	size_t end = record.find(SEPARATOR);
+
+	while (end != tstring::npos)
+	{
+		fields.push_back(record.substr(begin, end - begin));
+
+		begin = end + 1;
+		end = record.find(SEPARATOR, begin);
+	}
+
+	fields.push_back(record.substr(begin));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Default constructor.
+
+ClassInfo::ClassInfo()
+	: m_name()
+	, m_numProperties(0)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Full constructor.
+
+ClassInfo::ClassInfo(const tstring& name, size_t numProperties)
+	: m_name(name)
+	, m_numProperties(numProperties)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Compare two classes by name.
+
+static bool compareClasses(const ClassInfo& lhs, const ClassInfo& rhs)
+{
+	return (tstricmp(lhs.m_name.c_str(), rhs.m_name.c_str()) < 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Compare two namespaces by host and then name.
+
+static bool compareNamespaces(const NamespaceInfo& lhs, const NamespaceInfo& rhs)
+{
+	int result = tstricmp(lhs.m_host.c_str(), rhs.m_host.c_str());
+
+	if (result == 0)
+		result = tstricmp(lhs.m_name.c_str(), rhs.m_name.c_str());
+
+	return (result < 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Sort the inventory by host, then namespace and finally class.
+
+void sortInventory(Inventory& inventory)
+{
+	std::sort(inventory.begin(), inventory.end(), compareNamespaces);
+
+	for (Inventory::iterator it = inventory.begin(); it != inventory.end(); ++it)
+		std::sort(it->m_classes.begin(), it->m_classes.end(), compareClasses);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Load a previously cached inventory from a file.
+
+void loadInventory(const tstring& filename, Inventory& inventory)
+{
+	Core::TextFileIterator end;
+	Core::TextFileIterator it(filename);
+
+	for (; it != end; ++it)
+	{
+		const tstring& line = *it;
+
+		if (line.empty())
+			continue;
+
+		Fields fields;
+
+		splitRecord(line, fields);
+
+		if ( (fields[0] == TXT("N")) && (fields.size() >= 3) )
+		{
+			NamespaceInfo info;
+
+			info.m_host = fields[1];
+			info.m_name = fields[2];
+
+			if (fields.size() > 3)
+				info.m_error = fields[3];
+
+			inventory.push_back(info);
+		}
+		else if ( (fields[0] == TXT("C")) && (fields.size() == 3) && !inventory.empty() )
+		{
+			inventory.back().m_classes.push_back(ClassInfo(fields[1], Core::parse<size_t>(fields[2])));
+		}
+		else
+		{
+			throw Core::RuntimeException(Core::fmt(TXT("Invalid record in cache file '%s': %s"), filename.c_str(), line.c_str()));
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Save the inventory to a file so that it can be reused later.
+
+void saveInventory(const tstring& filename, const Inventory& inventory)
+{
+	std::basic_ofstream<tchar> file(filename.c_str());
+
+	if (!file)
+		throw Core::RuntimeException(Core::fmt(TXT("Failed to create cache file '%s'"), filename.c_str()));
+
+	for (Inventory::const_iterator it = inventory.begin(); it != inventory.end(); ++it)
+	{
+		file << TXT('N') << SEPARATOR << it->m_host << SEPARATOR << it->m_name << SEPARATOR << it->m_error << TXT('\n');
+
+		for (Classes::const_iterator classIter = it->m_classes.begin(); classIter != it->m_classes.end(); ++classIter)
+			file << TXT('C') << SEPARATOR << classIter->m_name << SEPARATOR << classIter->m_numProperties << TXT('\n');
+	}
+
+	if (!file.flush())
+		throw Core::RuntimeException(Core::fmt(TXT("Failed to write cache file '%s'"), filename.c_str()));
+}
@@ -0,0 +1,69 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   Inventory.hpp
+//! \brief  The types used to describe the namespaces and classes on hosts.
+//! \author Chris Oldwood
+
+// Check for previous inclusion
+#ifndef APP_INVENTORY_HPP
+#define APP_INVENTORY_HPP
+
+#if _MSC_VER > 1000
+#pragma once
+#endif
+
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+//! The details of a single WMI class.
+
+struct ClassInfo
+{
+	//! Default constructor.
+	ClassInfo();
+
+	//! Full constructor.
+	ClassInfo(const tstring& name, size_t numProperties);
+
+	//
+	// Members.
+	//
+	tstring	m_name;				//!< The class name.
+	size_t	m_numProperties;	//!< The number of (non-system) properties.
+};
+
+//! The list of classes in a namespace.
+typedef std::vector<ClassInfo> Classes;
+
+////////////////////////////////////////////////////////////////////////////////
+//! The details of a single namespace on a host.
+
+struct NamespaceInfo
+{
+	//
+	// Members.
+	//
+	tstring	m_host;		//!< The host the namespace lives on.
+	tstring	m_name;		//!< The full namespace path, e.g. root\cimv2.
+	tstring	m_error;	//!< The reason enumeration failed, if it did.
+	Classes	m_classes;	//!< The classes in the namespace, if requested.
+};
+
+//! The collection of namespaces across one or more hosts.
+typedef std::vector<NamespaceInfo> Inventory;
+
+////////////////////////////////////////////////////////////////////////////////
+// Sort the inventory by host, then namespace and finally class.
+
+void sortInventory(Inventory& inventory);
+
+////////////////////////////////////////////////////////////////////////////////
+// Load a previously cached inventory from a file.
+
+void loadInventory(const tstring& filename, Inventory& inventory);
+
+////////////////////////////////////////////////////////////////////////////////
+// Save the inventory to a file so that it can be reused later.
+
+void saveInventory(const tstring& filename, const Inventory& inventory);
+
+#endif // APP_INVENTORY_HPP
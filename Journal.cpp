@@ -0,0 +1,314 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   Journal.cpp
+//! \brief  The Journal class definition.
+//! \author Chris Oldwood
+
+#include "Common.hpp"
+#include "Journal.hpp"
+#include "AsyncFileWriter.hpp"
+#include "LineReader.hpp"
+#include "Utf8Encoding.hpp"
+#include <WCL/Win32Exception.hpp>
+#include <Core/RuntimeException.hpp>
+#include <Core/StringUtils.hpp>
+#include <Core/tiostream.hpp>
+
+//! The label at the start of a host heading.
+static const tchar HOST_LABEL[] = TXT("Host: ");
+
+//! The length of the host heading label.
+static const size_t HOST_LABEL_LENGTH = ARRAY_SIZE(HOST_LABEL) - 1;
+
+//! The label at the start of the heading that reports a failed host.
+static const tchar ERROR_LABEL[] = TXT("Error: ");
+
+//! The length of the error heading label.
+static const size_t ERROR_LABEL_LENGTH = ARRAY_SIZE(ERROR_LABEL) - 1;
+
+//! The status recorded for a host that was output in full.
+static const tchar STATUS_OK[] = TXT("OK");
+
+//! The status recorded for a host whose output ends with an error.
+static const tchar STATUS_FAILED[] = TXT("FAILED");
+
+////////////////////////////////////////////////////////////////////////////////
+//! Was the host output in full? A host that failed has the error in its output
+//! instead.
+
+bool JournalEntry::succeeded() const
+{
+	return (m_status == STATUS_OK);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Does the file end with a line terminator? An empty file does.
+
+static bool endsWithNewline(const tstring& filename)
+{
+	HANDLE file = ::CreateFile(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+	                           FILE_ATTRIBUTE_NORMAL, NULL);
+
+	if (file == INVALID_HANDLE_VALUE)
+		throw WCL::Win32Exception(::GetLastError(), Core::fmt(TXT("Failed to open the file '%s'"), filename.c_str()));
+
+	LARGE_INTEGER size;
+	char          last = '\n';
+	DWORD         read = 0;
+
+	if (::GetFileSizeEx(file, &size) && (size.QuadPart != 0))
+	{
+		LARGE_INTEGER position;
+
+		position.QuadPart = size.QuadPart - 1;
+
+		if (!::SetFilePointerEx(file, position, nullptr, FILE_BEGIN) || !::ReadFile(file, &last, 1, &read, nullptr))
+			last = '\0';
+	}
+
+	::CloseHandle(file);
+
+	return (last == '\n');
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Read the entries from a journal file. A missing file has no entries and an
+//! incomplete final line, from being interrupted mid-write, is ignored. Any
+//! other malformed line means it's not a journal.
+
+JournalEntries readJournal(const tstring& filename)
+{
+	JournalEntries entries;
+
+	if (::GetFileAttributes(filename.c_str()) == INVALID_FILE_ATTRIBUTES)
+		return entries;
+
+	LineReader reader(filename);
+	tstring    line;
+	bool       lastWasEntry = false;
+
+	while (reader.readLine(line))
+	{
+		lastWasEntry = false;
+
+		if (line.empty())
+			continue;
+
+		tistringstream stream(line);
+		JournalEntry   entry;
+		tstring        extra;
+
+		if (!(stream >> entry.m_status >> entry.m_offset >> entry.m_host) || (stream >> extra))
+		{
+			const tstring invalid = line;
+
+			// Only the final line can have been cut short.
+			if (reader.readLine(line))
+				throw Core::RuntimeException(Core::fmt(TXT("Invalid journal entry '%s' in '%s'"), invalid.c_str(), filename.c_str()));
+
+			break;
+		}
+
+		entries.push_back(entry);
+		lastWasEntry = true;
+	}
+
+	if (lastWasEntry && !endsWithNewline(filename))
+		entries.pop_back();
+
+	return entries;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Constructor. The file is either appended to or replaced.
+
+Journal::Journal(const tstring& filename, bool append)
+	: m_filename(filename)
+	, m_file(INVALID_HANDLE_VALUE)
+	, m_batch()
+	, m_numBatched(0)
+	, m_batchStarted(0)
+{
+	m_file = ::CreateFile(filename.c_str(), FILE_APPEND_DATA, FILE_SHARE_READ, nullptr, (append) ? OPEN_ALWAYS : CREATE_ALWAYS,
+	                      FILE_ATTRIBUTE_NORMAL, NULL);
+
+	if (m_file == INVALID_HANDLE_VALUE)
+		throw WCL::Win32Exception(::GetLastError(), Core::fmt(TXT("Failed to open the journal '%s'"), filename.c_str()));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Destructor. If the journal hasn't been closed the batched records are still
+//! written, but any error is lost.
+
+Journal::~Journal()
+{
+	if (m_file != INVALID_HANDLE_VALUE)
+	{
+		try
+		{
+			close();
+		}
+		catch (const Core::Exception& /*e*/)
+		{
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Record a completed host. The record is batched until either the batch is
+//! full or the first record in it has waited for the batch interval.
+
+void Journal::hostCompleted(const tstring& host, const tstring& status, uint64 offset)
+{
+	ASSERT(m_file != INVALID_HANDLE_VALUE);
+
+	if (m_numBatched++ == 0)
+		m_batchStarted = ::GetTickCount();
+
+	appendUtf8(Core::fmt(TXT("%s %I64u %s\n"), status.c_str(), offset, host.c_str()), m_batch);
+
+	if ( (m_numBatched >= BATCH_SIZE) || ((::GetTickCount() - m_batchStarted) >= BATCH_INTERVAL) )
+		writeBatch();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Write the batched records if the first one has waited for the batch
+//! interval. This stops records being held back by a slow host.
+
+void Journal::sync()
+{
+	ASSERT(m_file != INVALID_HANDLE_VALUE);
+
+	if ( (m_numBatched != 0) && ((::GetTickCount() - m_batchStarted) >= BATCH_INTERVAL) )
+		writeBatch();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Write any batched records and close the file.
+
+void Journal::close()
+{
+	ASSERT(m_file != INVALID_HANDLE_VALUE);
+
+	try
+	{
+		writeBatch();
+	}
+	catch (...)
+	{
+		::CloseHandle(m_file);
+		m_file = INVALID_HANDLE_VALUE;
+		throw;
+	}
+
+	::CloseHandle(m_file);
+	m_file = INVALID_HANDLE_VALUE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Write the batched records and flush them to disk.
+
+void Journal::writeBatch()
+{
+	if (m_batch.empty())
+		return;
+
+	DWORD written = 0;
+
+	if (!::WriteFile(m_file, &m_batch[0], static_cast<DWORD>(m_batch.size()), &written, nullptr) || !::FlushFileBuffers(m_file))
+		throw WCL::Win32Exception(::GetLastError(), Core::fmt(TXT("Failed to write to the journal '%s'"), m_filename.c_str()));
+
+	m_batch.clear();
+	m_numBatched = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Constructor.
+
+JournalSink::JournalSink(SnapshotSink& output, Journal& journal, const AsyncFileWriter* file, bool showHost)
+	: m_output(output)
+	, m_journal(journal)
+	, m_file(file)
+	, m_showHost(showHost)
+	, m_host()
+	, m_failed(false)
+	, m_heading()
+{
+	m_heading.m_isObject = false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Write the snapshot to the output, noting any change of host. A host heading
+//! completes the previous host before it's passed on and an error heading marks
+//! the current host as failed.
+
+void JournalSink::write(const ObjectSnapshot& snapshot)
+{
+	if (!snapshot.m_isObject)
+	{
+		tstring heading = snapshot.m_heading;
+
+		Core::trim(heading);
+
+		if (heading.compare(0, HOST_LABEL_LENGTH, HOST_LABEL) == 0)
+		{
+			hostCompleted();
+
+			m_host = heading.substr(HOST_LABEL_LENGTH);
+
+			// Pass the heading on without its text.
+			if (!m_showHost)
+			{
+				m_heading.m_sequence = snapshot.m_sequence;
+				m_heading.m_heading = snapshot.m_heading;
+				m_output.write(m_heading);
+				return;
+			}
+		}
+		else if (heading.compare(0, ERROR_LABEL_LENGTH, ERROR_LABEL) == 0)
+		{
+			m_failed = true;
+		}
+	}
+
+	m_output.write(snapshot);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Flush any buffered output and write any overdue journal records.
+
+void JournalSink::flush()
+{
+	m_output.flush();
+	m_journal.sync();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Record the last host as complete. This should only be called once all of
+//! the output has been written.
+
+void JournalSink::close()
+{
+	hostCompleted();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Record the current host as complete. When there is a single output file the
+//! output is flushed so that the file's size includes all of the host.
+
+void JournalSink::hostCompleted()
+{
+	if (m_host.empty())
+		return;
+
+	uint64 offset = 0;
+
+	if (m_file != nullptr)
+	{
+		m_output.flush();
+		offset = m_file->size();
+	}
+
+	m_journal.hostCompleted(m_host, (m_failed) ? STATUS_FAILED : STATUS_OK, offset);
+	m_host.erase();
+	m_failed = false;
+}
@@ -0,0 +1,146 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   Journal.hpp
+//! \brief  The Journal class declaration.
+//! \author Chris Oldwood
+
+// Check for previous inclusion
+#ifndef APP_JOURNAL_HPP
+#define APP_JOURNAL_HPP
+
+#if _MSC_VER > 1000
+#pragma once
+#endif
+
+#include "FormattingPipeline.hpp"
+#include <vector>
+
+class AsyncFileWriter;
+
+////////////////////////////////////////////////////////////////////////////////
+//! A host recorded in the journal as complete.
+
+struct JournalEntry
+{
+	tstring	m_host;		//!< The hostname.
+	tstring	m_status;	//!< The outcome, "OK" or "FAILED".
+	uint64	m_offset;	//!< The size of the output once the host was written.
+
+	//! Was the host output in full?
+	bool succeeded() const;
+};
+
+//! The entries read from a journal.
+typedef std::vector<JournalEntry> JournalEntries;
+
+////////////////////////////////////////////////////////////////////////////////
+// Read the entries from a journal file. A missing file has no entries and an
+// incomplete final line, from being interrupted mid-write, is ignored.
+
+JournalEntries readJournal(const tstring& filename);
+
+////////////////////////////////////////////////////////////////////////////////
+//! An append-only log of the hosts that have been completed, which allows an
+//! interrupted sweep to be resumed. Each host is recorded on its own line as
+//! "<status> <offset> <host>", where the offset is the size of the output file
+//! once the host had been written to it, so that a partly written host can be
+//! cut off the end. The records are written, and flushed to disk, in batches to
+//! keep the cost of syncing the file down.
+
+class Journal
+{
+public:
+	//! Constructor.
+	Journal(const tstring& filename, bool append);
+
+	//! Destructor.
+	~Journal();
+
+	//! Record a completed host.
+	void hostCompleted(const tstring& host, const tstring& status, uint64 offset);
+
+	//! Write the batched records if they're overdue.
+	void sync();
+
+	//! Write any batched records and close the file.
+	void close();
+
+	//
+	// Constants.
+	//
+
+	//! The most records batched before they're written.
+	static const size_t BATCH_SIZE = 256;
+
+	//! The most time (ms) records are batched for before they're written.
+	static const DWORD BATCH_INTERVAL = 1000;
+
+private:
+	//
+	// Members.
+	//
+	tstring				m_filename;		//!< The name of the journal file.
+	HANDLE				m_file;			//!< The file handle.
+	std::vector<byte>	m_batch;		//!< The UTF-8 records not yet written.
+	size_t				m_numBatched;	//!< The number of records not yet written.
+	DWORD				m_batchStarted;	//!< When the first record was batched.
+
+	//
+	// Internal methods.
+	//
+
+	//! Write the batched records and flush them to disk.
+	void writeBatch();
+
+	// NotCopyable.
+	Journal(const Journal&);
+	Journal& operator=(const Journal&);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! A sink which records each host in the journal once all of its output has
+//! been passed on to another sink. The hosts are told apart by their headings,
+//! which must therefore be present in the snapshots; the heading text is only
+//! passed on if requested. A host is complete when the next one starts or, for
+//! the last host, when the sink is closed. A host with an error heading in its
+//! output is recorded as having failed.
+
+class JournalSink : public SnapshotSink
+{
+public:
+	//! Constructor.
+	JournalSink(SnapshotSink& output, Journal& journal, const AsyncFileWriter* file, bool showHost);
+
+	//! Write the snapshot to the output, noting any change of host.
+	virtual void write(const ObjectSnapshot& snapshot);
+
+	//! Flush any buffered output and write any overdue journal records.
+	virtual void flush();
+
+	//! Record the last host as complete.
+	void close();
+
+private:
+	//
+	// Members.
+	//
+	SnapshotSink&			m_output;	//!< The sink to pass the output on to.
+	Journal&				m_journal;	//!< The journal to record the hosts in.
+	const AsyncFileWriter*	m_file;		//!< The single output file, if any.
+	bool					m_showHost;	//!< Pass the host headings on?
+	tstring					m_host;		//!< The host being output.
+	bool					m_failed;	//!< Has the host reported an error?
+	ObjectSnapshot			m_heading;	//!< A host heading without its text.
+
+	//
+	// Internal methods.
+	//
+
+	//! Record the current host as complete.
+	void hostCompleted();
+
+	// NotCopyable.
+	JournalSink(const JournalSink&);
+	JournalSink& operator=(const JournalSink&);
+};
+
+#endif // APP_JOURNAL_HPP
@@ -0,0 +1,145 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   LineReader.cpp
+//! \brief  The LineReader class definition.
+//! \author Chris Oldwood
+
+#include "Common.hpp"
+#include "LineReader.hpp"
+#include <WCL/Win32Exception.hpp>
+#include <Core/StringUtils.hpp>
+#include <algorithm>
+
+////////////////////////////////////////////////////////////////////////////////
+//! Constructor.
+
+LineReader::LineReader(const tstring& filename)
+	: m_filename(filename)
+	, m_file(INVALID_HANDLE_VALUE)
+	, m_buffer(BUFFER_SIZE)
+	, m_begin(0)
+	, m_end(0)
+	, m_eof(false)
+	, m_first(true)
+	, m_partial()
+{
+	m_file = ::CreateFile(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+	                      FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+
+	if (m_file == INVALID_HANDLE_VALUE)
+		throw WCL::Win32Exception(::GetLastError(), Core::fmt(TXT("Failed to open the file '%s'"), filename.c_str()));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Destructor.
+
+LineReader::~LineReader()
+{
+	::CloseHandle(m_file);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Read the next line, without its line terminator. Returns false at the end
+//! of the file.
+
+bool LineReader::readLine(tstring& line)
+{
+	m_partial.clear();
+
+	for (;;)
+	{
+		const char* begin = &m_buffer[0] + m_begin;
+		const char* end = &m_buffer[0] + m_end;
+		const char* newline = std::find(begin, end, '\n');
+
+		if (newline != end)
+		{
+			m_begin += (newline - begin) + 1;
+
+			if (m_partial.empty())
+			{
+				const size_t length = newline - begin;
+
+				decode(begin, ((length != 0) && (begin[length-1] == '\r')) ? length-1 : length, line);
+				return true;
+			}
+
+			m_partial.insert(m_partial.end(), begin, newline);
+			break;
+		}
+
+		m_partial.insert(m_partial.end(), begin, end);
+		m_begin = m_end;
+
+		if (!readChunk())
+		{
+			if (m_partial.empty())
+				return false;
+
+			break;
+		}
+	}
+
+	size_t length = m_partial.size();
+
+	if (m_partial[length-1] == '\r')
+		--length;
+
+	decode(&m_partial[0], length, line);
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Read the next chunk of the file. Returns false at the end of the file.
+
+bool LineReader::readChunk()
+{
+	if (m_eof)
+		return false;
+
+	DWORD read = 0;
+
+	if (!::ReadFile(m_file, &m_buffer[0], static_cast<DWORD>(m_buffer.size()), &read, nullptr))
+		throw WCL::Win32Exception(::GetLastError(), Core::fmt(TXT("Failed to read the file '%s'"), m_filename.c_str()));
+
+	m_begin = 0;
+	m_end = read;
+	m_eof = (read == 0);
+
+	// Skip the UTF-8 byte order mark.
+	if ( (m_first) && (m_end >= 3) && (m_buffer[0] == '\xEF') && (m_buffer[1] == '\xBB') && (m_buffer[2] == '\xBF') )
+		m_begin = 3;
+
+	m_first = false;
+
+	return !m_eof;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Decode the UTF-8 bytes into the line.
+
+void LineReader::decode(const char* bytes, size_t length, tstring& line)
+{
+	line.erase();
+
+	if (length == 0)
+		return;
+
+#ifdef _UNICODE
+	line.resize(length);
+
+	const int chars = ::MultiByteToWideChar(CP_UTF8, 0, bytes, static_cast<int>(length), &line[0], static_cast<int>(length));
+
+	line.resize(chars);
+#else
+	m_wide.resize(length);
+
+	const int chars = ::MultiByteToWideChar(CP_UTF8, 0, bytes, static_cast<int>(length), &m_wide[0], static_cast<int>(length));
+
+	line.resize(chars * 2);
+
+	const int ansiChars = ::WideCharToMultiByte(CP_ACP, 0, &m_wide[0], chars, &line[0], static_cast<int>(line.size()), nullptr, nullptr);
+
+	line.resize(ansiChars);
+#endif
+}
@@ -0,0 +1,74 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   LineReader.hpp
+//! \brief  The LineReader class declaration.
+//! \author Chris Oldwood
+
+// Check for previous inclusion
+#ifndef APP_LINEREADER_HPP
+#define APP_LINEREADER_HPP
+
+#if _MSC_VER > 1000
+#pragma once
+#endif
+
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+//! Reads a UTF-8 text file a line at a time. The file is read in fixed size
+//! chunks so that files of any size can be read with a small, constant amount
+//! of memory. Plain ASCII files, such as redirected console output, are valid
+//! UTF-8 too. A leading byte order mark is skipped.
+
+class LineReader
+{
+public:
+	//! Constructor.
+	explicit LineReader(const tstring& filename);
+
+	//! Destructor.
+	~LineReader();
+
+	//! Read the next line, without its line terminator.
+	bool readLine(tstring& line);
+
+	//
+	// Constants.
+	//
+
+	//! The size of the chunks read from the file.
+	static const size_t BUFFER_SIZE = 256 * 1024;
+
+private:
+	typedef std::vector<char> Bytes;
+
+	//
+	// Members.
+	//
+	tstring		m_filename;	//!< The name of the file.
+	HANDLE		m_file;		//!< The file handle.
+	Bytes		m_buffer;	//!< The current chunk.
+	size_t		m_begin;	//!< The start of the unread bytes in the chunk.
+	size_t		m_end;		//!< The end of the bytes in the chunk.
+	bool		m_eof;		//!< Has the end of the file been reached?
+	bool		m_first;	//!< Is the first chunk yet to be read?
+	Bytes		m_partial;	//!< A line which spans chunks.
+#ifndef _UNICODE
+	std::vector<wchar_t> m_wide;	//!< The line decoded as UTF-16.
+#endif
+
+	//
+	// Internal methods.
+	//
+
+	//! Read the next chunk of the file.
+	bool readChunk();
+
+	//! Decode the UTF-8 bytes into the line.
+	void decode(const char* bytes, size_t length, tstring& line);
+
+	// NotCopyable.
+	LineReader(const LineReader&);
+	LineReader& operator=(const LineReader&);
+};
+
+#endif // APP_LINEREADER_HPP
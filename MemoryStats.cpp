@@ -0,0 +1,106 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   MemoryStats.cpp
+//! \brief  The allocation statistics reported by the query command.
+//! \author Chris Oldwood
+
+#include "Common.hpp"
+#include "MemoryStats.hpp"
+#include "AllocationCounter.hpp"
+#include <Core/StringUtils.hpp>
+#include <psapi.h>
+
+////////////////////////////////////////////////////////////////////////////////
+//! Constructor.
+
+CountingSource::CountingSource(ObjectSource& source, size_t& numObjects)
+	: m_source(source)
+	, m_numObjects(numObjects)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Fill the snapshot with the next object or heading.
+
+bool CountingSource::next(ObjectSnapshot& snapshot)
+{
+	AllocationScope scope(FETCH_STAGE);
+
+	if (!m_source.next(snapshot))
+		return false;
+
+	if (snapshot.m_isObject)
+		++m_numObjects;
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Move past the next object without copying its properties. A skipped object
+//! is not counted as it's never output.
+
+bool CountingSource::skip(ObjectSnapshot& snapshot)
+{
+	AllocationScope scope(FETCH_STAGE);
+
+	return m_source.skip(snapshot);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Stop reading the current result set.
+
+void CountingSource::endResultSet()
+{
+	m_source.endResultSet();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Get the peak working set (bytes) of the process.
+
+static uint64 getPeakWorkingSet()
+{
+	PROCESS_MEMORY_COUNTERS counters = { 0 };
+
+	counters.cb = sizeof(counters);
+
+	if (!::GetProcessMemoryInfo(::GetCurrentProcess(), &counters, sizeof(counters)))
+		return 0;
+
+	return counters.PeakWorkingSetSize;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Write the allocations made during each stage, the allocations per object and
+//! the peak working set to the stream.
+
+void writeMemoryStats(tostream& out, size_t numObjects)
+{
+	uint64 totalCount = 0;
+	uint64 totalBytes = 0;
+
+	out << std::endl;
+	out << TXT("Stage        Allocations            Bytes") << std::endl;
+	out << TXT("-----------  -----------  ---------------") << std::endl;
+
+	for (size_t i = 0; i != NUM_ALLOCATION_STAGES; ++i)
+	{
+		const AllocationStage stage = static_cast<AllocationStage>(i);
+		const AllocationStats stats = getAllocationStats(stage);
+
+		out << Core::fmt(TXT("%-11s  %11I64u  %15I64u"), getStageName(stage), stats.m_count, stats.m_bytes) << std::endl;
+
+		totalCount += stats.m_count;
+		totalBytes += stats.m_bytes;
+	}
+
+	out << Core::fmt(TXT("%-11s  %11I64u  %15I64u"), TXT("total"), totalCount, totalBytes) << std::endl;
+	out << std::endl;
+
+	if (numObjects != 0)
+	{
+		const double perObject = static_cast<double>(static_cast<int64>(totalCount)) / static_cast<double>(numObjects);
+
+		out << Core::fmt(TXT("Allocations per row: %.1f (%u rows)"), perObject, static_cast<unsigned>(numObjects)) << std::endl;
+	}
+
+	out << Core::fmt(TXT("Peak working set: %I64u KB"), getPeakWorkingSet() / 1024) << std::endl;
+}
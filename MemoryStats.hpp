@@ -0,0 +1,54 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   MemoryStats.hpp
+//! \brief  The allocation statistics reported by the query command.
+//! \author Chris Oldwood
+
+// Check for previous inclusion
+#ifndef APP_MEMORYSTATS_HPP
+#define APP_MEMORYSTATS_HPP
+
+#if _MSC_VER > 1000
+#pragma once
+#endif
+
+#include "FormattingPipeline.hpp"
+#include <Core/tiostream.hpp>
+
+////////////////////////////////////////////////////////////////////////////////
+//! A source which passes on the objects from another source and counts them.
+//! The allocations made whilst reading them are attributed to the fetch stage.
+
+class CountingSource : public ObjectSource
+{
+public:
+	//! Constructor.
+	CountingSource(ObjectSource& source, size_t& numObjects);
+
+	//! Fill the snapshot with the next object or heading.
+	virtual bool next(ObjectSnapshot& snapshot);
+
+	//! Move past the next object without copying its properties.
+	virtual bool skip(ObjectSnapshot& snapshot);
+
+	//! Stop reading the current result set.
+	virtual void endResultSet();
+
+private:
+	//
+	// Members.
+	//
+	ObjectSource&	m_source;		//!< The source of the objects.
+	size_t&			m_numObjects;	//!< The count of objects passed on.
+
+	// NotCopyable.
+	CountingSource(const CountingSource&);
+	CountingSource& operator=(const CountingSource&);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Write the allocations made during each stage, the allocations per object and
+// the peak working set to the stream.
+
+void writeMemoryStats(tostream& out, size_t numObjects);
+
+#endif // APP_MEMORYSTATS_HPP
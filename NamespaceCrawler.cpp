@@ -0,0 +1,144 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   NamespaceCrawler.cpp
+//! \brief  The NamespaceCrawler class definition.
+//! \author Chris Oldwood
+
+#include "Common.hpp"
+#include "NamespaceCrawler.hpp"
+#include "TaskPool.hpp"
+#include <WMI/Connection.hpp>
+#include <WMI/ObjectIterator.hpp>
+
+////////////////////////////////////////////////////////////////////////////////
+//! The task that enumerates a single namespace.
+
+class NamespaceCrawler::NamespaceTask : public Task
+{
+public:
+	//! Constructor.
+	NamespaceTask(NamespaceCrawler& crawler, const tstring& host, const tstring& nmspace)
+		: m_crawler(crawler)
+		, m_host(host)
+		, m_namespace(nmspace)
+	{
+	}
+
+	//! Execute the task.
+	virtual void execute(TaskPool& pool, size_t worker)
+	{
+		m_crawler.crawlNamespace(pool, worker, m_host, m_namespace);
+	}
+
+private:
+	//
+	// Members.
+	//
+	NamespaceCrawler&	m_crawler;		//!< The owning crawler.
+	tstring				m_host;			//!< The host to query.
+	tstring				m_namespace;	//!< The namespace to enumerate.
+
+	// NotCopyable.
+	NamespaceTask(const NamespaceTask&);
+	NamespaceTask& operator=(const NamespaceTask&);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! Constructor.
+
+NamespaceCrawler::NamespaceCrawler(const tstring& user, const tstring& password, bool listClasses)
+	: m_user(user)
+	, m_password(password)
+	, m_listClasses(listClasses)
+	, m_lock()
+	, m_inventory(nullptr)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Crawl the namespaces below the root on the hosts, appending the results to
+//! the inventory. A namespace that cannot be enumerated is normally recorded
+//! with its error, but one that fails in an unexpected way leaves no trace
+//! other than the count returned.
+
+size_t NamespaceCrawler::crawl(const Hostnames& hosts, const tstring& root, size_t numThreads, Inventory& inventory)
+{
+	TaskPool pool(numThreads);
+
+	for (Hostnames::const_iterator it = hosts.begin(); it != hosts.end(); ++it)
+		pool.submit(TaskPtr(new NamespaceTask(*this, *it, root)));
+
+	m_inventory = &inventory;
+
+	pool.run();
+
+	m_inventory = nullptr;
+
+	sortInventory(inventory);
+
+	return pool.numFailures();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Enumerate a single namespace, queuing any child namespaces.
+
+void NamespaceCrawler::crawlNamespace(TaskPool& pool, size_t worker, const tstring& host, const tstring& nmspace)
+{
+	typedef WMI::Object::PropertyNames PropertyNames;
+
+	NamespaceInfo info;
+
+	info.m_host = host;
+	info.m_name = nmspace;
+
+	try
+	{
+		WMI::Connection connection;
+
+		if (host == WMI::Connection::LOCALHOST)
+			connection.open(host, TXT(""), TXT(""), nmspace);
+		else
+			connection.open(host, m_user, m_password, nmspace);
+
+		WMI::ObjectIterator end;
+		WCL::Variant        value;
+
+		// Queue the child namespaces first so that idle workers can steal them
+		// whilst we enumerate the classes.
+		WMI::ObjectIterator it = connection.execQuery(TXT("SELECT Name FROM __NAMESPACE"));
+
+		for (; it != end; ++it)
+		{
+			(*it).getProperty(TXT("Name"), value);
+
+			const tstring child = nmspace + TXT("\\") + value.format();
+
+			pool.submit(TaskPtr(new NamespaceTask(*this, host, child)), worker);
+		}
+
+		if (m_listClasses)
+		{
+			PropertyNames names;
+
+			it = connection.execQuery(TXT("SELECT * FROM meta_class"));
+
+			for (; it != end; ++it)
+			{
+				WMI::Object object = *it;
+
+				names.clear();
+				object.getPropertyNames(names);
+				object.getProperty(TXT("__CLASS"), value);
+
+				info.m_classes.push_back(ClassInfo(value.format(), names.size()));
+			}
+		}
+	}
+	catch (const Core::Exception& e)
+	{
+		info.m_error = e.twhat();
+	}
+
+	AutoLock lock(m_lock);
+
+	m_inventory->push_back(info);
+}
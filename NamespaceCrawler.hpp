@@ -0,0 +1,58 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   NamespaceCrawler.hpp
+//! \brief  The NamespaceCrawler class declaration.
+//! \author Chris Oldwood
+
+// Check for previous inclusion
+#ifndef APP_NAMESPACECRAWLER_HPP
+#define APP_NAMESPACECRAWLER_HPP
+
+#if _MSC_VER > 1000
+#pragma once
+#endif
+
+#include "Inventory.hpp"
+#include "Hosts.hpp"
+#include "Threading.hpp"
+
+class TaskPool;
+
+////////////////////////////////////////////////////////////////////////////////
+//! Walks the tree of namespaces on one or more hosts, optionally listing the
+//! classes in each one. Each namespace is enumerated as a separate task on a
+//! work-stealing pool so that sibling namespaces, and hosts, are crawled
+//! concurrently with each worker holding one connection at a time.
+
+class NamespaceCrawler
+{
+public:
+	//! Constructor.
+	NamespaceCrawler(const tstring& user, const tstring& password, bool listClasses);
+
+	//! Crawl the namespaces below the root on the hosts, appending the results
+	//! to the inventory. Returns the number of namespaces that failed without
+	//! their result being recorded.
+	size_t crawl(const Hostnames& hosts, const tstring& root, size_t numThreads, Inventory& inventory);
+
+private:
+	//! The task that enumerates a single namespace.
+	class NamespaceTask;
+
+	//
+	// Members.
+	//
+	tstring			m_user;			//!< The login name for remote hosts.
+	tstring			m_password;		//!< The password for remote hosts.
+	bool			m_listClasses;	//!< Enumerate the classes too?
+	CriticalSection	m_lock;			//!< The lock for the results.
+	Inventory*		m_inventory;	//!< The results of the crawl.
+
+	//
+	// Internal methods.
+	//
+
+	//! Enumerate a single namespace, queuing any child namespaces.
+	void crawlNamespace(TaskPool& pool, size_t worker, const tstring& host, const tstring& nmspace);
+};
+
+#endif // APP_NAMESPACECRAWLER_HPP
@@ -0,0 +1,248 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   NamespacesCmd.cpp
+//! \brief  The NamespacesCmd class definition.
+//! \author Chris Oldwood
+
+#include "Common.hpp"
+#include "NamespacesCmd.hpp"
+#include "CmdLineArgs.hpp"
+#include <Core/CmdLineException.hpp>
+#include <Core/StringUtils.hpp>
+#include "Hosts.hpp"
+#include "NamespaceCrawler.hpp"
+#include <set>
+
+////////////////////////////////////////////////////////////////////////////////
+//! The table of command specific command line switches.
+
+static Core::CmdLineSwitch s_switches[] = 
+{
+	{ USAGE,		TXT("?"),	NULL,				Core::CmdLineSwitch::ONCE,	Core::CmdLineSwitch::NONE,		NULL,				TXT("Display the command syntax")						},
+	{ USAGE,		NULL,		TXT("help"),		Core::CmdLineSwitch::ONCE,	Core::CmdLineSwitch::NONE,		NULL,				TXT("Display the command syntax")						},
+	{ HOSTNAMES,	TXT("h"),	TXT("hosts"),		Core::CmdLineSwitch::ONCE,	Core::CmdLineSwitch::MULTIPLE,	TXT("hostname"),	TXT("Remote machines to query")							},
+	{ HOSTSFILE,	TXT("hf"),	TXT("hostsfile"),	Core::CmdLineSwitch::ONCE,	Core::CmdLineSwitch::SINGLE,	TXT("file"),		TXT("File with remote machines to query")				},
+	{ USER,			TXT("u"),	TXT("user"),		Core::CmdLineSwitch::ONCE,	Core::CmdLineSwitch::SINGLE,	TXT("login"),		TXT("The login name for remote machines")				},
+	{ PASSWORD,		TXT("p"),	TXT("password"),	Core::CmdLineSwitch::ONCE,	Core::CmdLineSwitch::SINGLE,	TXT("password"),	TXT("The password for remote machines")					},
+	{ SHOW_HOST,	TXT("sh"),	TXT("showhost"),	Core::CmdLineSwitch::ONCE,	Core::CmdLineSwitch::NONE,		NULL,				TXT("Display the hostname in the output")				},
+	{ NAMESPACE,	TXT("n"),	TXT("namespace"),	Core::CmdLineSwitch::ONCE,	Core::CmdLineSwitch::SINGLE,	TXT("namespace"),	TXT("The namespace to start from (default: root)")		},
+	{ THREADS,		TXT("th"),	TXT("threads"),		Core::CmdLineSwitch::ONCE,	Core::CmdLineSwitch::SINGLE,	TXT("count"),		TXT("The number of worker threads (default: 8)")		},
+	{ CACHE,		TXT("c"),	TXT("cache"),		Core::CmdLineSwitch::ONCE,	Core::CmdLineSwitch::SINGLE,	TXT("file"),		TXT("Reuse or save the results in a cache file")		},
+	{ REFRESH,		TXT("r"),	TXT("refresh"),		Core::CmdLineSwitch::ONCE,	Core::CmdLineSwitch::NONE,		NULL,				TXT("Ignore the cached results and crawl again")		},
+};
+static size_t s_switchCount = ARRAY_SIZE(s_switches);
+
+//! The default number of worker threads.
+static const size_t DEFAULT_THREADS = 8;
+
+//! The default namespace to start from.
+static const tchar* DEFAULT_NAMESPACE = TXT("root");
+
+////////////////////////////////////////////////////////////////////////////////
+//! Constructor.
+
+NamespacesCmd::NamespacesCmd(int argc, tchar* argv[])
+	: WCL::ConsoleCmd(s_switches, s_switches+s_switchCount, argc, argv, USAGE)
+	, m_listClasses((argc > 1) && (tstricmp(argv[1], TXT("classes")) == 0))
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Destructor.
+
+NamespacesCmd::~NamespacesCmd()
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Get the description of the command.
+
+const tchar* NamespacesCmd::getDescription()
+{
+	if (m_listClasses)
+		return TXT("List the classes, and their property counts, in each namespace");
+
+	return TXT("List the namespaces below a root namespace");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Get the expected command usage.
+
+const tchar* NamespacesCmd::getUsage()
+{
+	if (m_listClasses)
+		return TXT("USAGE: WMICmd classes [--namespace <namespace>] [--hosts <hostname> ...] [--user <login> --password <password>] [--cache <file>]");
+
+	return TXT("USAGE: WMICmd namespaces [--namespace <namespace>] [--hosts <hostname> ...] [--user <login> --password <password>] [--cache <file>]");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! The implementation of the command.
+
+int NamespacesCmd::doExecute(tostream& out, tostream& err)
+{
+	typedef std::set<tstring> HostSet;
+
+	// Validate and extract the command line arguments.
+	if ( (m_parser.isSwitchSet(USER) && !m_parser.isSwitchSet(PASSWORD))
+	  || (m_parser.isSwitchSet(PASSWORD) && !m_parser.isSwitchSet(USER)) )
+		throw Core::CmdLineException(TXT("Both --user and --password must be specified together"));
+
+	if (m_parser.isSwitchSet(REFRESH) && !m_parser.isSwitchSet(CACHE))
+		throw Core::CmdLineException(TXT("--refresh can only be used with --cache"));
+
+	tstring		user       = m_parser.getSwitchValue(USER);
+	tstring		password   = m_parser.getSwitchValue(PASSWORD);
+	bool		showHost   = m_parser.isSwitchSet(SHOW_HOST);
+	tstring		root       = DEFAULT_NAMESPACE;
+	size_t		numThreads = DEFAULT_THREADS;
+	Hostnames	hostnames  = getHostnames(m_parser, HOSTNAMES, HOSTSFILE);
+	tstring		cacheFile  = m_parser.getSwitchValue(CACHE);
+
+	if (m_parser.isSwitchSet(NAMESPACE))
+		root = m_parser.getSwitchValue(NAMESPACE);
+
+	if (m_parser.isSwitchSet(THREADS))
+		numThreads = Core::parse<size_t>(m_parser.getSwitchValue(THREADS));
+
+	if (numThreads == 0)
+		throw Core::CmdLineException(TXT("The number of --threads must be at least 1"));
+
+	// Load the cache, even when refreshing, so that the results for the hosts
+	// that aren't crawled again are kept. A host is covered if an earlier
+	// crawl included the root namespace, as it will have included its
+	// children, and nothing failed.
+	Inventory cached;
+	HostSet   cachedHosts;
+
+	if (!cacheFile.empty() && (::GetFileAttributes(cacheFile.c_str()) != INVALID_FILE_ATTRIBUTES))
+	{
+		loadInventory(cacheFile, cached);
+
+		if (!m_parser.isSwitchSet(REFRESH))
+		{
+			HostSet failedHosts;
+
+			for (Inventory::const_iterator it = cached.begin(); it != cached.end(); ++it)
+			{
+				if (tstricmp(it->m_name.c_str(), root.c_str()) == 0)
+					cachedHosts.insert(it->m_host);
+
+				if (!it->m_error.empty())
+					failedHosts.insert(it->m_host);
+			}
+
+			for (HostSet::const_iterator it = failedHosts.begin(); it != failedHosts.end(); ++it)
+				cachedHosts.erase(*it);
+		}
+	}
+
+	// Crawl only the hosts we don't have results for.
+	Hostnames uncached;
+
+	for (Hostnames::const_iterator it = hostnames.begin(); it != hostnames.end(); ++it)
+	{
+		if (cachedHosts.find(*it) == cachedHosts.end())
+			uncached.push_back(*it);
+	}
+
+	Inventory inventory;
+	size_t    numFailures = 0;
+
+	if (!uncached.empty())
+	{
+		// The classes are always listed when caching so that the same cache
+		// can serve both commands.
+		NamespaceCrawler crawler(user, password, m_listClasses || !cacheFile.empty());
+
+		numFailures = crawler.crawl(uncached, root, numThreads, inventory);
+	}
+
+	// A host that failed keeps its previous results in the cache, if it had
+	// any, so that it's crawled again next time.
+	const HostSet crawledHosts(uncached.begin(), uncached.end());
+	HostSet       failedHosts;
+
+	if (numFailures != 0)
+		failedHosts = crawledHosts;
+
+	for (Inventory::const_iterator it = inventory.begin(); it != inventory.end(); ++it)
+	{
+		if (!it->m_error.empty())
+		{
+			failedHosts.insert(it->m_host);
+			++numFailures;
+		}
+	}
+
+	if (!cacheFile.empty() && !uncached.empty())
+	{
+		Inventory merged;
+
+		for (Inventory::const_iterator it = cached.begin(); it != cached.end(); ++it)
+		{
+			if ( (crawledHosts.find(it->m_host) == crawledHosts.end()) || (failedHosts.find(it->m_host) != failedHosts.end()) )
+				merged.push_back(*it);
+		}
+
+		for (Inventory::const_iterator it = inventory.begin(); it != inventory.end(); ++it)
+		{
+			if (failedHosts.find(it->m_host) == failedHosts.end())
+				merged.push_back(*it);
+		}
+
+		sortInventory(merged);
+
+		saveInventory(cacheFile, merged);
+	}
+
+	// Any cached results for the hosts crawled again have been superseded.
+	for (Inventory::const_iterator it = cached.begin(); it != cached.end(); ++it)
+	{
+		if (crawledHosts.find(it->m_host) == crawledHosts.end())
+			inventory.push_back(*it);
+	}
+
+	sortInventory(inventory);
+
+	// Display the results.
+	const tstring prefix = root + TXT("\\");
+	HostSet       requested(hostnames.begin(), hostnames.end());
+	tstring       lastHost;
+
+	for (Inventory::const_iterator it = inventory.begin(); it != inventory.end(); ++it)
+	{
+		const NamespaceInfo& info = *it;
+
+		if ( (requested.find(info.m_host) == requested.end())
+		  || ((tstricmp(info.m_name.c_str(), root.c_str()) != 0) && (tstricmp(info.m_name.substr(0, prefix.length()).c_str(), prefix.c_str()) != 0)) )
+			continue;
+
+		if (showHost && (info.m_host != lastHost))
+		{
+			out << std::endl;
+			out << TXT("Host: ") << info.m_host << std::endl;
+			out << std::endl;
+
+			lastHost = info.m_host;
+		}
+
+		if (!info.m_error.empty())
+		{
+			err << TXT("WARNING: Failed to enumerate ") << info.m_name << TXT(" on ") << info.m_host << TXT(": ") << info.m_error << std::endl;
+			continue;
+		}
+
+		if (!m_listClasses)
+		{
+			out << info.m_name << TXT('\n');
+			continue;
+		}
+
+		for (Classes::const_iterator classIter = info.m_classes.begin(); classIter != info.m_classes.end(); ++classIter)
+			out << info.m_name << TXT(':') << classIter->m_name << TXT(' ') << classIter->m_numProperties << TXT('\n');
+	}
+
+	out.flush();
+
+	return (numFailures == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,49 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   NamespacesCmd.hpp
+//! \brief  The NamespacesCmd class declaration.
+//! \author Chris Oldwood
+
+// Check for previous inclusion
+#ifndef APP_NAMESPACESCMD_HPP
+#define APP_NAMESPACESCMD_HPP
+
+#if _MSC_VER > 1000
+#pragma once
+#endif
+
+#include <WCL/ConsoleCmd.hpp>
+
+////////////////////////////////////////////////////////////////////////////////
+//! The command used to list the namespaces, or classes, on one or more hosts.
+//! The same class implements both the "namespaces" and "classes" commands.
+
+class NamespacesCmd : public WCL::ConsoleCmd
+{
+public:
+	//! Constructor.
+	NamespacesCmd(int argc, tchar* argv[]);
+
+	//! Destructor.
+	virtual ~NamespacesCmd();
+	
+private:
+	//
+	// Members.
+	//
+	bool	m_listClasses;	//!< Is this the "classes" command?
+
+	//
+	// Command methods.
+	//
+
+	//! Get the description of the command.
+	virtual const tchar* getDescription();
+
+	//! Get the expected command usage.
+	virtual const tchar* getUsage();
+
+	//! The implementation of the command.
+	virtual int doExecute(tostream& out, tostream& err);
+};
+
+#endif // APP_NAMESPACESCMD_HPP
@@ -0,0 +1,407 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   ParallelQuerySource.cpp
+//! \brief  The ParallelQuerySource class definition.
+//! \author Chris Oldwood
+
+#include "Common.hpp"
+#include "ParallelQuerySource.hpp"
+#include "AllocationCounter.hpp"
+#include <Core/RuntimeException.hpp>
+#include <Core/StringUtils.hpp>
+#include <WCL/AutoCom.hpp>
+#include <algorithm>
+
+////////////////////////////////////////////////////////////////////////////////
+// Constants.
+
+//! The label at the start of an error heading.
+static const tchar ERROR_LABEL[] = TXT("Error: ");
+
+////////////////////////////////////////////////////////////////////////////////
+//! Constructor.
+
+ParallelQuerySource::HostThread::HostThread(ParallelQuerySource& source)
+	: m_source(source)
+	, m_space(Event::AUTO_RESET)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! The thread's body.
+
+void ParallelQuerySource::HostThread::run()
+{
+	AllocationScope scope(FETCH_STAGE);
+
+	m_source.queryHosts(m_space);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Constructor. One thread is created for each host that can be in flight at
+//! once, up to the limit's maximum.
+
+ParallelQuerySource::ParallelQuerySource(const HostSourceFactoryPtr& sources, const Hostnames& hostnames,
+                                         const HostAnnotations& annotations, const AdaptiveLimit& limit,
+                                         size_t maxThreads, bool showHost, bool applyFormatting)
+	: m_sources(sources)
+	, m_hostnames(hostnames)
+	, m_showHost(showHost)
+	, m_applyFormatting(applyFormatting)
+	, m_window(maxThreads * HOSTS_AHEAD_PER_THREAD)
+	, m_lock()
+	, m_scheduler(hostnames, annotations, limit)
+	, m_results()
+	, m_work(std::max<size_t>(hostnames.size(), 1))
+	, m_changed(Event::AUTO_RESET)
+	, m_threads()
+	, m_started()
+	, m_nextHost(0)
+	, m_numBuffered(0)
+	, m_maxBuffered(0)
+	, m_stopping(false)
+{
+	ASSERT(maxThreads != 0);
+
+	for (size_t i = 0; i != hostnames.size(); ++i)
+	{
+		m_results.push_back(new HostResult());
+		m_results.back()->m_done = false;
+		m_results.back()->m_ending = false;
+		m_results.back()->m_waiting = nullptr;
+	}
+
+	try
+	{
+		const size_t numThreads = std::min(maxThreads, hostnames.size());
+
+		for (size_t i = 0; i != numThreads; ++i)
+		{
+			m_threads.push_back(new HostThread(*this));
+			m_threads.back()->start();
+		}
+	}
+	catch (...)
+	{
+		m_work.close();
+
+		for (HostThreads::iterator it = m_threads.begin(); it != m_threads.end(); ++it)
+		{
+			(*it)->join();
+			delete *it;
+		}
+
+		for (HostResults::iterator it = m_results.begin(); it != m_results.end(); ++it)
+			delete *it;
+
+		throw;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Destructor. Any hosts in flight are abandoned, including any waiting for
+//! space, and the hosts still queued are skipped.
+
+ParallelQuerySource::~ParallelQuerySource()
+{
+	{
+		AutoLock lock(m_lock);
+
+		m_stopping = true;
+
+		for (HostResults::iterator it = m_results.begin(); it != m_results.end(); ++it)
+		{
+			if ((*it)->m_waiting != nullptr)
+			{
+				(*it)->m_waiting->set();
+				(*it)->m_waiting = nullptr;
+			}
+		}
+	}
+
+	m_work.close();
+
+	for (HostThreads::iterator it = m_threads.begin(); it != m_threads.end(); ++it)
+	{
+		(*it)->join();
+		delete *it;
+	}
+
+	for (HostResults::iterator it = m_results.begin(); it != m_results.end(); ++it)
+		delete *it;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Fill the snapshot with the next object or heading. The hosts are passed on
+//! in order and so this waits until the next host has some output or has
+//! finished. A host that's waiting for space is woken once half its buffer has
+//! been passed on.
+
+bool ParallelQuerySource::next(ObjectSnapshot& snapshot)
+{
+	for (;;)
+	{
+		startHosts();
+
+		if (m_nextHost == m_results.size())
+			return false;
+
+		HostResult& result = *m_results[m_nextHost];
+
+		{
+			AutoLock lock(m_lock);
+
+			if (!result.m_snapshots.empty())
+			{
+				snapshot.swap(result.m_snapshots.front());
+				result.m_snapshots.pop_front();
+				--m_numBuffered;
+
+				if ( (result.m_waiting != nullptr) && (result.m_snapshots.size() <= (MAX_HOST_SNAPSHOTS / 2)) )
+				{
+					result.m_waiting->set();
+					result.m_waiting = nullptr;
+				}
+
+				return true;
+			}
+
+			if (result.m_done)
+			{
+				++m_nextHost;
+				continue;
+			}
+		}
+
+		m_changed.wait();
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Stop reading the current result set. The objects of it that are already
+//! buffered are dropped and, if the host hasn't moved on to its next result
+//! set yet, the host is told to end its query and drop any more it reads.
+
+void ParallelQuerySource::endResultSet()
+{
+	AutoLock lock(m_lock);
+
+	if (m_nextHost == m_results.size())
+		return;
+
+	HostResult& result = *m_results[m_nextHost];
+
+	while (!result.m_snapshots.empty() && result.m_snapshots.front().m_isObject)
+	{
+		result.m_snapshots.pop_front();
+		--m_numBuffered;
+	}
+
+	if ( (result.m_waiting != nullptr) && (result.m_snapshots.size() <= (MAX_HOST_SNAPSHOTS / 2)) )
+	{
+		result.m_waiting->set();
+		result.m_waiting = nullptr;
+	}
+
+	if (result.m_snapshots.empty() && !result.m_done)
+		result.m_ending = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! The host thread's main loop. Each host is timed from when its connection
+//! is requested until its last object has been snapshotted, and that latency
+//! is fed back to the scheduler. A host that fails has the error appended to
+//! its output, after a host heading if it never got as far as outputting one.
+
+void ParallelQuerySource::queryHosts(Event& space)
+{
+	WCL::AutoCom com(COINIT_MULTITHREADED);
+
+	size_t host = 0;
+
+	while (m_work.pop(host))
+	{
+		HostResult& result = *m_results[host];
+		const DWORD start = ::GetTickCount();
+		size_t      numSnapshots = 0;
+
+		try
+		{
+			queryHost(host, result, space, numSnapshots);
+		}
+		catch (const Core::Exception& e)
+		{
+			appendFailure(host, result, e.twhat(), (numSnapshots == 0));
+		}
+		catch (const std::exception& e)
+		{
+			appendFailure(host, result, Core::fmt(TXT("%hs"), e.what()), (numSnapshots == 0));
+		}
+
+		const DWORD latency = ::GetTickCount() - start;
+
+		{
+			AutoLock lock(m_lock);
+
+			m_scheduler.finish(host, latency);
+			result.m_done = true;
+		}
+
+		m_changed.set();
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Query a single host and buffer its objects. This gives up early if the
+//! source is being destroyed. The host's source is told when the consumer has
+//! ended the current result set.
+
+void ParallelQuerySource::queryHost(size_t host, HostResult& result, Event& space, size_t& numSnapshots)
+{
+	{
+		AutoLock lock(m_lock);
+
+		if (m_stopping)
+			return;
+	}
+
+	ObjectSourcePtr source = m_sources->createSource(m_hostnames[host]);
+	ObjectSnapshot  snapshot;
+
+	while (source->next(snapshot))
+	{
+		bool ending = false;
+
+		if (!push(host, result, snapshot, space, ending))
+			return;
+
+		if (ending)
+			source->endResultSet();
+		else
+			++numSnapshots;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Buffer the host's snapshot, waiting for space if it's full. A host is only
+//! made to wait whilst every host before it has been started, as otherwise the
+//! host whose output is next might be held back by the caps on the hosts in
+//! flight, which could never finish. An object from a result set that has been
+//! ended is dropped instead, and the caller told so that it can end the query.
+//! Returns false if the source is being destroyed.
+
+bool ParallelQuerySource::push(size_t host, HostResult& result, ObjectSnapshot& snapshot, Event& space, bool& ending)
+{
+	for (;;)
+	{
+		{
+			AutoLock lock(m_lock);
+
+			if (m_stopping)
+				return false;
+
+			if (result.m_ending)
+			{
+				if (snapshot.m_isObject)
+				{
+					ending = true;
+					return true;
+				}
+
+				result.m_ending = false;
+			}
+
+			if ( (result.m_snapshots.size() < MAX_HOST_SNAPSHOTS) || (m_scheduler.firstPending() < host) )
+			{
+				append(host, result, snapshot);
+				return true;
+			}
+
+			result.m_waiting = &space;
+		}
+
+		space.wait();
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Buffer the host's snapshot. The caller must hold the lock.
+
+void ParallelQuerySource::append(size_t host, HostResult& result, ObjectSnapshot& snapshot)
+{
+	const bool wasEmpty = result.m_snapshots.empty();
+
+	result.m_snapshots.push_back(ObjectSnapshot());
+	result.m_snapshots.back().swap(snapshot);
+
+	m_maxBuffered = std::max(m_maxBuffered, ++m_numBuffered);
+
+	if (wasEmpty && (host == m_nextHost))
+		m_changed.set();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Buffer the headings that report why a host failed. The error heading names
+//! the host when the host heading isn't shown. These are always buffered, even
+//! when the host is full, as there are at most two of them.
+
+void ParallelQuerySource::appendFailure(size_t host, HostResult& result, const tstring& error, bool addHostHeading)
+{
+	const tstring& hostname = m_hostnames[host];
+	ObjectSnapshot snapshot;
+
+	snapshot.m_isObject = false;
+
+	AutoLock lock(m_lock);
+
+	if (addHostHeading)
+	{
+		if (m_showHost)
+		{
+			if (m_applyFormatting)
+				snapshot.m_heading += TXT('\n');
+
+			snapshot.m_heading += TXT("Host: ") + hostname + TXT("\n");
+		}
+
+		append(host, result, snapshot);
+
+		snapshot.m_isObject = false;
+	}
+
+	snapshot.m_heading.erase();
+
+	if (m_applyFormatting)
+		snapshot.m_heading += TXT('\n');
+
+	snapshot.m_heading += ERROR_LABEL;
+
+	if (!m_showHost)
+		snapshot.m_heading += hostname + TXT(": ");
+
+	snapshot.m_heading += error + TXT("\n");
+
+	append(host, result, snapshot);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Hand any hosts that the scheduler will now allow to the threads. Only the
+//! hosts within the window beyond the next one can be started.
+
+void ParallelQuerySource::startHosts()
+{
+	m_started.clear();
+
+	{
+		AutoLock lock(m_lock);
+
+		const size_t end = std::min(m_nextHost + m_window, m_hostnames.size());
+		size_t       host = 0;
+
+		while (m_scheduler.tryStart(host, end))
+			m_started.push_back(host);
+	}
+
+	// The queue can hold every host and so this never blocks.
+	for (HostIndices::const_iterator it = m_started.begin(); it != m_started.end(); ++it)
+		m_work.push(*it);
+}
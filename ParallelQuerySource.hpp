@@ -0,0 +1,145 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   ParallelQuerySource.hpp
+//! \brief  The ParallelQuerySource class declaration.
+//! \author Chris Oldwood
+
+// Check for previous inclusion
+#ifndef APP_PARALLELQUERYSOURCE_HPP
+#define APP_PARALLELQUERYSOURCE_HPP
+
+#if _MSC_VER > 1000
+#pragma once
+#endif
+
+#include "QuerySource.hpp"
+#include "HostScheduler.hpp"
+#include "BoundedQueue.hpp"
+#include <deque>
+
+////////////////////////////////////////////////////////////////////////////////
+//! The source of objects for the query command when there are many hosts. The
+//! hosts are queried concurrently on a set of threads, with a HostScheduler
+//! deciding how many are in flight at once. Each host's objects are snapshotted
+//! on its thread and passed on in the same order as querying them one at a
+//! time. The host whose output is next is streamed, whilst the hosts behind it
+//! buffer a limited number of snapshots and then wait for their turn. Only a
+//! window of hosts beyond the next one are started so that hosts which finish
+//! quickly cannot pile up behind a slow one. A host that fails is reported by
+//! an error heading and the rest of the hosts are still queried.
+
+class ParallelQuerySource : public ObjectSource
+{
+public:
+	//! Constructor.
+	ParallelQuerySource(const HostSourceFactoryPtr& sources, const Hostnames& hostnames, const HostAnnotations& annotations,
+	                    const AdaptiveLimit& limit, size_t maxThreads, bool showHost, bool applyFormatting);
+
+	//! Destructor.
+	virtual ~ParallelQuerySource();
+
+	//! Fill the snapshot with the next object or heading.
+	virtual bool next(ObjectSnapshot& snapshot);
+
+	//! Stop reading the current result set.
+	virtual void endResultSet();
+
+	//! Get the most snapshots that were buffered at once.
+	size_t maxBuffered() const;
+
+	//
+	// Constants.
+	//
+
+	//! The most snapshots a host buffers before it waits for its turn.
+	static const size_t MAX_HOST_SNAPSHOTS = 256;
+
+	//! The number of hosts, per thread, that can be started ahead of the one
+	//! whose output is next.
+	static const size_t HOSTS_AHEAD_PER_THREAD = 2;
+
+private:
+	//! The results of querying a single host.
+	struct HostResult
+	{
+		std::deque<ObjectSnapshot>	m_snapshots;	//!< The objects and headings not yet passed on.
+		bool						m_done;			//!< Has the host finished?
+		bool						m_ending;		//!< Should the current result set be cut short?
+		Event*						m_waiting;		//!< Signalled when there's space, if the host is waiting.
+	};
+
+	//! A thread that queries hosts.
+	class HostThread : public Thread
+	{
+	public:
+		//! Constructor.
+		explicit HostThread(ParallelQuerySource& source);
+
+	private:
+		//! The thread's body.
+		virtual void run();
+
+		ParallelQuerySource&	m_source;	//!< The owning source.
+		Event					m_space;	//!< Signalled when the host can buffer again.
+	};
+
+	typedef BoundedQueue<size_t> WorkQueue;
+	typedef std::vector<HostResult*> HostResults;
+	typedef std::vector<HostThread*> HostThreads;
+	typedef std::vector<size_t> HostIndices;
+
+	//
+	// Members.
+	//
+	HostSourceFactoryPtr	m_sources;			//!< Creates the source for each host.
+	Hostnames				m_hostnames;		//!< The hosts to query.
+	bool					m_showHost;			//!< Output a heading for each host?
+	bool					m_applyFormatting;	//!< Format the output?
+	size_t					m_window;			//!< The most hosts started ahead of the next one.
+	CriticalSection			m_lock;				//!< The lock for the scheduler and results.
+	HostScheduler			m_scheduler;		//!< Decides when each host is queried.
+	HostResults				m_results;			//!< The results for each host.
+	WorkQueue				m_work;				//!< The hosts to be queried.
+	Event					m_changed;			//!< Signalled when the next host has output or a host finishes.
+	HostThreads				m_threads;			//!< The threads querying hosts.
+	HostIndices				m_started;			//!< The hosts just started.
+	size_t					m_nextHost;			//!< The next host to pass on.
+	size_t					m_numBuffered;		//!< The number of snapshots buffered.
+	size_t					m_maxBuffered;		//!< The most snapshots buffered at once.
+	bool					m_stopping;			//!< Should the threads give up?
+
+	//
+	// Internal methods.
+	//
+
+	//! The host thread's main loop.
+	void queryHosts(Event& space);
+
+	//! Query a single host and buffer its objects.
+	void queryHost(size_t host, HostResult& result, Event& space, size_t& numSnapshots);
+
+	//! Buffer the host's snapshot, waiting for space if it's full.
+	bool push(size_t host, HostResult& result, ObjectSnapshot& snapshot, Event& space, bool& ending);
+
+	//! Buffer the host's snapshot.
+	void append(size_t host, HostResult& result, ObjectSnapshot& snapshot);
+
+	//! Buffer the headings that report why a host failed.
+	void appendFailure(size_t host, HostResult& result, const tstring& error, bool addHostHeading);
+
+	//! Hand any hosts that can now be started to the threads.
+	void startHosts();
+
+	// NotCopyable.
+	ParallelQuerySource(const ParallelQuerySource&);
+	ParallelQuerySource& operator=(const ParallelQuerySource&);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! Get the most snapshots that were buffered at once, across all the hosts.
+
+inline size_t ParallelQuerySource::maxBuffered() const
+{
+	return m_maxBuffered;
+}
+
+#endif // APP_PARALLELQUERYSOURCE_HPP
@@ -0,0 +1,400 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   PerfCounters.cpp
+//! \brief  Helper functions for cooking raw performance counter values.
+//! \author Chris Oldwood
+
+#include "Common.hpp"
+#include "PerfCounters.hpp"
+#include <WCL/ComException.hpp>
+#include <WMI/Connection.hpp>
+#include <Core/StringUtils.hpp>
+#include <wbemidl.h>
+#include <winperf.h>
+#include <math.h>
+#include <algorithm>
+
+//! The properties which hold the timestamps and frequencies of each time base.
+static const tchar* TIME_BASE_PROPERTIES[] =
+{
+	TXT("Timestamp_PerfTime"),		TXT("Frequency_PerfTime"),
+	TXT("Timestamp_Sys100NS"),		TXT("Frequency_Sys100NS"),
+	TXT("Timestamp_Object"),		TXT("Frequency_Object"),
+};
+
+//! The suffix of the property which holds a counter's base value.
+static const tchar* BASE_SUFFIX = TXT("_Base");
+
+//! The scale used to round the cooked values to 3 decimal places.
+static const double ROUNDING = 1000.0;
+
+////////////////////////////////////////////////////////////////////////////////
+//! Set the security on a proxy to use the credentials, if any.
+
+static HRESULT setProxySecurity(IUnknown* proxy, COAUTHIDENTITY* identity)
+{
+	return ::CoSetProxyBlanket(proxy, RPC_C_AUTHN_DEFAULT, RPC_C_AUTHZ_DEFAULT, COLE_DEFAULT_PRINCIPAL,
+	                           RPC_C_AUTHN_LEVEL_CALL, RPC_C_IMP_LEVEL_IMPERSONATE, identity, EOAC_NONE);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Read the CounterType qualifier of every property of the class definition.
+
+static HRESULT readQualifiers(IWbemClassObject* object, CounterTypes& types)
+{
+	HRESULT result = object->BeginEnumeration(WBEM_FLAG_NONSYSTEM_ONLY);
+
+	while (SUCCEEDED(result))
+	{
+		// The variant takes ownership of the name.
+		WCL::Variant name;
+
+		result = object->Next(0, &V_BSTR(&name), nullptr, nullptr, nullptr);
+
+		if (result == WBEM_S_NO_MORE_DATA)
+		{
+			result = S_OK;
+			break;
+		}
+
+		if (FAILED(result))
+			break;
+
+		V_VT(&name) = VT_BSTR;
+
+		IWbemQualifierSet* qualifiers = nullptr;
+
+		result = object->GetPropertyQualifierSet(V_BSTR(&name), &qualifiers);
+
+		if (SUCCEEDED(result))
+		{
+			WCL::Variant type;
+
+			// Only the counters have a type.
+			if (SUCCEEDED(qualifiers->Get(L"CounterType", 0, &type, nullptr)) && (type.type() == VT_I4))
+				types[name.format()] = static_cast<DWORD>(V_I4(&type));
+
+			qualifiers->Release();
+		}
+	}
+
+	object->EndEnumeration();
+
+	return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Read the CounterType qualifier of every property of a class. The WMI library
+//! doesn't expose qualifiers and so the schema is read over its own connection
+//! using the COM interfaces directly.
+
+void readCounterTypes(const tstring& host, const tstring& user, const tstring& password,
+                      const tstring& className, CounterTypes& types)
+{
+	const bool useCredentials = !user.empty() && (host != WMI::Connection::LOCALHOST);
+
+	// The domain, if any, is passed separately to the login name.
+	const size_t  separator = user.find_first_of(TXT('\\'));
+	const tstring login = (separator != tstring::npos) ? user.substr(separator+1) : user;
+	const tstring domain = (separator != tstring::npos) ? user.substr(0, separator) : TXT("");
+
+	WCL::Variant path(Core::fmt(TXT("\\\\%s\\root\\cimv2"), host.c_str()).c_str());
+	WCL::Variant loginValue(login.c_str());
+	WCL::Variant domainValue(domain.c_str());
+	WCL::Variant passwordValue(password.c_str());
+	WCL::Variant userValue(user.c_str());
+	WCL::Variant classValue(className.c_str());
+
+	COAUTHIDENTITY identity = { 0 };
+
+	identity.User           = reinterpret_cast<USHORT*>(V_BSTR(&loginValue));
+	identity.UserLength     = ::SysStringLen(V_BSTR(&loginValue));
+	identity.Domain         = reinterpret_cast<USHORT*>(V_BSTR(&domainValue));
+	identity.DomainLength   = ::SysStringLen(V_BSTR(&domainValue));
+	identity.Password       = reinterpret_cast<USHORT*>(V_BSTR(&passwordValue));
+	identity.PasswordLength = ::SysStringLen(V_BSTR(&passwordValue));
+	identity.Flags          = SEC_WINNT_AUTH_IDENTITY_UNICODE;
+
+	IWbemLocator*     locator = nullptr;
+	IWbemServices*    services = nullptr;
+	IWbemClassObject* object = nullptr;
+
+	HRESULT result = ::CoCreateInstance(CLSID_WbemLocator, nullptr, CLSCTX_INPROC_SERVER, IID_IWbemLocator,
+	                                    reinterpret_cast<void**>(&locator));
+
+	if (SUCCEEDED(result))
+	{
+		result = locator->ConnectServer(V_BSTR(&path), (useCredentials) ? V_BSTR(&userValue) : nullptr,
+		                                (useCredentials) ? V_BSTR(&passwordValue) : nullptr,
+		                                nullptr, 0, nullptr, nullptr, &services);
+	}
+
+	if (SUCCEEDED(result))
+		result = setProxySecurity(services, (useCredentials) ? &identity : nullptr);
+
+	if (SUCCEEDED(result))
+		result = services->GetObject(V_BSTR(&classValue), WBEM_FLAG_RETURN_WBEM_COMPLETE, nullptr, &object, nullptr);
+
+	if (SUCCEEDED(result))
+		result = readQualifiers(object, types);
+
+	if (object != nullptr)
+		object->Release();
+
+	if (services != nullptr)
+		services->Release();
+
+	if (locator != nullptr)
+		locator->Release();
+
+	if (FAILED(result))
+	{
+		const tstring message = Core::fmt(TXT("Failed to read the counter types of '%s' on '%s'"), className.c_str(), host.c_str());
+
+		throw WCL::ComException(result, message.c_str());
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Get the difference between two samples of a counter. A 32-bit counter may
+//! have wrapped but a 64-bit one going backwards means it has been reset.
+
+static uint64 getDelta(DWORD type, uint64 previous, uint64 current)
+{
+	if ((type & PERF_SIZE_LARGE) == 0)
+		return static_cast<uint32>(static_cast<uint32>(current) - static_cast<uint32>(previous));
+
+	return (current >= previous) ? (current - previous) : 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Divide the values, treating an empty interval or base as a zero result.
+
+static double ratio(double numerator, double denominator)
+{
+	return (denominator != 0.0) ? (numerator / denominator) : 0.0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Calculate the displayable value of a counter from two consecutive samples,
+//! as described by the counter's type. The formulas are those used by the
+//! Win32_PerfFormattedData classes. Returns false if the type isn't one that
+//! can be cooked.
+
+bool cookCounter(DWORD type, const CounterValue& previous, const CounterValue& current, double& result)
+{
+	const double value = static_cast<double>(getDelta(type, previous.m_value, current.m_value));
+	const double base = static_cast<double>(getDelta(PERF_SIZE_LARGE, previous.m_base, current.m_base));
+	const double time = static_cast<double>(getDelta(PERF_SIZE_LARGE, previous.m_time, current.m_time));
+	const double frequency = static_cast<double>(current.m_frequency);
+
+	switch (type)
+	{
+		case PERF_COUNTER_RAWCOUNT:
+		case PERF_COUNTER_RAWCOUNT_HEX:
+		case PERF_COUNTER_LARGE_RAWCOUNT:
+		case PERF_COUNTER_LARGE_RAWCOUNT_HEX:
+			result = static_cast<double>(current.m_value);
+			break;
+
+		case PERF_RAW_FRACTION:
+		case PERF_LARGE_RAW_FRACTION:
+			result = ratio(100.0 * current.m_value, static_cast<double>(current.m_base));
+			break;
+
+		case PERF_COUNTER_COUNTER:
+		case PERF_COUNTER_BULK_COUNT:
+		case PERF_SAMPLE_COUNTER:
+			result = ratio(value * frequency, time);
+			break;
+
+		case PERF_COUNTER_TIMER:
+		case PERF_100NSEC_TIMER:
+		case PERF_OBJ_TIME_TIMER:
+			result = ratio(100.0 * value, time);
+			break;
+
+		case PERF_COUNTER_TIMER_INV:
+		case PERF_100NSEC_TIMER_INV:
+			result = (time != 0.0) ? (100.0 * (1.0 - (value / time))) : 0.0;
+			break;
+
+		case PERF_COUNTER_MULTI_TIMER:
+		case PERF_100NSEC_MULTI_TIMER:
+			result = ratio(ratio(100.0 * value, time), static_cast<double>(current.m_base));
+			break;
+
+		case PERF_COUNTER_MULTI_TIMER_INV:
+		case PERF_100NSEC_MULTI_TIMER_INV:
+			result = 100.0 * (static_cast<double>(current.m_base) - ratio(value, time));
+			break;
+
+		case PERF_PRECISION_SYSTEM_TIMER:
+		case PERF_PRECISION_100NS_TIMER:
+		case PERF_PRECISION_OBJECT_TIMER:
+		case PERF_SAMPLE_FRACTION:
+			result = ratio(100.0 * value, base);
+			break;
+
+		case PERF_AVERAGE_TIMER:
+			result = ratio(ratio(value, frequency), base);
+			break;
+
+		case PERF_AVERAGE_BULK:
+			result = ratio(value, base);
+			break;
+
+		case PERF_COUNTER_DELTA:
+		case PERF_COUNTER_LARGE_DELTA:
+			result = value;
+			break;
+
+		case PERF_COUNTER_QUEUELEN_TYPE:
+		case PERF_COUNTER_LARGE_QUEUELEN_TYPE:
+		case PERF_COUNTER_100NS_QUEUELEN_TYPE:
+		case PERF_COUNTER_OBJ_TIME_QUEUELEN_TYPE:
+			result = ratio(value, time);
+			break;
+
+		case PERF_ELAPSED_TIME:
+			result = ratio(static_cast<double>(getDelta(PERF_SIZE_LARGE, current.m_value, current.m_time)), frequency);
+			break;
+
+		default:
+			return false;
+	}
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Find a property by name. Returns the number of properties if it's missing.
+
+static size_t findProperty(const WMI::Object::PropertyNames& names, const tstring& name)
+{
+	for (size_t i = 0; i != names.size(); ++i)
+	{
+		if (names[i] == name)
+			return i;
+	}
+
+	return names.size();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Try and get an unsigned integer from a counter value. WMI returns the
+//! 32-bit counters as signed integers (VT_I4) and the 64-bit counters as
+//! strings (VT_BSTR), which are parsed in place.
+
+static bool tryGetUInt64(const WCL::Variant& value, uint64& result)
+{
+	switch (value.type())
+	{
+		case VT_I4:		result = static_cast<uint32>(V_I4(&value));		return true;
+		case VT_UI4:	result = V_UI4(&value);							return true;
+		case VT_I8:		result = static_cast<uint64>(V_I8(&value));		return true;
+		case VT_UI8:	result = V_UI8(&value);							return true;
+		case VT_BSTR:	break;
+		default:		return false;
+	}
+
+	const wchar_t* text = V_BSTR(&value);
+	wchar_t*       end = nullptr;
+
+	if ( (text == nullptr) || (*text == L'\0') )
+		return false;
+
+	result = _wcstoui64(text, &end, 10);
+
+	return (*end == L'\0');
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Try and get the raw values of a counter from an object.
+
+static bool tryGetCounterValue(DWORD type, const ObjectSnapshot& object, size_t index, const size_t timeBase[], CounterValue& counter)
+{
+	const size_t end = object.m_names.size();
+
+	// Choose the timestamp and frequency for the counter's time base.
+	size_t timeIndex = 0;
+
+	if ((type & PERF_TIMER_100NS) != 0)
+		timeIndex = 2;
+	else if ((type & PERF_OBJECT_TIMER) != 0)
+		timeIndex = 4;
+
+	const size_t base = findProperty(object.m_names, object.m_names[index] + BASE_SUFFIX);
+
+	counter.m_base = 0;
+	counter.m_time = 0;
+	counter.m_frequency = 0;
+
+	if ( (base != end) && !tryGetUInt64(object.m_values[base], counter.m_base) )
+		return false;
+
+	if ( (timeBase[timeIndex] != end) && !tryGetUInt64(object.m_values[timeBase[timeIndex]], counter.m_time) )
+		return false;
+
+	if ( (timeBase[timeIndex+1] != end) && !tryGetUInt64(object.m_values[timeBase[timeIndex+1]], counter.m_frequency) )
+		return false;
+
+	return tryGetUInt64(object.m_values[index], counter.m_value);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Replace the raw counters of an object with their cooked values, using the
+//! previous sample of the same object. The base counters, which aren't meant
+//! to be displayed, and the timestamps are removed and any other properties
+//! are copied as is, as is any counter whose type can't be cooked. Returns
+//! false if the samples don't have the same properties.
+
+bool cookObject(const CounterTypes& types, const ObjectSnapshot& previous, const ObjectSnapshot& current, ObjectSnapshot& cooked)
+{
+	const WMI::Object::PropertyNames& names = current.m_names;
+
+	if (previous.m_names != names)
+		return false;
+
+	size_t timeBase[ARRAY_SIZE(TIME_BASE_PROPERTIES)];
+
+	for (size_t i = 0; i != ARRAY_SIZE(TIME_BASE_PROPERTIES); ++i)
+		timeBase[i] = findProperty(names, TIME_BASE_PROPERTIES[i]);
+
+	cooked.m_heading.erase();
+	cooked.m_isObject = true;
+	cooked.m_names.clear();
+	cooked.m_values.clear();
+
+	for (size_t i = 0; i != names.size(); ++i)
+	{
+		if (std::find(timeBase, timeBase+ARRAY_SIZE(timeBase), i) != timeBase+ARRAY_SIZE(timeBase))
+			continue;
+
+		CounterTypes::const_iterator it = types.find(names[i]);
+
+		if ( (it != types.end()) && ((it->second & PERF_DISPLAY_NOSHOW) != 0) )
+			continue;
+
+		CounterValue previousValue;
+		CounterValue currentValue;
+		double       result = 0.0;
+
+		cooked.m_names.push_back(names[i]);
+
+		if ( (it != types.end()) && tryGetCounterValue(it->second, previous, i, timeBase, previousValue)
+		  && tryGetCounterValue(it->second, current, i, timeBase, currentValue)
+		  && cookCounter(it->second, previousValue, currentValue, result) )
+		{
+			cooked.m_values.push_back(WCL::Variant());
+
+			V_VT(&cooked.m_values.back()) = VT_R8;
+			V_R8(&cooked.m_values.back()) = floor((result * ROUNDING) + 0.5) / ROUNDING;
+		}
+		else
+		{
+			cooked.m_values.push_back(current.m_values[i]);
+		}
+	}
+
+	return true;
+}
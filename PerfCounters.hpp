@@ -0,0 +1,54 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   PerfCounters.hpp
+//! \brief  Helper functions for cooking raw performance counter values.
+//! \author Chris Oldwood
+
+// Check for previous inclusion
+#ifndef APP_PERFCOUNTERS_HPP
+#define APP_PERFCOUNTERS_HPP
+
+#if _MSC_VER > 1000
+#pragma once
+#endif
+
+#include "FormattingPipeline.hpp"
+#include <map>
+
+//! The CounterType qualifier of each counter property, keyed by name.
+typedef std::map<tstring, DWORD> CounterTypes;
+
+////////////////////////////////////////////////////////////////////////////////
+//! The raw values needed to cook a single counter from one sample.
+
+struct CounterValue
+{
+	uint64	m_value;		//!< The counter's raw value.
+	uint64	m_base;			//!< The value of its base counter, if any.
+	uint64	m_time;			//!< The timestamp for the counter's time base.
+	uint64	m_frequency;	//!< The ticks per second of the time base.
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Read the CounterType qualifier of every property of a class. The schema is
+// read over its own connection as the qualifiers aren't part of the objects
+// returned by a query.
+
+void readCounterTypes(const tstring& host, const tstring& user, const tstring& password,
+                      const tstring& className, CounterTypes& types);
+
+////////////////////////////////////////////////////////////////////////////////
+// Calculate the displayable value of a counter from two consecutive samples,
+// as described by the counter's type. Returns false if the type isn't one that
+// can be cooked.
+
+bool cookCounter(DWORD type, const CounterValue& previous, const CounterValue& current, double& result);
+
+////////////////////////////////////////////////////////////////////////////////
+// Replace the raw counters of an object with their cooked values, using the
+// previous sample of the same object. The base counters and timestamps are
+// removed and any other properties are copied as is. Returns false if the
+// samples don't have the same properties.
+
+bool cookObject(const CounterTypes& types, const ObjectSnapshot& previous, const ObjectSnapshot& current, ObjectSnapshot& cooked);
+
+#endif // APP_PERFCOUNTERS_HPP
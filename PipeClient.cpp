@@ -0,0 +1,147 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   PipeClient.cpp
+//! \brief  The client side of the query server protocol.
+//! \author Chris Oldwood
+
+#include "Common.hpp"
+#include "PipeClient.hpp"
+#include <WCL/Win32Exception.hpp>
+#include <Core/RuntimeException.hpp>
+#include <Core/StringUtils.hpp>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+// Constants.
+
+//! How long (ms) to wait for a busy server to accept the connection.
+static const DWORD CONNECT_TIMEOUT = 30 * 1000;
+
+//! The short and long names of the query switches whose value is a path.
+static const tchar* PATH_SWITCHES[] =
+{
+	TXT("hf"),	TXT("hostsfile"),
+	TXT("qf"),	TXT("query-file"),
+	TXT("of"),	TXT("output-file"),
+	TXT("od"),	TXT("output-dir"),
+	TXT("jn"),	TXT("journal"),
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! Open a connection to the server, waiting for it to become free if all its
+//! listeners are busy.
+
+static HANDLE connectToServer(const tstring& pipePath)
+{
+	for (;;)
+	{
+		HANDLE pipe = ::CreateFile(pipePath.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, 0, NULL);
+
+		if (pipe != INVALID_HANDLE_VALUE)
+			return pipe;
+
+		DWORD error = ::GetLastError();
+
+		if ( (error != ERROR_PIPE_BUSY) || !::WaitNamedPipe(pipePath.c_str(), CONNECT_TIMEOUT) )
+			throw WCL::Win32Exception(error, Core::fmt(TXT("Failed to connect to the server on '%s'"), pipePath.c_str()));
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Forward the command line to a resident query server, copying the output it
+//! streams back to our output streams. Returns the command's exit code.
+
+int forwardCommand(const tstring& pipeName, const RequestArgs& args, tostream& out, tostream& err)
+{
+	PipeHandle pipe(connectToServer(formatPipePath(pipeName)));
+	Payload    payload;
+
+	encodeRequest(args, payload);
+	writeFrame(pipe.get(), REQUEST_FRAME, (!payload.empty()) ? &payload[0] : nullptr, payload.size());
+
+	FrameType type;
+
+	while (readFrame(pipe.get(), type, payload))
+	{
+		const tchar* text = (!payload.empty()) ? reinterpret_cast<const tchar*>(&payload[0]) : TXT("");
+		const size_t length = payload.size() / sizeof(tchar);
+
+		if (type == OUTPUT_FRAME)
+		{
+			out.write(text, length);
+		}
+		else if (type == ERROR_FRAME)
+		{
+			err.write(text, length);
+		}
+		else if ( (type == EXIT_CODE_FRAME) && (payload.size() == sizeof(int32)) )
+		{
+			out.flush();
+			err.flush();
+
+			return *reinterpret_cast<const int32*>(&payload[0]);
+		}
+		else
+		{
+			throw Core::RuntimeException(Core::fmt(TXT("Invalid frame received from the server: %d"), type));
+		}
+	}
+
+	throw Core::RuntimeException(TXT("The server closed the connection unexpectedly"));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Check if the argument is a switch whose value is a path.
+
+static bool isPathSwitch(const tstring& arg)
+{
+	const tchar* name = arg.c_str();
+
+	if (*name == TXT('/'))
+		++name;
+	else if (*name == TXT('-'))
+		name += (*(name+1) == TXT('-')) ? 2 : 1;
+	else
+		return false;
+
+	for (size_t i = 0; i != ARRAY_SIZE(PATH_SWITCHES); ++i)
+	{
+		if (tstricmp(name, PATH_SWITCHES[i]) == 0)
+			return true;
+	}
+
+	return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Get the full path of a file or folder relative to the current folder.
+
+static tstring getFullPathName(const tstring& path)
+{
+	const DWORD length = ::GetFullPathName(path.c_str(), 0, nullptr, nullptr);
+
+	if (length == 0)
+		throw WCL::Win32Exception(::GetLastError(), Core::fmt(TXT("Failed to determine the full path of '%s'"), path.c_str()));
+
+	std::vector<tchar> buffer(length);
+
+	if (::GetFullPathName(path.c_str(), length, &buffer[0], nullptr) == 0)
+		throw WCL::Win32Exception(::GetLastError(), Core::fmt(TXT("Failed to determine the full path of '%s'"), path.c_str()));
+
+	return &buffer[0];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Replace the value of each switch that names a file or folder with its full
+//! path, as the server resolves relative paths against its own working folder.
+
+void makePathsAbsolute(RequestArgs& args)
+{
+	for (size_t i = 0; (i+1) < args.size(); ++i)
+	{
+		if (isPathSwitch(args[i]))
+		{
+			++i;
+			args[i] = getFullPathName(args[i]);
+		}
+	}
+}
@@ -0,0 +1,28 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   PipeClient.hpp
+//! \brief  The client side of the query server protocol.
+//! \author Chris Oldwood
+
+// Check for previous inclusion
+#ifndef APP_PIPECLIENT_HPP
+#define APP_PIPECLIENT_HPP
+
+#if _MSC_VER > 1000
+#pragma once
+#endif
+
+#include "PipeProtocol.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+// Forward the command line to a resident query server, copying the output it
+// streams back to our output streams. Returns the command's exit code.
+
+int forwardCommand(const tstring& pipeName, const RequestArgs& args, tostream& out, tostream& err);
+
+////////////////////////////////////////////////////////////////////////////////
+// Replace the value of each switch that names a file or folder with its full
+// path, as the server resolves relative paths against its own working folder.
+
+void makePathsAbsolute(RequestArgs& args);
+
+#endif // APP_PIPECLIENT_HPP
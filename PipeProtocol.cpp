@@ -0,0 +1,234 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   PipeProtocol.cpp
+//! \brief  The framed protocol used between the client and the query server.
+//! \author Chris Oldwood
+
+#include "Common.hpp"
+#include "PipeProtocol.hpp"
+#include "Threading.hpp"
+#include <WCL/Win32Exception.hpp>
+#include <Core/RuntimeException.hpp>
+#include <Core/StringUtils.hpp>
+#include <algorithm>
+
+////////////////////////////////////////////////////////////////////////////////
+// Constants.
+
+//! The name of the pipe used when none is specified.
+const tchar* DEFAULT_PIPE_NAME = TXT("WMICmd");
+
+//! The size of the frame header.
+static const size_t HEADER_SIZE = sizeof(uint32) + sizeof(byte);
+
+//! The largest payload we're prepared to accept.
+static const size_t MAX_PAYLOAD_SIZE = 16 * 1024 * 1024;
+
+////////////////////////////////////////////////////////////////////////////////
+//! Read or write an exact number of bytes. The pipe may have been opened for
+//! overlapped I/O and so we always wait for the transfer to complete.
+
+static bool transfer(HANDLE pipe, void* buffer, size_t size, bool write)
+{
+	Event  done(Event::MANUAL_RESET);
+	byte*  data = static_cast<byte*>(buffer);
+	size_t remaining = size;
+
+	while (remaining != 0)
+	{
+		OVERLAPPED overlapped = { 0 };
+		DWORD      count = static_cast<DWORD>(remaining);
+		DWORD      transferred = 0;
+
+		overlapped.hEvent = done.handle();
+
+		BOOL result = (write) ? ::WriteFile(pipe, data, count, nullptr, &overlapped)
+		                      : ::ReadFile(pipe, data, count, nullptr, &overlapped);
+
+		if (!result && (::GetLastError() != ERROR_IO_PENDING))
+			return false;
+
+		if (!::GetOverlappedResult(pipe, &overlapped, &transferred, TRUE) || (transferred == 0))
+			return false;
+
+		data += transferred;
+		remaining -= transferred;
+	}
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Format the full path of a local named pipe.
+
+tstring formatPipePath(const tstring& pipeName)
+{
+	return TXT("\\\\.\\pipe\\") + pipeName;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Write a single frame to the pipe.
+
+void writeFrame(HANDLE pipe, FrameType type, const void* data, size_t size)
+{
+	ASSERT(size <= MAX_PAYLOAD_SIZE);
+
+	byte header[HEADER_SIZE];
+
+	*reinterpret_cast<uint32*>(header) = static_cast<uint32>(size);
+	header[sizeof(uint32)] = static_cast<byte>(type);
+
+	if (!transfer(pipe, header, HEADER_SIZE, true)
+	 || ((size != 0) && !transfer(pipe, const_cast<void*>(data), size, true)))
+		throw WCL::Win32Exception(::GetLastError(), TXT("Failed to write to the pipe"));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Read a single frame from the pipe. Returns false if the other end closed
+//! the pipe cleanly before the start of the frame.
+
+bool readFrame(HANDLE pipe, FrameType& type, Payload& payload)
+{
+	byte header[HEADER_SIZE];
+
+	if (!transfer(pipe, header, HEADER_SIZE, false))
+	{
+		DWORD error = ::GetLastError();
+
+		if ( (error == ERROR_BROKEN_PIPE) || (error == ERROR_PIPE_NOT_CONNECTED) || (error == ERROR_SUCCESS) )
+			return false;
+
+		throw WCL::Win32Exception(error, TXT("Failed to read from the pipe"));
+	}
+
+	const size_t size = *reinterpret_cast<const uint32*>(header);
+
+	if (size > MAX_PAYLOAD_SIZE)
+		throw Core::RuntimeException(Core::fmt(TXT("Invalid frame size received: %u"), static_cast<uint32>(size)));
+
+	type = static_cast<FrameType>(header[sizeof(uint32)]);
+	payload.resize(size);
+
+	if ( (size != 0) && !transfer(pipe, &payload[0], size, false) )
+		throw WCL::Win32Exception(::GetLastError(), TXT("Failed to read from the pipe"));
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Encode the command line arguments as a request payload.
+
+void encodeRequest(const RequestArgs& args, Payload& payload)
+{
+	tstring request;
+
+	for (RequestArgs::const_iterator it = args.begin(); it != args.end(); ++it)
+	{
+		request += *it;
+		request += TXT('\0');
+	}
+
+	const byte* begin = reinterpret_cast<const byte*>(request.data());
+	const byte* end = begin + Core::numBytes<tchar>(request.length());
+
+	payload.assign(begin, end);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Decode the command line arguments from a request payload.
+
+void decodeRequest(const Payload& payload, RequestArgs& args)
+{
+	if ((payload.size() % sizeof(tchar)) != 0)
+		throw Core::RuntimeException(TXT("Invalid request received"));
+
+	if (payload.empty())
+		return;
+
+	const tchar* begin = reinterpret_cast<const tchar*>(&payload[0]);
+	const tchar* end = begin + (payload.size() / sizeof(tchar));
+
+	while (begin != end)
+	{
+		const tchar* arg = std::find(begin, end, TXT('\0'));
+
+		if (arg == end)
+			throw Core::RuntimeException(TXT("Invalid request received"));
+
+		args.push_back(tstring(begin, arg));
+
+		begin = arg + 1;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Constructor.
+
+FrameStreamBuf::FrameStreamBuf(HANDLE pipe, FrameType type)
+	: m_pipe(pipe)
+	, m_type(type)
+{
+	setp(m_buffer, m_buffer + BUFFER_SIZE);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Destructor.
+
+FrameStreamBuf::~FrameStreamBuf()
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Send the buffer and then buffer the character.
+
+FrameStreamBuf::int_type FrameStreamBuf::overflow(int_type c)
+{
+	send();
+
+	if (!traits_type::eq_int_type(c, traits_type::eof()))
+	{
+		*pptr() = traits_type::to_char_type(c);
+		pbump(1);
+	}
+
+	return traits_type::not_eof(c);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Send any buffered text.
+
+int FrameStreamBuf::sync()
+{
+	send();
+
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Send the buffered text as a frame.
+
+void FrameStreamBuf::send()
+{
+	const size_t length = pptr() - pbase();
+
+	if (length != 0)
+		writeFrame(m_pipe, m_type, pbase(), Core::numBytes<tchar>(length));
+
+	setp(m_buffer, m_buffer + BUFFER_SIZE);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Constructor.
+
+PipeHandle::PipeHandle(HANDLE handle)
+	: m_handle(handle)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Destructor.
+
+PipeHandle::~PipeHandle()
+{
+	if (m_handle != INVALID_HANDLE_VALUE)
+		::CloseHandle(m_handle);
+}
@@ -0,0 +1,149 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   PipeProtocol.hpp
+//! \brief  The framed protocol used between the client and the query server.
+//! \author Chris Oldwood
+
+// Check for previous inclusion
+#ifndef APP_PIPEPROTOCOL_HPP
+#define APP_PIPEPROTOCOL_HPP
+
+#if _MSC_VER > 1000
+#pragma once
+#endif
+
+#include <vector>
+#include <streambuf>
+
+////////////////////////////////////////////////////////////////////////////////
+// Every message is sent as a frame which consists of a 32-bit payload length,
+// a single byte frame type and then the payload. The client sends a single
+// REQUEST frame with the command line arguments separated by NULs. The server
+// streams back any number of OUTPUT and ERROR frames containing text followed
+// by a final EXIT_CODE frame with the 32-bit result of the command.
+
+//! The type of frame.
+enum FrameType
+{
+	REQUEST_FRAME	= 1,	//!< The command line to execute.
+	OUTPUT_FRAME	= 2,	//!< Text written to the standard output stream.
+	ERROR_FRAME		= 3,	//!< Text written to the standard error stream.
+	EXIT_CODE_FRAME	= 4,	//!< The command's exit code.
+};
+
+//! The contents of a frame.
+typedef std::vector<byte> Payload;
+
+//! The command line arguments sent in a request.
+typedef std::vector<tstring> RequestArgs;
+
+//! The name of the pipe used when none is specified.
+extern const tchar* DEFAULT_PIPE_NAME;
+
+////////////////////////////////////////////////////////////////////////////////
+// Format the full path of a local named pipe.
+
+tstring formatPipePath(const tstring& pipeName);
+
+////////////////////////////////////////////////////////////////////////////////
+// Write a single frame to the pipe.
+
+void writeFrame(HANDLE pipe, FrameType type, const void* data, size_t size);
+
+////////////////////////////////////////////////////////////////////////////////
+// Read a single frame from the pipe. Returns false if the other end closed
+// the pipe cleanly before the start of the frame.
+
+bool readFrame(HANDLE pipe, FrameType& type, Payload& payload);
+
+////////////////////////////////////////////////////////////////////////////////
+// Encode the command line arguments as a request payload.
+
+void encodeRequest(const RequestArgs& args, Payload& payload);
+
+////////////////////////////////////////////////////////////////////////////////
+// Decode the command line arguments from a request payload.
+
+void decodeRequest(const Payload& payload, RequestArgs& args);
+
+////////////////////////////////////////////////////////////////////////////////
+//! A stream buffer that sends the text written to it down a pipe as frames of
+//! a given type. A frame is sent whenever the buffer fills or is flushed.
+
+class FrameStreamBuf : public std::basic_streambuf<tchar>
+{
+public:
+	//! Constructor.
+	FrameStreamBuf(HANDLE pipe, FrameType type);
+
+	//! Destructor.
+	virtual ~FrameStreamBuf();
+
+protected:
+	//
+	// std::basic_streambuf methods.
+	//
+
+	//! Send the buffer and then buffer the character.
+	virtual int_type overflow(int_type c);
+
+	//! Send any buffered text.
+	virtual int sync();
+
+private:
+	//! The number of characters buffered before a frame is sent.
+	static const size_t BUFFER_SIZE = 4096;
+
+	//
+	// Members.
+	//
+	HANDLE		m_pipe;					//!< The pipe to write to.
+	FrameType	m_type;					//!< The type of frame to send.
+	tchar		m_buffer[BUFFER_SIZE];	//!< The unsent text.
+
+	//
+	// Internal methods.
+	//
+
+	//! Send the buffered text as a frame.
+	void send();
+
+	// NotCopyable.
+	FrameStreamBuf(const FrameStreamBuf&);
+	FrameStreamBuf& operator=(const FrameStreamBuf&);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! Helper class to own a pipe handle.
+
+class PipeHandle
+{
+public:
+	//! Constructor.
+	explicit PipeHandle(HANDLE handle);
+
+	//! Destructor.
+	~PipeHandle();
+
+	//! Get the handle.
+	HANDLE get() const;
+
+private:
+	//
+	// Members.
+	//
+	HANDLE	m_handle;	//!< The owned handle.
+
+	// NotCopyable.
+	PipeHandle(const PipeHandle&);
+	PipeHandle& operator=(const PipeHandle&);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! Get the handle.
+
+inline HANDLE PipeHandle::get() const
+{
+	return m_handle;
+}
+
+#endif // APP_PIPEPROTOCOL_HPP
@@ -0,0 +1,94 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   Queries.cpp
+//! \brief  Helper functions for building the list of queries to execute.
+//! \author Chris Oldwood
+
+#include "Common.hpp"
+#include "Queries.hpp"
+#include <Core/TextFileIterator.hpp>
+#include <Core/StringUtils.hpp>
+
+////////////////////////////////////////////////////////////////////////////////
+//! Parse a single query which may be prefixed with a name, e.g. "Disks: select
+//! * from Win32_LogicalDisk". An unnamed query is labelled with its text.
+
+NamedQuery parseQuery(const tstring& line)
+{
+	NamedQuery query;
+
+	query.m_text = line;
+
+	// The name is a single word; a ':' elsewhere could be part of the query,
+	// e.g. "select * from Win32_LogicalDisk where DeviceID='C:'".
+	size_t colon = line.find_first_of(TXT(':'));
+	size_t space = line.find_first_of(TXT(" \t'\""));
+
+	if ( (colon != tstring::npos) && (colon != 0) && (colon < space) )
+	{
+		query.m_name = line.substr(0, colon);
+		query.m_text = line.substr(colon+1);
+
+		Core::trim(query.m_text);
+	}
+
+	if (query.m_name.empty())
+		query.m_name = query.m_text;
+
+	return query;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Read the list of queries from a text file, one per line. Empty lines are
+//! ignored as are lines which start with the # character.
+
+Queries readQueryFile(const tstring& filename)
+{
+	Queries queries;
+
+	Core::TextFileIterator end;
+	Core::TextFileIterator it(filename);
+
+	for (; it != end; ++it)
+	{
+		tstring line(*it);
+
+		Core::trim(line);
+
+		// A '#' can appear in a query and so only whole line comments are allowed.
+		if (line.empty() || (line[0] == TXT('#')))
+			continue;
+
+		queries.push_back(parseQuery(line));
+	}
+
+	return queries;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Get the name of the class a query selects from, e.g. "Win32_Process" for
+//! "select Name from Win32_Process where ...". Returns an empty string if the
+//! query has no FROM clause.
+
+tstring getQueryClass(const tstring& query)
+{
+	const tchar* whitespace = TXT(" \t\r\n");
+
+	size_t begin = query.find_first_not_of(whitespace);
+
+	while (begin != tstring::npos)
+	{
+		size_t end = query.find_first_of(whitespace, begin);
+
+		if (end == tstring::npos)
+			break;
+
+		const bool isFrom = (tstricmp(query.substr(begin, end-begin).c_str(), TXT("from")) == 0);
+
+		begin = query.find_first_not_of(whitespace, end);
+
+		if (isFrom && (begin != tstring::npos))
+			return query.substr(begin, query.find_first_of(whitespace, begin) - begin);
+	}
+
+	return TXT("");
+}
@@ -0,0 +1,47 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   Queries.hpp
+//! \brief  Helper functions for building the list of queries to execute.
+//! \author Chris Oldwood
+
+// Check for previous inclusion
+#ifndef APP_QUERIES_HPP
+#define APP_QUERIES_HPP
+
+#if _MSC_VER > 1000
+#pragma once
+#endif
+
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+//! A WQL query and the name used to label its results.
+
+struct NamedQuery
+{
+	tstring	m_name;		//!< The label for the results.
+	tstring	m_text;		//!< The WQL query.
+};
+
+//! The list of queries.
+typedef std::vector<NamedQuery> Queries;
+
+////////////////////////////////////////////////////////////////////////////////
+// Parse a single query which may be prefixed with a name, e.g. "Disks: select
+// * from Win32_LogicalDisk". An unnamed query is labelled with its text.
+
+NamedQuery parseQuery(const tstring& line);
+
+////////////////////////////////////////////////////////////////////////////////
+// Read the list of queries from a text file, one per line. Empty lines are
+// ignored as are lines which start with the # character.
+
+Queries readQueryFile(const tstring& filename);
+
+////////////////////////////////////////////////////////////////////////////////
+// Get the name of the class a query selects from, e.g. "Win32_Process" for
+// "select Name from Win32_Process where ...". Returns an empty string if the
+// query has no FROM clause.
+
+tstring getQueryClass(const tstring& query);
+
+#endif // APP_QUERIES_HPP
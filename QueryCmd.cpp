@@ -8,15 +8,24 @@
 #include "CmdLineArgs.hpp"
 #include <Core/CmdLineException.hpp>
 #include <Core/tiostream.hpp>
-#include <WMI/Connection.hpp>
-#include <WMI/ObjectIterator.hpp>
-#include "Format.hpp"
-#include <Core/TextFileIterator.hpp>
-#include <sstream>
-#include <iomanip>
+#include "Hosts.hpp"
+#include "AsyncFileWriter.hpp"
+#include "Utf8StreamBuf.hpp"
+#include "QuerySource.hpp"
+#include "FormattingPipeline.hpp"
+#include "SamplingSource.hpp"
+#include "ParallelQuerySource.hpp"
+#include "CookingSource.hpp"
+#include "TableSource.hpp"
+#include "HostFiles.hpp"
+#include "Journal.hpp"
+#include "MemoryStats.hpp"
+#include "FilterSource.hpp"
+#include "AllocationCounter.hpp"
 #include <Core/StringUtils.hpp>
 #include <limits>
 #include <algorithm>
+#include <set>
 
 ////////////////////////////////////////////////////////////////////////////////
 //! The table of command specific command line switches.
@@ -34,14 +43,119 @@ static Core::CmdLineSwitch s_switches[] =
 	{ NO_FORMAT,	TXT("nf"),	TXT("noformat"),	Core::CmdLineSwitch::ONCE,	Core::CmdLineSwitch::NONE,		NULL,				TXT("Display raw values instead")						},
 	{ ALIGN,		TXT("a"),	TXT("align"),		Core::CmdLineSwitch::ONCE,	Core::CmdLineSwitch::NONE,		NULL,				TXT("Align the output")									},
 	{ TOP,			TXT("t"),	TXT("top"),			Core::CmdLineSwitch::ONCE,	Core::CmdLineSwitch::SINGLE,	TXT("count"),		TXT("Limit results to first N items")					},
+	{ OUTPUT_FILE,	TXT("of"),	TXT("output-file"),	Core::CmdLineSwitch::ONCE,	Core::CmdLineSwitch::SINGLE,	TXT("file"),		TXT("Write the output to a UTF-8 file instead")			},
+	{ COMPRESS,		TXT("z"),	TXT("compress"),	Core::CmdLineSwitch::ONCE,	Core::CmdLineSwitch::SINGLE,	TXT("gzip"),		TXT("Compress the output file")							},
+	{ LEVEL,		TXT("l"),	TXT("level"),		Core::CmdLineSwitch::ONCE,	Core::CmdLineSwitch::SINGLE,	TXT("1-9"),			TXT("The compression level (default: 6)")				},
+	{ THREADS,		TXT("th"),	TXT("threads"),		Core::CmdLineSwitch::ONCE,	Core::CmdLineSwitch::SINGLE,	TXT("count"),		TXT("The number of formatting threads (0 = none)")		},
+	{ QUERY_FILE,	TXT("qf"),	TXT("query-file"),	Core::CmdLineSwitch::ONCE,	Core::CmdLineSwitch::SINGLE,	TXT("file"),		TXT("The file with a list of queries to execute")		},
+	{ MAX_HOSTS,	TXT("mh"),	TXT("max-hosts"),	Core::CmdLineSwitch::ONCE,	Core::CmdLineSwitch::SINGLE,	TXT("count"),		TXT("The most hosts queried at once (default: 32)")		},
+	{ TARGET_LATENCY,TXT("tl"),	TXT("target-latency"),	Core::CmdLineSwitch::ONCE,	Core::CmdLineSwitch::SINGLE,	TXT("ms"),			TXT("The p95 time per host to aim for (default: 10000)")	},
+	{ SAMPLE,		TXT("sa"),	TXT("sample"),		Core::CmdLineSwitch::ONCE,	Core::CmdLineSwitch::SINGLE,	TXT("count"),		TXT("Output a random sample of N objects")				},
+	{ SEED,			TXT("se"),	TXT("seed"),		Core::CmdLineSwitch::ONCE,	Core::CmdLineSwitch::SINGLE,	TXT("number"),		TXT("The seed used to choose the sample")				},
+	{ SAMPLE_SCOPE,	TXT("ss"),	TXT("sample-scope"),	Core::CmdLineSwitch::ONCE,	Core::CmdLineSwitch::SINGLE,	TXT("host|all"),	TXT("Sample each host's results or all of them")		},
+	{ COOK,			TXT("ck"),	TXT("cook"),		Core::CmdLineSwitch::ONCE,	Core::CmdLineSwitch::NONE,		NULL,				TXT("Calculate the values of raw performance counters")	},
+	{ INTERVAL,		TXT("iv"),	TXT("interval"),	Core::CmdLineSwitch::ONCE,	Core::CmdLineSwitch::SINGLE,	TXT("ms"),			TXT("The time between samples (default: 1000)")			},
+	{ REPEAT,		TXT("rp"),	TXT("repeat"),		Core::CmdLineSwitch::ONCE,	Core::CmdLineSwitch::SINGLE,	TXT("count"),		TXT("The number of cooked samples (0 = until stopped)")	},
+	{ TABLE,		TXT("tb"),	TXT("table"),		Core::CmdLineSwitch::ONCE,	Core::CmdLineSwitch::NONE,		NULL,				TXT("Output the results as a table")					},
+	{ TABLE_SAMPLE,	TXT("ts"),	TXT("table-sample"),	Core::CmdLineSwitch::ONCE,	Core::CmdLineSwitch::SINGLE,	TXT("rows"),		TXT("The rows used to size the columns (0 = all)")		},
+	{ MAX_WIDTH,	TXT("mw"),	TXT("max-width"),	Core::CmdLineSwitch::ONCE,	Core::CmdLineSwitch::SINGLE,	TXT("chars"),		TXT("The widest a column can be (default: 40)")			},
+	{ WRAP,			TXT("w"),	TXT("wrap"),		Core::CmdLineSwitch::ONCE,	Core::CmdLineSwitch::NONE,		NULL,				TXT("Wrap, rather than truncate, wide values")			},
+	{ OUTPUT_DIR,	TXT("od"),	TXT("output-dir"),	Core::CmdLineSwitch::ONCE,	Core::CmdLineSwitch::SINGLE,	TXT("folder"),		TXT("Write each host's output to its own UTF-8 file")	},
+	{ MAX_OPEN_FILES,TXT("mo"),	TXT("max-open-files"),	Core::CmdLineSwitch::ONCE,	Core::CmdLineSwitch::SINGLE,	TXT("count"),		TXT("The most host files written at once (default: 64)")	},
+	{ JOURNAL,		TXT("jn"),	TXT("journal"),		Core::CmdLineSwitch::ONCE,	Core::CmdLineSwitch::SINGLE,	TXT("file"),		TXT("Record each host in a journal as it completes")	},
+	{ RESUME,		TXT("rs"),	TXT("resume"),		Core::CmdLineSwitch::ONCE,	Core::CmdLineSwitch::NONE,		NULL,				TXT("Skip the hosts already completed OK in the journal")	},
+	{ MEMSTATS,		TXT("ms"),	TXT("memstats"),	Core::CmdLineSwitch::ONCE,	Core::CmdLineSwitch::NONE,		NULL,				TXT("Report the memory allocated by each stage")		},
+	{ FILTER,		TXT("fl"),	TXT("filter"),		Core::CmdLineSwitch::ONCE,	Core::CmdLineSwitch::SINGLE,	TXT("expr"),		TXT("Only output the objects that match the expression")	},
 };
 static size_t s_switchCount = ARRAY_SIZE(s_switches);
 
+//! The initial size of the buffer used to format an object's properties.
+static const size_t INITIAL_BUFFER_SIZE = 4096;
+
+//! The most formatting threads used by default.
+static const size_t MAX_DEFAULT_THREADS = 8;
+
+//! The default for the most hosts queried at once.
+static const size_t DEFAULT_MAX_HOSTS = 32;
+
+//! The number of hosts initially queried at once.
+static const size_t INITIAL_HOSTS = 4;
+
+//! The default target for the p95 time (ms) to query a host.
+static const DWORD DEFAULT_TARGET_LATENCY = 10000;
+
+//! The default time (ms) between samples of the performance counters.
+static const DWORD DEFAULT_INTERVAL = 1000;
+
+////////////////////////////////////////////////////////////////////////////////
+//! Get the default number of formatting threads, which is one per processor.
+
+static size_t getDefaultNumThreads()
+{
+	SYSTEM_INFO info = { 0 };
+
+	::GetSystemInfo(&info);
+
+	return std::min<size_t>(std::max<size_t>(info.dwNumberOfProcessors, 1), MAX_DEFAULT_THREADS);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Format the objects from the source and write them to the sink, either as
+//! they're read or on a pool of worker threads.
+
+static void writeObjects(ObjectSource& objects, SnapshotSink& sink, size_t numThreads, bool showTypes, bool applyFormatting, bool align)
+{
+	// Without any worker threads the objects are formatted as they're read.
+	if (numThreads == 0)
+	{
+		SnapshotFormatter formatter(showTypes, applyFormatting, align);
+		ObjectSnapshot    snapshot;
+
+		snapshot.m_text.reserve(INITIAL_BUFFER_SIZE);
+
+		while (objects.next(snapshot))
+		{
+			{
+				AllocationScope scope(FORMAT_STAGE);
+
+				formatter.format(snapshot);
+			}
+
+			AllocationScope scope(OUTPUT_STAGE);
+
+			sink.write(snapshot);
+			sink.flush();
+		}
+	}
+	else
+	{
+		FormattingPipeline pipeline(numThreads, showTypes, applyFormatting, align);
+
+		pipeline.run(objects, sink);
+	}
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 //! Constructor.
 
 QueryCmd::QueryCmd(int argc, tchar* argv[])
 	: WCL::ConsoleCmd(s_switches, s_switches+s_switchCount, argc, argv, USAGE)
+	, m_localConnections(0, 0)
+	, m_connections(m_localConnections)
+	, m_numObjects(0)
+	, m_filter()
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Construct a command that uses connections from a shared pool.
+
+QueryCmd::QueryCmd(int argc, tchar* argv[], ConnectionPool& connections)
+	: WCL::ConsoleCmd(s_switches, s_switches+s_switchCount, argc, argv, USAGE)
+	, m_localConnections(0, 0)
+	, m_connections(connections)
+	, m_numObjects(0)
+	, m_filter()
 {
 }
 
@@ -65,23 +179,26 @@ const tchar* QueryCmd::getDescription()
 
 const tchar* QueryCmd::getUsage()
 {
-	return TXT("USAGE: WMICmd query <query> [--hosts <hostname> ...] [--user <login> --password <password>]");
+	return TXT("USAGE: WMICmd query <query> | --query-file <file> [--hosts <hostname> ...] [--user <login> --password <password>]");
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 //! The implementation of the command.
 
-int QueryCmd::doExecute(tostream& out, tostream& /*err*/)
+int QueryCmd::doExecute(tostream& out, tostream& err)
 {
 	ASSERT(m_parser.getUnnamedArgs().at(0) == TXT("query"));
 
-	typedef Core::CmdLineParser::StringVector Hostnames;
-	typedef Hostnames::const_iterator HostIter;
-	typedef WMI::Object::PropertyNames::const_iterator PropNameIter;
-
 	// Validate and extract the command line arguments.
-	if (m_parser.getUnnamedArgs().size() < 2)
+	if (m_parser.isSwitchSet(QUERY_FILE))
+	{
+		if (m_parser.getUnnamedArgs().size() > 1)
+			throw Core::CmdLineException(TXT("Cannot specify a query and --query-file together"));
+	}
+	else if (m_parser.getUnnamedArgs().size() < 2)
+	{
 		throw Core::CmdLineException(TXT("No WMI query text specified"));
+	}
 
 	if ( (m_parser.isSwitchSet(USER) && !m_parser.isSwitchSet(PASSWORD))
 	  || (m_parser.isSwitchSet(PASSWORD) && !m_parser.isSwitchSet(USER)) )
@@ -90,148 +207,504 @@ int QueryCmd::doExecute(tostream& out, tostream& /*err*/)
 	if ( (m_parser.isSwitchSet(SHOW_TYPES) && m_parser.isSwitchSet(ALIGN)) )
 		throw Core::CmdLineException(TXT("Cannot specify --showtypes and --align together"));
 
-	tstring		query    = m_parser.getUnnamedArgs().at(1);
+	if (m_parser.isSwitchSet(MAX_HOSTS) && (Core::parse<size_t>(m_parser.getSwitchValue(MAX_HOSTS)) == 0))
+		throw Core::CmdLineException(TXT("--max-hosts must be at least 1"));
+
+	if ( (m_parser.isSwitchSet(SEED) || m_parser.isSwitchSet(SAMPLE_SCOPE)) && !m_parser.isSwitchSet(SAMPLE) )
+		throw Core::CmdLineException(TXT("--seed and --sample-scope require --sample"));
+
+	if ( (m_parser.isSwitchSet(INTERVAL) || m_parser.isSwitchSet(REPEAT)) && !m_parser.isSwitchSet(COOK) )
+		throw Core::CmdLineException(TXT("--interval and --repeat require --cook"));
+
+	if (m_parser.isSwitchSet(COOK) && m_parser.isSwitchSet(SAMPLE))
+		throw Core::CmdLineException(TXT("Cannot specify --cook and --sample together"));
+
+	if ( (m_parser.isSwitchSet(TABLE_SAMPLE) || m_parser.isSwitchSet(MAX_WIDTH) || m_parser.isSwitchSet(WRAP))
+	  && !m_parser.isSwitchSet(TABLE) )
+		throw Core::CmdLineException(TXT("--table-sample, --max-width and --wrap require --table"));
+
+	if (m_parser.isSwitchSet(TABLE) && m_parser.isSwitchSet(ALIGN))
+		throw Core::CmdLineException(TXT("Cannot specify --table and --align together"));
+
+	if (m_parser.isSwitchSet(MAX_WIDTH) && (Core::parse<size_t>(m_parser.getSwitchValue(MAX_WIDTH)) == 0))
+		throw Core::CmdLineException(TXT("--max-width must be at least 1"));
+
+	if (m_parser.isSwitchSet(OUTPUT_DIR))
+	{
+		if (m_parser.isSwitchSet(OUTPUT_FILE))
+			throw Core::CmdLineException(TXT("Cannot specify --output-file and --output-dir together"));
+
+		if (m_parser.isSwitchSet(COOK) || m_parser.isSwitchSet(TABLE))
+			throw Core::CmdLineException(TXT("Cannot specify --output-dir with --cook or --table"));
+	}
+
+	if (m_parser.isSwitchSet(MAX_OPEN_FILES))
+	{
+		if (!m_parser.isSwitchSet(OUTPUT_DIR))
+			throw Core::CmdLineException(TXT("--max-open-files requires --output-dir"));
+
+		if (Core::parse<size_t>(m_parser.getSwitchValue(MAX_OPEN_FILES)) == 0)
+			throw Core::CmdLineException(TXT("--max-open-files must be at least 1"));
+	}
+
+	if (m_parser.isSwitchSet(JOURNAL))
+	{
+		if (!m_parser.isSwitchSet(OUTPUT_FILE) && !m_parser.isSwitchSet(OUTPUT_DIR))
+			throw Core::CmdLineException(TXT("--journal requires --output-file or --output-dir"));
+
+		if (m_parser.isSwitchSet(COMPRESS) || m_parser.isSwitchSet(COOK) || m_parser.isSwitchSet(TABLE) || m_parser.isSwitchSet(SAMPLE))
+			throw Core::CmdLineException(TXT("Cannot specify --journal with --compress, --cook, --table or --sample"));
+	}
+
+	if (m_parser.isSwitchSet(RESUME) && !m_parser.isSwitchSet(JOURNAL))
+		throw Core::CmdLineException(TXT("--resume requires --journal"));
+
+	if (m_parser.isSwitchSet(MEMSTATS))
+	{
+		if (!isAllocationCountingAvailable())
+			throw Core::CmdLineException(TXT("--memstats is not supported by this build"));
+
+		// The allocations are counted for the whole process and so the
+		// server's concurrent requests cannot be told apart.
+		if (&m_connections != &m_localConnections)
+			throw Core::CmdLineException(TXT("--memstats cannot be used with the query server"));
+	}
+
+	if (m_parser.isSwitchSet(SAMPLE_SCOPE))
+	{
+		const tstring scope = m_parser.getSwitchValue(SAMPLE_SCOPE);
+
+		if ( (tstricmp(scope.c_str(), TXT("host")) != 0) && (tstricmp(scope.c_str(), TXT("all")) != 0) )
+			throw Core::CmdLineException(Core::fmt(TXT("Invalid sample scope '%s'"), scope.c_str()));
+	}
+
+	Compression compression = NO_COMPRESSION;
+	int         level = GzipEncoder::DEFAULT_LEVEL;
+
+	if (m_parser.isSwitchSet(COMPRESS))
+	{
+		const tstring method = m_parser.getSwitchValue(COMPRESS);
+
+		if (tstricmp(method.c_str(), TXT("gzip")) == 0)
+			compression = GZIP_COMPRESSION;
+		else if (tstricmp(method.c_str(), TXT("zstd")) == 0)
+			throw Core::CmdLineException(TXT("zstd compression is not supported, use gzip instead"));
+		else
+			throw Core::CmdLineException(Core::fmt(TXT("Invalid compression method '%s'"), method.c_str()));
+
+		if (!m_parser.isSwitchSet(OUTPUT_FILE))
+			throw Core::CmdLineException(TXT("--compress requires an --output-file"));
+	}
+
+	if (m_parser.isSwitchSet(LEVEL))
+	{
+		if (!m_parser.isSwitchSet(COMPRESS))
+			throw Core::CmdLineException(TXT("--level requires --compress"));
+
+		level = Core::parse<int>(m_parser.getSwitchValue(LEVEL));
+
+		if ( (level < GzipEncoder::MIN_LEVEL) || (level > GzipEncoder::MAX_LEVEL) )
+			throw Core::CmdLineException(Core::fmt(TXT("Invalid compression level '%d'"), level));
+	}
+
+	// The filter is parsed up front so that any mistake is reported before
+	// the hosts are queried.
+	m_filter = FilterPtr();
+
+	if (m_parser.isSwitchSet(FILTER))
+		m_filter = FilterPtr(new Filter(m_parser.getSwitchValue(FILTER)));
+
+	m_numObjects = 0;
+
+	// Count the allocations from zero and stop, however the query ends.
+	AllocationCounting counting(m_parser.isSwitchSet(MEMSTATS));
+
+	JournalEntries completed;
+
+	if (m_parser.isSwitchSet(RESUME))
+		completed = readJournal(m_parser.getSwitchValue(JOURNAL));
+
+	// Write the output to a file, if requested. The encoding and compression
+	// happen on the writer's thread whilst the next objects are formatted.
+	if (m_parser.isSwitchSet(OUTPUT_FILE))
+	{
+		const tstring filename = m_parser.getSwitchValue(OUTPUT_FILE);
+
+		// A journalled file is truncated after the last host known to be
+		// complete and the rest appended to it.
+		uint64 offset = 0;
+
+		if (m_parser.isSwitchSet(RESUME))
+			offset = findResumeOffset(filename, completed);
+
+		AsyncFileWriterPtr file((m_parser.isSwitchSet(JOURNAL)) ? new AsyncFileWriter(filename, offset)
+		                                                         : new AsyncFileWriter(filename, compression, level));
+		Utf8StreamBuf      buffer(*file);
+		tostream           fileOut(&buffer);
+		StreamSink         sink(fileOut);
+
+		executeJournalled(sink, file.get(), completed);
+
+		fileOut.flush();
+		file->close();
+	}
+	// Or write each host's output to its own file.
+	else if (m_parser.isSwitchSet(OUTPUT_DIR))
+	{
+		const tstring directory = m_parser.getSwitchValue(OUTPUT_DIR);
+		size_t        maxOpenFiles = HostFiles::DEFAULT_MAX_OPEN_FILES;
+
+		if (m_parser.isSwitchSet(MAX_OPEN_FILES))
+			maxOpenFiles = Core::parse<size_t>(m_parser.getSwitchValue(MAX_OPEN_FILES));
+
+		if (m_parser.isSwitchSet(RESUME))
+			findResumeFiles(directory, completed);
+
+		HostFiles files(directory, m_parser.isSwitchSet(SHOW_HOST), HostFiles::DEFAULT_WRITERS, maxOpenFiles);
+
+		executeJournalled(files, nullptr, completed);
+
+		files.close();
+	}
+	else
+	{
+		StreamSink sink(out);
+
+		executeQuery(sink, completed);
+	}
+
+	if (m_parser.isSwitchSet(MEMSTATS))
+	{
+		counting.stop();
+
+		writeMemoryStats(err, m_numObjects);
+	}
+
+	return EXIT_SUCCESS;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Find where to resume writing the output file. The journal's entries are
+//! kept, in order, whilst the output they refer to is still in the file; the
+//! rest are dropped so that those hosts are queried again.
+
+uint64 QueryCmd::findResumeOffset(const tstring& filename, JournalEntries& completed)
+{
+	WIN32_FILE_ATTRIBUTE_DATA attributes;
+	uint64                    fileSize = 0;
+
+	if (::GetFileAttributesEx(filename.c_str(), GetFileExInfoStandard, &attributes))
+		fileSize = (static_cast<uint64>(attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow;
+
+	uint64                   offset = 0;
+	JournalEntries::iterator it = completed.begin();
+
+	for (; it != completed.end(); ++it)
+	{
+		if ( (it->m_offset < offset) || (it->m_offset > fileSize) )
+			break;
+
+		offset = it->m_offset;
+	}
+
+	completed.erase(it, completed.end());
+
+	return offset;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Drop the journal's entries for the hosts whose files were not written, e.g.
+//! because they were still being written when the sweep was interrupted.
+
+void QueryCmd::findResumeFiles(const tstring& directory, JournalEntries& completed)
+{
+	JournalEntries written;
+
+	for (JournalEntries::const_iterator it = completed.begin(); it != completed.end(); ++it)
+	{
+		const tstring filename = directory + TXT("\\") + HostFiles::getFilename(it->m_host);
+
+		if (::GetFileAttributes(filename.c_str()) != INVALID_FILE_ATTRIBUTES)
+			written.push_back(*it);
+	}
+
+	completed.swap(written);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Execute the query, recording each host in the journal as it completes, if
+//! requested. When resuming, the journal only needs appending to if all of its
+//! entries are still valid, otherwise it's rewritten with just the valid ones.
+
+void QueryCmd::executeJournalled(SnapshotSink& output, const AsyncFileWriter* file, const JournalEntries& completed)
+{
+	if (!m_parser.isSwitchSet(JOURNAL))
+	{
+		executeQuery(output, completed);
+		return;
+	}
+
+	const tstring filename = m_parser.getSwitchValue(JOURNAL);
+	const bool    append = m_parser.isSwitchSet(RESUME) && (readJournal(filename).size() == completed.size());
+
+	Journal     journal(filename, append);
+	JournalSink sink(output, journal, file, m_parser.isSwitchSet(SHOW_HOST));
+
+	if (!append)
+	{
+		for (JournalEntries::const_iterator it = completed.begin(); it != completed.end(); ++it)
+			journal.hostCompleted(it->m_host, it->m_status, it->m_offset);
+	}
+
+	executeQuery(sink, completed);
+
+	sink.close();
+	journal.close();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Execute the query and write the results to the sink. Any hosts that have
+//! already been completed successfully are skipped; the ones that failed are
+//! queried again.
+
+void QueryCmd::executeQuery(SnapshotSink& sink, const JournalEntries& completed)
+{
+	Queries		queries  = getQueries();
 	tstring		user     = m_parser.getSwitchValue(USER);
 	tstring		password = m_parser.getSwitchValue(PASSWORD);
-	bool		showHost = m_parser.isSwitchSet(SHOW_HOST);
 	bool		showTypes = m_parser.isSwitchSet(SHOW_TYPES);
 	bool		applyFormatting = !m_parser.isSwitchSet(NO_FORMAT);
 	bool		align    = m_parser.isSwitchSet(ALIGN);
-	Hostnames	hostnames;
 
-	if (m_parser.isSwitchSet(HOSTNAMES))
+	HostAnnotations annotations;
+	Hostnames       hostnames;
+
 	{
-		const Core::CmdLineParser::StringVector& args = m_parser.getNamedArgs().find(HOSTNAMES)->second;
+		AllocationScope scope(HOSTS_FILE_STAGE);
 
-		hostnames.insert(hostnames.end(), args.begin(), args.end());
+		hostnames = getHostnames(m_parser, HOSTNAMES, HOSTSFILE, annotations);
 	}
 
-	if (m_parser.isSwitchSet(HOSTSFILE))
+	// Fail before querying any hosts rather than lose a host's output file.
+	if (m_parser.isSwitchSet(OUTPUT_DIR))
+		HostFiles::checkFilenames(hostnames);
+
+	if (!completed.empty())
 	{
-		tstring hostsFile = m_parser.getSwitchValue(HOSTSFILE);
-		Core::CmdLineParser::StringVector args = readHostsFile(hostsFile);
+		std::set<tstring> skip;
 
-		hostnames.insert(hostnames.end(), args.begin(), args.end());
-	}
+		for (JournalEntries::const_iterator it = completed.begin(); it != completed.end(); ++it)
+		{
+			if (it->succeeded())
+				skip.insert(it->m_host);
+		}
+
+		Hostnames remaining;
 
-	if (hostnames.empty())
-		hostnames.push_back(WMI::Connection::LOCALHOST);
+		for (Hostnames::const_iterator it = hostnames.begin(); it != hostnames.end(); ++it)
+		{
+			if (skip.find(*it) == skip.end())
+				remaining.push_back(*it);
+		}
+
+		if (remaining.empty())
+			return;
+
+		hostnames.swap(remaining);
+	}
 
 	size_t maxItems = std::numeric_limits<size_t>::max();
 
 	if (m_parser.isSwitchSet(TOP))
 		maxItems = Core::parse<size_t>(m_parser.getSwitchValue(TOP));
 
-	// For all hosts to query...
-	for (HostIter it = hostnames.begin(); it != hostnames.end(); ++it)
+	// The objects are filtered after they're read and so a filter must also
+	// apply the limit, otherwise the query would stop short of the matches.
+	// The filter ends each query once it has found enough of them.
+	size_t maxMatches = std::numeric_limits<size_t>::max();
+
+	if (m_filter.get() != nullptr)
 	{
-		const tstring& host = *it;
+		maxMatches = maxItems;
+		maxItems = std::numeric_limits<size_t>::max();
+	}
 
-		// Open a connection.
-		WMI::Connection connection;
+	size_t numThreads = getDefaultNumThreads();
 
-		if (host == WMI::Connection::LOCALHOST)
-			connection.open();
-		else
-			connection.open(host, user, password);
+	if (m_parser.isSwitchSet(THREADS))
+		numThreads = Core::parse<size_t>(m_parser.getSwitchValue(THREADS));
 
-		// Execute the query.
-		WMI::ObjectIterator objectIter = connection.execQuery(query.c_str());
-		WMI::ObjectIterator objectEnd;
+	if (m_parser.isSwitchSet(COOK))
+	{
+		DWORD  interval = DEFAULT_INTERVAL;
+		size_t repeat = 1;
 
-		if (showHost)
-		{
-			if (applyFormatting)
-				out << std::endl;
+		if (m_parser.isSwitchSet(INTERVAL))
+			interval = Core::parse<DWORD>(m_parser.getSwitchValue(INTERVAL));
 
-			out << TXT("Host");
-			out << TXT(": ");
-			out << host;
-			out << std::endl;
-		}
+		if (m_parser.isSwitchSet(REPEAT))
+			repeat = Core::parse<size_t>(m_parser.getSwitchValue(REPEAT));
 
-		// For all objects...
-		for (size_t count = 0; (objectIter != objectEnd) && (count != maxItems); ++objectIter, ++count)
+		// Keep each host's connection open between samples, unless the
+		// connections are already shared with a server.
+		ConnectionPool  samplePool(1, ConnectionPool::DEFAULT_MAX_IDLE_TIME);
+		ConnectionPool& connections = (&m_connections == &m_localConnections) ? samplePool : m_connections;
+		CookingSource   cooking(user, password, queries, m_parser.isSwitchSet(SHOW_HOST), m_parser.isSwitchSet(QUERY_FILE),
+		                        (repeat != 1), applyFormatting);
+
+		for (size_t i = 0; (repeat == 0) || (i <= repeat); ++i)
 		{
-			if (applyFormatting)
-				out << std::endl;
+			const DWORD started = ::GetTickCount();
 
-			WMI::Object					object = *objectIter;
-			WMI::Object::PropertyNames	names;
+			ObjectSourcePtr source = createSource(connections, hostnames, annotations, queries, maxItems);
+			CountingSource  counted(*source, m_numObjects);
 
-			object.getPropertyNames(names);
+			cooking.startSample(counted);
 
-			// For all properties...
-			PropNameIter nameIter = names.begin();
-			PropNameIter nameEnd  = names.end();
+			FilterSource filtered(cooking, m_filter.get(), maxMatches);
 
-			size_t maxNameLength = 0;
+			writeResults(filtered, sink, numThreads, showTypes, applyFormatting, align);
 
-			for (; nameIter != nameEnd; ++nameIter)
-			{
-				const tstring& name = *nameIter;
+			const DWORD elapsed = ::GetTickCount() - started;
 
-				maxNameLength = std::max(name.length(), maxNameLength);
-			}
+			if ( (i != repeat) && (elapsed < interval) )
+				::Sleep(interval - elapsed);
+		}
 
-			size_t nameWidth = (align) ? maxNameLength : 0;
+		return;
+	}
 
-			nameIter = names.begin();
-			nameEnd  = names.end();
+	ObjectSourcePtr source = createSource(m_connections, hostnames, annotations, queries, maxItems);
+	CountingSource  counted(*source, m_numObjects);
+	FilterSource    filtered(counted, m_filter.get(), maxMatches);
 
-			for (; nameIter != nameEnd; ++nameIter)
-			{
-				const tstring& name = *nameIter;
+	if (m_parser.isSwitchSet(SAMPLE))
+	{
+		size_t sampleSize = Core::parse<size_t>(m_parser.getSwitchValue(SAMPLE));
+		uint64 seed = ::GetTickCount();
+		bool   perHost = true;
 
-				WCL::Variant value;
+		if (m_parser.isSwitchSet(SEED))
+			seed = Core::parse<uint64>(m_parser.getSwitchValue(SEED));
 
-				object.getProperty(name, value);
+		if (m_parser.isSwitchSet(SAMPLE_SCOPE))
+			perHost = (tstricmp(m_parser.getSwitchValue(SAMPLE_SCOPE).c_str(), TXT("host")) == 0);
 
-				tstring formattedType = TXT(" [") + WCL::Variant::formatFullType(value) + TXT("]");
-				tstring formattedValue = formatValue(value, applyFormatting);
+		SamplingSource sample(filtered, sampleSize, seed, perHost);
 
-				out << std::setiosflags(std::ios_base::left) << std::setw(nameWidth) << name;
+		writeResults(sample, sink, numThreads, showTypes, applyFormatting, align);
+	}
+	else
+	{
+		writeResults(filtered, sink, numThreads, showTypes, applyFormatting, align);
+	}
+}
 
-				if (showTypes)
-					out << formattedType;
+////////////////////////////////////////////////////////////////////////////////
+//! Write the objects from the source to the sink, laid out as a table if
+//! requested. The table's rows are already formatted and so only need writing.
 
-				out << TXT(": ");
-				out << formattedValue;
-				out << std::endl;
-			}
-		}
+void QueryCmd::writeResults(ObjectSource& objects, SnapshotSink& sink, size_t numThreads, bool showTypes, bool applyFormatting, bool align) const
+{
+	if (m_parser.isSwitchSet(TABLE))
+	{
+		size_t sampleRows = TableSource::DEFAULT_SAMPLE_ROWS;
+		size_t maxWidth = TableSource::DEFAULT_MAX_WIDTH;
+		bool   wrap = m_parser.isSwitchSet(WRAP);
+
+		if (m_parser.isSwitchSet(TABLE_SAMPLE))
+			sampleRows = Core::parse<size_t>(m_parser.getSwitchValue(TABLE_SAMPLE));
+
+		if (m_parser.isSwitchSet(MAX_WIDTH))
+			maxWidth = Core::parse<size_t>(m_parser.getSwitchValue(MAX_WIDTH));
+
+		TableSource table(objects, sampleRows, maxWidth, wrap, showTypes, applyFormatting);
+
+		writeObjects(table, sink, 0, false, applyFormatting, false);
 	}
+	else
+	{
+		writeObjects(objects, sink, numThreads, showTypes, applyFormatting, align);
+	}
+}
 
-	return EXIT_SUCCESS;
+////////////////////////////////////////////////////////////////////////////////
+//! Create the source of the objects for the queries. Multiple hosts are queried
+//! concurrently with an adaptive limit on how many are in flight at once, which
+//! is never more than --max-hosts. The headings are always labelled when
+//! cooking, as that's how the cooking source tells the hosts and queries apart.
+
+ObjectSourcePtr QueryCmd::createSource(ConnectionPool& connections, const Hostnames& hostnames, const HostAnnotations& annotations,
+                                       const Queries& queries, size_t maxItems) const
+{
+	bool	showQuery = m_parser.isSwitchSet(QUERY_FILE) || m_parser.isSwitchSet(COOK);
+	bool	showHost = m_parser.isSwitchSet(SHOW_HOST) || m_parser.isSwitchSet(OUTPUT_DIR) || m_parser.isSwitchSet(JOURNAL)
+	                || m_parser.isSwitchSet(COOK);
+	bool	applyFormatting = !m_parser.isSwitchSet(NO_FORMAT);
+	size_t	maxHosts = DEFAULT_MAX_HOSTS;
+	DWORD	targetLatency = DEFAULT_TARGET_LATENCY;
+
+	if (m_parser.isSwitchSet(MAX_HOSTS))
+		maxHosts = Core::parse<size_t>(m_parser.getSwitchValue(MAX_HOSTS));
+
+	if (m_parser.isSwitchSet(TARGET_LATENCY))
+		targetLatency = Core::parse<DWORD>(m_parser.getSwitchValue(TARGET_LATENCY));
+
+	HostSourceFactoryPtr sources = createHostSources(connections, queries, showHost, showQuery, applyFormatting, maxItems);
+
+	if (hostnames.size() == 1)
+		return sources->createSource(hostnames.front());
+
+	AdaptiveLimit limit(INITIAL_HOSTS, 1, maxHosts, targetLatency);
+
+	return ObjectSourcePtr(new ParallelQuerySource(sources, hostnames, annotations, limit, maxHosts,
+	                                               showHost, applyFormatting));
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-//! Read the list of hostnames from a text file. Empty lines are ignored as are
-//! comments which start with the # character.
+//! Create the factory for the sources of each host's objects, which execute
+//! the queries for real.
 
-Core::CmdLineParser::StringVector QueryCmd::readHostsFile(const tstring& filename)
+HostSourceFactoryPtr QueryCmd::createHostSources(ConnectionPool& connections, const Queries& queries, bool showHost,
+                                                 bool showQuery, bool applyFormatting, size_t maxItems) const
 {
-	Core::CmdLineParser::StringVector hosts;
+	const tstring user     = m_parser.getSwitchValue(USER);
+	const tstring password = m_parser.getSwitchValue(PASSWORD);
 
-	Core::TextFileIterator end;
-	Core::TextFileIterator it(filename);
+	return HostSourceFactoryPtr(new QuerySourceFactory(connections, user, password, queries,
+	                                                   showHost, showQuery, applyFormatting, maxItems));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Get the queries to execute, either from the command line or the query file.
 
-	for (; it != end; ++it)
+Queries QueryCmd::getQueries() const
+{
+	Queries queries;
+
+	if (m_parser.isSwitchSet(QUERY_FILE))
 	{
-		tstring line(*it);
+		const tstring filename = m_parser.getSwitchValue(QUERY_FILE);
 
-		size_t pos = line.find_first_of(TXT('#'));
+		queries = readQueryFile(filename);
 
-		if (pos != tstring::npos)
-			line.erase(pos);
+		if (queries.empty())
+			throw Core::CmdLineException(Core::fmt(TXT("The query file '%s' contains no queries"), filename.c_str()));
 
-		Core::trim(line);
+		for (Queries::const_iterator it = queries.begin(); it != queries.end(); ++it)
+		{
+			if (it->m_text.empty())
+				throw Core::CmdLineException(Core::fmt(TXT("The query '%s' has no WQL text"), it->m_name.c_str()));
+		}
+	}
+	else
+	{
+		NamedQuery query;
 
-		if (line.empty())
-			continue;
+		query.m_name = query.m_text = m_parser.getUnnamedArgs().at(1);
 
-		hosts.push_back(line);
+		queries.push_back(query);
 	}
 
-	return hosts;
+	return queries;
 }
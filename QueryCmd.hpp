@@ -12,6 +12,13 @@
 #endif
 
 #include <WCL/ConsoleCmd.hpp>
+#include "ConnectionPool.hpp"
+#include "Queries.hpp"
+#include "Hosts.hpp"
+#include "FormattingPipeline.hpp"
+#include "Journal.hpp"
+#include "Filter.hpp"
+#include "QuerySource.hpp"
 
 ////////////////////////////////////////////////////////////////////////////////
 //! The command used to list the running servers and topics.
@@ -22,10 +29,21 @@ public:
 	//! Constructor.
 	QueryCmd(int argc, tchar* argv[]);
 
+	//! Construct a command that uses connections from a shared pool.
+	QueryCmd(int argc, tchar* argv[], ConnectionPool& connections);
+
 	//! Destructor.
 	virtual ~QueryCmd();
 	
 private:
+	//
+	// Members.
+	//
+	ConnectionPool	m_localConnections;	//!< The pool used when none is shared.
+	ConnectionPool&	m_connections;		//!< The pool to take connections from.
+	size_t			m_numObjects;		//!< The number of objects read.
+	FilterPtr		m_filter;			//!< The filter applied to the objects, if any.
+
 	//
 	// Command methods.
 	//
@@ -39,8 +57,36 @@ private:
 	//! The implementation of the command.
 	virtual int doExecute(tostream& out, tostream& err);
 
-	//! Read the list of hostnames from a text file.
-	Core::CmdLineParser::StringVector readHostsFile(const tstring& filename);
+	//
+	// Internal methods.
+	//
+
+	//! Find where to resume writing the output file.
+	static uint64 findResumeOffset(const tstring& filename, JournalEntries& completed);
+
+	//! Drop the journal's entries for the hosts whose files were not written.
+	static void findResumeFiles(const tstring& directory, JournalEntries& completed);
+
+	//! Execute the query, recording each host in the journal, if requested.
+	void executeJournalled(SnapshotSink& output, const AsyncFileWriter* file, const JournalEntries& completed);
+
+	//! Execute the query and write the results to the sink.
+	void executeQuery(SnapshotSink& sink, const JournalEntries& completed);
+
+	//! Write the objects from the source to the sink.
+	void writeResults(ObjectSource& objects, SnapshotSink& sink, size_t numThreads, bool showTypes, bool applyFormatting, bool align) const;
+
+	//! Create the source of the objects for the queries.
+	ObjectSourcePtr createSource(ConnectionPool& connections, const Hostnames& hostnames, const HostAnnotations& annotations,
+	                             const Queries& queries, size_t maxItems) const;
+
+	//! Create the factory for the sources of each host's objects. This can be
+	//! overridden to run the command against a fake backend.
+	virtual HostSourceFactoryPtr createHostSources(ConnectionPool& connections, const Queries& queries, bool showHost,
+	                                               bool showQuery, bool applyFormatting, size_t maxItems) const;
+
+	//! Get the queries to execute.
+	Queries getQueries() const;
 };
 
 #endif // APP_QUERYCMD_HPP
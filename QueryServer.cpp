@@ -0,0 +1,279 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   QueryServer.cpp
+//! \brief  The QueryServer class definition.
+//! \author Chris Oldwood
+
+#include "Common.hpp"
+#include "QueryServer.hpp"
+#include "QueryCmd.hpp"
+#include <WCL/AutoCom.hpp>
+#include <WCL/Win32Exception.hpp>
+#include <Core/CmdLineException.hpp>
+#include <Core/StringUtils.hpp>
+
+////////////////////////////////////////////////////////////////////////////////
+// Constants.
+
+//! The size of the pipe's buffers.
+static const DWORD PIPE_BUFFER_SIZE = 64 * 1024;
+
+//! The maximum number of idle connections pooled per host.
+static const size_t MAX_IDLE_PER_HOST = 4;
+
+////////////////////////////////////////////////////////////////////////////////
+//! Constructor.
+
+QueryServer::QueryServer(const tstring& pipeName, size_t numListeners)
+	: m_pipePath(formatPipePath(pipeName))
+	, m_numListeners(numListeners)
+	, m_listeners()
+	, m_stopEvent(Event::MANUAL_RESET)
+	, m_connections(MAX_IDLE_PER_HOST, ConnectionPool::DEFAULT_MAX_IDLE_TIME)
+{
+	ASSERT(numListeners != 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Destructor.
+
+QueryServer::~QueryServer()
+{
+	stop();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Start listening for clients. The pipe instances are all created up front so
+//! that we fail fast if another server already owns the pipe and so clients
+//! can connect as soon as this returns.
+
+void QueryServer::start()
+{
+	ASSERT(m_listeners.empty());
+
+	m_stopEvent.reset();
+
+	try
+	{
+		for (size_t i = 0; i != m_numListeners; ++i)
+		{
+			HANDLE pipe = createPipe(i == 0);
+
+			try
+			{
+				m_listeners.push_back(new Listener(*this, pipe));
+			}
+			catch (...)
+			{
+				::CloseHandle(pipe);
+				throw;
+			}
+
+			m_listeners.back()->start();
+		}
+	}
+	catch (...)
+	{
+		stop();
+		throw;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Create an instance of the server pipe.
+
+HANDLE QueryServer::createPipe(bool firstInstance)
+{
+	DWORD       openMode = PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED;
+	const DWORD pipeMode = PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS;
+
+	if (firstInstance)
+		openMode |= FILE_FLAG_FIRST_PIPE_INSTANCE;
+
+	HANDLE pipe = ::CreateNamedPipe(m_pipePath.c_str(), openMode, pipeMode, PIPE_UNLIMITED_INSTANCES,
+									PIPE_BUFFER_SIZE, PIPE_BUFFER_SIZE, 0, nullptr);
+
+	if (pipe == INVALID_HANDLE_VALUE)
+		throw WCL::Win32Exception(::GetLastError(), Core::fmt(TXT("Failed to create the server pipe '%s'"), m_pipePath.c_str()));
+
+	return pipe;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Stop listening and wait for any requests in progress to finish.
+
+void QueryServer::stop()
+{
+	m_stopEvent.set();
+
+	joinListeners();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Ask the server to stop. This can be called from any thread.
+
+void QueryServer::requestStop()
+{
+	m_stopEvent.set();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Wait until the server is stopped.
+
+void QueryServer::wait()
+{
+	m_stopEvent.wait();
+
+	joinListeners();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Wait for all the listeners to finish and clean up.
+
+void QueryServer::joinListeners()
+{
+	for (Listeners::iterator it = m_listeners.begin(); it != m_listeners.end(); ++it)
+	{
+		(*it)->join();
+		delete *it;
+	}
+
+	m_listeners.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! The listener thread's main loop. The pipe is opened for overlapped I/O so
+//! that waiting for a client can be abandoned when the server is stopped.
+
+void QueryServer::listen(HANDLE pipe)
+{
+	WCL::AutoCom com(COINIT_MULTITHREADED);
+
+	Event connected(Event::MANUAL_RESET);
+
+	while (!m_stopEvent.wait(0))
+	{
+		OVERLAPPED overlapped = { 0 };
+
+		overlapped.hEvent = connected.handle();
+		connected.reset();
+
+		if (!::ConnectNamedPipe(pipe, &overlapped))
+		{
+			DWORD error = ::GetLastError();
+
+			if (error == ERROR_IO_PENDING)
+			{
+				HANDLE handles[] = { connected.handle(), m_stopEvent.handle() };
+				DWORD  unused;
+
+				if (::WaitForMultipleObjects(ARRAY_SIZE(handles), handles, FALSE, INFINITE) != WAIT_OBJECT_0)
+				{
+					::CancelIo(pipe);
+					::GetOverlappedResult(pipe, &overlapped, &unused, TRUE);
+					break;
+				}
+
+				if (!::GetOverlappedResult(pipe, &overlapped, &unused, FALSE))
+				{
+					::DisconnectNamedPipe(pipe);
+					continue;
+				}
+			}
+			else if (error != ERROR_PIPE_CONNECTED)
+			{
+				::DisconnectNamedPipe(pipe);
+				continue;
+			}
+		}
+
+		try
+		{
+			serveClient(pipe);
+		}
+		catch (const Core::Exception& /*e*/)
+		{
+			// The client has most likely gone away.
+		}
+
+		::FlushFileBuffers(pipe);
+		::DisconnectNamedPipe(pipe);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Serve a single client's request.
+
+void QueryServer::serveClient(HANDLE pipe)
+{
+	FrameType   type;
+	Payload     payload;
+	RequestArgs args;
+
+	if (!readFrame(pipe, type, payload) || (type != REQUEST_FRAME))
+		return;
+
+	decodeRequest(payload, args);
+
+	FrameStreamBuf outBuffer(pipe, OUTPUT_FRAME);
+	FrameStreamBuf errBuffer(pipe, ERROR_FRAME);
+	tostream       out(&outBuffer);
+	tostream       err(&errBuffer);
+	int32          result = EXIT_FAILURE;
+
+	try
+	{
+		result = execute(args, out, err);
+	}
+	catch (const Core::Exception& e)
+	{
+		err << TXT("ERROR: ") << e.twhat() << std::endl;
+	}
+
+	out.flush();
+	err.flush();
+
+	writeFrame(pipe, EXIT_CODE_FRAME, &result, sizeof(result));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Execute the command line requested by the client.
+
+int QueryServer::execute(const RequestArgs& args, tostream& out, tostream& err)
+{
+	if (args.empty())
+		throw Core::CmdLineException(TXT("No command specified"));
+
+	if (tstricmp(args[0].c_str(), TXT("query")) != 0)
+		throw Core::CmdLineException(Core::fmt(TXT("Command not supported by the server: '%s'"), args[0].c_str()));
+
+	// Recreate the command line as the command expects it.
+	std::vector<tchar*> argv;
+
+	argv.push_back(const_cast<tchar*>(TXT("WMICmd")));
+
+	for (RequestArgs::const_iterator it = args.begin(); it != args.end(); ++it)
+		argv.push_back(const_cast<tchar*>(it->c_str()));
+
+	argv.push_back(nullptr);
+
+	QueryCmd command(static_cast<int>(argv.size()-1), &argv[0], m_connections);
+
+	return command.execute(out, err);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Constructor.
+
+QueryServer::Listener::Listener(QueryServer& server, HANDLE pipe)
+	: m_server(server)
+	, m_pipe(pipe)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! The thread's body.
+
+void QueryServer::Listener::run()
+{
+	m_server.listen(m_pipe.get());
+}
@@ -0,0 +1,108 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   QueryServer.hpp
+//! \brief  The QueryServer class declaration.
+//! \author Chris Oldwood
+
+// Check for previous inclusion
+#ifndef APP_QUERYSERVER_HPP
+#define APP_QUERYSERVER_HPP
+
+#if _MSC_VER > 1000
+#pragma once
+#endif
+
+#include "Threading.hpp"
+#include "ConnectionPool.hpp"
+#include "PipeProtocol.hpp"
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+//! A resident server that executes query requests sent over a local named
+//! pipe. Each listener thread serves one client at a time and all queries
+//! share a pool of warm connections so that repeated queries against the same
+//! host avoid the cost of authenticating every time.
+
+class QueryServer
+{
+public:
+	//! Constructor.
+	QueryServer(const tstring& pipeName, size_t numListeners);
+
+	//! Destructor.
+	~QueryServer();
+
+	//! Start listening for clients.
+	void start();
+
+	//! Stop listening and wait for any requests in progress to finish.
+	void stop();
+
+	//! Ask the server to stop. This can be called from any thread.
+	void requestStop();
+
+	//! Wait until the server is stopped.
+	void wait();
+
+	//! Get the pool of connections.
+	const ConnectionPool& connections() const;
+
+private:
+	//! A thread that listens for and serves clients.
+	class Listener : public Thread
+	{
+	public:
+		//! Constructor.
+		Listener(QueryServer& server, HANDLE pipe);
+
+	private:
+		//! The thread's body.
+		virtual void run();
+
+		QueryServer&	m_server;	//!< The owning server.
+		PipeHandle		m_pipe;		//!< The listener's pipe instance.
+	};
+
+	typedef std::vector<Listener*> Listeners;
+
+	//
+	// Members.
+	//
+	tstring			m_pipePath;		//!< The full path of the pipe.
+	size_t			m_numListeners;	//!< The number of listener threads.
+	Listeners		m_listeners;	//!< The listener threads.
+	Event			m_stopEvent;	//!< Signalled to stop the listeners.
+	ConnectionPool	m_connections;	//!< The warm connections.
+
+	//
+	// Internal methods.
+	//
+
+	//! Create an instance of the server pipe.
+	HANDLE createPipe(bool firstInstance);
+
+	//! The listener thread's main loop.
+	void listen(HANDLE pipe);
+
+	//! Serve a single client's request.
+	void serveClient(HANDLE pipe);
+
+	//! Execute the command line requested by the client.
+	int execute(const RequestArgs& args, tostream& out, tostream& err);
+
+	//! Wait for all the listeners to finish and clean up.
+	void joinListeners();
+
+	// NotCopyable.
+	QueryServer(const QueryServer&);
+	QueryServer& operator=(const QueryServer&);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! Get the pool of connections.
+
+inline const ConnectionPool& QueryServer::connections() const
+{
+	return m_connections;
+}
+
+#endif // APP_QUERYSERVER_HPP
@@ -0,0 +1,237 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   QuerySource.cpp
+//! \brief  The QuerySource class definition.
+//! \author Chris Oldwood
+
+#include "Common.hpp"
+#include "QuerySource.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+//! Constructor.
+
+QuerySource::QuerySource(ConnectionPool& connections, const Hostnames& hostnames, const tstring& user,
+                         const tstring& password, const Queries& queries, bool showHost, bool showQuery,
+                         bool applyFormatting, size_t maxItems)
+	: m_connections(connections)
+	, m_hostnames(hostnames)
+	, m_user(user)
+	, m_password(password)
+	, m_queries(queries)
+	, m_showHost(showHost)
+	, m_showQuery(showQuery)
+	, m_applyFormatting(applyFormatting)
+	, m_maxItems(maxItems)
+	, m_nextHost(0)
+	, m_host()
+	, m_connection()
+	, m_nextQuery(0)
+	, m_draining(false)
+	, m_objectIter()
+	, m_pendingIter()
+	, m_count(0)
+{
+	ASSERT(!m_queries.empty());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Destructor.
+
+QuerySource::~QuerySource()
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Fill the snapshot with the next object or heading.
+
+bool QuerySource::next(ObjectSnapshot& snapshot)
+{
+	return advance(snapshot, true);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Move past the next object without copying its properties. A heading is
+//! still returned in full.
+
+bool QuerySource::skip(ObjectSnapshot& snapshot)
+{
+	return advance(snapshot, false);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Stop reading the current query's results. The enumerator is released, so
+//! the rest of the objects are never fetched, and the next call moves on to
+//! the next query or host.
+
+void QuerySource::endResultSet()
+{
+	if (m_draining)
+		m_objectIter = WMI::ObjectIterator();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Move to the next object or heading. When a query has no more objects the
+//! next one is drained and when a host has no more queries its connection is
+//! returned to the pool and the next host queried. A heading is returned at the
+//! start of each host and query, even when it's not shown, so that consumers
+//! can tell where one result set ends and the next begins.
+
+bool QuerySource::advance(ObjectSnapshot& snapshot, bool copyObject)
+{
+	const WMI::ObjectIterator objectEnd;
+
+	for (;;)
+	{
+		if (m_connection.get() == nullptr)
+		{
+			if (m_nextHost == m_hostnames.size())
+				return false;
+
+			openNextHost();
+
+			setHeading(snapshot, m_showHost, TXT("Host"), m_host);
+			return true;
+		}
+
+		if (!m_draining)
+		{
+			if (m_nextQuery == m_queries.size())
+			{
+				// Only a connection that's known to be healthy is returned to the pool.
+				m_objectIter = objectEnd;
+				m_connections.release(m_host, m_user, m_password, m_connection);
+				m_connection = ConnectionPtr();
+				continue;
+			}
+
+			startNextQuery();
+
+			setHeading(snapshot, m_showQuery, TXT("Query"), m_queries[m_nextQuery-1].m_name);
+			return true;
+		}
+
+		if ( (m_objectIter != objectEnd) && (m_count != m_maxItems) )
+		{
+			if (copyObject)
+			{
+				takeSnapshot(snapshot);
+			}
+			else
+			{
+				snapshot.m_heading.erase();
+				snapshot.m_isObject = true;
+				snapshot.m_names.clear();
+				snapshot.m_values.clear();
+			}
+
+			++m_objectIter;
+			++m_count;
+
+			return true;
+		}
+
+		m_draining = false;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Open a connection to the next host, or reuse a warm one, and issue the first
+//! query.
+
+void QuerySource::openNextHost()
+{
+	m_host = m_hostnames[m_nextHost++];
+
+	ConnectionPtr connection = m_connections.acquire(m_host, m_user, m_password);
+
+	m_pendingIter = connection->execQuery(m_queries.front().m_text.c_str());
+	m_connection = connection;
+	m_nextQuery = 0;
+	m_draining = false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Start draining the results of the pending query. The query after it is
+//! issued straight away so that the host can be executing it whilst these
+//! results are being read.
+
+void QuerySource::startNextQuery()
+{
+	m_objectIter = m_pendingIter;
+	m_pendingIter = WMI::ObjectIterator();
+	m_count = 0;
+	m_draining = true;
+
+	if (++m_nextQuery != m_queries.size())
+		m_pendingIter = m_connection->execQuery(m_queries[m_nextQuery].m_text.c_str());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Fill the snapshot with a heading, e.g. "Host: <hostname>". A heading that
+//! isn't shown is left empty.
+
+void QuerySource::setHeading(ObjectSnapshot& snapshot, bool show, const tchar* label, const tstring& value)
+{
+	snapshot.m_heading.erase();
+
+	if (show)
+	{
+		if (m_applyFormatting)
+			snapshot.m_heading += TXT('\n');
+
+		snapshot.m_heading += label;
+		snapshot.m_heading += TXT(": ");
+		snapshot.m_heading += value;
+		snapshot.m_heading += TXT('\n');
+	}
+
+	snapshot.m_isObject = false;
+	snapshot.m_names.clear();
+	snapshot.m_values.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Copy the properties of the current object into the snapshot. The snapshot's
+//! existing values are overwritten in place.
+
+void QuerySource::takeSnapshot(ObjectSnapshot& snapshot)
+{
+	WMI::Object object = *m_objectIter;
+
+	snapshot.m_heading.erase();
+	snapshot.m_isObject = true;
+	snapshot.m_names.clear();
+
+	object.getPropertyNames(snapshot.m_names);
+
+	snapshot.m_values.resize(snapshot.m_names.size());
+
+	for (size_t i = 0; i != snapshot.m_names.size(); ++i)
+		object.getProperty(snapshot.m_names[i], snapshot.m_values[i]);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Constructor.
+
+QuerySourceFactory::QuerySourceFactory(ConnectionPool& connections, const tstring& user, const tstring& password,
+                                       const Queries& queries, bool showHost, bool showQuery, bool applyFormatting,
+                                       size_t maxItems)
+	: m_connections(connections)
+	, m_user(user)
+	, m_password(password)
+	, m_queries(queries)
+	, m_showHost(showHost)
+	, m_showQuery(showQuery)
+	, m_applyFormatting(applyFormatting)
+	, m_maxItems(maxItems)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Create the source of the objects for the host. The queries are executed in
+//! exactly the same way as when the hosts are queried one at a time.
+
+ObjectSourcePtr QuerySourceFactory::createSource(const tstring& host) const
+{
+	return ObjectSourcePtr(new QuerySource(m_connections, Hostnames(1, host), m_user, m_password, m_queries,
+	                                       m_showHost, m_showQuery, m_applyFormatting, m_maxItems));
+}
@@ -0,0 +1,142 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   QuerySource.hpp
+//! \brief  The QuerySource class declaration.
+//! \author Chris Oldwood
+
+// Check for previous inclusion
+#ifndef APP_QUERYSOURCE_HPP
+#define APP_QUERYSOURCE_HPP
+
+#if _MSC_VER > 1000
+#pragma once
+#endif
+
+#include "FormattingPipeline.hpp"
+#include "ConnectionPool.hpp"
+#include "Hosts.hpp"
+#include "Queries.hpp"
+#include <WMI/ObjectIterator.hpp>
+
+////////////////////////////////////////////////////////////////////////////////
+//! The source of objects for the query command. This executes the queries on
+//! each host in turn and snapshots the properties of the resulting objects. The
+//! queries for a host are all issued on the same connection, with the next one
+//! started whilst the results of the previous one are still being drained.
+
+class QuerySource : public ObjectSource
+{
+public:
+	//! Constructor.
+	QuerySource(ConnectionPool& connections, const Hostnames& hostnames, const tstring& user,
+	            const tstring& password, const Queries& queries, bool showHost, bool showQuery,
+	            bool applyFormatting, size_t maxItems);
+
+	//! Destructor.
+	virtual ~QuerySource();
+
+	//! Fill the snapshot with the next object or heading.
+	virtual bool next(ObjectSnapshot& snapshot);
+
+	//! Move past the next object without copying its properties.
+	virtual bool skip(ObjectSnapshot& snapshot);
+
+	//! Stop reading the current query's results.
+	virtual void endResultSet();
+
+private:
+	//
+	// Members.
+	//
+	ConnectionPool&		m_connections;		//!< The pool to take connections from.
+	Hostnames			m_hostnames;		//!< The hosts to query.
+	tstring				m_user;				//!< The login for remote hosts.
+	tstring				m_password;			//!< The password for remote hosts.
+	Queries				m_queries;			//!< The WQL queries.
+	bool				m_showHost;			//!< Output a heading for each host?
+	bool				m_showQuery;		//!< Output a heading for each query?
+	bool				m_applyFormatting;	//!< Format the output?
+	size_t				m_maxItems;			//!< The limit on objects per host.
+	size_t				m_nextHost;			//!< The index of the next host to query.
+	tstring				m_host;				//!< The host being queried.
+	ConnectionPtr		m_connection;		//!< The connection to the host, if open.
+	size_t				m_nextQuery;		//!< The index of the next query to drain.
+	bool				m_draining;			//!< Are the query's results being read?
+	WMI::ObjectIterator	m_objectIter;		//!< The next object from the query.
+	WMI::ObjectIterator	m_pendingIter;		//!< The results of the next query.
+	size_t				m_count;			//!< The number of objects from the query.
+
+	//
+	// Internal methods.
+	//
+
+	//! Move to the next object or heading, optionally copying the object.
+	bool advance(ObjectSnapshot& snapshot, bool copyObject);
+
+	//! Open the connection to the next host and issue the first query.
+	void openNextHost();
+
+	//! Start draining the pending query and issue the one after it.
+	void startNextQuery();
+
+	//! Fill the snapshot with a heading.
+	void setHeading(ObjectSnapshot& snapshot, bool show, const tchar* label, const tstring& value);
+
+	//! Copy the properties of the current object into the snapshot.
+	void takeSnapshot(ObjectSnapshot& snapshot);
+
+	// NotCopyable.
+	QuerySource(const QuerySource&);
+	QuerySource& operator=(const QuerySource&);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! Creates the source of the objects for a single host. This allows the hosts
+//! to be queried concurrently against a fake backend.
+
+class HostSourceFactory
+{
+public:
+	//! Destructor.
+	virtual ~HostSourceFactory() {}
+
+	//! Create the source of the objects for the host. This can be called from
+	//! many threads at once.
+	virtual ObjectSourcePtr createSource(const tstring& host) const = 0;
+};
+
+//! The default host source factory smart-pointer type.
+typedef Core::SharedPtr<HostSourceFactory> HostSourceFactoryPtr;
+
+////////////////////////////////////////////////////////////////////////////////
+//! Creates a QuerySource to execute the queries on a single host.
+
+class QuerySourceFactory : public HostSourceFactory
+{
+public:
+	//! Constructor.
+	QuerySourceFactory(ConnectionPool& connections, const tstring& user, const tstring& password,
+	                   const Queries& queries, bool showHost, bool showQuery, bool applyFormatting,
+	                   size_t maxItems);
+
+	//! Create the source of the objects for the host.
+	virtual ObjectSourcePtr createSource(const tstring& host) const;
+
+private:
+	//
+	// Members.
+	//
+	ConnectionPool&		m_connections;		//!< The pool to take connections from.
+	tstring				m_user;				//!< The login for remote hosts.
+	tstring				m_password;			//!< The password for remote hosts.
+	Queries				m_queries;			//!< The WQL queries.
+	bool				m_showHost;			//!< Output a heading for each host?
+	bool				m_showQuery;		//!< Output a heading for each query?
+	bool				m_applyFormatting;	//!< Format the output?
+	size_t				m_maxItems;			//!< The limit on objects per query.
+
+	// NotCopyable.
+	QuerySourceFactory(const QuerySourceFactory&);
+	QuerySourceFactory& operator=(const QuerySourceFactory&);
+};
+
+#endif // APP_QUERYSOURCE_HPP
@@ -0,0 +1,447 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   ResultDiff.cpp
+//! \brief  The ResultDiff class definition.
+//! \author Chris Oldwood
+
+#include "Common.hpp"
+#include "ResultDiff.hpp"
+#include "SpillFile.hpp"
+
+//! The marker shown for a property only one side has.
+static const tchar* MISSING_VALUE = TXT("(missing)");
+
+////////////////////////////////////////////////////////////////////////////////
+//! A spill file which holds the records of one partition. The records are
+//! written as a sequence of strings and then read back once the source has
+//! been split.
+
+class ResultDiff::PartitionFile : public RecordSource
+{
+public:
+	//! Append a record to the file.
+	void write(const ResultRecord& record);
+
+	//! Move back to the start of the file to read the records.
+	void rewind();
+
+	//! Get the size of the file.
+	uint64 size() const;
+
+	//! Read the next record.
+	virtual bool read(ResultRecord& record);
+
+private:
+	//
+	// Members.
+	//
+	SpillFile	m_file;		//!< The temporary file.
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! Append a record to the file.
+
+void ResultDiff::PartitionFile::write(const ResultRecord& record)
+{
+	m_file.writeString(record.m_host);
+	m_file.writeString(record.m_query);
+	m_file.writeString(record.m_key);
+	m_file.writeNumber(static_cast<uint32>(record.m_properties.size()));
+
+	for (Properties::const_iterator it = record.m_properties.begin(); it != record.m_properties.end(); ++it)
+	{
+		m_file.writeString(it->first);
+		m_file.writeString(it->second);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Move back to the start of the file to read the records.
+
+void ResultDiff::PartitionFile::rewind()
+{
+	m_file.rewind();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Get the size of the file. This is only valid once it has been rewound.
+
+uint64 ResultDiff::PartitionFile::size() const
+{
+	return m_file.size();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Read the next record. Returns false at the end of the file.
+
+bool ResultDiff::PartitionFile::read(ResultRecord& record)
+{
+	uint32 numProperties = 0;
+
+	if (!m_file.readString(record.m_host))
+		return false;
+
+	if (!m_file.readString(record.m_query) || !m_file.readString(record.m_key) || !m_file.readNumber(numProperties))
+		m_file.throwError();
+
+	record.m_properties.resize(numProperties);
+
+	for (Properties::iterator it = record.m_properties.begin(); it != record.m_properties.end(); ++it)
+	{
+		if (!m_file.readString(it->first) || !m_file.readString(it->second))
+			m_file.throwError();
+	}
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Constructor.
+
+ResultDiff::ResultDiff(const tstring& keyProperty, size_t numPartitions)
+	: m_keyProperty(keyProperty)
+	, m_numPartitions(numPartitions)
+	, m_table()
+	, m_buckets()
+	, m_chain()
+	, m_matched()
+	, m_numAdded(0)
+	, m_numRemoved(0)
+	, m_numChanged(0)
+{
+	ASSERT((numPartitions != 0) && (numPartitions <= MAX_PARTITIONS));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Destructor.
+
+ResultDiff::~ResultDiff()
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Choose the number of partitions needed to keep the hash table for the
+//! smaller result set within the memory budget.
+
+size_t ResultDiff::choosePartitions(uint64 smallerSize, uint64 maxMemory)
+{
+	ASSERT(maxMemory != 0);
+
+	const uint64 required = smallerSize * MEMORY_PER_BYTE;
+	const uint64 partitions = (required + maxMemory - 1) / maxMemory;
+
+	if (partitions <= 1)
+		return 1;
+
+	if (partitions >= MAX_PARTITIONS)
+		return MAX_PARTITIONS;
+
+	return static_cast<size_t>(partitions);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Compare the result sets and write the differences to the stream. With one
+//! partition the hash table is built straight from the chosen side and the
+//! other side is streamed past it. Otherwise both sides are split across the
+//! spill files first and the smaller file of each pair becomes the build side.
+//! The differences are written in the order the probe side is read, followed
+//! by the build side's unmatched records in the order they were read.
+
+void ResultDiff::run(RecordSource& oldSource, RecordSource& newSource, bool buildFromOld, tostream& out)
+{
+	if (m_numPartitions == 1)
+	{
+		if (buildFromOld)
+			joinPartition(oldSource, newSource, true, out);
+		else
+			joinPartition(newSource, oldSource, false, out);
+
+		return;
+	}
+
+	PartitionFiles oldFiles;
+	PartitionFiles newFiles;
+
+	try
+	{
+		oldFiles.reserve(m_numPartitions);
+		newFiles.reserve(m_numPartitions);
+
+		for (size_t i = 0; i != m_numPartitions; ++i)
+		{
+			oldFiles.push_back(new PartitionFile());
+			newFiles.push_back(new PartitionFile());
+		}
+
+		partition(oldSource, oldFiles);
+		partition(newSource, newFiles);
+
+		for (size_t i = 0; i != m_numPartitions; ++i)
+		{
+			PartitionFile& oldFile = *oldFiles[i];
+			PartitionFile& newFile = *newFiles[i];
+
+			if (oldFile.size() <= newFile.size())
+				joinPartition(oldFile, newFile, true, out);
+			else
+				joinPartition(newFile, oldFile, false, out);
+		}
+	}
+	catch (...)
+	{
+		deleteFiles(oldFiles);
+		deleteFiles(newFiles);
+		throw;
+	}
+
+	deleteFiles(oldFiles);
+	deleteFiles(newFiles);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Split the records from the source across the spill files by their hash.
+
+void ResultDiff::partition(RecordSource& source, PartitionFiles& files)
+{
+	ResultRecord record;
+
+	while (source.read(record))
+		files[hashRecord(record) % m_numPartitions]->write(record);
+
+	for (PartitionFiles::iterator it = files.begin(); it != files.end(); ++it)
+		(*it)->rewind();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Join a pair of partitions and write out their differences. Each probe
+//! record is paired with the first unmatched build record for the same object
+//! so that duplicate keys are paired in the order they appear. The probe side
+//! is streamed past the table and never held in memory.
+
+void ResultDiff::joinPartition(RecordSource& build, RecordSource& probe, bool buildIsOld, tostream& out)
+{
+	buildTable(build);
+
+	ResultRecord record;
+
+	while (probe.read(record))
+	{
+		const size_t match = findMatch(record);
+
+		if (match == m_table.size())
+		{
+			if (buildIsOld)
+				writeDifference(ADDED, nullptr, &record, out);
+			else
+				writeDifference(REMOVED, &record, nullptr, out);
+
+			continue;
+		}
+
+		m_matched[match] = true;
+
+		const ResultRecord& other = m_table[match];
+
+		if (other.m_properties != record.m_properties)
+		{
+			if (buildIsOld)
+				writeDifference(CHANGED, &other, &record, out);
+			else
+				writeDifference(CHANGED, &record, &other, out);
+		}
+	}
+
+	for (size_t i = 0; i != m_table.size(); ++i)
+	{
+		if (m_matched[i])
+			continue;
+
+		if (buildIsOld)
+			writeDifference(REMOVED, &m_table[i], nullptr, out);
+		else
+			writeDifference(ADDED, nullptr, &m_table[i], out);
+	}
+
+	Records().swap(m_table);
+	Indices().swap(m_buckets);
+	Indices().swap(m_chain);
+	Flags().swap(m_matched);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Load the build side into the hash table. The number of buckets is the power
+//! of two at or above the number of records and each bucket is a chain of
+//! record indices.
+
+void ResultDiff::buildTable(RecordSource& build)
+{
+	ResultRecord record;
+
+	while (build.read(record))
+	{
+		m_table.push_back(ResultRecord());
+		m_table.back().swap(record);
+	}
+
+	size_t numBuckets = 1;
+
+	while (numBuckets < m_table.size())
+		numBuckets *= 2;
+
+	const size_t end = m_table.size();
+
+	m_buckets.assign(numBuckets, end);
+	m_chain.assign(m_table.size(), end);
+	m_matched.assign(m_table.size(), false);
+
+	// Insert in reverse so that each chain is in file order.
+	for (size_t i = m_table.size(); i != 0; --i)
+	{
+		const size_t index = i-1;
+		const size_t bucket = (hashRecord(m_table[index]) / m_numPartitions) & (numBuckets-1);
+
+		m_chain[index] = m_buckets[bucket];
+		m_buckets[bucket] = index;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Find the first unmatched record in the table for the same object. Returns
+//! the size of the table if there isn't one.
+
+size_t ResultDiff::findMatch(const ResultRecord& record) const
+{
+	const size_t end = m_table.size();
+
+	if (end == 0)
+		return end;
+
+	const size_t bucket = (hashRecord(record) / m_numPartitions) & (m_buckets.size()-1);
+
+	for (size_t index = m_buckets[bucket]; index != end; index = m_chain[index])
+	{
+		if (!m_matched[index] && m_table[index].isSameObject(record))
+			return index;
+	}
+
+	return end;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Write out a difference between the old and new objects, either of which can
+//! be missing. Added and removed objects are shown in full, changed objects
+//! just show the properties that differ.
+
+void ResultDiff::writeDifference(DiffType type, const ResultRecord* oldRecord, const ResultRecord* newRecord, tostream& out)
+{
+	ASSERT((oldRecord != nullptr) || (newRecord != nullptr));
+
+	if (type != CHANGED)
+	{
+		const bool          added = (type == ADDED);
+		const ResultRecord& record = (added) ? *newRecord : *oldRecord;
+
+		out << ((added) ? TXT("Added: ") : TXT("Removed: ")) << describe(record) << TXT('\n');
+
+		for (Properties::const_iterator propIter = record.m_properties.begin(); propIter != record.m_properties.end(); ++propIter)
+			out << TXT("  ") << propIter->first << TXT(": ") << propIter->second << TXT('\n');
+
+		out << TXT('\n');
+
+		if (added)
+			++m_numAdded;
+		else
+			++m_numRemoved;
+
+		return;
+	}
+
+	ASSERT((oldRecord != nullptr) && (newRecord != nullptr));
+
+	out << TXT("Changed: ") << describe(*newRecord) << TXT('\n');
+
+	// Both property lists are sorted by name so they can be merged.
+	Properties::const_iterator oldIter = oldRecord->m_properties.begin();
+	Properties::const_iterator oldEnd = oldRecord->m_properties.end();
+	Properties::const_iterator newIter = newRecord->m_properties.begin();
+	Properties::const_iterator newEnd = newRecord->m_properties.end();
+
+	while ( (oldIter != oldEnd) || (newIter != newEnd) )
+	{
+		if ( (newIter == newEnd) || ((oldIter != oldEnd) && (oldIter->first < newIter->first)) )
+		{
+			out << TXT("  ") << oldIter->first << TXT(": ") << oldIter->second << TXT(" -> ") << MISSING_VALUE << TXT('\n');
+			++oldIter;
+		}
+		else if ( (oldIter == oldEnd) || (newIter->first < oldIter->first) )
+		{
+			out << TXT("  ") << newIter->first << TXT(": ") << MISSING_VALUE << TXT(" -> ") << newIter->second << TXT('\n');
+			++newIter;
+		}
+		else
+		{
+			if (oldIter->second != newIter->second)
+				out << TXT("  ") << oldIter->first << TXT(": ") << oldIter->second << TXT(" -> ") << newIter->second << TXT('\n');
+
+			++oldIter;
+			++newIter;
+		}
+	}
+
+	out << TXT('\n');
+
+	++m_numChanged;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Delete the spill files, which removes them from the disk.
+
+void ResultDiff::deleteFiles(PartitionFiles& files)
+{
+	for (PartitionFiles::iterator it = files.begin(); it != files.end(); ++it)
+		delete *it;
+
+	files.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Calculate the FNV-1a hash of the object's host, query and key.
+
+uint32 ResultDiff::hashRecord(const ResultRecord& record)
+{
+	const tstring* fields[] = { &record.m_host, &record.m_query, &record.m_key };
+
+	uint32 hash = 2166136261u;
+
+	for (size_t i = 0; i != ARRAY_SIZE(fields); ++i)
+	{
+		const tstring& field = *fields[i];
+
+		for (tstring::const_iterator it = field.begin(); it != field.end(); ++it)
+		{
+			hash ^= static_cast<uint32>(*it);
+			hash *= 16777619u;
+		}
+
+		// Separate the fields so that "ab"+"c" and "a"+"bc" differ.
+		hash ^= 0xFF;
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Format the identity of an object, e.g. "ProcessId=4 on HOST in Processes".
+
+tstring ResultDiff::describe(const ResultRecord& record) const
+{
+	tstring text = m_keyProperty + TXT("=") + record.m_key;
+
+	if (!record.m_host.empty())
+		text += TXT(" on ") + record.m_host;
+
+	if (!record.m_query.empty())
+		text += TXT(" in ") + record.m_query;
+
+	return text;
+}
@@ -0,0 +1,146 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   ResultDiff.hpp
+//! \brief  The ResultDiff class declaration.
+//! \author Chris Oldwood
+
+// Check for previous inclusion
+#ifndef APP_RESULTDIFF_HPP
+#define APP_RESULTDIFF_HPP
+
+#if _MSC_VER > 1000
+#pragma once
+#endif
+
+#include "ResultSet.hpp"
+#include <Core/tiostream.hpp>
+
+////////////////////////////////////////////////////////////////////////////////
+//! Compares two result sets and writes out the objects which have been added,
+//! removed or changed. The objects are matched on their host, query and key
+//! property using a hash join, with the hash table built from the smaller
+//! side. When the result sets are too large to hold in memory both sides are
+//! first split across a number of spill files by the hash of their keys and
+//! then each pair of partitions is joined in turn. Only the build side is ever
+//! held in memory as each difference is written out as soon as it's found.
+
+class ResultDiff
+{
+public:
+	//! Constructor.
+	ResultDiff(const tstring& keyProperty, size_t numPartitions);
+
+	//! Destructor.
+	~ResultDiff();
+
+	//! Compare the result sets and write the differences to the stream.
+	void run(RecordSource& oldSource, RecordSource& newSource, bool buildFromOld, tostream& out);
+
+	//! Get the number of objects only in the new result set.
+	size_t numAdded() const;
+
+	//! Get the number of objects only in the old result set.
+	size_t numRemoved() const;
+
+	//! Get the number of objects whose properties differ.
+	size_t numChanged() const;
+
+	//! Choose the number of partitions for the memory budget.
+	static size_t choosePartitions(uint64 smallerSize, uint64 maxMemory);
+
+	//
+	// Constants.
+	//
+
+	//! The maximum number of partitions, and so spill files per side.
+	static const size_t MAX_PARTITIONS = 128;
+
+	//! The estimated size in memory of a record for each byte on disk.
+	static const size_t MEMORY_PER_BYTE = 4;
+
+private:
+	//! The kinds of difference.
+	enum DiffType
+	{
+		REMOVED,	//!< Only in the old result set.
+		ADDED,		//!< Only in the new result set.
+		CHANGED,	//!< In both but with different properties.
+	};
+
+	class PartitionFile;
+
+	typedef std::vector<ResultRecord> Records;
+	typedef std::vector<size_t> Indices;
+	typedef std::vector<bool> Flags;
+	typedef std::vector<PartitionFile*> PartitionFiles;
+
+	//
+	// Members.
+	//
+	tstring		m_keyProperty;		//!< The name of the key property.
+	size_t		m_numPartitions;	//!< The number of partitions to join.
+	Records		m_table;			//!< The records on the build side.
+	Indices		m_buckets;			//!< The first record in each hash bucket.
+	Indices		m_chain;			//!< The next record in the same bucket.
+	Flags		m_matched;			//!< Has the record been matched?
+	size_t		m_numAdded;			//!< The number of added objects.
+	size_t		m_numRemoved;		//!< The number of removed objects.
+	size_t		m_numChanged;		//!< The number of changed objects.
+
+	//
+	// Internal methods.
+	//
+
+	//! Split the records from the source across the spill files.
+	void partition(RecordSource& source, PartitionFiles& files);
+
+	//! Join a pair of partitions and write out their differences.
+	void joinPartition(RecordSource& build, RecordSource& probe, bool buildIsOld, tostream& out);
+
+	//! Load the build side into the hash table.
+	void buildTable(RecordSource& build);
+
+	//! Find the first unmatched record in the table for the same object.
+	size_t findMatch(const ResultRecord& record) const;
+
+	//! Write out a difference between the old and new objects.
+	void writeDifference(DiffType type, const ResultRecord* oldRecord, const ResultRecord* newRecord, tostream& out);
+
+	//! Delete the spill files.
+	static void deleteFiles(PartitionFiles& files);
+
+	//! Calculate the hash of the object's identity.
+	static uint32 hashRecord(const ResultRecord& record);
+
+	//! Format the identity of an object.
+	tstring describe(const ResultRecord& record) const;
+
+	// NotCopyable.
+	ResultDiff(const ResultDiff&);
+	ResultDiff& operator=(const ResultDiff&);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! Get the number of objects only in the new result set.
+
+inline size_t ResultDiff::numAdded() const
+{
+	return m_numAdded;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Get the number of objects only in the old result set.
+
+inline size_t ResultDiff::numRemoved() const
+{
+	return m_numRemoved;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Get the number of objects whose properties differ.
+
+inline size_t ResultDiff::numChanged() const
+{
+	return m_numChanged;
+}
+
+#endif // APP_RESULTDIFF_HPP
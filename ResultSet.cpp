@@ -0,0 +1,211 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   ResultSet.cpp
+//! \brief  The types used to read back the saved output of a query.
+//! \author Chris Oldwood
+
+#include "Common.hpp"
+#include "ResultSet.hpp"
+#include "Format.hpp"
+#include <WCL/Variant.hpp>
+#include <Core/StringUtils.hpp>
+#include <algorithm>
+
+//! The heading which starts each host's results.
+static const tstring HOST_HEADING = TXT("Host: ");
+
+//! The heading which starts each query's results.
+static const tstring QUERY_HEADING = TXT("Query: ");
+
+//! The separator between a property's name and its value.
+static const tstring VALUE_SEPARATOR = TXT(": ");
+
+////////////////////////////////////////////////////////////////////////////////
+//! Does the line start with the prefix?
+
+static bool startsWith(const tstring& line, const tstring& prefix)
+{
+	return (line.compare(0, prefix.length(), prefix) == 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Apply the same rules to the value as formatValue() so that a raw value,
+//! such as a WMI datetime, matches the formatted version of it.
+
+static void normaliseValue(tstring& value)
+{
+	if (!value.empty())
+		value = formatValue(WCL::Variant(value.c_str()), true);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Exchange the contents with another record without copying them.
+
+void ResultRecord::swap(ResultRecord& rhs)
+{
+	m_host.swap(rhs.m_host);
+	m_query.swap(rhs.m_query);
+	m_key.swap(rhs.m_key);
+	m_properties.swap(rhs.m_properties);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Is this the same object as another record?
+
+bool ResultRecord::isSameObject(const ResultRecord& rhs) const
+{
+	return (m_key == rhs.m_key) && (m_host == rhs.m_host) && (m_query == rhs.m_query);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Constructor.
+
+ResultSetReader::ResultSetReader(const tstring& filename, const tstring& keyProperty)
+	: m_reader(filename)
+	, m_keyProperty(keyProperty)
+	, m_host()
+	, m_query()
+	, m_line()
+	, m_haveLine(false)
+	, m_hasKey(false)
+	, m_numUnkeyed(0)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Destructor.
+
+ResultSetReader::~ResultSetReader()
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Read the next record that has the key property. Objects without one are
+//! counted and skipped.
+
+bool ResultSetReader::read(ResultRecord& record)
+{
+	while (readObject(record))
+	{
+		if (m_hasKey)
+			return true;
+
+		++m_numUnkeyed;
+	}
+
+	return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Read the next object, whether or not it has a key. A line which ends the
+//! object, such as a heading, is kept for the next call.
+
+bool ResultSetReader::readObject(ResultRecord& record)
+{
+	bool inObject = false;
+
+	record.m_key.erase();
+	record.m_properties.clear();
+	m_hasKey = false;
+
+	for (;;)
+	{
+		if (!m_haveLine && !m_reader.readLine(m_line))
+			break;
+
+		m_haveLine = false;
+
+		if (m_line.empty())
+		{
+			if (inObject)
+				break;
+
+			continue;
+		}
+
+		if (startsWith(m_line, HOST_HEADING) || startsWith(m_line, QUERY_HEADING))
+		{
+			if (inObject)
+			{
+				m_haveLine = true;
+				break;
+			}
+
+			if (startsWith(m_line, HOST_HEADING))
+			{
+				m_host = m_line.substr(HOST_HEADING.length());
+				m_query.erase();
+			}
+			else
+			{
+				m_query = m_line.substr(QUERY_HEADING.length());
+			}
+
+			continue;
+		}
+
+		if (!addProperty(record, m_line))
+		{
+			m_haveLine = true;
+			break;
+		}
+
+		inObject = true;
+	}
+
+	if (!inObject)
+		return false;
+
+	record.m_host = m_host;
+	record.m_query = m_query;
+
+	std::sort(record.m_properties.begin(), record.m_properties.end());
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Add a property line to the object. Any padding from aligning the names and
+//! the type from --showtypes are removed from the name. Returns false if the
+//! object already has the property, in which case it must be the start of the
+//! next object. A line which isn't a property is ignored.
+
+bool ResultSetReader::addProperty(ResultRecord& record, const tstring& line)
+{
+	const size_t separator = line.find(VALUE_SEPARATOR);
+
+	if (separator == tstring::npos)
+		return true;
+
+	tstring name = line.substr(0, separator);
+	tstring value = line.substr(separator + VALUE_SEPARATOR.length());
+
+	const size_t type = name.find(TXT(" ["));
+
+	if (type != tstring::npos)
+		name.erase(type);
+
+	Core::trim(name);
+
+	if (tstricmp(name.c_str(), m_keyProperty.c_str()) == 0)
+	{
+		if (m_hasKey)
+			return false;
+
+		normaliseValue(value);
+		record.m_key.swap(value);
+		m_hasKey = true;
+
+		return true;
+	}
+
+	for (Properties::const_iterator it = record.m_properties.begin(); it != record.m_properties.end(); ++it)
+	{
+		if (it->first == name)
+			return false;
+	}
+
+	normaliseValue(value);
+	record.m_properties.push_back(Property(name, value));
+
+	return true;
+}
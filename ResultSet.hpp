@@ -0,0 +1,108 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   ResultSet.hpp
+//! \brief  The types used to read back the saved output of a query.
+//! \author Chris Oldwood
+
+// Check for previous inclusion
+#ifndef APP_RESULTSET_HPP
+#define APP_RESULTSET_HPP
+
+#if _MSC_VER > 1000
+#pragma once
+#endif
+
+#include "LineReader.hpp"
+#include <vector>
+
+//! A property name and its formatted value.
+typedef std::pair<tstring, tstring> Property;
+
+//! The properties of an object, sorted by name.
+typedef std::vector<Property> Properties;
+
+////////////////////////////////////////////////////////////////////////////////
+//! An object read back from a saved result set. It is identified by the host
+//! and query it came from and the value of its key property.
+
+struct ResultRecord
+{
+	tstring		m_host;			//!< The host, if shown.
+	tstring		m_query;		//!< The query name, if shown.
+	tstring		m_key;			//!< The key property's value.
+	Properties	m_properties;	//!< The other properties.
+
+	//! Exchange the contents with another record without copying them.
+	void swap(ResultRecord& rhs);
+
+	//! Is this the same object as another record?
+	bool isSameObject(const ResultRecord& rhs) const;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! The source of records to compare.
+
+class RecordSource
+{
+public:
+	//! Destructor.
+	virtual ~RecordSource() {}
+
+	//! Read the next record. Returns false when there are no more.
+	virtual bool read(ResultRecord& record) = 0;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! Reads the objects from the saved output of the query command, with or
+//! without formatting. The "Host:" and "Query:" headings mark where each
+//! result set starts. An object ends at an empty line or when a property
+//! appears again. Each value is passed through formatValue() so that a value
+//! saved without formatting compares equal to the same value saved with it.
+
+class ResultSetReader : public RecordSource
+{
+public:
+	//! Constructor.
+	ResultSetReader(const tstring& filename, const tstring& keyProperty);
+
+	//! Destructor.
+	virtual ~ResultSetReader();
+
+	//! Read the next record that has the key property.
+	virtual bool read(ResultRecord& record);
+
+	//! Get the number of objects skipped because they had no key property.
+	size_t numUnkeyed() const;
+
+private:
+	//
+	// Members.
+	//
+	LineReader	m_reader;		//!< The file being read.
+	tstring		m_keyProperty;	//!< The name of the key property.
+	tstring		m_host;			//!< The current host.
+	tstring		m_query;		//!< The current query.
+	tstring		m_line;			//!< The current line.
+	bool		m_haveLine;		//!< Is the current line still to be used?
+	bool		m_hasKey;		//!< Has the current object got a key?
+	size_t		m_numUnkeyed;	//!< The number of objects without a key.
+
+	//
+	// Internal methods.
+	//
+
+	//! Read the next object, whether or not it has a key.
+	bool readObject(ResultRecord& record);
+
+	//! Add a property line to the object.
+	bool addProperty(ResultRecord& record, const tstring& line);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! Get the number of objects skipped because they had no key property.
+
+inline size_t ResultSetReader::numUnkeyed() const
+{
+	return m_numUnkeyed;
+}
+
+#endif // APP_RESULTSET_HPP
@@ -0,0 +1,223 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   SamplingSource.cpp
+//! \brief  The SamplingSource class definition.
+//! \author Chris Oldwood
+
+#include "Common.hpp"
+#include "SamplingSource.hpp"
+#include <algorithm>
+
+//! The slot value used when an object isn't chosen.
+static const size_t NO_SLOT = static_cast<size_t>(-1);
+
+//! The group value used before any heading has been passed on.
+static const size_t NO_GROUP = static_cast<size_t>(-1);
+
+////////////////////////////////////////////////////////////////////////////////
+//! Constructor.
+
+SamplingSource::SamplingSource(ObjectSource& source, size_t sampleSize, uint64 seed, bool perResultSet)
+	: m_source(source)
+	, m_sampleSize(sampleSize)
+	, m_perResultSet(perResultSet)
+	, m_random(seed ^ 0x9E3779B97F4A7C15ULL)
+	, m_samples()
+	, m_numSamples(0)
+	, m_numObjects(0)
+	, m_headings()
+	, m_afterObject(false)
+	, m_pending()
+	, m_hasPending(false)
+	, m_finished(false)
+	, m_scratch()
+	, m_output()
+	, m_nextOutput(0)
+	, m_lastGroup(NO_GROUP)
+	, m_emitting(false)
+{
+	// The generator never leaves the all zeroes state.
+	if (m_random == 0)
+		m_random = 0x9E3779B97F4A7C15ULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Destructor.
+
+SamplingSource::~SamplingSource()
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Fill the snapshot with the next sampled object or heading. The objects are
+//! only passed on once the whole result set, or source, has been read.
+
+bool SamplingSource::next(ObjectSnapshot& snapshot)
+{
+	for (;;)
+	{
+		if (m_emitting)
+		{
+			// A result set's heading is passed on even if it has no objects.
+			if ( (m_perResultSet) && (m_lastGroup == NO_GROUP) && (!m_headings.empty()) )
+			{
+				passOnHeading(snapshot, 0);
+				return true;
+			}
+
+			if (m_nextOutput != m_output.size())
+			{
+				Sample& sample = *m_output[m_nextOutput];
+
+				if (sample.m_group != m_lastGroup)
+				{
+					passOnHeading(snapshot, sample.m_group);
+					return true;
+				}
+
+				snapshot.swap(sample.m_snapshot);
+				++m_nextOutput;
+
+				return true;
+			}
+
+			m_emitting = false;
+		}
+
+		if (m_finished)
+			return false;
+
+		takeSample();
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Read the objects from the source and take the sample. When sampling each
+//! result set separately this stops at the heading of the next result set.
+//! Consecutive headings, e.g. for the host and then the query, are combined.
+
+void SamplingSource::takeSample()
+{
+	m_numSamples = 0;
+	m_numObjects = 0;
+	m_headings.clear();
+	m_afterObject = false;
+	m_output.clear();
+	m_nextOutput = 0;
+	m_lastGroup = NO_GROUP;
+
+	if (m_hasPending)
+	{
+		m_headings.push_back(tstring());
+		m_headings.back().swap(m_pending);
+		m_hasPending = false;
+	}
+
+	for (;;)
+	{
+		// The choice is made before reading so that the properties of an object
+		// that won't survive are never copied.
+		const size_t slot = chooseSlot();
+		const bool   more = (slot != NO_SLOT) ? m_source.next(m_scratch) : m_source.skip(m_scratch);
+
+		if (!more)
+		{
+			m_finished = true;
+			break;
+		}
+
+		if (!m_scratch.m_isObject)
+		{
+			if ( (m_afterObject) && (m_perResultSet) )
+			{
+				m_pending.swap(m_scratch.m_heading);
+				m_hasPending = true;
+				break;
+			}
+
+			if ( (m_afterObject) || (m_headings.empty()) )
+				m_headings.push_back(m_scratch.m_heading);
+			else
+				m_headings.back() += m_scratch.m_heading;
+
+			m_afterObject = false;
+			continue;
+		}
+
+		if (m_headings.empty())
+			m_headings.push_back(tstring());
+
+		if (slot != NO_SLOT)
+		{
+			if (slot == m_samples.size())
+				m_samples.push_back(Sample());
+
+			Sample& sample = m_samples[slot];
+
+			sample.m_snapshot.swap(m_scratch);
+			sample.m_position = m_numObjects;
+			sample.m_group = m_headings.size()-1;
+
+			if (slot == m_numSamples)
+				++m_numSamples;
+		}
+
+		++m_numObjects;
+		m_afterObject = true;
+	}
+
+	for (size_t i = 0; i != m_numSamples; ++i)
+		m_output.push_back(&m_samples[i]);
+
+	std::sort(m_output.begin(), m_output.end(), isEarlier);
+
+	m_emitting = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Fill the snapshot with the heading for a group of objects.
+
+void SamplingSource::passOnHeading(ObjectSnapshot& snapshot, size_t group)
+{
+	snapshot.m_heading = m_headings[group];
+	snapshot.m_isObject = false;
+	snapshot.m_names.clear();
+	snapshot.m_values.clear();
+
+	m_lastGroup = group;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Choose the reservoir slot for the next object. The first N objects fill the
+//! reservoir and after that the nth object replaces a random slot with a
+//! probability of N/n (Algorithm R). Returns NO_SLOT if it isn't chosen.
+
+size_t SamplingSource::chooseSlot()
+{
+	if (m_numObjects < m_sampleSize)
+		return m_numObjects;
+
+	const uint64 choice = nextRandom() % (static_cast<uint64>(m_numObjects) + 1);
+
+	return (choice < m_sampleSize) ? static_cast<size_t>(choice) : NO_SLOT;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Generate the next random number. This is a xorshift64* generator, which
+//! is used instead of rand() so that the sequence only depends on the seed.
+
+uint64 SamplingSource::nextRandom()
+{
+	m_random ^= m_random >> 12;
+	m_random ^= m_random << 25;
+	m_random ^= m_random >> 27;
+
+	return m_random * 2685821657736338717ULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Compare samples by their position in the source.
+
+bool SamplingSource::isEarlier(const Sample* lhs, const Sample* rhs)
+{
+	return (lhs->m_position < rhs->m_position);
+}
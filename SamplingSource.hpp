@@ -0,0 +1,97 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   SamplingSource.hpp
+//! \brief  The SamplingSource class declaration.
+//! \author Chris Oldwood
+
+// Check for previous inclusion
+#ifndef APP_SAMPLINGSOURCE_HPP
+#define APP_SAMPLINGSOURCE_HPP
+
+#if _MSC_VER > 1000
+#pragma once
+#endif
+
+#include "FormattingPipeline.hpp"
+#include <vector>
+#include <deque>
+
+////////////////////////////////////////////////////////////////////////////////
+//! A source which passes on a uniform random sample of the objects from another
+//! source. A single pass is made over the objects using reservoir sampling and
+//! so only the sampled objects are held in memory, and the properties of an
+//! object are only copied when it's chosen. The sample is either taken from
+//! each result set, which is delimited by its headings, or from all of them.
+//! The objects are passed on in their original order, and for a given seed the
+//! same objects are always chosen.
+
+class SamplingSource : public ObjectSource
+{
+public:
+	//! Constructor.
+	SamplingSource(ObjectSource& source, size_t sampleSize, uint64 seed, bool perResultSet);
+
+	//! Destructor.
+	virtual ~SamplingSource();
+
+	//! Fill the snapshot with the next sampled object or heading.
+	virtual bool next(ObjectSnapshot& snapshot);
+
+private:
+	//! An object chosen for the sample.
+	struct Sample
+	{
+		ObjectSnapshot	m_snapshot;	//!< The object.
+		size_t			m_position;	//!< The object's position in the source.
+		size_t			m_group;	//!< The index of the object's heading.
+	};
+
+	typedef std::deque<Sample> Samples;
+	typedef std::vector<Sample*> SampleOrder;
+	typedef std::vector<tstring> Headings;
+
+	//
+	// Members.
+	//
+	ObjectSource&	m_source;		//!< The source of the objects.
+	size_t			m_sampleSize;	//!< The maximum number of objects to pass on.
+	bool			m_perResultSet;	//!< Sample each result set separately?
+	uint64			m_random;		//!< The random number generator state.
+	Samples			m_samples;		//!< The reservoir of chosen objects.
+	size_t			m_numSamples;	//!< The number of reservoir slots in use.
+	size_t			m_numObjects;	//!< The number of objects read.
+	Headings		m_headings;		//!< The headings read.
+	bool			m_afterObject;	//!< Was the last item read an object?
+	tstring			m_pending;		//!< The heading which ended the last result set.
+	bool			m_hasPending;	//!< Is there a heading which ended the last result set?
+	bool			m_finished;		//!< Has the source been exhausted?
+	ObjectSnapshot	m_scratch;		//!< The buffer for the item being read.
+	SampleOrder		m_output;		//!< The samples in their original order.
+	size_t			m_nextOutput;	//!< The index of the next sample to pass on.
+	size_t			m_lastGroup;	//!< The index of the last heading passed on.
+	bool			m_emitting;		//!< Is the sample being passed on?
+
+	//
+	// Internal methods.
+	//
+
+	//! Read the objects and take the sample.
+	void takeSample();
+
+	//! Fill the snapshot with a heading.
+	void passOnHeading(ObjectSnapshot& snapshot, size_t group);
+
+	//! Choose the reservoir slot for the next object, if any.
+	size_t chooseSlot();
+
+	//! Generate the next random number.
+	uint64 nextRandom();
+
+	//! Compare samples by their position in the source.
+	static bool isEarlier(const Sample* lhs, const Sample* rhs);
+
+	// NotCopyable.
+	SamplingSource(const SamplingSource&);
+	SamplingSource& operator=(const SamplingSource&);
+};
+
+#endif // APP_SAMPLINGSOURCE_HPP
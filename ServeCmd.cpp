@@ -0,0 +1,107 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   ServeCmd.cpp
+//! \brief  The ServeCmd class definition.
+//! \author Chris Oldwood
+
+#include "Common.hpp"
+#include "ServeCmd.hpp"
+#include "CmdLineArgs.hpp"
+#include <Core/CmdLineException.hpp>
+#include <Core/StringUtils.hpp>
+#include "QueryServer.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+//! The table of command specific command line switches.
+
+static Core::CmdLineSwitch s_switches[] = 
+{
+	{ USAGE,		TXT("?"),	NULL,				Core::CmdLineSwitch::ONCE,	Core::CmdLineSwitch::NONE,		NULL,				TXT("Display the command syntax")						},
+	{ USAGE,		NULL,		TXT("help"),		Core::CmdLineSwitch::ONCE,	Core::CmdLineSwitch::NONE,		NULL,				TXT("Display the command syntax")						},
+	{ PIPE,			TXT("pn"),	TXT("pipe"),		Core::CmdLineSwitch::ONCE,	Core::CmdLineSwitch::SINGLE,	TXT("name"),		TXT("The name of the pipe to listen on")				},
+	{ THREADS,		TXT("th"),	TXT("threads"),		Core::CmdLineSwitch::ONCE,	Core::CmdLineSwitch::SINGLE,	TXT("count"),		TXT("The number of clients served at once (default: 4)")	},
+};
+static size_t s_switchCount = ARRAY_SIZE(s_switches);
+
+//! The default number of listener threads.
+static const size_t DEFAULT_LISTENERS = 4;
+
+//! The server to stop when the console is closed.
+static QueryServer* s_server = nullptr;
+
+////////////////////////////////////////////////////////////////////////////////
+//! The handler for Ctrl+C et al, which stops the server gracefully.
+
+static BOOL WINAPI consoleCtrlHandler(DWORD /*type*/)
+{
+	if (s_server != nullptr)
+		s_server->requestStop();
+
+	return TRUE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Constructor.
+
+ServeCmd::ServeCmd(int argc, tchar* argv[])
+	: WCL::ConsoleCmd(s_switches, s_switches+s_switchCount, argc, argv, USAGE)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Destructor.
+
+ServeCmd::~ServeCmd()
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Get the description of the command.
+
+const tchar* ServeCmd::getDescription()
+{
+	return TXT("Run a resident server that executes queries sent by clients");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Get the expected command usage.
+
+const tchar* ServeCmd::getUsage()
+{
+	return TXT("USAGE: WMICmd serve [--pipe <name>] [--threads <count>]");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! The implementation of the command.
+
+int ServeCmd::doExecute(tostream& out, tostream& /*err*/)
+{
+	ASSERT(m_parser.getUnnamedArgs().at(0) == TXT("serve"));
+
+	tstring pipeName = DEFAULT_PIPE_NAME;
+	size_t  numListeners = DEFAULT_LISTENERS;
+
+	if (m_parser.isSwitchSet(PIPE))
+		pipeName = m_parser.getSwitchValue(PIPE);
+
+	if (m_parser.isSwitchSet(THREADS))
+		numListeners = Core::parse<size_t>(m_parser.getSwitchValue(THREADS));
+
+	if (numListeners == 0)
+		throw Core::CmdLineException(TXT("The number of --threads must be at least 1"));
+
+	QueryServer server(pipeName, numListeners);
+
+	server.start();
+
+	s_server = &server;
+	::SetConsoleCtrlHandler(consoleCtrlHandler, TRUE);
+
+	out << TXT("Listening on ") << formatPipePath(pipeName) << TXT(" (press Ctrl+C to stop)") << std::endl;
+
+	server.wait();
+
+	::SetConsoleCtrlHandler(consoleCtrlHandler, FALSE);
+	s_server = nullptr;
+
+	return EXIT_SUCCESS;
+}
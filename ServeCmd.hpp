@@ -0,0 +1,43 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   ServeCmd.hpp
+//! \brief  The ServeCmd class declaration.
+//! \author Chris Oldwood
+
+// Check for previous inclusion
+#ifndef APP_SERVECMD_HPP
+#define APP_SERVECMD_HPP
+
+#if _MSC_VER > 1000
+#pragma once
+#endif
+
+#include <WCL/ConsoleCmd.hpp>
+
+////////////////////////////////////////////////////////////////////////////////
+//! The command used to run a resident query server.
+
+class ServeCmd : public WCL::ConsoleCmd
+{
+public:
+	//! Constructor.
+	ServeCmd(int argc, tchar* argv[]);
+
+	//! Destructor.
+	virtual ~ServeCmd();
+	
+private:
+	//
+	// Command methods.
+	//
+
+	//! Get the description of the command.
+	virtual const tchar* getDescription();
+
+	//! Get the expected command usage.
+	virtual const tchar* getUsage();
+
+	//! The implementation of the command.
+	virtual int doExecute(tostream& out, tostream& err);
+};
+
+#endif // APP_SERVECMD_HPP
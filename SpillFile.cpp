@@ -0,0 +1,140 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   SpillFile.cpp
+//! \brief  The SpillFile class definition.
+//! \author Chris Oldwood
+
+#include "Common.hpp"
+#include "SpillFile.hpp"
+#include <Core/RuntimeException.hpp>
+#include <WCL/Win32Exception.hpp>
+
+////////////////////////////////////////////////////////////////////////////////
+//! Constructor. The file is created in the user's temporary folder.
+
+SpillFile::SpillFile()
+	: m_filename()
+	, m_file(nullptr)
+	, m_size(0)
+{
+	tchar folder[MAX_PATH+1] = { 0 };
+	tchar filename[MAX_PATH+1] = { 0 };
+
+	if (::GetTempPath(ARRAY_SIZE(folder), folder) == 0)
+		throw WCL::Win32Exception(::GetLastError(), TXT("Failed to get the temporary folder"));
+
+	if (::GetTempFileName(folder, TXT("WMI"), 0, filename) == 0)
+		throw WCL::Win32Exception(::GetLastError(), TXT("Failed to create a temporary file"));
+
+	m_filename = filename;
+
+	// The 'D' mode deletes the file when it's closed.
+	m_file = _tfopen(m_filename.c_str(), TXT("w+bD"));
+
+	if (m_file == nullptr)
+	{
+		::DeleteFile(m_filename.c_str());
+		throw Core::RuntimeException(Core::fmt(TXT("Failed to open the temporary file '%s'"), m_filename.c_str()));
+	}
+
+	setvbuf(m_file, nullptr, _IOFBF, BUFFER_SIZE);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Destructor.
+
+SpillFile::~SpillFile()
+{
+	fclose(m_file);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Append a number to the file.
+
+void SpillFile::writeNumber(uint32 value)
+{
+	if (fwrite(&value, sizeof(value), 1, m_file) != 1)
+		throwError();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Append a string to the file, prefixed by its length.
+
+void SpillFile::writeString(const tstring& value)
+{
+	const uint32 length = static_cast<uint32>(value.length());
+
+	writeNumber(length);
+
+	if ( (length != 0) && (fwrite(value.data(), sizeof(tchar), length, m_file) != length) )
+		throwError();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Read the next number. Returns false at the end of the file.
+
+bool SpillFile::readNumber(uint32& value)
+{
+	if (fread(&value, sizeof(value), 1, m_file) != 1)
+	{
+		if (ferror(m_file))
+			throwError();
+
+		return false;
+	}
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Read the next string. Returns false at the end of the file.
+
+bool SpillFile::readString(tstring& value)
+{
+	uint32 length = 0;
+
+	if (!readNumber(length))
+		return false;
+
+	value.resize(length);
+
+	if ( (length != 0) && (fread(&value[0], sizeof(tchar), length, m_file) != length) )
+		throwError();
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Move back to the start of the file to read the data.
+
+void SpillFile::rewind()
+{
+	if (fflush(m_file) != 0)
+		throwError();
+
+	// The file can be larger than 2 GB and so needs the 64-bit position.
+	const int64 size = _ftelli64(m_file);
+
+	if (size < 0)
+		throwError();
+
+	m_size = static_cast<uint64>(size);
+
+	if (_fseeki64(m_file, 0, SEEK_SET) != 0)
+		throwError();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Get the size of the file. This is only valid once it has been rewound.
+
+uint64 SpillFile::size() const
+{
+	return m_size;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Throw an exception for a failed read or write, or a truncated file.
+
+void SpillFile::throwError() const
+{
+	throw Core::RuntimeException(Core::fmt(TXT("Failed to read or write the temporary file '%s'"), m_filename.c_str()));
+}
@@ -0,0 +1,72 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   SpillFile.hpp
+//! \brief  The SpillFile class declaration.
+//! \author Chris Oldwood
+
+// Check for previous inclusion
+#ifndef APP_SPILLFILE_HPP
+#define APP_SPILLFILE_HPP
+
+#if _MSC_VER > 1000
+#pragma once
+#endif
+
+#include <stdio.h>
+
+////////////////////////////////////////////////////////////////////////////////
+//! A temporary file used to hold data which is too large to keep in memory.
+//! The data is written in a simple binary form, each string prefixed by its
+//! length, and then read back once it has been rewound. The file is deleted
+//! when it is closed.
+
+class SpillFile
+{
+public:
+	//! Constructor.
+	SpillFile();
+
+	//! Destructor.
+	~SpillFile();
+
+	//! Append a number to the file.
+	void writeNumber(uint32 value);
+
+	//! Append a string to the file.
+	void writeString(const tstring& value);
+
+	//! Read the next number.
+	bool readNumber(uint32& value);
+
+	//! Read the next string.
+	bool readString(tstring& value);
+
+	//! Move back to the start of the file to read the data.
+	void rewind();
+
+	//! Get the size of the file.
+	uint64 size() const;
+
+	//! Throw an exception for a failed read or write.
+	void throwError() const;
+
+	//
+	// Constants.
+	//
+
+	//! The size of the file's buffer.
+	static const size_t BUFFER_SIZE = 32 * 1024;
+
+private:
+	//
+	// Members.
+	//
+	tstring	m_filename;	//!< The name of the file.
+	FILE*	m_file;		//!< The file handle.
+	uint64	m_size;		//!< The size of the file once written.
+
+	// NotCopyable.
+	SpillFile(const SpillFile&);
+	SpillFile& operator=(const SpillFile&);
+};
+
+#endif // APP_SPILLFILE_HPP
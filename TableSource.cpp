@@ -0,0 +1,448 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   TableSource.cpp
+//! \brief  The TableSource class definition.
+//! \author Chris Oldwood
+
+#include "Common.hpp"
+#include "TableSource.hpp"
+#include "Format.hpp"
+#include "AllocationCounter.hpp"
+#include <Core/StringUtils.hpp>
+#include <algorithm>
+
+//! The space between columns.
+static const tchar COLUMN_GAP[] = TXT("  ");
+
+//! The length of the space between columns.
+static const size_t COLUMN_GAP_LENGTH = ARRAY_SIZE(COLUMN_GAP) - 1;
+
+//! The marker for a truncated value.
+static const tchar ELLIPSIS[] = TXT("...");
+
+//! The length of the marker for a truncated value.
+static const size_t ELLIPSIS_LENGTH = ARRAY_SIZE(ELLIPSIS) - 1;
+
+//! The label at the start of a host heading.
+static const tchar HOST_LABEL[] = TXT("Host: ");
+
+//! The length of the host heading label.
+static const size_t HOST_LABEL_LENGTH = ARRAY_SIZE(HOST_LABEL) - 1;
+
+//! The label at the start of a query heading.
+static const tchar QUERY_LABEL[] = TXT("Query: ");
+
+//! The length of the query heading label.
+static const size_t QUERY_LABEL_LENGTH = ARRAY_SIZE(QUERY_LABEL) - 1;
+
+////////////////////////////////////////////////////////////////////////////////
+//! Constructor.
+
+TableSource::TableSource(ObjectSource& source, size_t sampleRows, size_t maxWidth, bool wrap, bool showTypes, bool applyFormatting)
+	: m_source(source)
+	, m_sampleRows(sampleRows)
+	, m_maxWidth(maxWidth)
+	, m_wrap(wrap)
+	, m_showTypes(showTypes)
+	, m_applyFormatting(applyFormatting)
+	, m_input()
+	, m_haveInput(false)
+	, m_finished(false)
+	, m_host()
+	, m_query()
+	, m_inTable(false)
+	, m_names()
+	, m_showHost(false)
+	, m_showQuery(false)
+	, m_headings()
+	, m_types()
+	, m_formatters()
+	, m_widths()
+	, m_widthsFixed(false)
+	, m_heldRows()
+	, m_spillFile()
+	, m_numHeld(0)
+	, m_nextHeld(0)
+	, m_pending()
+	, m_row()
+{
+	ASSERT(maxWidth != 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Destructor.
+
+TableSource::~TableSource()
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Fill the snapshot with the next line(s) of the table. Objects are read from
+//! the source until there is some output ready. When a table ends before its
+//! widths have been chosen the object or heading that ended it is kept back
+//! until the table's held rows have been output.
+
+bool TableSource::next(ObjectSnapshot& snapshot)
+{
+	for (;;)
+	{
+		if (nextPending(snapshot))
+			return true;
+
+		if (m_finished)
+			return false;
+
+		if (!m_haveInput)
+		{
+			if (!m_source.next(m_input))
+			{
+				m_finished = true;
+				endTable();
+				continue;
+			}
+
+			m_haveInput = true;
+		}
+
+		if (!m_input.m_isObject)
+		{
+			if (processHeading(m_input.m_heading))
+				m_haveInput = false;
+
+			continue;
+		}
+
+		if (!isSameTable(m_input))
+		{
+			if (endTable())
+				continue;
+
+			startTable(m_input);
+		}
+
+		formatRow(m_input, m_row);
+		addRow(m_row);
+
+		m_haveInput = false;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Fill the snapshot with any output that's ready. The queued text comes
+//! before any held rows.
+
+bool TableSource::nextPending(ObjectSnapshot& snapshot)
+{
+	snapshot.m_isObject = false;
+	snapshot.m_names.clear();
+	snapshot.m_values.clear();
+
+	if (!m_pending.empty())
+	{
+		snapshot.m_heading.swap(m_pending.front());
+		m_pending.pop_front();
+		return true;
+	}
+
+	if (!m_widthsFixed || (m_nextHeld == m_numHeld))
+		return false;
+
+	if (m_spillFile.get() != nullptr)
+	{
+		uint32 numColumns = 0;
+
+		if (!m_spillFile->readNumber(numColumns))
+			m_spillFile->throwError();
+
+		m_row.resize(numColumns);
+
+		for (Row::iterator it = m_row.begin(); it != m_row.end(); ++it)
+		{
+			if (!m_spillFile->readString(*it))
+				m_spillFile->throwError();
+		}
+
+		layoutRow(m_row, snapshot.m_heading);
+	}
+	else
+	{
+		layoutRow(m_heldRows[m_nextHeld], snapshot.m_heading);
+	}
+
+	if (++m_nextHeld == m_numHeld)
+	{
+		m_heldRows.clear();
+		m_spillFile = SpillFilePtr();
+		m_numHeld = m_nextHeld = 0;
+	}
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Handle a heading from the source. The host and query headings just change
+//! the values for those columns. Any other heading ends the table and is then
+//! output as is. Returns false if the heading has to wait for the table's held
+//! rows to be output first.
+
+bool TableSource::processHeading(const tstring& heading)
+{
+	tstring text = heading;
+
+	Core::trim(text);
+
+	if (text.empty())
+		return true;
+
+	if (text.compare(0, HOST_LABEL_LENGTH, HOST_LABEL) == 0)
+	{
+		m_host = text.substr(HOST_LABEL_LENGTH);
+		return true;
+	}
+
+	if (text.compare(0, QUERY_LABEL_LENGTH, QUERY_LABEL) == 0)
+	{
+		m_query = text.substr(QUERY_LABEL_LENGTH);
+		return true;
+	}
+
+	if (endTable())
+		return false;
+
+	m_pending.push_back(heading);
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Does the object belong in the current table? It must have the same
+//! properties and the same host and query columns.
+
+bool TableSource::isSameTable(const ObjectSnapshot& object) const
+{
+	return m_inTable
+	    && (m_showHost == !m_host.empty())
+	    && (m_showQuery == !m_query.empty())
+	    && (object.m_names == m_names);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Start a new table for the object.
+
+void TableSource::startTable(const ObjectSnapshot& object)
+{
+	m_inTable = true;
+	m_names = object.m_names;
+	m_showHost = !m_host.empty();
+	m_showQuery = !m_query.empty();
+	m_headings.clear();
+
+	if (m_showHost)
+		m_headings.push_back(TXT("Host"));
+
+	if (m_showQuery)
+		m_headings.push_back(TXT("Query"));
+
+	m_headings.insert(m_headings.end(), m_names.begin(), m_names.end());
+
+	m_types.assign(m_names.size(), tstring());
+	m_formatters.assign(m_names.size(), ColumnFormatter(false, m_applyFormatting));
+	m_widths.assign(m_headings.size(), 0);
+	m_widthsFixed = false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Finish the current table. If its widths haven't been chosen yet they are
+//! chosen now and its held rows queued. Returns true if anything was queued.
+
+bool TableSource::endTable()
+{
+	if (!m_inTable)
+		return false;
+
+	m_inTable = false;
+
+	if (m_widthsFixed)
+		return false;
+
+	fixWidths();
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Format the object's values as a row. Any control characters, such as line
+//! breaks, are replaced by spaces so that a value stays on its row. Whilst the
+//! widths are still being chosen the type of each property is also noted.
+
+void TableSource::formatRow(const ObjectSnapshot& object, Row& row)
+{
+	AllocationScope scope(FORMAT_STAGE);
+
+	row.resize(m_headings.size());
+
+	size_t column = 0;
+
+	if (m_showHost)
+		row[column++] = m_host;
+
+	if (m_showQuery)
+		row[column++] = m_query;
+
+	for (size_t i = 0; i != object.m_values.size(); ++i, ++column)
+	{
+		const WCL::Variant& value = object.m_values[i];
+		tstring&            cell = row[column];
+
+		cell.erase();
+		m_formatters[i].appendValue(cell, value);
+
+		for (tstring::iterator it = cell.begin(); it != cell.end(); ++it)
+		{
+			if (static_cast<uint32>(*it) < 0x20)
+				*it = TXT(' ');
+		}
+
+		if ( m_showTypes && !m_widthsFixed && m_types[i].empty()
+		  && (value.type() != VT_EMPTY) && (value.type() != VT_NULL) )
+		{
+			m_types[i] = WCL::Variant::formatFullType(value);
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Add the row to the table. Until the widths are chosen the row is held back,
+//! in memory or in the spill file, and once enough rows have been seen the
+//! widths are fixed. After that the row is laid out straight away.
+
+void TableSource::addRow(const Row& row)
+{
+	if (m_widthsFixed)
+	{
+		m_pending.push_back(tstring());
+		layoutRow(row, m_pending.back());
+		return;
+	}
+
+	for (size_t i = 0; i != row.size(); ++i)
+		m_widths[i] = std::max(m_widths[i], row[i].length());
+
+	if (m_sampleRows == 0)
+	{
+		if (m_spillFile.get() == nullptr)
+			m_spillFile = SpillFilePtr(new SpillFile());
+
+		m_spillFile->writeNumber(static_cast<uint32>(row.size()));
+
+		for (Row::const_iterator it = row.begin(); it != row.end(); ++it)
+			m_spillFile->writeString(*it);
+	}
+	else
+	{
+		m_heldRows.push_back(row);
+	}
+
+	if (++m_numHeld == m_sampleRows)
+		fixWidths();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Choose the column widths from the held rows and the headings, up to the
+//! maximum width, and then queue the headings. The held rows are output after
+//! them.
+
+void TableSource::fixWidths()
+{
+	const size_t offset = m_headings.size() - m_names.size();
+
+	if (m_showTypes)
+	{
+		for (size_t i = 0; i != m_types.size(); ++i)
+		{
+			if (!m_types[i].empty())
+				m_headings[offset+i] = Core::fmt(TXT("%s [%s]"), m_names[i].c_str(), m_types[i].c_str());
+		}
+	}
+
+	Row separators(m_headings.size());
+
+	for (size_t i = 0; i != m_headings.size(); ++i)
+	{
+		m_widths[i] = std::min(std::max(m_widths[i], m_headings[i].length()), m_maxWidth);
+		separators[i].assign(m_widths[i], TXT('-'));
+	}
+
+	m_widthsFixed = true;
+	m_nextHeld = 0;
+
+	if (m_spillFile.get() != nullptr)
+		m_spillFile->rewind();
+
+	if (m_applyFormatting)
+		m_pending.push_back(TXT("\n"));
+
+	m_pending.push_back(tstring());
+	layoutRow(m_headings, m_pending.back());
+
+	m_pending.push_back(tstring());
+	layoutRow(separators, m_pending.back());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Lay out a row using the column widths. Each value is padded to its column's
+//! width. A wider value is either truncated, with an ellipsis, or wrapped onto
+//! as many extra lines as it needs.
+
+void TableSource::layoutRow(const Row& row, tstring& text) const
+{
+	ASSERT(row.size() == m_widths.size());
+
+	size_t numLines = 1;
+
+	if (m_wrap)
+	{
+		for (size_t i = 0; i != row.size(); ++i)
+			numLines = std::max(numLines, (row[i].length() + m_widths[i] - 1) / m_widths[i]);
+	}
+
+	text.erase();
+
+	for (size_t line = 0; line != numLines; ++line)
+	{
+		const size_t lineStart = text.length();
+
+		for (size_t i = 0; i != row.size(); ++i)
+		{
+			const tstring& value = row[i];
+			const size_t   width = m_widths[i];
+			const size_t   start = text.length();
+
+			if (i != 0)
+				text += COLUMN_GAP;
+
+			if (m_wrap)
+			{
+				if ((line * width) < value.length())
+					text.append(value, line * width, width);
+			}
+			else if (line == 0)
+			{
+				if (value.length() <= width)
+					text += value;
+				else if (width > ELLIPSIS_LENGTH)
+					text.append(value, 0, width - ELLIPSIS_LENGTH).append(ELLIPSIS);
+				else
+					text.append(value, 0, width);
+			}
+
+			const size_t used = text.length() - start - ((i != 0) ? COLUMN_GAP_LENGTH : 0);
+
+			if (used < width)
+				text.append(width - used, TXT(' '));
+		}
+
+		// Drop the padding after the last value.
+		const size_t end = text.find_last_not_of(TXT(' '));
+
+		text.erase(((end == tstring::npos) || (end < lineStart)) ? lineStart : end + 1);
+		text += TXT('\n');
+	}
+}
@@ -0,0 +1,130 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   TableSource.hpp
+//! \brief  The TableSource class declaration.
+//! \author Chris Oldwood
+
+// Check for previous inclusion
+#ifndef APP_TABLESOURCE_HPP
+#define APP_TABLESOURCE_HPP
+
+#if _MSC_VER > 1000
+#pragma once
+#endif
+
+#include "FormattingPipeline.hpp"
+#include "SpillFile.hpp"
+#include <deque>
+
+////////////////////////////////////////////////////////////////////////////////
+//! An object source which lays out the objects from another source as a table,
+//! with one row per object and one column per property. The host and query
+//! headings become columns too so that a table spans all the hosts. A new
+//! table is started whenever the properties change or another heading, such
+//! as a sample number, is output.
+//!
+//! The column widths are computed from the first rows of each table, which are
+//! held back until the widths are known. Alternatively every row can be spilled
+//! to a temporary file and read back once the widths are known, which gives
+//! exact widths without holding the rows in memory. Values wider than their
+//! column are truncated or wrapped. The rows are returned as headings and so
+//! need no further formatting.
+
+class TableSource : public ObjectSource
+{
+public:
+	//! Constructor.
+	TableSource(ObjectSource& source, size_t sampleRows, size_t maxWidth, bool wrap, bool showTypes, bool applyFormatting);
+
+	//! Destructor.
+	virtual ~TableSource();
+
+	//! Fill the snapshot with the next line(s) of the table.
+	virtual bool next(ObjectSnapshot& snapshot);
+
+	//
+	// Constants.
+	//
+
+	//! The default number of rows used to size the columns.
+	static const size_t DEFAULT_SAMPLE_ROWS = 1000;
+
+	//! The default maximum width of a column.
+	static const size_t DEFAULT_MAX_WIDTH = 40;
+
+private:
+	//! The text of a row, one string per column.
+	typedef std::vector<tstring> Row;
+	//! The rows held back whilst the widths are computed.
+	typedef std::vector<Row> Rows;
+	//! The column widths.
+	typedef std::vector<size_t> Widths;
+	//! The shared pointer type for the spill file.
+	typedef Core::SharedPtr<SpillFile> SpillFilePtr;
+
+	//
+	// Members.
+	//
+	ObjectSource&				m_source;			//!< The source of the objects.
+	size_t						m_sampleRows;		//!< The rows used to size the columns, 0 for all.
+	size_t						m_maxWidth;			//!< The widest a column can be.
+	bool						m_wrap;				//!< Wrap, rather than truncate, wide values?
+	bool						m_showTypes;		//!< Show the value types in the headings?
+	bool						m_applyFormatting;	//!< Format the values?
+	ObjectSnapshot				m_input;			//!< The last snapshot read from the source.
+	bool						m_haveInput;		//!< Is m_input waiting to be processed?
+	bool						m_finished;			//!< Has the source been drained?
+	tstring						m_host;				//!< The current host, if shown.
+	tstring						m_query;			//!< The current query, if shown.
+	bool						m_inTable;			//!< Is there a table in progress?
+	WMI::Object::PropertyNames	m_names;			//!< The table's properties.
+	bool						m_showHost;			//!< Does the table have a host column?
+	bool						m_showQuery;		//!< Does the table have a query column?
+	Row							m_headings;			//!< The column headings.
+	Row							m_types;			//!< The type of each property.
+	ColumnFormatters			m_formatters;		//!< The formatter for each property.
+	Widths						m_widths;			//!< The column widths.
+	bool						m_widthsFixed;		//!< Have the column widths been chosen?
+	Rows						m_heldRows;			//!< The rows held back in memory.
+	SpillFilePtr				m_spillFile;		//!< The rows held back on disk.
+	size_t						m_numHeld;			//!< The number of rows held back.
+	size_t						m_nextHeld;			//!< The next held row to output.
+	std::deque<tstring>			m_pending;			//!< The text waiting to be output.
+	Row							m_row;				//!< The row being formatted.
+
+	//
+	// Internal methods.
+	//
+
+	//! Fill the snapshot with any output that's ready.
+	bool nextPending(ObjectSnapshot& snapshot);
+
+	//! Handle a heading from the source.
+	bool processHeading(const tstring& heading);
+
+	//! Does the object belong in the current table?
+	bool isSameTable(const ObjectSnapshot& object) const;
+
+	//! Start a new table for the object.
+	void startTable(const ObjectSnapshot& object);
+
+	//! Finish the current table.
+	bool endTable();
+
+	//! Format the object's values as a row.
+	void formatRow(const ObjectSnapshot& object, Row& row);
+
+	//! Add the row to the table.
+	void addRow(const Row& row);
+
+	//! Choose the column widths and queue the headings and held rows.
+	void fixWidths();
+
+	//! Lay out a row using the column widths.
+	void layoutRow(const Row& row, tstring& text) const;
+
+	// NotCopyable.
+	TableSource(const TableSource&);
+	TableSource& operator=(const TableSource&);
+};
+
+#endif // APP_TABLESOURCE_HPP
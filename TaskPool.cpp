@@ -0,0 +1,211 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   TaskPool.cpp
+//! \brief  The TaskPool class definition.
+//! \author Chris Oldwood
+
+#include "Common.hpp"
+#include "TaskPool.hpp"
+#include <WCL/AutoCom.hpp>
+
+////////////////////////////////////////////////////////////////////////////////
+//! Constructor.
+
+TaskPool::TaskPool(size_t numWorkers)
+	: m_queues()
+	, m_workers()
+	, m_available(0)
+	, m_pending(0)
+	, m_failures(0)
+	, m_nextQueue(0)
+{
+	ASSERT(numWorkers != 0);
+
+	for (size_t i = 0; i != numWorkers; ++i)
+		m_queues.push_back(new TaskQueue);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Destructor.
+
+TaskPool::~TaskPool()
+{
+	ASSERT(m_workers.empty());
+
+	for (TaskQueues::iterator it = m_queues.begin(); it != m_queues.end(); ++it)
+		delete *it;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Queue a task. Tasks queued before run() is called are shared across the
+//! workers in turn.
+
+void TaskPool::submit(const TaskPtr& task)
+{
+	submit(task, m_nextQueue);
+
+	m_nextQueue = (m_nextQueue + 1) % m_queues.size();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Queue a task on the given worker's deque.
+
+void TaskPool::submit(const TaskPtr& task, size_t worker)
+{
+	ASSERT(worker < m_queues.size());
+
+	TaskQueue& queue = *m_queues[worker];
+
+	::InterlockedIncrement(&m_pending);
+
+	{
+		AutoLock lock(queue.m_lock);
+
+		queue.m_tasks.push_back(task);
+	}
+
+	m_available.release();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Execute all the queued tasks, and any they create, and then wait for the
+//! workers to finish.
+
+void TaskPool::run()
+{
+	ASSERT(m_workers.empty());
+
+	// Nothing will ever wake the workers.
+	if (m_pending == 0)
+		return;
+
+	try
+	{
+		for (size_t i = 0; i != m_queues.size(); ++i)
+		{
+			m_workers.push_back(new Worker(*this, i));
+			m_workers.back()->start();
+		}
+	}
+	catch (...)
+	{
+		// Let the workers that did start drain the queues.
+		for (Workers::iterator it = m_workers.begin(); it != m_workers.end(); ++it)
+		{
+			(*it)->join();
+			delete *it;
+		}
+
+		m_workers.clear();
+		throw;
+	}
+
+	for (Workers::iterator it = m_workers.begin(); it != m_workers.end(); ++it)
+	{
+		(*it)->join();
+		delete *it;
+	}
+
+	m_workers.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! The worker thread's main loop. An idle worker blocks on the semaphore, which
+//! is released once for every task queued and once for every worker when the
+//! last task has finished.
+
+void TaskPool::workerMain(size_t worker)
+{
+	WCL::AutoCom com(COINIT_MULTITHREADED);
+
+	for (;;)
+	{
+		m_available.wait();
+
+		TaskPtr task;
+
+		while (!tryPop(worker, task) && !trySteal(worker, task))
+		{
+			// Woken because all the work is done?
+			if (m_pending == 0)
+				return;
+
+			// Another worker took our task whilst we were scanning the queues
+			// and its own task has yet to be found.
+			::SwitchToThread();
+		}
+
+		try
+		{
+			task->execute(*this, worker);
+		}
+		catch (...)
+		{
+			::InterlockedIncrement(&m_failures);
+		}
+
+		// Only now can the task be counted as done as it may have
+		// queued further tasks whilst executing.
+		if (::InterlockedDecrement(&m_pending) == 0)
+			m_available.release(static_cast<LONG>(m_queues.size()));
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Try and take the newest task from the worker's own queue.
+
+bool TaskPool::tryPop(size_t worker, TaskPtr& task)
+{
+	TaskQueue& queue = *m_queues[worker];
+
+	AutoLock lock(queue.m_lock);
+
+	if (queue.m_tasks.empty())
+		return false;
+
+	task = queue.m_tasks.back();
+	queue.m_tasks.pop_back();
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Try and take the oldest task from another worker's queue.
+
+bool TaskPool::trySteal(size_t thief, TaskPtr& task)
+{
+	const size_t numQueues = m_queues.size();
+
+	for (size_t i = 1; i != numQueues; ++i)
+	{
+		TaskQueue& victim = *m_queues[(thief + i) % numQueues];
+
+		AutoLock lock(victim.m_lock);
+
+		if (!victim.m_tasks.empty())
+		{
+			task = victim.m_tasks.front();
+			victim.m_tasks.pop_front();
+
+			return true;
+		}
+	}
+
+	return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Constructor.
+
+TaskPool::Worker::Worker(TaskPool& pool, size_t index)
+	: m_pool(pool)
+	, m_index(index)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! The thread's body.
+
+void TaskPool::Worker::run()
+{
+	m_pool.workerMain(m_index);
+}
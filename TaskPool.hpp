@@ -0,0 +1,142 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   TaskPool.hpp
+//! \brief  The TaskPool class declaration.
+//! \author Chris Oldwood
+
+// Check for previous inclusion
+#ifndef APP_TASKPOOL_HPP
+#define APP_TASKPOOL_HPP
+
+#if _MSC_VER > 1000
+#pragma once
+#endif
+
+#include "Threading.hpp"
+#include <Core/SharedPtr.hpp>
+#include <deque>
+#include <vector>
+
+class TaskPool;
+
+////////////////////////////////////////////////////////////////////////////////
+//! A unit of work executed by the pool.
+
+class Task
+{
+public:
+	//! Destructor.
+	virtual ~Task() {}
+
+	//! Execute the task on the given worker. The task can submit further tasks
+	//! to the pool from here.
+	virtual void execute(TaskPool& pool, size_t worker) = 0;
+};
+
+//! The default task smart-pointer type.
+typedef Core::SharedPtr<Task> TaskPtr;
+
+////////////////////////////////////////////////////////////////////////////////
+//! A pool of worker threads that share work by stealing. Each worker has its
+//! own deque of tasks which it processes newest first. When a worker runs dry
+//! it steals the oldest task from another worker's deque, which for a tree
+//! walk is the one most likely to generate further work. An idle worker
+//! blocks until a task is queued or all the work is done. The workers are
+//! initialised for COM as the tasks are expected to talk to WMI.
+
+class TaskPool
+{
+public:
+	//! Constructor.
+	explicit TaskPool(size_t numWorkers);
+
+	//! Destructor.
+	~TaskPool();
+
+	//! Get the number of workers.
+	size_t numWorkers() const;
+
+	//! Queue a task. Tasks queued before run() is called are shared across
+	//! the workers in turn.
+	void submit(const TaskPtr& task);
+
+	//! Queue a task on the given worker's deque.
+	void submit(const TaskPtr& task, size_t worker);
+
+	//! Execute all the queued tasks, and any they create, and then wait for
+	//! the workers to finish.
+	void run();
+
+	//! Get the number of tasks that terminated with an exception.
+	size_t numFailures() const;
+
+private:
+	//! A worker's task deque.
+	struct TaskQueue
+	{
+		CriticalSection		m_lock;		//!< The lock protecting the queue.
+		std::deque<TaskPtr>	m_tasks;	//!< The pending tasks.
+	};
+
+	//! A worker thread.
+	class Worker : public Thread
+	{
+	public:
+		//! Constructor.
+		Worker(TaskPool& pool, size_t index);
+
+	private:
+		//! The thread's body.
+		virtual void run();
+
+		TaskPool&	m_pool;		//!< The owning pool.
+		size_t		m_index;	//!< The worker's index.
+	};
+
+	typedef std::vector<TaskQueue*> TaskQueues;
+	typedef std::vector<Worker*> Workers;
+
+	//
+	// Members.
+	//
+	TaskQueues		m_queues;		//!< The per-worker task queues.
+	Workers			m_workers;		//!< The worker threads.
+	Semaphore		m_available;	//!< The number of queued tasks, plus stop signals.
+	volatile LONG	m_pending;		//!< The number of unfinished tasks.
+	volatile LONG	m_failures;		//!< The number of tasks that failed.
+	size_t			m_nextQueue;	//!< The queue for the next external task.
+
+	//
+	// Internal methods.
+	//
+
+	//! The worker thread's main loop.
+	void workerMain(size_t worker);
+
+	//! Try and take the newest task from the worker's own queue.
+	bool tryPop(size_t worker, TaskPtr& task);
+
+	//! Try and take the oldest task from another worker's queue.
+	bool trySteal(size_t thief, TaskPtr& task);
+
+	// NotCopyable.
+	TaskPool(const TaskPool&);
+	TaskPool& operator=(const TaskPool&);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! Get the number of workers.
+
+inline size_t TaskPool::numWorkers() const
+{
+	return m_queues.size();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Get the number of tasks that terminated with an exception.
+
+inline size_t TaskPool::numFailures() const
+{
+	return static_cast<size_t>(m_failures);
+}
+
+#endif // APP_TASKPOOL_HPP
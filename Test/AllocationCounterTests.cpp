@@ -0,0 +1,167 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   AllocationCounterTests.cpp
+//! \brief  The unit tests for the allocation counter and memory statistics.
+//! \author Chris Oldwood
+
+#include "Common.hpp"
+#include <Core/UnitTest.hpp>
+#include "AllocationCounter.hpp"
+#include "MemoryStats.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+//! A source of identical objects, with a heading before the first one. The
+//! snapshot is filled in place so that its buffers are reused.
+
+class RepeatingSource : public ObjectSource
+{
+public:
+	explicit RepeatingSource(size_t numObjects)
+		: m_numObjects(numObjects), m_count(0)
+	{
+	}
+
+	virtual bool next(ObjectSnapshot& snapshot)
+	{
+		if (m_count == (m_numObjects + 1))
+			return false;
+
+		snapshot.m_isObject = (m_count != 0);
+		snapshot.m_heading = (m_count == 0) ? TXT("Host: alpha\n") : TXT("");
+		snapshot.m_names.resize(3);
+		snapshot.m_names[0] = TXT("Name");
+		snapshot.m_names[1] = TXT("ProcessId");
+		snapshot.m_names[2] = TXT("Description");
+		snapshot.m_values.resize(3);
+		snapshot.m_values[0] = WCL::Variant(TXT("service.exe"));
+		snapshot.m_values[1] = WCL::Variant(static_cast<int32>(m_count));
+		snapshot.m_values[2] = WCL::Variant();
+
+		++m_count;
+
+		return true;
+	}
+
+private:
+	size_t	m_numObjects;
+	size_t	m_count;
+};
+
+TEST_SET(AllocationCounter)
+{
+
+TEST_CASE("allocations should be attributed to the stage of the innermost scope")
+{
+	const AllocationStats formatBefore = getAllocationStats(FORMAT_STAGE);
+	const AllocationStats outputBefore = getAllocationStats(OUTPUT_STAGE);
+
+	{
+		AllocationScope format(FORMAT_STAGE);
+
+		delete[] new char[64];
+
+		{
+			AllocationScope output(OUTPUT_STAGE);
+
+			delete[] new char[32];
+		}
+
+		delete[] new char[16];
+	}
+
+	const AllocationStats formatAfter = getAllocationStats(FORMAT_STAGE);
+	const AllocationStats outputAfter = getAllocationStats(OUTPUT_STAGE);
+
+	TEST_TRUE(formatAfter.m_count - formatBefore.m_count == 2);
+	TEST_TRUE(formatAfter.m_bytes - formatBefore.m_bytes == 80);
+	TEST_TRUE(outputAfter.m_count - outputBefore.m_count == 1);
+	TEST_TRUE(outputAfter.m_bytes - outputBefore.m_bytes == 32);
+}
+TEST_CASE_END
+
+TEST_CASE("counting should start from zero and stop when the counter is destroyed")
+{
+	{
+		AllocationScope format(FORMAT_STAGE);
+
+		delete[] new char[64];
+	}
+
+	TEST_TRUE(getAllocationStats(FORMAT_STAGE).m_count != 0);
+
+	{
+		AllocationCounting counting(true);
+
+		TEST_TRUE(getAllocationStats(FORMAT_STAGE).m_count == 0);
+
+		AllocationScope format(FORMAT_STAGE);
+
+		delete[] new char[64];
+	}
+
+	{
+		AllocationScope format(FORMAT_STAGE);
+
+		delete[] new char[32];
+	}
+
+	const AllocationStats stats = getAllocationStats(FORMAT_STAGE);
+
+	TEST_TRUE(stats.m_count == 1);
+	TEST_TRUE(stats.m_bytes == 64);
+
+	// The test harness counts throughout.
+	enableAllocationCounting(true);
+}
+TEST_CASE_END
+
+TEST_CASE("the counting source should count the objects but not the headings")
+{
+	RepeatingSource source(10);
+	size_t          numObjects = 0;
+	CountingSource  counted(source, numObjects);
+	ObjectSnapshot  snapshot;
+	size_t          numItems = 0;
+
+	while (counted.next(snapshot))
+		++numItems;
+
+	TEST_TRUE(numItems == 11);
+	TEST_TRUE(numObjects == 10);
+}
+TEST_CASE_END
+
+TEST_CASE("formatting a stream of objects should not allocate once the buffers have grown")
+{
+	RepeatingSource   source(1000);
+	size_t            numObjects = 0;
+	CountingSource    counted(source, numObjects);
+	SnapshotFormatter formatter(false, true, true);
+	ObjectSnapshot    snapshot;
+
+	snapshot.m_text.reserve(1024);
+
+	// Read the heading and first object to set up the columns.
+	for (size_t i = 0; i != 2; ++i)
+	{
+		counted.next(snapshot);
+		formatter.format(snapshot);
+	}
+
+	const AllocationStats before = getAllocationStats(FORMAT_STAGE);
+
+	while (counted.next(snapshot))
+	{
+		AllocationScope scope(FORMAT_STAGE);
+
+		formatter.format(snapshot);
+	}
+
+	const AllocationStats after = getAllocationStats(FORMAT_STAGE);
+
+	TEST_TRUE(numObjects == 1000);
+	TEST_TRUE(after.m_count == before.m_count);
+}
+TEST_CASE_END
+
+}
+TEST_SET_END
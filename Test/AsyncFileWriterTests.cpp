@@ -0,0 +1,184 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   AsyncFileWriterTests.cpp
+//! \brief  The unit tests for the AsyncFileWriter and Utf8StreamBuf classes.
+//! \author Chris Oldwood
+
+#include "Common.hpp"
+#include <Core/UnitTest.hpp>
+#include "AsyncFileWriter.hpp"
+#include "Utf8StreamBuf.hpp"
+#include "Gunzip.hpp"
+#include <Core/StringUtils.hpp>
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+
+////////////////////////////////////////////////////////////////////////////////
+//! Create a unique name for a temporary file.
+
+static tstring createTempFilename(const tchar* suffix)
+{
+	tchar folder[MAX_PATH+1] = { 0 };
+
+	::GetTempPath(MAX_PATH, folder);
+
+	return Core::fmt(TXT("%sWMICmdTest-%u%s"), folder, ::GetCurrentProcessId(), suffix);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Read the entire file and then delete it.
+
+static ByteBuffer readAndDeleteFile(const tstring& filename)
+{
+	ByteBuffer contents;
+
+	{
+		std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary);
+
+		contents.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	}
+
+	::DeleteFile(filename.c_str());
+
+	return contents;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Write the text to a file via the UTF-8 stream buffer.
+
+static void writeText(const tstring& filename, const tstring& text, Compression compression)
+{
+	AsyncFileWriter	file(filename, compression, GzipEncoder::DEFAULT_LEVEL);
+	Utf8StreamBuf	buffer(file);
+	tostream		out(&buffer);
+
+	out << text;
+	out.flush();
+
+	file.close();
+}
+
+TEST_SET(AsyncFileWriter)
+{
+
+TEST_CASE("text written through the stream should be encoded as UTF-8")
+{
+	const tstring filename = createTempFilename(TXT(".txt"));
+
+	writeText(filename, TXT("caf\x00e9 \xD83D\xDE00"), NO_COMPRESSION);
+
+	const byte expected[] = { 'c', 'a', 'f', 0xC3, 0xA9, ' ', 0xF0, 0x9F, 0x98, 0x80 };
+
+	TEST_TRUE(readAndDeleteFile(filename) == ByteBuffer(expected, expected+ARRAY_SIZE(expected)));
+}
+TEST_CASE_END
+
+TEST_CASE("a surrogate pair split across a buffer boundary should be encoded together")
+{
+	const tstring filename = createTempFilename(TXT(".txt"));
+
+	tstring text(4095, TXT('a'));
+	text += TXT("\xD83D\xDE00");
+
+	writeText(filename, text, NO_COMPRESSION);
+
+	const ByteBuffer contents = readAndDeleteFile(filename);
+	const byte       expected[] = { 'a', 0xF0, 0x9F, 0x98, 0x80 };
+
+	TEST_TRUE(contents.size() == 4099);
+	TEST_TRUE(std::equal(expected, expected+ARRAY_SIZE(expected), contents.end()-ARRAY_SIZE(expected)));
+}
+TEST_CASE_END
+
+TEST_CASE("a surrogate pair split between a small and a large write should be encoded together")
+{
+	const tstring filename = createTempFilename(TXT(".txt"));
+
+	{
+		AsyncFileWriter	file(filename, NO_COMPRESSION, GzipEncoder::DEFAULT_LEVEL);
+		Utf8StreamBuf	buffer(file);
+		tostream		out(&buffer);
+
+		out << TXT("a\xD83D");
+		out << (TXT("\xDE00") + tstring(1000, TXT('b')));
+		out.flush();
+
+		file.close();
+	}
+
+	const ByteBuffer contents = readAndDeleteFile(filename);
+	const byte       expected[] = { 'a', 0xF0, 0x9F, 0x98, 0x80, 'b' };
+
+	TEST_TRUE(contents.size() == 1005);
+	TEST_TRUE(std::equal(expected, expected+ARRAY_SIZE(expected), contents.begin()));
+}
+TEST_CASE_END
+
+TEST_CASE("compressed output should decompress to the uncompressed output")
+{
+	const tstring plainFile = createTempFilename(TXT(".txt"));
+	const tstring gzipFile = createTempFilename(TXT(".txt.gz"));
+
+	// Write enough to make the writer switch buffers several times.
+	tstring text;
+
+	for (size_t i = 0; (text.length() * sizeof(tchar)) < (4 * AsyncFileWriter::BUFFER_SIZE); ++i)
+		text += Core::fmt(TXT("\nName      : caf\x00e9-%u\nProcessId : %u\n"), static_cast<unsigned>(i), static_cast<unsigned>((i * 7919) % 65536));
+
+	writeText(plainFile, text, NO_COMPRESSION);
+	writeText(gzipFile, text, GZIP_COMPRESSION);
+
+	const ByteBuffer plain = readAndDeleteFile(plainFile);
+	const ByteBuffer compressed = readAndDeleteFile(gzipFile);
+	ByteBuffer       decompressed;
+
+	TEST_TRUE(!plain.empty());
+	TEST_TRUE(compressed.size() < plain.size());
+	TEST_TRUE(tryGunzip(compressed, decompressed));
+	TEST_TRUE(decompressed == plain);
+}
+TEST_CASE_END
+
+TEST_CASE("appending to a file should first discard anything after the offset")
+{
+	const tstring filename = createTempFilename(TXT(".txt"));
+
+	writeText(filename, TXT("keep|discard"), NO_COMPRESSION);
+
+	{
+		AsyncFileWriter file(filename, 5);
+
+		TEST_TRUE(file.size() == 5);
+
+		file.write("more", 4);
+
+		TEST_TRUE(file.size() == 9);
+
+		file.close();
+	}
+
+	const byte expected[] = { 'k', 'e', 'e', 'p', '|', 'm', 'o', 'r', 'e' };
+
+	TEST_TRUE(readAndDeleteFile(filename) == ByteBuffer(expected, expected+ARRAY_SIZE(expected)));
+}
+TEST_CASE_END
+
+TEST_CASE("creating a file in a folder that does not exist should throw")
+{
+	bool threw = false;
+
+	try
+	{
+		AsyncFileWriter file(TXT("Z:\\WMICmd\\No Such Folder\\Output.txt"), NO_COMPRESSION, GzipEncoder::DEFAULT_LEVEL);
+	}
+	catch (const Core::Exception& /*e*/)
+	{
+		threw = true;
+	}
+
+	TEST_TRUE(threw);
+}
+TEST_CASE_END
+
+}
+TEST_SET_END
@@ -0,0 +1,101 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   BoundedQueueTests.cpp
+//! \brief  The unit tests for the BoundedQueue class.
+//! \author Chris Oldwood
+
+#include "Common.hpp"
+#include <Core/UnitTest.hpp>
+#include "BoundedQueue.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+//! A thread that pops items until the queue is closed, summing them.
+
+class SummingConsumer : public Thread
+{
+public:
+	explicit SummingConsumer(BoundedQueue<size_t>& queue)
+		: m_queue(queue), m_total(0), m_count(0)
+	{
+	}
+
+	size_t total() const { return m_total; }
+	size_t count() const { return m_count; }
+
+private:
+	virtual void run()
+	{
+		size_t item = 0;
+
+		while (m_queue.pop(item))
+		{
+			m_total += item;
+			++m_count;
+		}
+	}
+
+	BoundedQueue<size_t>&	m_queue;
+	size_t					m_total;
+	size_t					m_count;
+};
+
+TEST_SET(BoundedQueue)
+{
+
+TEST_CASE("items should be removed in the order they were added")
+{
+	BoundedQueue<size_t> queue(3);
+
+	queue.push(1);
+	queue.push(2);
+	queue.push(3);
+	queue.close();
+
+	size_t item = 0;
+
+	TEST_TRUE(queue.pop(item) && (item == 1));
+	TEST_TRUE(queue.tryPop(item) && (item == 2));
+	TEST_TRUE(queue.pop(item) && (item == 3));
+	TEST_FALSE(queue.pop(item));
+	TEST_FALSE(queue.tryPop(item));
+}
+TEST_CASE_END
+
+TEST_CASE("every item should be consumed exactly once and all consumers released on close")
+{
+	const size_t numItems = 10000;
+	const size_t numConsumers = 4;
+
+	BoundedQueue<size_t> queue(8);
+	SummingConsumer*     consumers[numConsumers];
+
+	for (size_t i = 0; i != numConsumers; ++i)
+	{
+		consumers[i] = new SummingConsumer(queue);
+		consumers[i]->start();
+	}
+
+	for (size_t i = 1; i <= numItems; ++i)
+		queue.push(i);
+
+	queue.close();
+
+	size_t total = 0;
+	size_t count = 0;
+
+	for (size_t i = 0; i != numConsumers; ++i)
+	{
+		consumers[i]->join();
+
+		total += consumers[i]->total();
+		count += consumers[i]->count();
+
+		delete consumers[i];
+	}
+
+	TEST_TRUE(count == numItems);
+	TEST_TRUE(total == (numItems * (numItems + 1)) / 2);
+}
+TEST_CASE_END
+
+}
+TEST_SET_END
@@ -0,0 +1,333 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   FilterTests.cpp
+//! \brief  The unit tests for the Filter and FilterSource classes.
+//! \author Chris Oldwood
+
+#include "Common.hpp"
+#include <Core/UnitTest.hpp>
+#include "Filter.hpp"
+#include "FilterSource.hpp"
+#include <Core/CmdLineException.hpp>
+#include <Core/StringUtils.hpp>
+#include <algorithm>
+
+////////////////////////////////////////////////////////////////////////////////
+//! The properties of a process, as returned by WMI. The 64-bit integers and
+//! datetimes are strings.
+
+struct Process
+{
+	const tchar*	m_name;
+	int32			m_processId;
+	const tchar*	m_workingSetSize;
+	const tchar*	m_creationDate;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! Fill the names and values with a process's properties. A missing creation
+//! date is null.
+
+static void setProcess(WMI::Object::PropertyNames& names, PropertyValues& values, const Process& process)
+{
+	names.clear();
+	names.push_back(TXT("Name"));
+	names.push_back(TXT("ProcessId"));
+	names.push_back(TXT("WorkingSetSize"));
+	names.push_back(TXT("CreationDate"));
+
+	values.clear();
+	values.push_back(WCL::Variant(process.m_name));
+	values.push_back(WCL::Variant(process.m_processId));
+	values.push_back(WCL::Variant(process.m_workingSetSize));
+	values.push_back((process.m_creationDate != nullptr) ? WCL::Variant(process.m_creationDate) : WCL::Variant());
+}
+
+//! The processes the tests filter.
+static const Process s_processes[] =
+{
+	{ TXT("System"),		4,		TXT("241664"),					nullptr							},
+	{ TXT("svchost.exe"),	1024,	TXT("9223372036854775808"),		TXT("20120101093000.000000+000")	},
+	{ TXT("SVCHOST.EXE"),	2048,	TXT("18446744073709551615"),	TXT("20120615120000.500000+060")	},
+	{ TXT("explorer.exe"),	3000,	TXT("52428800"),				TXT("20121231235959.999999+000")	},
+};
+
+static const size_t s_numProcesses = ARRAY_SIZE(s_processes);
+
+////////////////////////////////////////////////////////////////////////////////
+//! Get the names of the processes that match the filter, separated by commas.
+
+static tstring matchProcesses(const tchar* expression)
+{
+	Filter                     filter(expression);
+	WMI::Object::PropertyNames names;
+	PropertyValues             values;
+	tstring                    matches;
+
+	for (size_t i = 0; i != s_numProcesses; ++i)
+	{
+		setProcess(names, values, s_processes[i]);
+
+		if (filter.matches(names, values))
+		{
+			if (!matches.empty())
+				matches += TXT(",");
+
+			matches += Core::fmt(TXT("%d"), s_processes[i].m_processId);
+		}
+	}
+
+	return matches;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! A source of processes, with a heading before them. Ending the result set
+//! skips the rest of the processes.
+
+class ProcessSource : public ObjectSource
+{
+public:
+	ProcessSource()
+		: m_next(0)
+		, m_numRead(0)
+	{
+	}
+
+	virtual bool next(ObjectSnapshot& snapshot)
+	{
+		if (m_next == (s_numProcesses + 1))
+			return false;
+
+		if (m_next == 0)
+		{
+			snapshot.m_heading = TXT("Host: alpha\n");
+			snapshot.m_isObject = false;
+			snapshot.m_names.clear();
+			snapshot.m_values.clear();
+		}
+		else
+		{
+			snapshot.m_heading.erase();
+			snapshot.m_isObject = true;
+			setProcess(snapshot.m_names, snapshot.m_values, s_processes[m_next-1]);
+			++m_numRead;
+		}
+
+		++m_next;
+
+		return true;
+	}
+
+	virtual void endResultSet()
+	{
+		m_next = s_numProcesses + 1;
+	}
+
+	size_t numRead() const
+	{
+		return m_numRead;
+	}
+
+private:
+	size_t	m_next;
+	size_t	m_numRead;
+};
+
+TEST_SET(Filter)
+{
+
+TEST_CASE("integers and strings should be compared with the usual operators")
+{
+	TEST_TRUE(matchProcesses(TXT("ProcessId = 1024")) == TXT("1024"));
+	TEST_TRUE(matchProcesses(TXT("ProcessId <> 1024")) == TXT("4,2048,3000"));
+	TEST_TRUE(matchProcesses(TXT("ProcessId != 1024")) == TXT("4,2048,3000"));
+	TEST_TRUE(matchProcesses(TXT("ProcessId < 2048")) == TXT("4,1024"));
+	TEST_TRUE(matchProcesses(TXT("ProcessId <= 2048")) == TXT("4,1024,2048"));
+	TEST_TRUE(matchProcesses(TXT("ProcessId > 2048")) == TXT("3000"));
+	TEST_TRUE(matchProcesses(TXT("ProcessId >= 2048")) == TXT("2048,3000"));
+	TEST_TRUE(matchProcesses(TXT("processid >= 2047.5")) == TXT("2048,3000"));
+	TEST_TRUE(matchProcesses(TXT("Name = 'svchost.exe'")) == TXT("1024,2048"));
+	TEST_TRUE(matchProcesses(TXT("Name > \"svchost.exe\"")) == TXT("4"));
+	TEST_TRUE(matchProcesses(TXT("Name = 5")) == TXT(""));
+}
+TEST_CASE_END
+
+TEST_CASE("64-bit integers held as strings should be compared as numbers")
+{
+	TEST_TRUE(matchProcesses(TXT("WorkingSetSize > 1000000")) == TXT("1024,2048,3000"));
+	TEST_TRUE(matchProcesses(TXT("WorkingSetSize > 9223372036854775807")) == TXT("1024,2048"));
+	TEST_TRUE(matchProcesses(TXT("WorkingSetSize = 18446744073709551615")) == TXT("2048"));
+	TEST_TRUE(matchProcesses(TXT("WorkingSetSize BETWEEN 200000 AND 60000000")) == TXT("4,3000"));
+	TEST_TRUE(matchProcesses(TXT("WorkingSetSize > -1")) == TXT("4,1024,2048,3000"));
+}
+TEST_CASE_END
+
+TEST_CASE("WMI datetimes should be compared with datetime literals")
+{
+	TEST_TRUE(matchProcesses(TXT("CreationDate >= '2012-06-01'")) == TXT("2048,3000"));
+	TEST_TRUE(matchProcesses(TXT("CreationDate < '2012-01-01 09:30'")) == TXT(""));
+	TEST_TRUE(matchProcesses(TXT("CreationDate = '2012-01-01 09:30:00'")) == TXT("1024"));
+	TEST_TRUE(matchProcesses(TXT("CreationDate BETWEEN '2012-01-01' AND '2012-12-31'")) == TXT("1024,2048"));
+	TEST_TRUE(matchProcesses(TXT("CreationDate > '20120615120000.000000+060'")) == TXT("2048,3000"));
+}
+TEST_CASE_END
+
+TEST_CASE("WMI datetimes should be converted to UTC using their timezone offset")
+{
+	TEST_TRUE(matchProcesses(TXT("CreationDate > '2012-06-15 11:00'")) == TXT("2048,3000"));
+	TEST_TRUE(matchProcesses(TXT("CreationDate > '2012-06-15 11:30'")) == TXT("3000"));
+	TEST_TRUE(matchProcesses(TXT("CreationDate = '20120615110000.500000+000'")) == TXT("2048"));
+	TEST_TRUE(matchProcesses(TXT("CreationDate = '20120615060000.500000-300'")) == TXT("2048"));
+	TEST_TRUE(matchProcesses(TXT("CreationDate < '20120101040000.000001-330'")) == TXT("1024"));
+	TEST_TRUE(matchProcesses(TXT("CreationDate < '20130101003000.000000+060'")) == TXT("1024,2048"));
+}
+TEST_CASE_END
+
+TEST_CASE("LIKE should support the WQL wildcards without regard to case")
+{
+	TEST_TRUE(matchProcesses(TXT("Name LIKE 'svc%'")) == TXT("1024,2048"));
+	TEST_TRUE(matchProcesses(TXT("Name LIKE '%.EXE'")) == TXT("1024,2048,3000"));
+	TEST_TRUE(matchProcesses(TXT("Name LIKE 'S_stem'")) == TXT("4"));
+	TEST_TRUE(matchProcesses(TXT("Name LIKE '[a-f]%'")) == TXT("3000"));
+	TEST_TRUE(matchProcesses(TXT("Name LIKE '[^s]%'")) == TXT("3000"));
+	TEST_TRUE(matchProcesses(TXT("Name LIKE '%e%e%'")) == TXT("1024,2048,3000"));
+	TEST_TRUE(matchProcesses(TXT("Name NOT LIKE '%.exe'")) == TXT("4"));
+	TEST_TRUE(matchProcesses(TXT("ProcessId LIKE '4'")) == TXT(""));
+}
+TEST_CASE_END
+
+TEST_CASE("conditions should be combined with AND binding more tightly than OR")
+{
+	TEST_TRUE(matchProcesses(TXT("ProcessId = 4 OR ProcessId > 1000 AND Name LIKE 'e%'")) == TXT("4,3000"));
+	TEST_TRUE(matchProcesses(TXT("(ProcessId = 4 OR ProcessId > 1000) AND Name LIKE 's%'")) == TXT("4,1024,2048"));
+	TEST_TRUE(matchProcesses(TXT("NOT (ProcessId = 4) and not Name like 'svc%'")) == TXT("3000"));
+	TEST_TRUE(matchProcesses(TXT("ProcessId NOT BETWEEN 1000 AND 2500")) == TXT("4,3000"));
+	TEST_TRUE(matchProcesses(TXT("CreationDate IS NULL")) == TXT("4"));
+	TEST_TRUE(matchProcesses(TXT("CreationDate IS NOT NULL")) == TXT("1024,2048,3000"));
+}
+TEST_CASE_END
+
+TEST_CASE("an invalid expression should throw when it's parsed")
+{
+	const tchar* expressions[] =
+	{
+		TXT(""),
+		TXT("ProcessId"),
+		TXT("ProcessId = "),
+		TXT("ProcessId = 1 AND"),
+		TXT("(ProcessId = 1"),
+		TXT("ProcessId = 1)"),
+		TXT("Name = 'svchost"),
+		TXT("Name LIKE 5"),
+		TXT("Name LIKE '[abc'"),
+		TXT("ProcessId BETWEEN 1 OR 2"),
+		TXT("ProcessId ! 1"),
+		TXT("ProcessId NOT = 1"),
+		TXT("CreationDate IS 1"),
+	};
+
+	size_t numThrown = 0;
+
+	for (size_t i = 0; i != ARRAY_SIZE(expressions); ++i)
+	{
+		try
+		{
+			Filter filter(expressions[i]);
+		}
+		catch (const Core::CmdLineException& /*e*/)
+		{
+			++numThrown;
+		}
+	}
+
+	TEST_TRUE(numThrown == ARRAY_SIZE(expressions));
+}
+TEST_CASE_END
+
+TEST_CASE("the columns should be looked up again when the properties change")
+{
+	Filter                     filter(TXT("ProcessId = 1024"));
+	WMI::Object::PropertyNames names;
+	PropertyValues             values;
+
+	setProcess(names, values, s_processes[1]);
+
+	TEST_TRUE(filter.matches(names, values));
+
+	std::reverse(names.begin(), names.end());
+	std::reverse(values.begin(), values.end());
+
+	TEST_TRUE(filter.matches(names, values));
+
+	names.erase(names.begin() + 2);
+	values.erase(values.begin() + 2);
+
+	TEST_FALSE(filter.matches(names, values));
+
+	setProcess(names, values, s_processes[1]);
+
+	TEST_TRUE(filter.matches(names, values));
+
+	names[1] = TXT("ParentProcessId");
+
+	TEST_FALSE(filter.matches(names, values));
+}
+TEST_CASE_END
+
+TEST_CASE("a property that the object does not have should be treated as null")
+{
+	WMI::Object::PropertyNames names;
+	PropertyValues             values;
+
+	setProcess(names, values, s_processes[1]);
+
+	names.erase(names.begin() + 1);
+	values.erase(values.begin() + 1);
+
+	Filter isNull(TXT("ProcessId IS NULL"));
+	Filter notEqual(TXT("NOT ProcessId = 1024"));
+	Filter between(TXT("ProcessId BETWEEN 1 AND 5000 OR Name LIKE 'svc%'"));
+
+	TEST_TRUE(isNull.matches(names, values));
+	TEST_TRUE(notEqual.matches(names, values));
+	TEST_TRUE(between.matches(names, values));
+}
+TEST_CASE_END
+
+TEST_CASE("the source should pass on the headings and limit the matching objects")
+{
+	Filter         filter(TXT("Name LIKE '%.exe'"));
+	ProcessSource  processes;
+	FilterSource   source(processes, &filter, 2);
+	ObjectSnapshot snapshot;
+	tstring        output;
+
+	while (source.next(snapshot))
+	{
+		output += (snapshot.m_isObject) ? snapshot.m_values[0].format() + TXT("\n") : snapshot.m_heading;
+	}
+
+	TEST_TRUE(output == TXT("Host: alpha\nsvchost.exe\nSVCHOST.EXE\n"));
+}
+TEST_CASE_END
+
+TEST_CASE("the source should end the result set once the limit has been reached")
+{
+	Filter         filter(TXT("Name LIKE 'svc%'"));
+	ProcessSource  processes;
+	FilterSource   source(processes, &filter, 1);
+	ObjectSnapshot snapshot;
+	size_t         numObjects = 0;
+
+	while (source.next(snapshot))
+	{
+		if (snapshot.m_isObject)
+			++numObjects;
+	}
+
+	TEST_TRUE(numObjects == 1);
+	TEST_TRUE(processes.numRead() == 2);
+}
+TEST_CASE_END
+
+}
+TEST_SET_END
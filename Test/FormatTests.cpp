@@ -6,6 +6,43 @@
 #include "Common.hpp"
 #include <Core/UnitTest.hpp>
 #include "Format.hpp"
+#include "AllocationCounter.hpp"
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+//! Attach a new one-dimensional array of the given element type to the value.
+
+static void createArray(WCL::Variant& value, VARTYPE type, const void* items, size_t count, size_t itemSize)
+{
+	SAFEARRAY* array = ::SafeArrayCreateVector(type, 0, static_cast<ULONG>(count));
+	void*      data = nullptr;
+
+	::SafeArrayAccessData(array, &data);
+	memcpy(data, items, count * itemSize);
+	::SafeArrayUnaccessData(array);
+
+	V_VT(&value) = static_cast<VARTYPE>(VT_ARRAY | type);
+	V_ARRAY(&value) = array;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Attach a new one-dimensional array of strings to the value.
+
+static void createStringArray(WCL::Variant& value, const wchar_t* const* items, size_t count)
+{
+	SAFEARRAY* array = ::SafeArrayCreateVector(VT_BSTR, 0, static_cast<ULONG>(count));
+
+	for (LONG i = 0; i != static_cast<LONG>(count); ++i)
+	{
+		BSTR item = ::SysAllocString(items[i]);
+
+		::SafeArrayPutElement(array, &i, item);
+		::SysFreeString(item);
+	}
+
+	V_VT(&value) = VT_ARRAY | VT_BSTR;
+	V_ARRAY(&value) = array;
+}
 
 TEST_SET(Format)
 {
@@ -28,13 +65,17 @@ TEST_CASE_END
 
 TEST_CASE("tryConvertDateTime should convert a well-formed WMI datetime")
 {
-	const size_t count = 2;
+	const size_t count = 6;
 
 	const tchar* cases[count][2] = 
 	{
 		//     YYYYMMDDHHMMSS.FFFFFF+TZO
 		{ TXT("20010203040506.123456+060"), TXT("03/02/2001 04:05:06 +060") },
 		{ TXT("20010203040506.123456-060"), TXT("03/02/2001 04:05:06 -060") },
+		{ TXT("19700101000000.000000+000"), TXT("01/01/1970 00:00:00 +000") },
+		{ TXT("20371231235959.999999+000"), TXT("31/12/2037 23:59:59 +000") },
+		{ TXT("19691231235959.999999+000"), TXT("31/12/1969 23:59:59 +000") },
+		{ TXT("20380101000000.000000+000"), TXT("01/01/2038 00:00:00 +000") },
 	};
 
 	for (size_t i = 0; i != count; ++i)
@@ -183,5 +224,195 @@ TEST_CASE("tryConvert64BitInteger should fail when input invalid")
 }
 TEST_CASE_END
 
+TEST_CASE("tryConvert64BitInteger should fail when the value is out of range")
+{
+	const tchar* cases[] = 
+	{
+		TXT("-"),
+		TXT("18446744073709551616"),
+		TXT("-9223372036854775809"),
+	}; 
+
+	const size_t count = ARRAY_SIZE(cases);
+
+	for (size_t i = 0; i != count; ++i)
+	{
+		tstring	actual;
+
+		TEST_FALSE(tryConvert64BitInteger(cases[i], actual));
+	}
+}
+TEST_CASE_END
+
+TEST_CASE("formatting a property should pad the name and only show the type when requested")
+{
+	const tstring      name(TXT("Size"));
+	const WCL::Variant value(static_cast<int32>(1234));
+
+	tstring actual;
+
+	appendProperty(actual, name, 6, value, false, true);
+
+	TEST_TRUE(actual == TXT("Size  : 1,234\n"));
+
+	actual.erase();
+	appendProperty(actual, name, 0, value, true, false);
+
+	TEST_TRUE(actual == TXT("Size [VT_I4]: 1234\n"));
+}
+TEST_CASE_END
+
+TEST_CASE("formatting properties into a reused buffer should not allocate")
+{
+	const tstring      name(TXT("Property"));
+	const WCL::Variant values[] =
+	{
+		WCL::Variant(),
+		WCL::Variant(static_cast<int32>(-123456789)),
+		WCL::Variant(TXT("plain string value")),
+		WCL::Variant(TXT("18446744073709551615")),
+		WCL::Variant(TXT("20010203040506.123456+060")),
+	};
+
+	const size_t count = ARRAY_SIZE(values);
+
+	tstring buffer;
+
+	buffer.reserve(1024);
+
+	const size_t before = allocationCount();
+
+	for (size_t i = 0; i != count; ++i)
+	{
+		buffer.erase();
+
+		appendProperty(buffer, name, 16, values[i], false, true);
+		appendProperty(buffer, name, 16, values[i], false, false);
+	}
+
+	TEST_TRUE(allocationCount() == before);
+}
+TEST_CASE_END
+
+TEST_CASE("formatting an integer array should list every element")
+{
+	const LONG items[] = { 1234, -5, 0 };
+
+	WCL::Variant value;
+
+	createArray(value, VT_I4, items, ARRAY_SIZE(items), sizeof(items[0]));
+
+	TEST_TRUE(formatValue(value, true) == TXT("1234,-5,0"));
+	TEST_TRUE(formatValue(value, false) == TXT("1234,-5,0"));
+}
+TEST_CASE_END
+
+TEST_CASE("formatting an unsigned or boolean array should list every element")
+{
+	const BYTE         bytes[] = { 192, 168, 0, 1 };
+	const VARIANT_BOOL bools[] = { VARIANT_TRUE, VARIANT_FALSE };
+
+	WCL::Variant byteArray, boolArray;
+
+	createArray(byteArray, VT_UI1, bytes, ARRAY_SIZE(bytes), sizeof(bytes[0]));
+	createArray(boolArray, VT_BOOL, bools, ARRAY_SIZE(bools), sizeof(bools[0]));
+
+	TEST_TRUE(formatValue(byteArray, false) == TXT("192,168,0,1"));
+	TEST_TRUE(formatValue(boolArray, true) == TXT("True,False"));
+}
+TEST_CASE_END
+
+TEST_CASE("formatting a string array should apply value detection to each element")
+{
+	const wchar_t* items[] = { L"10.0.0.1", L"20010203040506.123456+060", L"1234" };
+
+	WCL::Variant value;
+
+	createStringArray(value, items, ARRAY_SIZE(items));
+
+	TEST_TRUE(formatValue(value, true) == TXT("10.0.0.1,03/02/2001 04:05:06 +060,1234"));
+	TEST_TRUE(formatValue(value, false) == TXT("10.0.0.1,20010203040506.123456+060,1234"));
+}
+TEST_CASE_END
+
+TEST_CASE("formatting a large array should truncate the output when formatting enabled")
+{
+	const size_t count = 250;
+
+	std::vector<USHORT> items(count, 7);
+
+	WCL::Variant value;
+
+	createArray(value, VT_UI2, &items[0], items.size(), sizeof(items[0]));
+
+	const tstring formatted = formatValue(value, true);
+	const tstring raw = formatValue(value, false);
+
+	TEST_TRUE(tstrstr(formatted.c_str(), TXT(",... (150 more)")) != nullptr);
+	TEST_TRUE(raw.length() == ((count * 2) - 1));
+}
+TEST_CASE_END
+
+TEST_CASE("a column formatter should give the same output as formatting each value on its own")
+{
+	const WCL::Variant values[] =
+	{
+		WCL::Variant(TXT("process.exe")),
+		WCL::Variant(),
+		WCL::Variant(TXT("-42")),
+		WCL::Variant(static_cast<int32>(-123456789)),
+		WCL::Variant(TXT("20101008181758.546000+060")),
+		WCL::Variant(TXT("")),
+	};
+
+	bool allMatch = true;
+
+	for (size_t flags = 0; flags != 4; ++flags)
+	{
+		const bool showTypes = ((flags & 1) != 0);
+		const bool applyFormatting = ((flags & 2) != 0);
+
+		ColumnFormatter formatter(showTypes, applyFormatting);
+
+		for (size_t i = 0; i != ARRAY_SIZE(values); ++i)
+		{
+			tstring expected, actual;
+
+			appendProperty(expected, TXT("Name"), 6, values[i], showTypes, applyFormatting);
+			formatter.appendProperty(actual, TXT("Name"), 6, values[i]);
+
+			allMatch = allMatch && (actual == expected);
+		}
+	}
+
+	TEST_TRUE(allMatch);
+}
+TEST_CASE_END
+
+TEST_CASE("a string column that stopped detecting should still convert a later datetime or 64-bit integer")
+{
+	ColumnFormatter formatter(false, true);
+	tstring         actual;
+
+	for (size_t i = 0; i != (ColumnFormatter::DETECTION_SAMPLE * 2); ++i)
+	{
+		actual.erase();
+		formatter.appendValue(actual, WCL::Variant(TXT("plain text")));
+	}
+
+	TEST_TRUE(actual == TXT("plain text"));
+
+	actual.erase();
+	formatter.appendValue(actual, WCL::Variant(TXT("18446744073709551615")));
+
+	TEST_TRUE(actual == TXT("18,446,744,073,709,551,615"));
+
+	actual.erase();
+	formatter.appendValue(actual, WCL::Variant(TXT("20101008181758.546000+060")));
+
+	TEST_TRUE(actual == formatValue(WCL::Variant(TXT("20101008181758.546000+060")), true));
+}
+TEST_CASE_END
+
 }
 TEST_SET_END
@@ -0,0 +1,294 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   FormattingPipelineTests.cpp
+//! \brief  The unit tests for the FormattingPipeline class.
+//! \author Chris Oldwood
+
+#include "Common.hpp"
+#include <Core/UnitTest.hpp>
+#include "FormattingPipeline.hpp"
+#include <Core/RuntimeException.hpp>
+#include <Core/StringUtils.hpp>
+#include <sstream>
+
+////////////////////////////////////////////////////////////////////////////////
+//! A source of synthetic objects which resemble processes, with a heading
+//! before every 1000 objects. It can also be made to fail part way through.
+
+class SyntheticSource : public ObjectSource
+{
+public:
+	SyntheticSource(size_t numObjects, size_t failAfter)
+		: m_numObjects(numObjects), m_failAfter(failAfter), m_count(0)
+	{
+	}
+
+	virtual bool next(ObjectSnapshot& snapshot)
+	{
+		if (m_count == m_failAfter)
+			throw Core::RuntimeException(TXT("Synthetic failure"));
+
+		if (m_count == m_numObjects)
+			return false;
+
+		snapshot.m_heading = ((m_count % 1000) == 0) ? Core::fmt(TXT("Batch: %u\n"), static_cast<unsigned>(m_count / 1000)) : TXT("");
+		snapshot.m_isObject = true;
+		snapshot.m_names.clear();
+		snapshot.m_names.push_back(TXT("Name"));
+		snapshot.m_names.push_back(TXT("ProcessId"));
+		snapshot.m_names.push_back(TXT("WorkingSetSize"));
+		snapshot.m_values.resize(3);
+		snapshot.m_values[0] = WCL::Variant(Core::fmt(TXT("process%u.exe"), static_cast<unsigned>(m_count)).c_str());
+		snapshot.m_values[1] = WCL::Variant(static_cast<int32>(m_count * 4));
+		snapshot.m_values[2] = WCL::Variant(Core::fmt(TXT("%u"), static_cast<unsigned>(m_count * 65536)).c_str());
+
+		++m_count;
+
+		return true;
+	}
+
+	size_t count() const
+	{
+		return m_count;
+	}
+
+private:
+	size_t	m_numObjects;
+	size_t	m_failAfter;
+	size_t	m_count;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! A fake embedded object which records whether it was used by any thread other
+//! than the one that created it.
+
+class FakeEmbeddedObject : public IUnknown
+{
+public:
+	FakeEmbeddedObject()
+		: m_thread(::GetCurrentThreadId()), m_usedElsewhere(false)
+	{
+	}
+
+	virtual HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** object)
+	{
+		checkThread();
+
+		*object = nullptr;
+
+		if (riid != IID_IUnknown)
+			return E_NOINTERFACE;
+
+		*object = this;
+		return S_OK;
+	}
+
+	virtual ULONG STDMETHODCALLTYPE AddRef()
+	{
+		checkThread();
+		return 1;
+	}
+
+	virtual ULONG STDMETHODCALLTYPE Release()
+	{
+		checkThread();
+		return 1;
+	}
+
+	bool usedElsewhere() const
+	{
+		return m_usedElsewhere;
+	}
+
+private:
+	DWORD			m_thread;
+	volatile bool	m_usedElsewhere;
+
+	void checkThread()
+	{
+		if (::GetCurrentThreadId() != m_thread)
+			m_usedElsewhere = true;
+	}
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! A source where every other object holds an embedded object.
+
+class EmbeddedObjectSource : public ObjectSource
+{
+public:
+	EmbeddedObjectSource(FakeEmbeddedObject& object, size_t numObjects)
+		: m_object(object), m_numObjects(numObjects), m_count(0)
+	{
+	}
+
+	virtual bool next(ObjectSnapshot& snapshot)
+	{
+		if (m_count == m_numObjects)
+			return false;
+
+		snapshot.m_heading.erase();
+		snapshot.m_isObject = true;
+		snapshot.m_names.clear();
+		snapshot.m_names.push_back(TXT("Id"));
+		snapshot.m_names.push_back(TXT("Object"));
+		snapshot.m_values.resize(2);
+		snapshot.m_values[0] = WCL::Variant(static_cast<int32>(m_count));
+		snapshot.m_values[1] = WCL::Variant();
+
+		if ((m_count % 2) == 0)
+		{
+			m_object.AddRef();
+			V_VT(&snapshot.m_values[1]) = VT_UNKNOWN;
+			V_UNKNOWN(&snapshot.m_values[1]) = &m_object;
+		}
+
+		++m_count;
+
+		return true;
+	}
+
+private:
+	FakeEmbeddedObject&	m_object;
+	size_t				m_numObjects;
+	size_t				m_count;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! A sink which fails on the first write.
+
+class FailingSink : public SnapshotSink
+{
+public:
+	virtual void write(const ObjectSnapshot& /*snapshot*/)
+	{
+		throw Core::RuntimeException(TXT("The disk is full"));
+	}
+
+	virtual void flush()
+	{
+	}
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! Format the objects from the source on the calling thread.
+
+static tstring formatInline(ObjectSource& source)
+{
+	ObjectSnapshot snapshot;
+	tstring        output;
+
+	while (source.next(snapshot))
+	{
+		formatSnapshot(snapshot, false, true, true);
+		output += snapshot.m_text;
+	}
+
+	return output;
+}
+
+TEST_SET(FormattingPipeline)
+{
+	const size_t NEVER = static_cast<size_t>(-1);
+
+TEST_CASE("the output should be in the same order as formatting on a single thread")
+{
+	SyntheticSource expectedSource(5000, NEVER);
+	const tstring   expected = formatInline(expectedSource);
+
+	const size_t numWorkers[] = { 1, 2, 4 };
+
+	for (size_t i = 0; i != ARRAY_SIZE(numWorkers); ++i)
+	{
+		SyntheticSource    source(5000, NEVER);
+		FormattingPipeline pipeline(numWorkers[i], false, true, true);
+		tostringstream     out;
+
+		pipeline.run(source, out);
+
+		TEST_TRUE(out.str() == expected);
+	}
+}
+TEST_CASE_END
+
+TEST_CASE("an empty source should produce no output")
+{
+	SyntheticSource    source(0, NEVER);
+	FormattingPipeline pipeline(4, false, true, true);
+	tostringstream     out;
+
+	pipeline.run(source, out);
+
+	TEST_TRUE(out.str().empty());
+}
+TEST_CASE_END
+
+TEST_CASE("an error from the source should be passed on after the earlier objects are written")
+{
+	SyntheticSource expectedSource(250, NEVER);
+	const tstring   expected = formatInline(expectedSource);
+
+	SyntheticSource    source(5000, 250);
+	FormattingPipeline pipeline(4, false, true, true);
+	tostringstream     out;
+	bool               threw = false;
+
+	try
+	{
+		pipeline.run(source, out);
+	}
+	catch (const Core::RuntimeException& /*e*/)
+	{
+		threw = true;
+	}
+
+	TEST_TRUE(threw);
+	TEST_TRUE(out.str() == expected);
+}
+TEST_CASE_END
+
+TEST_CASE("a failing sink should stop the source being read any further")
+{
+	const size_t numWorkers = 4;
+
+	SyntheticSource    source(100000, NEVER);
+	FormattingPipeline pipeline(numWorkers, false, true, true);
+	FailingSink        sink;
+	bool               threw = false;
+
+	try
+	{
+		pipeline.run(source, sink);
+	}
+	catch (const Core::RuntimeException& /*e*/)
+	{
+		threw = true;
+	}
+
+	TEST_TRUE(threw);
+	TEST_TRUE(source.count() <= (numWorkers * FormattingPipeline::SNAPSHOTS_PER_WORKER));
+}
+TEST_CASE_END
+
+TEST_CASE("an embedded object should only be formatted on the thread that read it")
+{
+	FakeEmbeddedObject object;
+
+	{
+		EmbeddedObjectSource expectedSource(object, 1000);
+		const tstring        expected = formatInline(expectedSource);
+
+		EmbeddedObjectSource source(object, 1000);
+		FormattingPipeline   pipeline(4, false, true, true);
+		tostringstream       out;
+
+		pipeline.run(source, out);
+
+		TEST_TRUE(out.str() == expected);
+	}
+
+	TEST_FALSE(object.usedElsewhere());
+}
+TEST_CASE_END
+
+}
+TEST_SET_END
@@ -0,0 +1,364 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   Gunzip.cpp
+//! \brief  A minimal gzip decoder used to check the compressed output.
+//! \author Chris Oldwood
+
+#include "Common.hpp"
+#include "Gunzip.hpp"
+
+namespace
+{
+
+//! Thrown when the stream is malformed.
+struct FormatError
+{
+};
+
+//! The base match length for each length code.
+const uint16 LENGTH_BASE[] =
+{ 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+
+//! The number of extra bits for each length code.
+const uint16 LENGTH_EXTRA[] =
+{ 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+
+//! The base distance for each distance code.
+const uint16 DIST_BASE[] =
+{ 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+
+//! The number of extra bits for each distance code.
+const uint16 DIST_EXTRA[] =
+{ 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+//! The order the code length code lengths are read in.
+const size_t CODELEN_ORDER[] =
+{ 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+//! The longest Huffman code.
+const size_t MAX_BITS = 15;
+
+////////////////////////////////////////////////////////////////////////////////
+//! Reads the stream a byte or a bit at a time.
+
+class Reader
+{
+public:
+	explicit Reader(const ByteBuffer& data)
+		: m_data(data), m_pos(0), m_bitBuffer(0), m_bitCount(0)
+	{
+	}
+
+	uint32 readByte()
+	{
+		if (m_pos == m_data.size())
+			throw FormatError();
+
+		return m_data[m_pos++];
+	}
+
+	uint32 readBits(size_t count)
+	{
+		while (m_bitCount < count)
+		{
+			m_bitBuffer |= readByte() << m_bitCount;
+			m_bitCount += 8;
+		}
+
+		const uint32 value = m_bitBuffer & ((1u << count) - 1);
+
+		m_bitBuffer >>= count;
+		m_bitCount -= count;
+
+		return value;
+	}
+
+	void alignToByte()
+	{
+		m_bitBuffer = 0;
+		m_bitCount = 0;
+	}
+
+	bool atEnd() const
+	{
+		return (m_pos == m_data.size());
+	}
+
+private:
+	const ByteBuffer&	m_data;
+	size_t				m_pos;
+	uint32				m_bitBuffer;
+	size_t				m_bitCount;
+
+	// NotCopyable.
+	Reader(const Reader&);
+	Reader& operator=(const Reader&);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! A canonical Huffman code, decoded a bit at a time.
+
+struct Huffman
+{
+	std::vector<uint16>	m_count;	//!< The number of codes of each length.
+	std::vector<uint16>	m_symbols;	//!< The symbols ordered by code.
+
+	Huffman(const uint16* lengths, size_t count)
+		: m_count(MAX_BITS+1, 0), m_symbols(count, 0)
+	{
+		for (size_t i = 0; i != count; ++i)
+			++m_count[lengths[i]];
+
+		std::vector<uint16> offsets(MAX_BITS+1, 0);
+
+		for (size_t bits = 1; bits != MAX_BITS; ++bits)
+			offsets[bits+1] = static_cast<uint16>(offsets[bits] + m_count[bits]);
+
+		for (size_t i = 0; i != count; ++i)
+		{
+			if (lengths[i] != 0)
+				m_symbols[offsets[lengths[i]]++] = static_cast<uint16>(i);
+		}
+	}
+
+	size_t decode(Reader& reader) const
+	{
+		int code = 0;
+		int first = 0;
+		int index = 0;
+
+		for (size_t bits = 1; bits <= MAX_BITS; ++bits)
+		{
+			code |= reader.readBits(1);
+
+			const int count = m_count[bits];
+
+			if (code - count < first)
+				return m_symbols[index + (code - first)];
+
+			index += count;
+			first += count;
+			first <<= 1;
+			code <<= 1;
+		}
+
+		throw FormatError();
+	}
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! Decode the symbols of a compressed block.
+
+void inflateBlock(Reader& reader, const Huffman& litLen, const Huffman& dist, ByteBuffer& output)
+{
+	for (;;)
+	{
+		const size_t symbol = litLen.decode(reader);
+
+		if (symbol < 256)
+		{
+			output.push_back(static_cast<byte>(symbol));
+		}
+		else if (symbol == 256)
+		{
+			return;
+		}
+		else
+		{
+			const size_t lengthCode = symbol - 257;
+
+			if (lengthCode >= ARRAY_SIZE(LENGTH_BASE))
+				throw FormatError();
+
+			const size_t length = LENGTH_BASE[lengthCode] + reader.readBits(LENGTH_EXTRA[lengthCode]);
+			const size_t distCode = dist.decode(reader);
+
+			if (distCode >= ARRAY_SIZE(DIST_BASE))
+				throw FormatError();
+
+			const size_t distance = DIST_BASE[distCode] + reader.readBits(DIST_EXTRA[distCode]);
+
+			if (distance > output.size())
+				throw FormatError();
+
+			for (size_t i = 0; i != length; ++i)
+			{
+				const byte value = output[output.size() - distance];
+
+				output.push_back(value);
+			}
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Decode a block that uses the fixed codes.
+
+void inflateFixed(Reader& reader, ByteBuffer& output)
+{
+	uint16 lengths[288];
+
+	for (size_t i = 0; i != 288; ++i)
+		lengths[i] = static_cast<uint16>((i < 144) ? 8 : (i < 256) ? 9 : (i < 280) ? 7 : 8);
+
+	uint16 distLengths[30];
+
+	for (size_t i = 0; i != 30; ++i)
+		distLengths[i] = 5;
+
+	inflateBlock(reader, Huffman(lengths, 288), Huffman(distLengths, 30), output);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Decode a block that uses dynamic codes.
+
+void inflateDynamic(Reader& reader, ByteBuffer& output)
+{
+	const size_t numLitLen = reader.readBits(5) + 257;
+	const size_t numDist = reader.readBits(5) + 1;
+	const size_t numCodeLen = reader.readBits(4) + 4;
+
+	uint16 codeLengths[19] = { 0 };
+
+	for (size_t i = 0; i != numCodeLen; ++i)
+		codeLengths[CODELEN_ORDER[i]] = static_cast<uint16>(reader.readBits(3));
+
+	const Huffman codeLength(codeLengths, 19);
+
+	uint16 lengths[286+30] = { 0 };
+
+	for (size_t i = 0; i != numLitLen + numDist; )
+	{
+		const size_t symbol = codeLength.decode(reader);
+
+		if (symbol < 16)
+		{
+			lengths[i++] = static_cast<uint16>(symbol);
+			continue;
+		}
+
+		uint16 value = 0;
+		size_t repeat = 0;
+
+		if (symbol == 16)
+		{
+			if (i == 0)
+				throw FormatError();
+
+			value = lengths[i-1];
+			repeat = 3 + reader.readBits(2);
+		}
+		else if (symbol == 17)
+		{
+			repeat = 3 + reader.readBits(3);
+		}
+		else
+		{
+			repeat = 11 + reader.readBits(7);
+		}
+
+		if (i + repeat > numLitLen + numDist)
+			throw FormatError();
+
+		for (; repeat != 0; --repeat)
+			lengths[i++] = value;
+	}
+
+	inflateBlock(reader, Huffman(lengths, numLitLen), Huffman(lengths + numLitLen, numDist), output);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Calculate the CRC-32 of the data.
+
+uint32 calculateCrc(const ByteBuffer& data)
+{
+	uint32 crc = 0xFFFFFFFF;
+
+	for (size_t i = 0; i != data.size(); ++i)
+	{
+		crc ^= data[i];
+
+		for (size_t bit = 0; bit != 8; ++bit)
+			crc = (crc & 1) ? (0xEDB88320 ^ (crc >> 1)) : (crc >> 1);
+	}
+
+	return ~crc;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Read a little-endian 32-bit value.
+
+uint32 readUint32(Reader& reader)
+{
+	uint32 value = 0;
+
+	for (size_t shift = 0; shift != 32; shift += 8)
+		value |= reader.readByte() << shift;
+
+	return value;
+}
+
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Decompress a gzip stream.
+
+bool tryGunzip(const ByteBuffer& compressed, ByteBuffer& output)
+{
+	output.clear();
+
+	try
+	{
+		Reader reader(compressed);
+
+		// We only expect the header written by GzipEncoder.
+		if ( (reader.readByte() != 0x1F) || (reader.readByte() != 0x8B) || (reader.readByte() != 8) || (reader.readByte() != 0) )
+			return false;
+
+		for (size_t i = 0; i != 6; ++i)
+			reader.readByte();
+
+		bool last = false;
+
+		while (!last)
+		{
+			last = (reader.readBits(1) == 1);
+
+			const uint32 type = reader.readBits(2);
+
+			if (type == 0)
+			{
+				reader.alignToByte();
+
+				const uint32 length = reader.readByte() | (reader.readByte() << 8);
+				reader.readByte();
+				reader.readByte();
+
+				for (uint32 i = 0; i != length; ++i)
+					output.push_back(static_cast<byte>(reader.readByte()));
+			}
+			else if (type == 1)
+			{
+				inflateFixed(reader, output);
+			}
+			else if (type == 2)
+			{
+				inflateDynamic(reader, output);
+			}
+			else
+			{
+				return false;
+			}
+		}
+
+		reader.alignToByte();
+
+		const uint32 crc = readUint32(reader);
+		const uint32 size = readUint32(reader);
+
+		return reader.atEnd() && (crc == calculateCrc(output)) && (size == static_cast<uint32>(output.size()));
+	}
+	catch (const FormatError& /*e*/)
+	{
+		return false;
+	}
+}
@@ -0,0 +1,23 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   Gunzip.hpp
+//! \brief  A minimal gzip decoder used to check the compressed output.
+//! \author Chris Oldwood
+
+// Check for previous inclusion
+#ifndef TEST_GUNZIP_HPP
+#define TEST_GUNZIP_HPP
+
+#if _MSC_VER > 1000
+#pragma once
+#endif
+
+#include "GzipEncoder.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+// Decompress a gzip stream. Returns false if the stream is malformed or the
+// CRC and size in the trailer do not match the decompressed data. This is a
+// straightforward, and slow, decoder which is only intended for tests.
+
+bool tryGunzip(const ByteBuffer& compressed, ByteBuffer& output);
+
+#endif // TEST_GUNZIP_HPP
@@ -0,0 +1,215 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   GzipEncoderTests.cpp
+//! \brief  The unit tests for the GzipEncoder class.
+//! \author Chris Oldwood
+
+#include "Common.hpp"
+#include <Core/UnitTest.hpp>
+#include "GzipEncoder.hpp"
+#include "Gunzip.hpp"
+#include <sstream>
+#include <algorithm>
+
+////////////////////////////////////////////////////////////////////////////////
+//! Create some text that resembles the query output, with enough variation
+//! that both matches and literals are generated.
+
+static ByteBuffer createText(size_t numObjects)
+{
+	std::ostringstream text;
+	uint32             random = 12345;
+
+	for (size_t i = 0; i != numObjects; ++i)
+	{
+		random = (random * 1103515245) + 12345;
+
+		text << "\nName      : svchost.exe\nProcessId : " << (random >> 16) << "\nThreads   : " << (random & 0xFF) << "\n";
+	}
+
+	const std::string output = text.str();
+
+	return ByteBuffer(output.begin(), output.end());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Compress the data, writing it to the encoder in pieces of the given size.
+
+static ByteBuffer compress(const ByteBuffer& data, int level, size_t pieceSize)
+{
+	GzipEncoder encoder(level);
+	ByteBuffer  compressed;
+
+	for (size_t offset = 0; offset < data.size(); offset += pieceSize)
+		encoder.write(&data[offset], std::min(pieceSize, data.size() - offset), compressed);
+
+	encoder.finish(compressed);
+
+	return compressed;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! The text from createText(8) compressed by GNU gzip 1.12 ("gzip -9n"). This
+//! uses a dynamic Huffman block and checks the test decoder against a
+//! reference encoder rather than only our own.
+
+static const byte s_referenceStream[] =
+{
+	0x1F, 0x8B, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x8D, 0xCF, 0x41, 0x0A, 0xC3, 0x40,
+	0x08, 0x05, 0xD0, 0xBD, 0xA7, 0xC8, 0x09, 0xCA, 0xE8, 0xE8, 0x44, 0x7B, 0x83, 0x6E, 0x4A, 0x17,
+	0xBD, 0x40, 0x48, 0x84, 0x6C, 0x4A, 0x20, 0x53, 0x4A, 0x8F, 0xDF, 0x90, 0x9D, 0x5D, 0xE9, 0x52,
+	0x7C, 0xFC, 0x2F, 0xDC, 0xA7, 0x97, 0x0F, 0xE7, 0x5C, 0x87, 0xFE, 0x99, 0xD7, 0xAD, 0xBF, 0x2F,
+	0xFE, 0x75, 0x78, 0xEC, 0xDB, 0xEC, 0xBD, 0xDF, 0x96, 0x63, 0x2F, 0x4C, 0xB5, 0xC1, 0x73, 0xDD,
+	0x7D, 0x5A, 0xFA, 0x79, 0x89, 0xD4, 0x00, 0x32, 0x94, 0x69, 0x94, 0x48, 0x89, 0x6A, 0x8E, 0x0A,
+	0xAB, 0x4A, 0xA0, 0xCC, 0x39, 0x59, 0xD9, 0x34, 0x66, 0xB2, 0x24, 0xEB, 0x5A, 0xB3, 0x98, 0x89,
+	0x55, 0x73, 0x14, 0x5B, 0xE1, 0x48, 0x49, 0x30, 0xF9, 0x29, 0x49, 0xB1, 0xBF, 0xC2, 0xC9, 0xBE,
+	0xAC, 0x56, 0x62, 0x5F, 0xAC, 0xF0, 0x03, 0x0E, 0xCC, 0x55, 0x13, 0xD5, 0x01, 0x00, 0x00,
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! The output of the encoder at the default level for createText(8), which uses
+//! a dynamic Huffman block, and for "123456789", which uses the fixed codes.
+//! Both streams were checked by decompressing them with zlib so that the
+//! encoder is not only tested against a decoder written alongside it.
+
+static const byte s_dynamicStream[] =
+{
+	0x1F, 0x8B, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0B, 0x8C, 0x8F, 0x41, 0x0A, 0xC3, 0x40,
+	0x08, 0x00, 0xEF, 0xBE, 0x22, 0x2F, 0x28, 0xBB, 0xAE, 0x6E, 0xB5, 0x3F, 0xE8, 0xA5, 0xF4, 0xD0,
+	0x0F, 0x84, 0x44, 0xC8, 0xA5, 0x04, 0x62, 0x29, 0x7D, 0x7E, 0x43, 0x6E, 0xE6, 0xA4, 0x47, 0x71,
+	0x98, 0x11, 0x1E, 0xE3, 0xDB, 0x86, 0x63, 0x6E, 0x83, 0x7F, 0xA7, 0x65, 0xF5, 0xCF, 0xC5, 0x7E,
+	0x06, 0xCF, 0x6D, 0x9D, 0xCC, 0xFD, 0x3E, 0xEF, 0x7B, 0x26, 0x6C, 0x1D, 0x5E, 0xCB, 0x66, 0xE3,
+	0xEC, 0xC7, 0x65, 0xC5, 0x0E, 0x29, 0x94, 0xF0, 0xCA, 0x11, 0x45, 0x6C, 0x90, 0xB4, 0x8A, 0x70,
+	0x40, 0x89, 0x72, 0x64, 0x23, 0x95, 0xE8, 0x24, 0x4E, 0xE6, 0x6A, 0xD7, 0xE8, 0xAC, 0x4D, 0x72,
+	0x68, 0xED, 0x85, 0x22, 0x8A, 0x5C, 0x93, 0x9F, 0x22, 0x17, 0x3D, 0x05, 0x27, 0x7B, 0x49, 0xB4,
+	0xC4, 0xDE, 0xDA, 0xE0, 0x3F, 0x00, 0x0E, 0xCC, 0x55, 0x13, 0xD5, 0x01, 0x00, 0x00,
+};
+
+static const byte s_fixedStream[] =
+{
+	0x1F, 0x8B, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0B, 0x32, 0x34, 0x32, 0x36, 0x31, 0x35,
+	0x33, 0xB7, 0xB0, 0x04, 0x0C, 0x00, 0x26, 0x39, 0xF4, 0xCB, 0x09, 0x00, 0x00, 0x00,
+};
+
+TEST_SET(GzipEncoder)
+{
+
+TEST_CASE("an empty stream should only contain the header and trailer")
+{
+	GzipEncoder encoder;
+	ByteBuffer  compressed;
+
+	encoder.finish(compressed);
+
+	TEST_TRUE(compressed.size() == 20);
+	TEST_TRUE((compressed[0] == 0x1F) && (compressed[1] == 0x8B) && (compressed[2] == 8));
+
+	ByteBuffer output;
+
+	TEST_TRUE(tryGunzip(compressed, output));
+	TEST_TRUE(output.empty());
+}
+TEST_CASE_END
+
+TEST_CASE("the trailer should contain the CRC-32 and size of the data")
+{
+	const char   text[] = "123456789";
+	const byte*  data = reinterpret_cast<const byte*>(text);
+	GzipEncoder  encoder;
+	ByteBuffer   compressed;
+
+	encoder.write(data, 9, compressed);
+	encoder.finish(compressed);
+
+	const byte expected[] = { 0x26, 0x39, 0xF4, 0xCB, 0x09, 0x00, 0x00, 0x00 };
+
+	TEST_TRUE(std::equal(expected, expected+8, compressed.end()-8));
+}
+TEST_CASE_END
+
+TEST_CASE("compressed data should decompress to the original data at every level")
+{
+	const ByteBuffer data = createText(10000);
+
+	for (int level = GzipEncoder::MIN_LEVEL; level <= GzipEncoder::MAX_LEVEL; ++level)
+	{
+		ByteBuffer output;
+
+		TEST_TRUE(tryGunzip(compress(data, level, 1000), output));
+		TEST_TRUE(output == data);
+	}
+}
+TEST_CASE_END
+
+TEST_CASE("data written a byte at a time should decompress to the original data")
+{
+	const ByteBuffer data = createText(5000);
+
+	ByteBuffer output1, output2;
+
+	TEST_TRUE(tryGunzip(compress(data, GzipEncoder::DEFAULT_LEVEL, 1), output1));
+	TEST_TRUE(tryGunzip(compress(data, GzipEncoder::DEFAULT_LEVEL, data.size()), output2));
+	TEST_TRUE((output1 == data) && (output2 == data));
+}
+TEST_CASE_END
+
+TEST_CASE("repetitive text should compress well")
+{
+	const std::string line = "Caption : Microsoft Windows Server 2008 R2 Enterprise\n";
+
+	std::string text;
+
+	for (size_t i = 0; i != 20000; ++i)
+		text += line;
+
+	const ByteBuffer data(text.begin(), text.end());
+	const ByteBuffer compressed = compress(data, GzipEncoder::DEFAULT_LEVEL, 4096);
+
+	TEST_TRUE(compressed.size() < (data.size() / 100));
+}
+TEST_CASE_END
+
+TEST_CASE("incompressible data should not grow significantly")
+{
+	ByteBuffer data(100000);
+	uint32     random = 1;
+
+	for (size_t i = 0; i != data.size(); ++i)
+	{
+		random = (random * 1103515245) + 12345;
+		data[i] = static_cast<byte>(random >> 24);
+	}
+
+	const ByteBuffer compressed = compress(data, GzipEncoder::MAX_LEVEL, 65536);
+
+	TEST_TRUE(compressed.size() < (data.size() + (data.size() / 100)));
+
+	ByteBuffer output;
+
+	TEST_TRUE(tryGunzip(compressed, output));
+	TEST_TRUE(output == data);
+}
+TEST_CASE_END
+
+TEST_CASE("the test decoder should decompress a stream from a reference gzip encoder")
+{
+	const ByteBuffer compressed(s_referenceStream, s_referenceStream+ARRAY_SIZE(s_referenceStream));
+	ByteBuffer       output;
+
+	TEST_TRUE(tryGunzip(compressed, output));
+	TEST_TRUE(output == createText(8));
+}
+TEST_CASE_END
+
+TEST_CASE("the output should match the streams verified with an independent decoder")
+{
+	const char       text[] = "123456789";
+	const ByteBuffer digits(text, text+9);
+	const ByteBuffer data = createText(8);
+
+	TEST_TRUE(compress(data, GzipEncoder::DEFAULT_LEVEL, data.size()) == ByteBuffer(s_dynamicStream, s_dynamicStream+ARRAY_SIZE(s_dynamicStream)));
+	TEST_TRUE(compress(digits, GzipEncoder::DEFAULT_LEVEL, digits.size()) == ByteBuffer(s_fixedStream, s_fixedStream+ARRAY_SIZE(s_fixedStream)));
+}
+TEST_CASE_END
+
+}
+TEST_SET_END
@@ -0,0 +1,268 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   HostFilesTests.cpp
+//! \brief  The unit tests for the HostFiles class.
+//! \author Chris Oldwood
+
+#include "Common.hpp"
+#include <Core/UnitTest.hpp>
+#include "HostFiles.hpp"
+#include <Core/StringUtils.hpp>
+#include <Core/RuntimeException.hpp>
+#include <Core/AnsiWide.hpp>
+#include <WMI/Connection.hpp>
+#include <fstream>
+#include <iterator>
+
+////////////////////////////////////////////////////////////////////////////////
+//! Create a unique name for a temporary folder.
+
+static tstring createTempFolder()
+{
+	tchar folder[MAX_PATH+1] = { 0 };
+
+	::GetTempPath(MAX_PATH, folder);
+
+	return Core::fmt(TXT("%sWMICmdTest-%u-hosts"), folder, ::GetCurrentProcessId());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Read the entire file, if it exists, and then delete it.
+
+static std::string readAndDeleteFile(const tstring& filename)
+{
+	std::string contents;
+
+	{
+		std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary);
+
+		contents.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	}
+
+	::DeleteFile(filename.c_str());
+
+	return contents;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Does the file exist?
+
+static bool fileExists(const tstring& filename)
+{
+	return (::GetFileAttributes(filename.c_str()) != INVALID_FILE_ATTRIBUTES);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Write a host heading to the sink.
+
+static void writeHeading(HostFiles& files, const tstring& host)
+{
+	ObjectSnapshot snapshot;
+
+	snapshot.m_isObject = false;
+	snapshot.m_heading = Core::fmt(TXT("\nHost: %s\n"), host.c_str());
+	snapshot.m_text = snapshot.m_heading;
+
+	files.write(snapshot);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Write some formatted object text to the sink.
+
+static void writeObject(HostFiles& files, const tstring& text)
+{
+	ObjectSnapshot snapshot;
+
+	snapshot.m_isObject = true;
+	snapshot.m_text = text;
+
+	files.write(snapshot);
+}
+
+TEST_SET(HostFiles)
+{
+
+TEST_CASE("each host's output should be written to its own file without the host heading")
+{
+	const tstring folder = createTempFolder();
+
+	{
+		HostFiles files(folder, false, 2, HostFiles::DEFAULT_MAX_OPEN_FILES);
+
+		writeHeading(files, TXT("alpha"));
+		writeObject(files, TXT("Name: a1\n"));
+		writeObject(files, TXT("Name: a2\n"));
+		writeHeading(files, TXT("beta"));
+		writeHeading(files, TXT("gamma"));
+		writeObject(files, TXT("Name: g1\n"));
+
+		files.close();
+	}
+
+	TEST_TRUE(!fileExists(folder + TXT("\\alpha.txt.tmp")));
+	TEST_TRUE(readAndDeleteFile(folder + TXT("\\alpha.txt")) == "Name: a1\nName: a2\n");
+	TEST_TRUE(fileExists(folder + TXT("\\beta.txt")));
+	TEST_TRUE(readAndDeleteFile(folder + TXT("\\beta.txt")).empty());
+	TEST_TRUE(readAndDeleteFile(folder + TXT("\\gamma.txt")) == "Name: g1\n");
+
+	::RemoveDirectory(folder.c_str());
+}
+TEST_CASE_END
+
+TEST_CASE("the host heading should be kept when requested")
+{
+	const tstring folder = createTempFolder();
+
+	{
+		HostFiles files(folder, true, 1, 1);
+
+		writeHeading(files, TXT("alpha"));
+		writeObject(files, TXT("Name: a1\n"));
+
+		files.close();
+	}
+
+	TEST_TRUE(readAndDeleteFile(folder + TXT("\\alpha.txt")) == "\nHost: alpha\nName: a1\n");
+
+	::RemoveDirectory(folder.c_str());
+}
+TEST_CASE_END
+
+TEST_CASE("a host's output should stay in order when it spans many chunks and only one file is open at once")
+{
+	const tstring folder = createTempFolder();
+	const tstring line(1000, TXT('x'));
+	const size_t  numLines = (HostFiles::CHUNK_SIZE * HostFiles::CHUNKS_PER_WRITER * 2) / line.length();
+
+	tstring expected;
+
+	{
+		HostFiles files(folder, false, 2, 1);
+
+		for (size_t host = 0; host != 3; ++host)
+		{
+			writeHeading(files, Core::fmt(TXT("host%u"), static_cast<unsigned>(host)));
+
+			for (size_t i = 0; i != numLines; ++i)
+				writeObject(files, Core::fmt(TXT("%u:%s\n"), static_cast<unsigned>(i), line.c_str()));
+		}
+
+		files.close();
+	}
+
+	for (size_t i = 0; i != numLines; ++i)
+		expected += Core::fmt(TXT("%u:%s\n"), static_cast<unsigned>(i), line.c_str());
+
+	bool allMatch = true;
+
+	for (size_t host = 0; host != 3; ++host)
+	{
+		const tstring filename = Core::fmt(TXT("%s\\host%u.txt"), folder.c_str(), static_cast<unsigned>(host));
+
+		allMatch = allMatch && (readAndDeleteFile(filename) == std::string(T2A(expected.c_str())));
+	}
+
+	TEST_TRUE(allMatch);
+
+	::RemoveDirectory(folder.c_str());
+}
+TEST_CASE_END
+
+TEST_CASE("output before the first host heading should be rejected")
+{
+	const tstring folder = createTempFolder();
+
+	{
+		HostFiles files(folder, false, 1, 1);
+		bool      threw = false;
+
+		try
+		{
+			writeObject(files, TXT("Name: a1\n"));
+		}
+		catch (const Core::RuntimeException& /*e*/)
+		{
+			threw = true;
+		}
+
+		TEST_TRUE(threw);
+
+		files.close();
+	}
+
+	::RemoveDirectory(folder.c_str());
+}
+TEST_CASE_END
+
+TEST_CASE("the filename should be the hostname with any invalid characters replaced")
+{
+	TEST_TRUE(HostFiles::getFilename(TXT("server01")) == TXT("server01.txt"));
+	TEST_TRUE(HostFiles::getFilename(TXT("fe80::1")) == TXT("fe80__1.txt"));
+	TEST_TRUE(HostFiles::getFilename(WMI::Connection::LOCALHOST) == TXT("localhost.txt"));
+}
+TEST_CASE_END
+
+TEST_CASE("hosts which would be written to the same file should be rejected")
+{
+	Hostnames hosts;
+
+	hosts.push_back(TXT("server01"));
+	hosts.push_back(TXT("fe80::1"));
+
+	HostFiles::checkFilenames(hosts);
+
+	const tchar* const duplicates[] = { TXT("server01"), TXT("SERVER01"), TXT("fe80__1") };
+
+	for (size_t i = 0; i != ARRAY_SIZE(duplicates); ++i)
+	{
+		Hostnames withDuplicate = hosts;
+		bool      threw = false;
+
+		withDuplicate.push_back(duplicates[i]);
+
+		try
+		{
+			HostFiles::checkFilenames(withDuplicate);
+		}
+		catch (const Core::RuntimeException& /*e*/)
+		{
+			threw = true;
+		}
+
+		TEST_TRUE(threw);
+	}
+}
+TEST_CASE_END
+
+TEST_CASE("a host heading for a file already written should be rejected")
+{
+	const tstring folder = createTempFolder();
+
+	{
+		HostFiles files(folder, false, 1, 1);
+		bool      threw = false;
+
+		writeHeading(files, TXT("a:b"));
+		writeObject(files, TXT("Name: a1\n"));
+
+		try
+		{
+			writeHeading(files, TXT("a_b"));
+		}
+		catch (const Core::RuntimeException& /*e*/)
+		{
+			threw = true;
+		}
+
+		TEST_TRUE(threw);
+
+		files.close();
+	}
+
+	TEST_TRUE(readAndDeleteFile(folder + TXT("\\a_b.txt")) == "Name: a1\n");
+
+	::RemoveDirectory(folder.c_str());
+}
+TEST_CASE_END
+
+}
+TEST_SET_END
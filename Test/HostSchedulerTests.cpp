@@ -0,0 +1,272 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   HostSchedulerTests.cpp
+//! \brief  The unit tests for the HostScheduler and AdaptiveLimit classes.
+//! \author Chris Oldwood
+
+#include "Common.hpp"
+#include <Core/UnitTest.hpp>
+#include "HostScheduler.hpp"
+#include <Core/StringUtils.hpp>
+#include <map>
+#include <algorithm>
+
+////////////////////////////////////////////////////////////////////////////////
+//! A fake backend whose latency depends on the load. Every host takes a base
+//! time plus a little for each host in flight, until the collector reaches its
+//! knee and then the latency climbs steeply. Hosts in the WAN site are slower
+//! still and suffer badly if more than two of them are queried at once.
+
+class FakeBackend
+{
+public:
+	FakeBackend(size_t knee)
+		: m_knee(knee)
+	{
+	}
+
+	DWORD latency(size_t inFlight, bool isWan, size_t wanInFlight) const
+	{
+		DWORD latency = 100 + static_cast<DWORD>(inFlight * 10);
+
+		if (inFlight > m_knee)
+			latency += static_cast<DWORD>((inFlight - m_knee) * 250);
+
+		if (isWan)
+		{
+			latency += 300;
+
+			if (wanInFlight > 2)
+				latency += static_cast<DWORD>((wanInFlight - 2) * 1000);
+		}
+
+		return latency;
+	}
+
+private:
+	size_t	m_knee;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! The results of a simulated sweep.
+
+struct SweepStats
+{
+	size_t				m_numFinished;		//!< The number of hosts finished.
+	size_t				m_maxInFlight;		//!< The most hosts in flight.
+	size_t				m_maxWanInFlight;	//!< The most WAN hosts in flight.
+	size_t				m_maxSubnetInFlight;//!< The most subnet hosts in flight.
+	std::vector<DWORD>	m_latencies;		//!< The latencies in finishing order.
+	DWORD				m_elapsed;			//!< The time taken for the sweep.
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! Run a discrete event simulation of a sweep of the hosts. A host's latency
+//! is decided by the load at the moment it's started.
+
+static SweepStats simulateSweep(const Hostnames& hosts, const HostAnnotations& annotations, const AdaptiveLimit& limit, const FakeBackend& backend)
+{
+	typedef std::multimap<DWORD, size_t> Events;
+
+	HostScheduler scheduler(hosts, annotations, limit);
+	Events        events;
+	DWORD         now = 0;
+	SweepStats    stats = { 0, 0, 0, 0, std::vector<DWORD>(), 0 };
+	std::vector<DWORD> latencies(hosts.size());
+	std::vector<bool>  isWan(hosts.size());
+	std::vector<bool>  isSubnet(hosts.size());
+	size_t        wanInFlight = 0;
+	size_t        subnetInFlight = 0;
+
+	for (size_t i = 0; i != hosts.size(); ++i)
+	{
+		HostSites::const_iterator it = annotations.m_sites.find(hosts[i]);
+
+		isWan[i] = (it != annotations.m_sites.end()) && (it->second == TXT("WAN"));
+		isSubnet[i] = (hosts[i].compare(0, 5, TXT("10.0.")) == 0);
+	}
+
+	while (!scheduler.isDone())
+	{
+		size_t host = 0;
+
+		while (scheduler.tryStart(host))
+		{
+			if (isWan[host])
+				++wanInFlight;
+
+			if (isSubnet[host])
+				++subnetInFlight;
+
+			latencies[host] = backend.latency(scheduler.numInFlight(), isWan[host], wanInFlight);
+			events.insert(Events::value_type(now + latencies[host], host));
+
+			stats.m_maxInFlight = std::max(stats.m_maxInFlight, scheduler.numInFlight());
+			stats.m_maxWanInFlight = std::max(stats.m_maxWanInFlight, wanInFlight);
+			stats.m_maxSubnetInFlight = std::max(stats.m_maxSubnetInFlight, subnetInFlight);
+		}
+
+		ASSERT(!events.empty());
+
+		Events::iterator next = events.begin();
+
+		now = next->first;
+		host = next->second;
+		events.erase(next);
+
+		if (isWan[host])
+			--wanInFlight;
+
+		if (isSubnet[host])
+			--subnetInFlight;
+
+		scheduler.finish(host, latencies[host]);
+		stats.m_latencies.push_back(latencies[host]);
+		++stats.m_numFinished;
+	}
+
+	stats.m_elapsed = now;
+
+	return stats;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Calculate the 95th percentile of the latencies.
+
+static DWORD percentile95(std::vector<DWORD> latencies)
+{
+	std::sort(latencies.begin(), latencies.end());
+
+	return latencies[((latencies.size() * 95) + 99) / 100 - 1];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Create a list of numbered hosts.
+
+static Hostnames createHosts(const tchar* format, size_t count)
+{
+	Hostnames hosts;
+
+	for (size_t i = 0; i != count; ++i)
+		hosts.push_back(Core::fmt(format, static_cast<unsigned>(i)));
+
+	return hosts;
+}
+
+TEST_SET(HostScheduler)
+{
+	const DWORD TARGET = 1000;
+
+TEST_CASE("the limit should be raised whilst the latency is within the target")
+{
+	AdaptiveLimit limit(2, 1, 10, TARGET);
+
+	for (size_t i = 0; i != AdaptiveLimit::MIN_SAMPLES; ++i)
+		limit.addLatency(TARGET, limit.generation());
+
+	TEST_TRUE(limit.limit() == 3);
+}
+TEST_CASE_END
+
+TEST_CASE("the limit should be halved when the latency exceeds the target and later latencies from before the cut ignored")
+{
+	AdaptiveLimit limit(8, 1, 10, TARGET);
+
+	for (size_t i = 0; i != 8; ++i)
+		limit.addLatency(TARGET * 2, 0);
+
+	TEST_TRUE(limit.limit() == 4);
+	TEST_TRUE(limit.generation() == 1);
+
+	for (size_t i = 0; i != 8; ++i)
+		limit.addLatency(TARGET * 2, 0);
+
+	TEST_TRUE(limit.limit() == 4);
+}
+TEST_CASE_END
+
+TEST_CASE("only the hosts before the end should be started and the first pending one reported")
+{
+	const Hostnames hosts = createHosts(TXT("host%u"), 5);
+	HostAnnotations annotations;
+	HostScheduler   scheduler(hosts, annotations, AdaptiveLimit(4, 1, 4, TARGET));
+	size_t          host = 0;
+
+	TEST_TRUE(scheduler.firstPending() == 0);
+	TEST_TRUE(scheduler.tryStart(host, 2) && (host == 0));
+	TEST_TRUE(scheduler.tryStart(host, 2) && (host == 1));
+	TEST_FALSE(scheduler.tryStart(host, 2));
+	TEST_TRUE(scheduler.firstPending() == 2);
+
+	scheduler.finish(0, 10);
+
+	TEST_TRUE(scheduler.tryStart(host, 5) && (host == 2));
+	TEST_TRUE(scheduler.tryStart(host, 5) && (host == 3));
+	TEST_TRUE(scheduler.tryStart(host, 5) && (host == 4));
+	TEST_TRUE(scheduler.firstPending() == hosts.size());
+}
+TEST_CASE_END
+
+TEST_CASE("a sweep should ramp up to the collector's knee and keep the p95 latency near the target")
+{
+	const Hostnames hosts = createHosts(TXT("host%u"), 2000);
+	HostAnnotations annotations;
+	FakeBackend     backend(40);
+
+	SweepStats stats = simulateSweep(hosts, annotations, AdaptiveLimit(4, 1, 64, TARGET), backend);
+
+	TEST_TRUE(stats.m_numFinished == hosts.size());
+	TEST_TRUE(stats.m_maxInFlight > 32);
+	TEST_TRUE(stats.m_maxInFlight <= 64);
+	TEST_TRUE(percentile95(stats.m_latencies) <= (TARGET * 3) / 2);
+
+	SweepStats serial = simulateSweep(hosts, annotations, AdaptiveLimit(1, 1, 1, TARGET), backend);
+
+	TEST_TRUE((stats.m_elapsed * 5) < serial.m_elapsed);
+}
+TEST_CASE_END
+
+TEST_CASE("a sweep should back off when the collector is overloaded")
+{
+	const Hostnames hosts = createHosts(TXT("host%u"), 2000);
+	HostAnnotations annotations;
+	FakeBackend     backend(8);
+
+	SweepStats stats = simulateSweep(hosts, annotations, AdaptiveLimit(32, 1, 64, TARGET), backend);
+
+	const std::vector<DWORD> lastHalf(stats.m_latencies.begin() + (stats.m_latencies.size() / 2), stats.m_latencies.end());
+
+	TEST_TRUE(stats.m_numFinished == hosts.size());
+	TEST_TRUE(percentile95(lastHalf) <= (TARGET * 3) / 2);
+}
+TEST_CASE_END
+
+TEST_CASE("a sweep should never exceed the caps on a site or subnet")
+{
+	Hostnames       hosts = createHosts(TXT("host%u"), 100);
+	const Hostnames wanHosts = createHosts(TXT("wan%u"), 20);
+	const Hostnames subnetHosts = createHosts(TXT("10.0.0.%u"), 20);
+	HostAnnotations annotations;
+
+	hosts.insert(hosts.begin() + 10, wanHosts.begin(), wanHosts.end());
+	hosts.insert(hosts.end(), subnetHosts.begin(), subnetHosts.end());
+
+	for (Hostnames::const_iterator it = wanHosts.begin(); it != wanHosts.end(); ++it)
+		annotations.m_sites[*it] = TXT("WAN");
+
+	GroupLimit wanLimit = { false, TXT("WAN"), 0, 0, 2 };
+	GroupLimit subnetLimit = { true, tstring(), 0x0A000000, 0xFFFFFF00, 3 };
+
+	annotations.m_limits.push_back(wanLimit);
+	annotations.m_limits.push_back(subnetLimit);
+
+	SweepStats stats = simulateSweep(hosts, annotations, AdaptiveLimit(4, 1, 64, TARGET), FakeBackend(40));
+
+	TEST_TRUE(stats.m_numFinished == hosts.size());
+	TEST_TRUE(stats.m_maxWanInFlight == 2);
+	TEST_TRUE(stats.m_maxSubnetInFlight == 3);
+	TEST_TRUE(stats.m_maxInFlight > 4);
+}
+TEST_CASE_END
+
+}
+TEST_SET_END
@@ -0,0 +1,64 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   HostsTests.cpp
+//! \brief  The unit tests for the hosts helper functions.
+//! \author Chris Oldwood
+
+#include "Common.hpp"
+#include <Core/UnitTest.hpp>
+#include "Hosts.hpp"
+#include <Core/StringUtils.hpp>
+#include <fstream>
+
+TEST_SET(Hosts)
+{
+
+TEST_CASE("a hosts file should be read with its site annotations and limits")
+{
+	tchar folder[MAX_PATH+1] = { 0 };
+
+	::GetTempPath(MAX_PATH, folder);
+
+	const tstring filename = Core::fmt(TXT("%sWMICmdTest-%u.hosts"), folder, ::GetCurrentProcessId());
+
+	{
+		std::ofstream file(filename.c_str());
+
+		file << "# Caps on the hosts queried at once.\n";
+		file << "@limit site=London 2\n";
+		file << "@limit subnet=10.1.0.0/16 4  # The lab.\n";
+		file << "\n";
+		file << "host01 site=London\n";
+		file << "10.1.2.3\n";
+	}
+
+	HostAnnotations annotations;
+	Hostnames       hosts = readHostsFile(filename, annotations);
+
+	::DeleteFile(filename.c_str());
+
+	TEST_TRUE(hosts.size() == 2);
+	TEST_TRUE(hosts[0] == TXT("host01"));
+	TEST_TRUE(hosts[1] == TXT("10.1.2.3"));
+	TEST_TRUE(annotations.m_sites[TXT("host01")] == TXT("London"));
+	TEST_TRUE(annotations.m_limits.size() == 2);
+	TEST_TRUE(!annotations.m_limits[0].m_isSubnet && (annotations.m_limits[0].m_site == TXT("London")));
+	TEST_TRUE(annotations.m_limits[0].m_max == 2);
+	TEST_TRUE(annotations.m_limits[1].m_isSubnet && (annotations.m_limits[1].m_network == 0x0A010000));
+	TEST_TRUE(annotations.m_limits[1].m_mask == 0xFFFF0000);
+	TEST_TRUE(annotations.m_limits[1].m_max == 4);
+}
+TEST_CASE_END
+
+TEST_CASE("only a well formed dotted address should be parsed as IPv4")
+{
+	uint32 address = 0;
+
+	TEST_TRUE(tryParseIPv4(TXT("192.168.1.10"), address) && (address == 0xC0A8010A));
+	TEST_FALSE(tryParseIPv4(TXT("192.168.1"), address));
+	TEST_FALSE(tryParseIPv4(TXT("192.168.1.256"), address));
+	TEST_FALSE(tryParseIPv4(TXT("host01"), address));
+}
+TEST_CASE_END
+
+}
+TEST_SET_END
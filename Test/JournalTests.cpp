@@ -0,0 +1,227 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   JournalTests.cpp
+//! \brief  The unit tests for the Journal and JournalSink classes.
+//! \author Chris Oldwood
+
+#include "Common.hpp"
+#include <Core/UnitTest.hpp>
+#include "Journal.hpp"
+#include "AsyncFileWriter.hpp"
+#include "Utf8StreamBuf.hpp"
+#include <Core/StringUtils.hpp>
+#include <Core/RuntimeException.hpp>
+#include <fstream>
+#include <iterator>
+
+////////////////////////////////////////////////////////////////////////////////
+//! Create a unique name for a temporary file.
+
+static tstring createTempFilename(const tchar* suffix)
+{
+	tchar folder[MAX_PATH+1] = { 0 };
+
+	::GetTempPath(MAX_PATH, folder);
+
+	return Core::fmt(TXT("%sWMICmdTest-%u%s"), folder, ::GetCurrentProcessId(), suffix);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Replace the file's contents with the text.
+
+static void writeFile(const tstring& filename, const char* text)
+{
+	std::ofstream file(filename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+
+	file << text;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Read the entire file and then delete it.
+
+static std::string readAndDeleteFile(const tstring& filename)
+{
+	std::string contents;
+
+	{
+		std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary);
+
+		contents.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	}
+
+	::DeleteFile(filename.c_str());
+
+	return contents;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Write a snapshot with the heading or object text to the sink.
+
+static void writeSnapshot(SnapshotSink& sink, bool isObject, const tstring& text)
+{
+	ObjectSnapshot snapshot;
+
+	snapshot.m_sequence = 0;
+	snapshot.m_isObject = isObject;
+	snapshot.m_heading = (isObject) ? TXT("") : text;
+	snapshot.m_text = text;
+
+	sink.write(snapshot);
+}
+
+TEST_SET(Journal)
+{
+
+TEST_CASE("the completed hosts should be read back in the order they were recorded")
+{
+	const tstring filename = createTempFilename(TXT(".journal"));
+
+	{
+		Journal journal(filename, false);
+
+		journal.hostCompleted(TXT("alpha"), TXT("OK"), 10);
+		journal.hostCompleted(TXT("beta"), TXT("OK"), 25);
+
+		journal.close();
+	}
+
+	{
+		Journal journal(filename, true);
+
+		journal.hostCompleted(TXT("gamma"), TXT("OK"), 40);
+
+		journal.close();
+	}
+
+	const JournalEntries entries = readJournal(filename);
+
+	TEST_TRUE(entries.size() == 3);
+	TEST_TRUE( (entries[0].m_host == TXT("alpha")) && (entries[0].m_status == TXT("OK")) && (entries[0].m_offset == 10) );
+	TEST_TRUE( (entries[1].m_host == TXT("beta")) && (entries[1].m_offset == 25) );
+	TEST_TRUE( (entries[2].m_host == TXT("gamma")) && (entries[2].m_offset == 40) );
+
+	::DeleteFile(filename.c_str());
+}
+TEST_CASE_END
+
+TEST_CASE("reading a journal that does not exist should return no entries")
+{
+	TEST_TRUE(readJournal(createTempFilename(TXT(".nosuchjournal"))).empty());
+}
+TEST_CASE_END
+
+TEST_CASE("an incomplete final line should be ignored")
+{
+	const tstring filename = createTempFilename(TXT(".journal"));
+
+	writeFile(filename, "OK 10 alpha\nOK 25 bet");
+
+	TEST_TRUE(readJournal(filename).size() == 1);
+
+	writeFile(filename, "OK 10 alpha\nOK 2");
+
+	TEST_TRUE(readJournal(filename).size() == 1);
+
+	::DeleteFile(filename.c_str());
+}
+TEST_CASE_END
+
+TEST_CASE("a malformed line before the final one should throw")
+{
+	const tstring filename = createTempFilename(TXT(".journal"));
+	bool          threw = false;
+
+	writeFile(filename, "OK 10 alpha\nrubbish\nOK 25 beta\n");
+
+	try
+	{
+		readJournal(filename);
+	}
+	catch (const Core::RuntimeException& /*e*/)
+	{
+		threw = true;
+	}
+
+	TEST_TRUE(threw);
+
+	::DeleteFile(filename.c_str());
+}
+TEST_CASE_END
+
+TEST_CASE("each host should be recorded with the size of the output once it has been written")
+{
+	const tstring outputFile = createTempFilename(TXT(".txt"));
+	const tstring journalFile = createTempFilename(TXT(".journal"));
+
+	{
+		AsyncFileWriter	file(outputFile, 0);
+		Utf8StreamBuf	buffer(file);
+		tostream		out(&buffer);
+		StreamSink		output(out);
+		Journal			journal(journalFile, false);
+		JournalSink		sink(output, journal, &file, false);
+
+		writeSnapshot(sink, false, TXT("\nHost: alpha\n"));
+		writeSnapshot(sink, true, TXT("a1\n"));
+		writeSnapshot(sink, true, TXT("a2\n"));
+		writeSnapshot(sink, false, TXT("\nHost: beta\n"));
+		writeSnapshot(sink, true, TXT("b1\n"));
+
+		sink.close();
+		journal.close();
+
+		out.flush();
+		file.close();
+	}
+
+	const JournalEntries entries = readJournal(journalFile);
+
+	TEST_TRUE(entries.size() == 2);
+	TEST_TRUE( (entries[0].m_host == TXT("alpha")) && (entries[0].m_offset == 6) );
+	TEST_TRUE( (entries[1].m_host == TXT("beta")) && (entries[1].m_offset == 9) );
+	TEST_TRUE(readAndDeleteFile(outputFile) == "a1\na2\nb1\n");
+
+	::DeleteFile(journalFile.c_str());
+}
+TEST_CASE_END
+
+TEST_CASE("a host that reported an error should be recorded as failed")
+{
+	const tstring outputFile = createTempFilename(TXT(".txt"));
+	const tstring journalFile = createTempFilename(TXT(".journal"));
+
+	{
+		AsyncFileWriter	file(outputFile, 0);
+		Utf8StreamBuf	buffer(file);
+		tostream		out(&buffer);
+		StreamSink		output(out);
+		Journal			journal(journalFile, false);
+		JournalSink		sink(output, journal, &file, false);
+
+		writeSnapshot(sink, false, TXT("\nHost: alpha\n"));
+		writeSnapshot(sink, true, TXT("a1\n"));
+		writeSnapshot(sink, false, TXT("\nError: The RPC server is unavailable.\n"));
+		writeSnapshot(sink, false, TXT("\nHost: beta\n"));
+		writeSnapshot(sink, true, TXT("b1\n"));
+
+		sink.close();
+		journal.close();
+
+		out.flush();
+		file.close();
+	}
+
+	const JournalEntries entries = readJournal(journalFile);
+
+	TEST_TRUE(entries.size() == 2);
+	TEST_TRUE( (entries[0].m_host == TXT("alpha")) && (entries[0].m_status == TXT("FAILED")) );
+	TEST_TRUE( (entries[1].m_host == TXT("beta")) && (entries[1].m_status == TXT("OK")) );
+	TEST_FALSE(entries[0].succeeded());
+	TEST_TRUE(entries[1].succeeded());
+
+	::DeleteFile(outputFile.c_str());
+	::DeleteFile(journalFile.c_str());
+}
+TEST_CASE_END
+
+}
+TEST_SET_END
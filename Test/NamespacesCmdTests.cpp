@@ -0,0 +1,49 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   NamespacesCmdTests.cpp
+//! \brief  The unit tests for the NamespacesCmd class.
+//! \author Chris Oldwood
+
+#include "Common.hpp"
+#include <Core/UnitTest.hpp>
+#include "NamespacesCmd.hpp"
+#include <sstream>
+#include <WCL/AutoCom.hpp>
+
+TEST_SET(NamespacesCmd)
+{
+	// Like the QueryCmd tests these use the genuine WMI layer on the local
+	// machine rather than a mock.
+	WCL::AutoCom com(COINIT_APARTMENTTHREADED);
+
+TEST_CASE("namespaces should list the namespaces below the root")
+{
+	tchar*    argv[] = { TXT("Test.exe"), TXT("namespaces"), TXT("--namespace"), TXT("root") };
+	const int argc = ARRAY_SIZE(argv);
+
+	NamespacesCmd  command(argc, argv);
+	tostringstream out, err;
+
+	int result = command.execute(out, err);
+
+	TEST_TRUE(result == 0);
+	TEST_TRUE(tstrstr(out.str().c_str(), TXT("root\\cimv2\n")) != nullptr);
+}
+TEST_CASE_END
+
+TEST_CASE("classes should list the classes and their property counts")
+{
+	tchar*    argv[] = { TXT("Test.exe"), TXT("classes"), TXT("--namespace"), TXT("root\\cimv2") };
+	const int argc = ARRAY_SIZE(argv);
+
+	NamespacesCmd  command(argc, argv);
+	tostringstream out, err;
+
+	int result = command.execute(out, err);
+
+	TEST_TRUE(result == 0);
+	TEST_TRUE(tstrstr(out.str().c_str(), TXT("root\\cimv2:Win32_OperatingSystem ")) != nullptr);
+}
+TEST_CASE_END
+
+}
+TEST_SET_END
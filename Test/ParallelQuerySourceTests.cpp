@@ -0,0 +1,254 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   ParallelQuerySourceTests.cpp
+//! \brief  The unit tests for the ParallelQuerySource class.
+//! \author Chris Oldwood
+
+#include "Common.hpp"
+#include <Core/UnitTest.hpp>
+#include "ParallelQuerySource.hpp"
+#include <Core/StringUtils.hpp>
+#include <Core/RuntimeException.hpp>
+
+////////////////////////////////////////////////////////////////////////////////
+//! A host that outputs a heading followed by a number of objects. It can be
+//! made to fail after a number of objects. Ending the result set skips the
+//! rest of the objects.
+
+class FakeHostSource : public ObjectSource
+{
+public:
+	FakeHostSource(const tstring& host, size_t numObjects, size_t failAfter)
+		: m_host(host), m_numObjects(numObjects), m_failAfter(failAfter), m_index(0)
+	{
+	}
+
+	virtual bool next(ObjectSnapshot& snapshot)
+	{
+		snapshot.m_names.clear();
+		snapshot.m_values.clear();
+
+		if (m_index == 0)
+		{
+			snapshot.m_heading = TXT("Host: ") + m_host + TXT("\n");
+			snapshot.m_isObject = false;
+			++m_index;
+			return true;
+		}
+
+		if ((m_index - 1) == m_failAfter)
+			throw Core::RuntimeException(TXT("The host stopped responding"));
+
+		if ((m_index - 1) == m_numObjects)
+			return false;
+
+		snapshot.m_heading.erase();
+		snapshot.m_isObject = true;
+		snapshot.m_names.push_back(TXT("Id"));
+		snapshot.m_values.push_back(WCL::Variant(static_cast<int32>(m_index - 1)));
+		++m_index;
+
+		return true;
+	}
+
+	virtual void endResultSet()
+	{
+		m_index = m_numObjects + 1;
+	}
+
+private:
+	tstring	m_host;
+	size_t	m_numObjects;
+	size_t	m_failAfter;
+	size_t	m_index;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! Creates the fake hosts. The host "slow" takes a while to connect to, the
+//! host "refused" cannot be connected to and the host "broken" fails part way
+//! through its output.
+
+class FakeHostSourceFactory : public HostSourceFactory
+{
+public:
+	FakeHostSourceFactory(size_t numObjects)
+		: m_numObjects(numObjects)
+	{
+	}
+
+	virtual ObjectSourcePtr createSource(const tstring& host) const
+	{
+		if (host == TXT("slow"))
+			::Sleep(250);
+
+		if (host == TXT("refused"))
+			throw Core::RuntimeException(TXT("The host refused the connection"));
+
+		const size_t failAfter = (host == TXT("broken")) ? 10 : static_cast<size_t>(-1);
+
+		return ObjectSourcePtr(new FakeHostSource(host, m_numObjects, failAfter));
+	}
+
+private:
+	size_t	m_numObjects;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! The output of a sweep, counted by host.
+
+struct SweepOutput
+{
+	Hostnames				m_hosts;		//!< The hosts in the order output.
+	std::vector<size_t>		m_numObjects;	//!< The number of objects output for each host.
+	std::vector<tstring>	m_errors;		//!< The error for each host, if any.
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! Read all of the output of the source.
+
+static SweepOutput readOutput(ObjectSource& source)
+{
+	SweepOutput    output;
+	ObjectSnapshot snapshot;
+
+	while (source.next(snapshot))
+	{
+		if (snapshot.m_isObject)
+		{
+			++output.m_numObjects.back();
+			continue;
+		}
+
+		tstring heading = snapshot.m_heading;
+
+		Core::trim(heading);
+
+		if (heading.compare(0, 6, TXT("Host: ")) == 0)
+		{
+			output.m_hosts.push_back(heading.substr(6));
+			output.m_numObjects.push_back(0);
+			output.m_errors.push_back(TXT(""));
+		}
+		else
+		{
+			output.m_errors.back() = heading;
+		}
+	}
+
+	return output;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Create the list of hosts to query.
+
+static Hostnames createHosts(const tchar* first, size_t count)
+{
+	Hostnames hosts(1, first);
+
+	for (size_t i = 1; i != count; ++i)
+		hosts.push_back(Core::fmt(TXT("host%u"), static_cast<unsigned>(i)));
+
+	return hosts;
+}
+
+TEST_SET(ParallelQuerySource)
+{
+	const size_t NUM_THREADS = 2;
+	const size_t NUM_OBJECTS = 5000;
+	const DWORD  TARGET = 10000;
+
+TEST_CASE("the hosts should be output in order and the buffering capped whilst the first host is slow")
+{
+	const Hostnames hosts = createHosts(TXT("slow"), 8);
+	HostAnnotations annotations;
+	AdaptiveLimit   limit(NUM_THREADS, 1, NUM_THREADS, TARGET);
+
+	ParallelQuerySource source(HostSourceFactoryPtr(new FakeHostSourceFactory(NUM_OBJECTS)), hosts, annotations,
+	                           limit, NUM_THREADS, true, true);
+
+	const SweepOutput output = readOutput(source);
+
+	TEST_TRUE(output.m_hosts == hosts);
+
+	for (size_t i = 0; i != hosts.size(); ++i)
+		TEST_TRUE( (output.m_numObjects[i] == NUM_OBJECTS) && output.m_errors[i].empty() );
+
+	const size_t window = NUM_THREADS * ParallelQuerySource::HOSTS_AHEAD_PER_THREAD;
+
+	TEST_TRUE(source.maxBuffered() >= ParallelQuerySource::MAX_HOST_SNAPSHOTS);
+	TEST_TRUE(source.maxBuffered() <= window * (ParallelQuerySource::MAX_HOST_SNAPSHOTS + 1));
+}
+TEST_CASE_END
+
+TEST_CASE("a host that fails should be reported under its heading and the other hosts still output")
+{
+	Hostnames hosts = createHosts(TXT("slow"), 6);
+
+	hosts[2] = TXT("refused");
+	hosts[4] = TXT("broken");
+
+	HostAnnotations annotations;
+	AdaptiveLimit   limit(NUM_THREADS, 1, NUM_THREADS, TARGET);
+
+	ParallelQuerySource source(HostSourceFactoryPtr(new FakeHostSourceFactory(NUM_OBJECTS)), hosts, annotations,
+	                           limit, NUM_THREADS, true, true);
+
+	const SweepOutput output = readOutput(source);
+
+	TEST_TRUE(output.m_hosts == hosts);
+
+	TEST_TRUE(output.m_numObjects[2] == 0);
+	TEST_TRUE(output.m_errors[2] == TXT("Error: The host refused the connection"));
+	TEST_TRUE(output.m_numObjects[4] == 10);
+	TEST_TRUE(output.m_errors[4] == TXT("Error: The host stopped responding"));
+
+	TEST_TRUE( (output.m_numObjects[5] == NUM_OBJECTS) && output.m_errors[5].empty() );
+}
+TEST_CASE_END
+
+TEST_CASE("ending the result set should drop the rest of the host's objects")
+{
+	const size_t    MAX_OBJECTS = 3;
+	const Hostnames hosts = createHosts(TXT("host0"), 8);
+	HostAnnotations annotations;
+	AdaptiveLimit   limit(NUM_THREADS, 1, NUM_THREADS, TARGET);
+	ObjectSnapshot  snapshot;
+	size_t          numObjects = 0;
+
+	ParallelQuerySource source(HostSourceFactoryPtr(new FakeHostSourceFactory(NUM_OBJECTS)), hosts, annotations,
+	                           limit, NUM_THREADS, true, true);
+
+	while (source.next(snapshot))
+	{
+		if (!snapshot.m_isObject)
+		{
+			numObjects = 0;
+			continue;
+		}
+
+		TEST_TRUE(numObjects != MAX_OBJECTS);
+
+		if (++numObjects == MAX_OBJECTS)
+			source.endResultSet();
+	}
+}
+TEST_CASE_END
+
+TEST_CASE("destroying the source part way through should abandon the hosts still being queried")
+{
+	const Hostnames hosts = createHosts(TXT("host0"), 20);
+	HostAnnotations annotations;
+	AdaptiveLimit   limit(NUM_THREADS, 1, NUM_THREADS, TARGET);
+	ObjectSnapshot  snapshot;
+
+	{
+		ParallelQuerySource source(HostSourceFactoryPtr(new FakeHostSourceFactory(NUM_OBJECTS)), hosts, annotations,
+		                           limit, NUM_THREADS, true, true);
+
+		for (size_t i = 0; i != 100; ++i)
+			TEST_TRUE(source.next(snapshot));
+	}
+}
+TEST_CASE_END
+
+}
+TEST_SET_END
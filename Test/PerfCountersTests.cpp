@@ -0,0 +1,125 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   PerfCountersTests.cpp
+//! \brief  The unit tests for the performance counter helper functions.
+//! \author Chris Oldwood
+
+#include "Common.hpp"
+#include <Core/UnitTest.hpp>
+#include "PerfCounters.hpp"
+#include <winperf.h>
+
+////////////////////////////////////////////////////////////////////////////////
+//! Create the raw values for a counter.
+
+static CounterValue makeValue(uint64 value, uint64 base, uint64 time, uint64 frequency)
+{
+	CounterValue counter = { value, base, time, frequency };
+
+	return counter;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Create a sample of a processor object as returned by the raw class.
+
+static ObjectSnapshot makeProcessor(const tchar* percentIdle, const tchar* interrupts, const tchar* timestamp)
+{
+	ObjectSnapshot snapshot;
+
+	snapshot.m_isObject = true;
+	snapshot.m_names.push_back(TXT("Frequency_PerfTime"));
+	snapshot.m_names.push_back(TXT("Frequency_Sys100NS"));
+	snapshot.m_names.push_back(TXT("InterruptsPersec"));
+	snapshot.m_names.push_back(TXT("Name"));
+	snapshot.m_names.push_back(TXT("PercentIdleTime"));
+	snapshot.m_names.push_back(TXT("Timestamp_PerfTime"));
+	snapshot.m_names.push_back(TXT("Timestamp_Sys100NS"));
+	snapshot.m_values.push_back(WCL::Variant(TXT("1000")));
+	snapshot.m_values.push_back(WCL::Variant(TXT("10000000")));
+	snapshot.m_values.push_back(WCL::Variant(interrupts));
+	snapshot.m_values.push_back(WCL::Variant(TXT("_Total")));
+	snapshot.m_values.push_back(WCL::Variant(percentIdle));
+	snapshot.m_values.push_back(WCL::Variant(timestamp));
+	snapshot.m_values.push_back(WCL::Variant(timestamp));
+
+	return snapshot;
+}
+
+TEST_SET(PerfCounters)
+{
+
+TEST_CASE("a rate should be the change in the counter per second")
+{
+	double result = 0.0;
+
+	TEST_TRUE(cookCounter(PERF_COUNTER_BULK_COUNT, makeValue(1000, 0, 5000, 1000), makeValue(3000, 0, 7000, 1000), result));
+	TEST_TRUE(result == 1000.0);
+}
+TEST_CASE_END
+
+TEST_CASE("a 32-bit rate should allow for the counter wrapping")
+{
+	double result = 0.0;
+
+	TEST_TRUE(cookCounter(PERF_COUNTER_COUNTER, makeValue(0xFFFFFFFF, 0, 0, 10), makeValue(9, 0, 10, 10), result));
+	TEST_TRUE(result == 10.0);
+}
+TEST_CASE_END
+
+TEST_CASE("a percentage of time should be relative to the interval and can be inverted")
+{
+	double result = 0.0;
+
+	TEST_TRUE(cookCounter(PERF_100NSEC_TIMER, makeValue(0, 0, 0, 10000000), makeValue(250, 0, 1000, 10000000), result));
+	TEST_TRUE(result == 25.0);
+
+	TEST_TRUE(cookCounter(PERF_100NSEC_TIMER_INV, makeValue(0, 0, 0, 10000000), makeValue(250, 0, 1000, 10000000), result));
+	TEST_TRUE(result == 75.0);
+}
+TEST_CASE_END
+
+TEST_CASE("fractions and averages should use the base counter")
+{
+	double result = 0.0;
+
+	TEST_TRUE(cookCounter(PERF_RAW_FRACTION, makeValue(0, 0, 0, 0), makeValue(30, 120, 0, 0), result));
+	TEST_TRUE(result == 25.0);
+
+	TEST_TRUE(cookCounter(PERF_AVERAGE_BULK, makeValue(100, 10, 0, 0), makeValue(400, 20, 0, 0), result));
+	TEST_TRUE(result == 30.0);
+
+	TEST_TRUE(cookCounter(PERF_AVERAGE_TIMER, makeValue(0, 0, 0, 1000), makeValue(500, 5, 0, 1000), result));
+	TEST_TRUE(result == 0.1);
+}
+TEST_CASE_END
+
+TEST_CASE("a counter type which can't be cooked should be rejected")
+{
+	double result = 0.0;
+
+	TEST_FALSE(cookCounter(PERF_COUNTER_TEXT, makeValue(0, 0, 0, 0), makeValue(1, 0, 1, 1), result));
+}
+TEST_CASE_END
+
+TEST_CASE("an object's counters should be cooked and its timestamps removed")
+{
+	CounterTypes types;
+
+	types[TXT("InterruptsPersec")] = PERF_COUNTER_COUNTER;
+	types[TXT("PercentIdleTime")] = PERF_100NSEC_TIMER_INV;
+
+	const ObjectSnapshot previous = makeProcessor(TXT("0"), TXT("100"), TXT("0"));
+	const ObjectSnapshot current = makeProcessor(TXT("2500"), TXT("600"), TXT("10000"));
+	ObjectSnapshot       cooked;
+
+	TEST_TRUE(cookObject(types, previous, current, cooked));
+
+	TEST_TRUE(cooked.m_names.size() == 3);
+	TEST_TRUE((cooked.m_names[0] == TXT("InterruptsPersec")) && (cooked.m_values[0].type() == VT_R8));
+	TEST_TRUE(V_R8(&cooked.m_values[0]) == 50.0);
+	TEST_TRUE((cooked.m_names[1] == TXT("Name")) && (cooked.m_values[1].format() == TXT("_Total")));
+	TEST_TRUE((cooked.m_names[2] == TXT("PercentIdleTime")) && (V_R8(&cooked.m_values[2]) == 75.0));
+}
+TEST_CASE_END
+
+}
+TEST_SET_END
@@ -0,0 +1,42 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   QueriesTests.cpp
+//! \brief  The unit tests for the query list helper functions.
+//! \author Chris Oldwood
+
+#include "Common.hpp"
+#include <Core/UnitTest.hpp>
+#include "Queries.hpp"
+
+TEST_SET(Queries)
+{
+
+TEST_CASE("a query prefixed with a single word and a colon should be named")
+{
+	NamedQuery query = parseQuery(TXT("Disks: select * from Win32_LogicalDisk"));
+
+	TEST_TRUE(query.m_name == TXT("Disks"));
+	TEST_TRUE(query.m_text == TXT("select * from Win32_LogicalDisk"));
+}
+TEST_CASE_END
+
+TEST_CASE("an unnamed query should be labelled with its text")
+{
+	const tstring text = TXT("select * from Win32_LogicalDisk where DeviceID='C:'");
+
+	NamedQuery query = parseQuery(text);
+
+	TEST_TRUE(query.m_name == text);
+	TEST_TRUE(query.m_text == text);
+}
+TEST_CASE_END
+
+TEST_CASE("the class should be taken from the query's FROM clause")
+{
+	TEST_TRUE(getQueryClass(TXT("select * from Win32_PerfRawData_PerfOS_Processor")) == TXT("Win32_PerfRawData_PerfOS_Processor"));
+	TEST_TRUE(getQueryClass(TXT("SELECT Name FROM\tWin32_Process WHERE Name='from'")) == TXT("Win32_Process"));
+	TEST_TRUE(getQueryClass(TXT("select * from")).empty());
+}
+TEST_CASE_END
+
+}
+TEST_SET_END
@@ -8,6 +8,10 @@
 #include "QueryCmd.hpp"
 #include <sstream>
 #include <WCL/AutoCom.hpp>
+#include "Gunzip.hpp"
+#include <Core/StringUtils.hpp>
+#include <fstream>
+#include <iterator>
 
 TEST_SET(QueryCmd)
 {
@@ -46,5 +50,76 @@ TEST_CASE("execute with --noformat should elide spacing between objects")
 }
 TEST_CASE_END
 
+TEST_CASE("execute with --output-file and --compress should write the output as gzip")
+{
+	tchar folder[MAX_PATH+1] = { 0 };
+
+	::GetTempPath(MAX_PATH, folder);
+
+	const tstring filename = Core::fmt(TXT("%sWMICmdTest-%u.txt.gz"), folder, ::GetCurrentProcessId());
+
+	tchar*    argv[] = { TXT("Test.exe"), TXT("query"), TXT("select Name from Win32_Service"), TXT("--output-file"),
+	                     const_cast<tchar*>(filename.c_str()), TXT("--compress"), TXT("gzip") };
+	const int argc = ARRAY_SIZE(argv);
+
+	QueryCmd       command(argc, argv);
+	tostringstream out, err;
+
+	int result = command.execute(out, err);
+
+	std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary);
+	ByteBuffer    compressed((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	ByteBuffer    output;
+
+	file.close();
+	::DeleteFile(filename.c_str());
+
+	TEST_TRUE(result == 0);
+	TEST_TRUE(out.str().empty());
+	TEST_TRUE(tryGunzip(compressed, output));
+	TEST_TRUE(std::string(output.begin(), output.end()).find("Name: ") != std::string::npos);
+}
+TEST_CASE_END
+
+TEST_CASE("execute with --query-file should label the results of each query in order")
+{
+	tchar folder[MAX_PATH+1] = { 0 };
+
+	::GetTempPath(MAX_PATH, folder);
+
+	const tstring filename = Core::fmt(TXT("%sWMICmdTest-%u.wql"), folder, ::GetCurrentProcessId());
+
+	{
+		std::ofstream file(filename.c_str());
+
+		file << "# Collect the OS and services together.\n";
+		file << "OS: select Caption from Win32_OperatingSystem\n";
+		file << "\n";
+		file << "Services: select Name from Win32_Service\n";
+	}
+
+	tchar*    argv[] = { TXT("Test.exe"), TXT("query"), TXT("--query-file"), const_cast<tchar*>(filename.c_str()) };
+	const int argc = ARRAY_SIZE(argv);
+
+	QueryCmd       command(argc, argv);
+	tostringstream out, err;
+
+	int result = command.execute(out, err);
+
+	::DeleteFile(filename.c_str());
+
+	const tstring output = out.str();
+	const size_t  osPos = output.find(TXT("Query: OS\n"));
+	const size_t  servicesPos = output.find(TXT("Query: Services\n"));
+
+	TEST_TRUE(result == 0);
+	TEST_TRUE(osPos != tstring::npos);
+	TEST_TRUE(servicesPos != tstring::npos);
+	TEST_TRUE(osPos < output.find(TXT("Caption: ")));
+	TEST_TRUE(output.find(TXT("Caption: ")) < servicesPos);
+	TEST_TRUE(servicesPos < output.find(TXT("Name: ")));
+}
+TEST_CASE_END
+
 }
 TEST_SET_END
@@ -0,0 +1,136 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   QueryServerTests.cpp
+//! \brief  The unit tests for the QueryServer class and its client.
+//! \author Chris Oldwood
+
+#include "Common.hpp"
+#include <Core/UnitTest.hpp>
+#include "QueryServer.hpp"
+#include "PipeClient.hpp"
+#include <sstream>
+#include <Core/StringUtils.hpp>
+
+TEST_SET(QueryServer)
+{
+	// Like the QueryCmd tests these run genuine WMI queries on the local machine.
+	const tstring pipeName = Core::fmt(TXT("WMICmdTest-%u"), ::GetCurrentProcessId());
+
+TEST_CASE("a request and arguments should survive encoding and decoding")
+{
+	RequestArgs args;
+
+	args.push_back(TXT("query"));
+	args.push_back(TXT("select * from Win32_OperatingSystem"));
+	args.push_back(TXT(""));
+
+	Payload     payload;
+	RequestArgs actual;
+
+	encodeRequest(args, payload);
+	decodeRequest(payload, actual);
+
+	TEST_TRUE(actual == args);
+}
+TEST_CASE_END
+
+TEST_CASE("the paths given to a forwarded command should be made absolute")
+{
+	tchar folder[MAX_PATH+1] = { 0 };
+
+	::GetCurrentDirectory(ARRAY_SIZE(folder), folder);
+
+	const tstring current = folder;
+	const tstring prefix = (*current.rbegin() == TXT('\\')) ? current : current + TXT("\\");
+
+	RequestArgs args;
+
+	args.push_back(TXT("query"));
+	args.push_back(TXT("select * from Win32_OperatingSystem"));
+	args.push_back(TXT("--output-file"));
+	args.push_back(TXT("output.txt"));
+	args.push_back(TXT("-hf"));
+	args.push_back(TXT("C:\\Hosts.txt"));
+	args.push_back(TXT("/JOURNAL"));
+	args.push_back(TXT("journal.txt"));
+	args.push_back(TXT("--top"));
+	args.push_back(TXT("5"));
+
+	makePathsAbsolute(args);
+
+	TEST_TRUE(args[1] == TXT("select * from Win32_OperatingSystem"));
+	TEST_TRUE(args[3] == prefix + TXT("output.txt"));
+	TEST_TRUE(args[5] == TXT("C:\\Hosts.txt"));
+	TEST_TRUE(args[7] == prefix + TXT("journal.txt"));
+	TEST_TRUE(args[9] == TXT("5"));
+}
+TEST_CASE_END
+
+TEST_CASE("a forwarded query should stream back the output and exit code")
+{
+	QueryServer server(pipeName, 1);
+
+	server.start();
+
+	RequestArgs args;
+
+	args.push_back(TXT("query"));
+	args.push_back(TXT("select LastBootUpTime from Win32_OperatingSystem"));
+
+	tostringstream out, err;
+
+	int result = forwardCommand(pipeName, args, out, err);
+
+	server.stop();
+
+	TEST_TRUE(result == 0);
+	TEST_TRUE(tstrstr(out.str().c_str(), TXT("LastBootUpTime")) != nullptr);
+}
+TEST_CASE_END
+
+TEST_CASE("repeated queries to the same host should reuse a warm connection")
+{
+	QueryServer server(pipeName, 1);
+
+	server.start();
+
+	RequestArgs args;
+
+	args.push_back(TXT("query"));
+	args.push_back(TXT("select Name from Win32_OperatingSystem"));
+
+	for (size_t i = 0; i != 3; ++i)
+	{
+		tostringstream out, err;
+
+		TEST_TRUE(forwardCommand(pipeName, args, out, err) == 0);
+	}
+
+	TEST_TRUE(server.connections().numIdle() == 1);
+
+	server.stop();
+}
+TEST_CASE_END
+
+TEST_CASE("a forwarded command that fails should report the error and a non-zero exit code")
+{
+	QueryServer server(pipeName, 1);
+
+	server.start();
+
+	RequestArgs args;
+
+	args.push_back(TXT("serve"));
+
+	tostringstream out, err;
+
+	int result = forwardCommand(pipeName, args, out, err);
+
+	server.stop();
+
+	TEST_TRUE(result != 0);
+	TEST_TRUE(tstrstr(err.str().c_str(), TXT("not supported")) != nullptr);
+}
+TEST_CASE_END
+
+}
+TEST_SET_END
@@ -0,0 +1,202 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   ResultDiffTests.cpp
+//! \brief  The unit tests for the ResultDiff class.
+//! \author Chris Oldwood
+
+#include "Common.hpp"
+#include <Core/UnitTest.hpp>
+#include "ResultDiff.hpp"
+#include <Core/StringUtils.hpp>
+#include <fstream>
+#include <algorithm>
+
+////////////////////////////////////////////////////////////////////////////////
+//! Write the text to a temporary file and return its name.
+
+static tstring writeTempFile(const tchar* suffix, const char* text)
+{
+	tchar folder[MAX_PATH+1] = { 0 };
+
+	::GetTempPath(MAX_PATH, folder);
+
+	const tstring filename = Core::fmt(TXT("%sWMICmdTest-%u%s"), folder, ::GetCurrentProcessId(), suffix);
+
+	std::ofstream file(filename.c_str());
+
+	file << text;
+
+	return filename;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Split the text into its lines and sort them.
+
+static std::vector<tstring> sortedLines(const tstring& text)
+{
+	std::vector<tstring> lines;
+	tistringstream       in(text);
+	tstring              line;
+
+	while (std::getline(in, line))
+		lines.push_back(line);
+
+	std::sort(lines.begin(), lines.end());
+
+	return lines;
+}
+
+//! The old results, saved with formatting and --align.
+static const char* OLD_RESULTS =
+	"\n"
+	"Host: HOST01\n"
+	"\n"
+	"Name      : notepad.exe\n"
+	"ProcessId : 100\n"
+	"Threads   : 1\n"
+	"\n"
+	"Name      : explorer.exe\n"
+	"ProcessId : 200\n"
+	"Threads   : 20\n"
+	"\n"
+	"Name      : svchost.exe\n"
+	"ProcessId : 300\n"
+	"Threads   : 5\n";
+
+//! The new results, saved without formatting and so with no blank lines.
+static const char* NEW_RESULTS =
+	"Host: HOST01\n"
+	"Name: notepad.exe\n"
+	"ProcessId: 100\n"
+	"Threads: 1\n"
+	"Name: explorer.exe\n"
+	"ProcessId: 200\n"
+	"Threads: 22\n"
+	"Name: calc.exe\n"
+	"ProcessId: 400\n"
+	"Threads: 3\n";
+
+TEST_SET(ResultDiff)
+{
+
+TEST_CASE("a saved result set should be read back as keyed records")
+{
+	const tstring filename = writeTempFile(TXT(".txt"),
+		"\n"
+		"Host: HOST01\n"
+		"\n"
+		"Name [VT_BSTR]: notepad.exe\n"
+		"ProcessId [VT_I4]: 100\n"
+		"\n"
+		"Name [VT_BSTR]: System Idle Process\n"
+		"Name [VT_BSTR]: explorer.exe\n"
+		"ProcessId [VT_I4]: 200\n");
+
+	std::vector<ResultRecord> records;
+	size_t                    numUnkeyed = 0;
+
+	{
+		ResultSetReader reader(filename, TXT("processid"));
+		ResultRecord    record;
+
+		while (reader.read(record))
+			records.push_back(record);
+
+		numUnkeyed = reader.numUnkeyed();
+	}
+
+	::DeleteFile(filename.c_str());
+
+	TEST_TRUE(records.size() == 2);
+	TEST_TRUE(numUnkeyed == 1);
+	TEST_TRUE(records[0].m_host == TXT("HOST01"));
+	TEST_TRUE(records[0].m_key == TXT("100"));
+	TEST_TRUE(records[0].m_properties.size() == 1);
+	TEST_TRUE(records[0].m_properties[0] == Property(TXT("Name"), TXT("notepad.exe")));
+	TEST_TRUE(records[1].m_key == TXT("200"));
+	TEST_TRUE(records[1].m_properties[0].second == TXT("explorer.exe"));
+}
+TEST_CASE_END
+
+TEST_CASE("added, removed and changed objects should be reported")
+{
+	const tstring oldFile = writeTempFile(TXT("-old.txt"), OLD_RESULTS);
+	const tstring newFile = writeTempFile(TXT("-new.txt"), NEW_RESULTS);
+
+	tostringstream out;
+	ResultDiff     diff(TXT("ProcessId"), 1);
+
+	{
+		ResultSetReader oldReader(oldFile, TXT("ProcessId"));
+		ResultSetReader newReader(newFile, TXT("ProcessId"));
+
+		diff.run(oldReader, newReader, true, out);
+	}
+
+	::DeleteFile(oldFile.c_str());
+	::DeleteFile(newFile.c_str());
+
+	const tstring expected =
+		TXT("Changed: ProcessId=200 on HOST01\n")
+		TXT("  Threads: 20 -> 22\n")
+		TXT("\n")
+		TXT("Added: ProcessId=400 on HOST01\n")
+		TXT("  Name: calc.exe\n")
+		TXT("  Threads: 3\n")
+		TXT("\n")
+		TXT("Removed: ProcessId=300 on HOST01\n")
+		TXT("  Name: svchost.exe\n")
+		TXT("  Threads: 5\n")
+		TXT("\n");
+
+	TEST_TRUE(diff.numAdded() == 1);
+	TEST_TRUE(diff.numRemoved() == 1);
+	TEST_TRUE(diff.numChanged() == 1);
+	TEST_TRUE(out.str() == expected);
+}
+TEST_CASE_END
+
+TEST_CASE("the differences should be the same when the join is partitioned")
+{
+	const tstring oldFile = writeTempFile(TXT("-old.txt"), OLD_RESULTS);
+	const tstring newFile = writeTempFile(TXT("-new.txt"), NEW_RESULTS);
+
+	tostringstream expected;
+	tostringstream actual;
+
+	{
+		ResultSetReader oldReader(oldFile, TXT("ProcessId"));
+		ResultSetReader newReader(newFile, TXT("ProcessId"));
+		ResultDiff      diff(TXT("ProcessId"), 1);
+
+		diff.run(oldReader, newReader, false, expected);
+	}
+
+	{
+		ResultSetReader oldReader(oldFile, TXT("ProcessId"));
+		ResultSetReader newReader(newFile, TXT("ProcessId"));
+		ResultDiff      diff(TXT("ProcessId"), 7);
+
+		diff.run(oldReader, newReader, true, actual);
+
+		TEST_TRUE((diff.numAdded() == 1) && (diff.numRemoved() == 1) && (diff.numChanged() == 1));
+	}
+
+	::DeleteFile(oldFile.c_str());
+	::DeleteFile(newFile.c_str());
+
+	TEST_TRUE(sortedLines(actual.str()) == sortedLines(expected.str()));
+}
+TEST_CASE_END
+
+TEST_CASE("the number of partitions should keep the smaller side within the budget")
+{
+	const uint64 MB = 1024 * 1024;
+
+	TEST_TRUE(ResultDiff::choosePartitions(10 * MB, 256 * MB) == 1);
+	TEST_TRUE(ResultDiff::choosePartitions(100 * MB, 256 * MB) == 2);
+	TEST_TRUE(ResultDiff::choosePartitions(100000 * MB, 256 * MB) == ResultDiff::MAX_PARTITIONS);
+}
+TEST_CASE_END
+
+}
+TEST_SET_END
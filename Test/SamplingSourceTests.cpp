@@ -0,0 +1,179 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   SamplingSourceTests.cpp
+//! \brief  The unit tests for the SamplingSource class.
+//! \author Chris Oldwood
+
+#include "Common.hpp"
+#include <Core/UnitTest.hpp>
+#include "SamplingSource.hpp"
+#include <Core/StringUtils.hpp>
+
+////////////////////////////////////////////////////////////////////////////////
+//! A source of numbered objects split into result sets by headings. It counts
+//! how many objects had their properties copied.
+
+class NumberedSource : public ObjectSource
+{
+public:
+	NumberedSource(size_t numSets, size_t setSize)
+		: m_numSets(numSets), m_setSize(setSize), m_set(0), m_index(0), m_numCopied(0)
+	{
+	}
+
+	virtual bool next(ObjectSnapshot& snapshot)
+	{
+		return advance(snapshot, true);
+	}
+
+	virtual bool skip(ObjectSnapshot& snapshot)
+	{
+		return advance(snapshot, false);
+	}
+
+	size_t numCopied() const
+	{
+		return m_numCopied;
+	}
+
+private:
+	bool advance(ObjectSnapshot& snapshot, bool copyObject)
+	{
+		if (m_set == m_numSets)
+			return false;
+
+		snapshot.m_names.clear();
+		snapshot.m_values.clear();
+
+		if (m_index == 0)
+		{
+			snapshot.m_heading = Core::fmt(TXT("Host: %u\n"), static_cast<unsigned>(m_set));
+			snapshot.m_isObject = false;
+		}
+		else
+		{
+			snapshot.m_heading.erase();
+			snapshot.m_isObject = true;
+
+			if (copyObject)
+			{
+				snapshot.m_names.push_back(TXT("Id"));
+				snapshot.m_values.push_back(WCL::Variant(static_cast<int32>((m_set * m_setSize) + m_index - 1)));
+				++m_numCopied;
+			}
+		}
+
+		if (++m_index > m_setSize)
+		{
+			m_index = 0;
+			++m_set;
+		}
+
+		return true;
+	}
+
+	size_t	m_numSets;
+	size_t	m_setSize;
+	size_t	m_set;
+	size_t	m_index;
+	size_t	m_numCopied;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! Format the sampled objects as a compact string, e.g. "Host: 0\n1,5,".
+
+static tstring formatSample(ObjectSource& source)
+{
+	ObjectSnapshot snapshot;
+	tstring        output;
+
+	while (source.next(snapshot))
+	{
+		if (snapshot.m_isObject)
+			output += Core::fmt(TXT("%d,"), V_I4(&snapshot.m_values.at(0)));
+		else
+			output += snapshot.m_heading;
+	}
+
+	return output;
+}
+
+TEST_SET(SamplingSource)
+{
+
+TEST_CASE("the same seed should always choose the same sample")
+{
+	NumberedSource firstSource(3, 1000);
+	SamplingSource firstSample(firstSource, 10, 42, true);
+	const tstring  first = formatSample(firstSample);
+
+	NumberedSource secondSource(3, 1000);
+	SamplingSource secondSample(secondSource, 10, 42, true);
+	const tstring  second = formatSample(secondSample);
+
+	TEST_TRUE(first == second);
+}
+TEST_CASE_END
+
+TEST_CASE("sampling each result set should pass on every heading and at most N objects per set in order")
+{
+	NumberedSource source(3, 1000);
+	SamplingSource sample(source, 10, 42, true);
+	ObjectSnapshot snapshot;
+
+	size_t numHeadings = 0;
+	size_t numObjects = 0;
+	bool   inOrder = true;
+	LONG   last = -1;
+
+	while (sample.next(snapshot))
+	{
+		if (!snapshot.m_isObject)
+		{
+			TEST_TRUE((numHeadings * 10) == numObjects);
+			++numHeadings;
+			continue;
+		}
+
+		const LONG value = V_I4(&snapshot.m_values.at(0));
+
+		inOrder = inOrder && (value > last) && (value < static_cast<LONG>(numHeadings * 1000));
+		last = value;
+		++numObjects;
+	}
+
+	TEST_TRUE(numHeadings == 3);
+	TEST_TRUE(numObjects == 30);
+	TEST_TRUE(inOrder);
+	TEST_TRUE(source.numCopied() < 3000);
+}
+TEST_CASE_END
+
+TEST_CASE("sampling all result sets should take N objects in total")
+{
+	NumberedSource source(3, 1000);
+	SamplingSource sample(source, 10, 42, false);
+	ObjectSnapshot snapshot;
+
+	size_t numObjects = 0;
+
+	while (sample.next(snapshot))
+	{
+		if (snapshot.m_isObject)
+			++numObjects;
+	}
+
+	TEST_TRUE(numObjects == 10);
+}
+TEST_CASE_END
+
+TEST_CASE("a sample larger than the result set should pass on every object")
+{
+	NumberedSource source(1, 5);
+	SamplingSource sample(source, 10, 42, true);
+
+	TEST_TRUE(formatSample(sample) == TXT("Host: 0\n0,1,2,3,4,"));
+}
+TEST_CASE_END
+
+}
+TEST_SET_END
@@ -0,0 +1,170 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   TableSourceTests.cpp
+//! \brief  The unit tests for the TableSource class.
+//! \author Chris Oldwood
+
+#include "Common.hpp"
+#include <Core/UnitTest.hpp>
+#include "TableSource.hpp"
+
+////////////////////////////////////////////////////////////////////////////////
+//! An entry in a scripted source. An entry with a heading is a heading,
+//! otherwise it's an object with one or two string properties.
+
+struct ScriptEntry
+{
+	const tchar*	m_heading;	//!< The heading, if not an object.
+	const tchar*	m_name1;	//!< The first property name.
+	const tchar*	m_value1;	//!< The first property value.
+	const tchar*	m_name2;	//!< The second property name, if any.
+	const tchar*	m_value2;	//!< The second property value.
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! A source which returns a fixed script of headings and objects.
+
+class ScriptedSource : public ObjectSource
+{
+public:
+	ScriptedSource(const ScriptEntry* begin, const ScriptEntry* end)
+		: m_next(begin), m_end(end)
+	{
+	}
+
+	virtual bool next(ObjectSnapshot& snapshot)
+	{
+		if (m_next == m_end)
+			return false;
+
+		const ScriptEntry& entry = *m_next++;
+
+		snapshot.m_names.clear();
+		snapshot.m_values.clear();
+		snapshot.m_heading.erase();
+		snapshot.m_isObject = (entry.m_heading == nullptr);
+
+		if (!snapshot.m_isObject)
+		{
+			snapshot.m_heading = entry.m_heading;
+			return true;
+		}
+
+		snapshot.m_names.push_back(entry.m_name1);
+		snapshot.m_values.push_back(WCL::Variant(entry.m_value1));
+
+		if (entry.m_name2 != nullptr)
+		{
+			snapshot.m_names.push_back(entry.m_name2);
+			snapshot.m_values.push_back(WCL::Variant(entry.m_value2));
+		}
+
+		return true;
+	}
+
+private:
+	const ScriptEntry*	m_next;
+	const ScriptEntry*	m_end;
+};
+
+//! Two hosts with the same class of objects.
+static const ScriptEntry TWO_HOSTS[] =
+{
+	{ TXT("\nHost: ALPHA\n"), nullptr, nullptr, nullptr, nullptr },
+	{ nullptr, TXT("Name"), TXT("c:"), TXT("Size"), TXT("100") },
+	{ nullptr, TXT("Name"), TXT("d:"), TXT("Size"), TXT("2000000") },
+	{ TXT("\nHost: B\n"), nullptr, nullptr, nullptr, nullptr },
+	{ nullptr, TXT("Name"), TXT("averyveryverylongname"), TXT("Size"), TXT("7") },
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! Lay out the script as a table and return the text.
+
+static tstring formatTable(const ScriptEntry* begin, const ScriptEntry* end, size_t sampleRows, size_t maxWidth, bool wrap)
+{
+	ScriptedSource source(begin, end);
+	TableSource    table(source, sampleRows, maxWidth, wrap, false, false);
+	ObjectSnapshot snapshot;
+	tstring        output;
+
+	while (table.next(snapshot))
+	{
+		ASSERT(!snapshot.m_isObject);
+
+		output += snapshot.m_heading;
+	}
+
+	return output;
+}
+
+TEST_SET(TableSource)
+{
+
+TEST_CASE("the columns should be aligned across all the hosts")
+{
+	const tstring expected = TXT("Host   Name                   Size\n")
+	                         TXT("-----  ---------------------  -------\n")
+	                         TXT("ALPHA  c:                     100\n")
+	                         TXT("ALPHA  d:                     2000000\n")
+	                         TXT("B      averyveryverylongname  7\n");
+
+	TEST_TRUE(formatTable(TWO_HOSTS, TWO_HOSTS+ARRAY_SIZE(TWO_HOSTS), 1000, 40, false) == expected);
+}
+TEST_CASE_END
+
+TEST_CASE("spilling every row should give the same widths as sampling them all")
+{
+	const tstring sampled = formatTable(TWO_HOSTS, TWO_HOSTS+ARRAY_SIZE(TWO_HOSTS), 1000, 40, false);
+	const tstring spilled = formatTable(TWO_HOSTS, TWO_HOSTS+ARRAY_SIZE(TWO_HOSTS), 0, 40, false);
+
+	TEST_TRUE(spilled == sampled);
+}
+TEST_CASE_END
+
+TEST_CASE("values wider than the sampled rows should be truncated")
+{
+	const tstring expected = TXT("Host   Name  Size\n")
+	                         TXT("-----  ----  ----\n")
+	                         TXT("ALPHA  c:    100\n")
+	                         TXT("ALPHA  d:    2...\n")
+	                         TXT("B      a...  7\n");
+
+	TEST_TRUE(formatTable(TWO_HOSTS, TWO_HOSTS+ARRAY_SIZE(TWO_HOSTS), 1, 40, false) == expected);
+}
+TEST_CASE_END
+
+TEST_CASE("values wider than the maximum width should be wrapped if requested")
+{
+	const tstring expected = TXT("Host   Name      Size\n")
+	                         TXT("-----  --------  -------\n")
+	                         TXT("ALPHA  c:        100\n")
+	                         TXT("ALPHA  d:        2000000\n")
+	                         TXT("B      averyver  7\n")
+	                         TXT("       yverylon\n")
+	                         TXT("       gname\n");
+
+	TEST_TRUE(formatTable(TWO_HOSTS, TWO_HOSTS+ARRAY_SIZE(TWO_HOSTS), 0, 8, true) == expected);
+}
+TEST_CASE_END
+
+TEST_CASE("a change of properties or another heading should start a new table")
+{
+	const ScriptEntry script[] =
+	{
+		{ nullptr, TXT("A"), TXT("1"), nullptr, nullptr },
+		{ TXT("Sample: 2\n"), nullptr, nullptr, nullptr, nullptr },
+		{ nullptr, TXT("A"), TXT("2"), nullptr, nullptr },
+		{ nullptr, TXT("B"), TXT("x"), TXT("C"), TXT("y") },
+	};
+
+	const tstring expected = TXT("A\n-\n1\n")
+	                         TXT("Sample: 2\n")
+	                         TXT("A\n-\n2\n")
+	                         TXT("B  C\n-  -\nx  y\n");
+
+	TEST_TRUE(formatTable(script, script+ARRAY_SIZE(script), 1, 40, false) == expected);
+	TEST_TRUE(formatTable(script, script+ARRAY_SIZE(script), 0, 40, false) == expected);
+}
+TEST_CASE_END
+
+}
+TEST_SET_END
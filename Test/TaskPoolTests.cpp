@@ -0,0 +1,139 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   TaskPoolTests.cpp
+//! \brief  The unit tests for the TaskPool class.
+//! \author Chris Oldwood
+
+#include "Common.hpp"
+#include <Core/UnitTest.hpp>
+#include "TaskPool.hpp"
+#include <set>
+
+////////////////////////////////////////////////////////////////////////////////
+//! A task that expands a binary tree of the given depth, recording each node.
+
+class TreeTask : public Task
+{
+public:
+	TreeTask(size_t node, size_t depth, volatile LONG& visited, CriticalSection& lock, std::set<size_t>& workers)
+		: m_node(node), m_depth(depth), m_visited(visited), m_lock(lock), m_workers(workers)
+	{
+	}
+
+	virtual void execute(TaskPool& pool, size_t worker)
+	{
+		::InterlockedIncrement(&m_visited);
+
+		if (m_depth != 0)
+		{
+			pool.submit(TaskPtr(new TreeTask((m_node*2)+1, m_depth-1, m_visited, m_lock, m_workers)), worker);
+			pool.submit(TaskPtr(new TreeTask((m_node*2)+2, m_depth-1, m_visited, m_lock, m_workers)), worker);
+		}
+
+		// Give the other workers a chance to steal.
+		::Sleep(0);
+
+		AutoLock lock(m_lock);
+
+		m_workers.insert(worker);
+	}
+
+private:
+	size_t				m_node;
+	size_t				m_depth;
+	volatile LONG&		m_visited;
+	CriticalSection&	m_lock;
+	std::set<size_t>&	m_workers;
+
+	TreeTask(const TreeTask&);
+	TreeTask& operator=(const TreeTask&);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! A task that always throws.
+
+class FailingTask : public Task
+{
+public:
+	virtual void execute(TaskPool& /*pool*/, size_t /*worker*/)
+	{
+		throw std::exception();
+	}
+};
+
+TEST_SET(TaskPool)
+{
+
+TEST_CASE("running the pool should execute every task including those submitted by tasks")
+{
+	const size_t depth = 10;
+	const LONG   numNodes = (1 << (depth+1)) - 1;
+
+	volatile LONG    visited = 0;
+	CriticalSection  lock;
+	std::set<size_t> workers;
+
+	TaskPool pool(4);
+
+	pool.submit(TaskPtr(new TreeTask(0, depth, visited, lock, workers)));
+	pool.run();
+
+	TEST_TRUE(visited == numNodes);
+	TEST_TRUE(pool.numFailures() == 0);
+}
+TEST_CASE_END
+
+TEST_CASE("running the pool should share a single root task's work across the workers")
+{
+	volatile LONG    visited = 0;
+	CriticalSection  lock;
+	std::set<size_t> workers;
+
+	TaskPool pool(2);
+
+	pool.submit(TaskPtr(new TreeTask(0, 12, visited, lock, workers)));
+	pool.run();
+
+	TEST_TRUE(workers.size() == 2);
+}
+TEST_CASE_END
+
+TEST_CASE("a task that throws should be counted as a failure and not stop the pool")
+{
+	volatile LONG    visited = 0;
+	CriticalSection  lock;
+	std::set<size_t> workers;
+
+	TaskPool pool(2);
+
+	pool.submit(TaskPtr(new FailingTask));
+	pool.submit(TaskPtr(new TreeTask(0, 2, visited, lock, workers)));
+	pool.run();
+
+	TEST_TRUE(pool.numFailures() == 1);
+	TEST_TRUE(visited == 7);
+}
+TEST_CASE_END
+
+TEST_CASE("running the pool should return when there are no tasks and the pool can be run again")
+{
+	volatile LONG    visited = 0;
+	CriticalSection  lock;
+	std::set<size_t> workers;
+
+	TaskPool pool(4);
+
+	pool.run();
+
+	for (size_t i = 0; i != 2; ++i)
+	{
+		pool.submit(TaskPtr(new TreeTask(0, 4, visited, lock, workers)));
+		pool.run();
+	}
+
+	TEST_TRUE(visited == 62);
+	TEST_TRUE(pool.numFailures() == 0);
+}
+TEST_CASE_END
+
+}
+TEST_SET_END
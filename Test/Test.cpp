@@ -6,8 +6,12 @@
 #include "Common.hpp"
 #include <tchar.h>
 #include <Core/UnitTest.hpp>
+#include "AllocationCounter.hpp"
 
 int _tmain(int argc, _TCHAR* argv[])
 {
+	// Count the allocations so that the tests can assert a budget.
+	enableAllocationCounting(true);
+
 	TEST_SUITE_MAIN(argc, argv);
 }
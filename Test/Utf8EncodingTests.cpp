@@ -0,0 +1,85 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   Utf8EncodingTests.cpp
+//! \brief  The unit tests for the UTF-8 encoding functions.
+//! \author Chris Oldwood
+
+#include "Common.hpp"
+#include <Core/UnitTest.hpp>
+#include "Utf8Encoding.hpp"
+#include <Core/StringUtils.hpp>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+//! Encode the text with the function under test.
+
+static std::string encode(const tstring& text)
+{
+	std::vector<byte> output(text.length() * MAX_UTF8_BYTES_PER_UNIT + 1);
+
+	const size_t length = encodeUtf8(text.data(), text.length(), &output[0]);
+
+	return std::string(output.begin(), output.begin() + length);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Encode the text with the Windows API.
+
+static std::string encodeWithApi(const tstring& text)
+{
+	if (text.empty())
+		return std::string();
+
+	std::vector<char> output(text.length() * MAX_UTF8_BYTES_PER_UNIT);
+
+	const int length = ::WideCharToMultiByte(CP_UTF8, 0, text.data(), static_cast<int>(text.length()),
+	                                         &output[0], static_cast<int>(output.size()), nullptr, nullptr);
+
+	return std::string(output.begin(), output.begin() + length);
+}
+
+TEST_SET(Utf8Encoding)
+{
+
+TEST_CASE("a non-ASCII character should be encoded correctly wherever it falls within a block")
+{
+	const tchar* characters[] = { TXT("\x00e9"), TXT("\x20AC"), TXT("\xD83D\xDE00") };
+
+	for (size_t c = 0; c != ARRAY_SIZE(characters); ++c)
+	{
+		for (size_t i = 0; i != 20; ++i)
+		{
+			tstring text(20, TXT('x'));
+
+			text.insert(i, characters[c]);
+
+			TEST_TRUE(encode(text) == encodeWithApi(text));
+		}
+	}
+}
+TEST_CASE_END
+
+TEST_CASE("an unpaired surrogate should be encoded as the replacement character")
+{
+	TEST_TRUE(encode(tstring(TXT("a\xD83D")) + TXT("b")) == "a\xEF\xBF\xBD" "b");
+	TEST_TRUE(encode(tstring(TXT("a\xDE00")) + TXT("b")) == "a\xEF\xBF\xBD" "b");
+	TEST_TRUE(encode(TXT("a\xD83D")) == "a\xEF\xBF\xBD");
+}
+TEST_CASE_END
+
+TEST_CASE("string heavy output should be encoded the same as the Windows API")
+{
+	tstring text;
+
+	for (size_t i = 0; i != 1000; ++i)
+	{
+		text += Core::fmt(TXT("\nName        : svchost%u.exe\nCommandLine : C:\\Windows\\system32\\svchost.exe -k netsvcs -p\n"), static_cast<unsigned>(i));
+		text += Core::fmt(TXT("Description : Caf\x00e9 \x20AC%u \xD83D\xDE00\n"), static_cast<unsigned>(i));
+	}
+
+	TEST_TRUE(encode(text) == encodeWithApi(text));
+	TEST_TRUE(encode(TXT("")).empty());
+}
+TEST_CASE_END
+
+}
+TEST_SET_END
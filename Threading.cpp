@@ -0,0 +1,216 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   Threading.cpp
+//! \brief  Thin wrappers around the Win32 threading primitives.
+//! \author Chris Oldwood
+
+#include "Common.hpp"
+#include "Threading.hpp"
+#include <WCL/Win32Exception.hpp>
+#include <Core/StringUtils.hpp>
+#include <process.h>
+#include <climits>
+
+////////////////////////////////////////////////////////////////////////////////
+//! Constructor.
+
+CriticalSection::CriticalSection()
+{
+	::InitializeCriticalSection(&m_section);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Destructor.
+
+CriticalSection::~CriticalSection()
+{
+	::DeleteCriticalSection(&m_section);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Acquire the lock.
+
+void CriticalSection::enter()
+{
+	::EnterCriticalSection(&m_section);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Release the lock.
+
+void CriticalSection::leave()
+{
+	::LeaveCriticalSection(&m_section);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Constructor.
+
+AutoLock::AutoLock(CriticalSection& section)
+	: m_section(section)
+{
+	m_section.enter();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Destructor.
+
+AutoLock::~AutoLock()
+{
+	m_section.leave();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Constructor.
+
+Event::Event(ResetType type)
+	: m_handle(::CreateEvent(nullptr, (type == MANUAL_RESET), FALSE, nullptr))
+{
+	if (m_handle == NULL)
+		throw WCL::Win32Exception(::GetLastError(), TXT("Failed to create an event"));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Destructor.
+
+Event::~Event()
+{
+	::CloseHandle(m_handle);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Signal the event.
+
+void Event::set()
+{
+	::SetEvent(m_handle);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Reset the event.
+
+void Event::reset()
+{
+	::ResetEvent(m_handle);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Wait for the event to be signalled. Returns false on timeout.
+
+bool Event::wait(DWORD timeout)
+{
+	return (::WaitForSingleObject(m_handle, timeout) == WAIT_OBJECT_0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Get the underlying handle.
+
+HANDLE Event::handle() const
+{
+	return m_handle;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Constructor.
+
+Semaphore::Semaphore(LONG initialCount)
+	: m_handle(::CreateSemaphore(nullptr, initialCount, LONG_MAX, nullptr))
+{
+	if (m_handle == NULL)
+		throw WCL::Win32Exception(::GetLastError(), TXT("Failed to create a semaphore"));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Destructor.
+
+Semaphore::~Semaphore()
+{
+	::CloseHandle(m_handle);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Increase the count, releasing any waiting threads.
+
+void Semaphore::release(LONG count)
+{
+	::ReleaseSemaphore(m_handle, count, nullptr);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Wait for the count to be non-zero and then decrement it. Returns false
+//! on timeout.
+
+bool Semaphore::wait(DWORD timeout)
+{
+	return (::WaitForSingleObject(m_handle, timeout) == WAIT_OBJECT_0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Default constructor.
+
+Thread::Thread()
+	: m_handle(NULL)
+	, m_failed(false)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Destructor.
+
+Thread::~Thread()
+{
+	ASSERT(m_handle == NULL);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Start the thread.
+
+void Thread::start()
+{
+	ASSERT(m_handle == NULL);
+
+	uintptr_t handle = ::_beginthreadex(nullptr, 0, threadMain, this, 0, nullptr);
+
+	if (handle == 0)
+		throw WCL::Win32Exception(::GetLastError(), TXT("Failed to start a thread"));
+
+	m_handle = reinterpret_cast<HANDLE>(handle);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Wait for the thread to finish.
+
+void Thread::join()
+{
+	if (m_handle == NULL)
+		return;
+
+	::WaitForSingleObject(m_handle, INFINITE);
+	::CloseHandle(m_handle);
+
+	m_handle = NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! The thread entry point.
+
+unsigned __stdcall Thread::threadMain(void* parameter)
+{
+	Thread* thread = static_cast<Thread*>(parameter);
+
+	try
+	{
+		thread->run();
+	}
+	catch (const Core::Exception& e)
+	{
+		thread->m_error = e.twhat();
+		thread->m_failed = true;
+	}
+	catch (const std::exception& e)
+	{
+		thread->m_error = Core::fmt(TXT("Unexpected exception: %hs"), e.what());
+		thread->m_failed = true;
+	}
+
+	return 0;
+}
@@ -0,0 +1,207 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   Threading.hpp
+//! \brief  Thin wrappers around the Win32 threading primitives.
+//! \author Chris Oldwood
+
+// Check for previous inclusion
+#ifndef APP_THREADING_HPP
+#define APP_THREADING_HPP
+
+#if _MSC_VER > 1000
+#pragma once
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+//! A critical section used to serialise access to shared state.
+
+class CriticalSection
+{
+public:
+	//! Constructor.
+	CriticalSection();
+
+	//! Destructor.
+	~CriticalSection();
+
+	//! Acquire the lock.
+	void enter();
+
+	//! Release the lock.
+	void leave();
+
+private:
+	//
+	// Members.
+	//
+	CRITICAL_SECTION	m_section;	//!< The underlying critical section.
+
+	// NotCopyable.
+	CriticalSection(const CriticalSection&);
+	CriticalSection& operator=(const CriticalSection&);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! Helper class to hold a critical section for the lifetime of the object.
+
+class AutoLock
+{
+public:
+	//! Constructor.
+	explicit AutoLock(CriticalSection& section);
+
+	//! Destructor.
+	~AutoLock();
+
+private:
+	//
+	// Members.
+	//
+	CriticalSection&	m_section;	//!< The lock being held.
+
+	// NotCopyable.
+	AutoLock(const AutoLock&);
+	AutoLock& operator=(const AutoLock&);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! An event that threads can wait on to be signalled.
+
+class Event
+{
+public:
+	//! The type of reset the event uses.
+	enum ResetType
+	{
+		AUTO_RESET,		//!< Reset after releasing a single waiting thread.
+		MANUAL_RESET,	//!< Stays signalled until explicitly reset.
+	};
+
+	//! Constructor.
+	explicit Event(ResetType type);
+
+	//! Destructor.
+	~Event();
+
+	//! Signal the event.
+	void set();
+
+	//! Reset the event.
+	void reset();
+
+	//! Wait for the event to be signalled. Returns false on timeout.
+	bool wait(DWORD timeout = INFINITE);
+
+	//! Get the underlying handle.
+	HANDLE handle() const;
+
+private:
+	//
+	// Members.
+	//
+	HANDLE	m_handle;	//!< The event handle.
+
+	// NotCopyable.
+	Event(const Event&);
+	Event& operator=(const Event&);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! A counting semaphore.
+
+class Semaphore
+{
+public:
+	//! Constructor.
+	explicit Semaphore(LONG initialCount);
+
+	//! Destructor.
+	~Semaphore();
+
+	//! Increase the count, releasing any waiting threads.
+	void release(LONG count = 1);
+
+	//! Wait for the count to be non-zero and then decrement it. Returns false
+	//! on timeout.
+	bool wait(DWORD timeout = INFINITE);
+
+private:
+	//
+	// Members.
+	//
+	HANDLE	m_handle;	//!< The semaphore handle.
+
+	// NotCopyable.
+	Semaphore(const Semaphore&);
+	Semaphore& operator=(const Semaphore&);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! The base class for a worker thread. Any exception which escapes the run()
+//! method is caught and its message made available via error().
+
+class Thread
+{
+public:
+	//! Default constructor.
+	Thread();
+
+	//! Destructor.
+	virtual ~Thread();
+
+	//! Start the thread.
+	void start();
+
+	//! Wait for the thread to finish.
+	void join();
+
+	//! Check if the thread terminated because of an exception.
+	bool failed() const;
+
+	//! Get the message of the exception that terminated the thread.
+	const tstring& error() const;
+
+protected:
+	//
+	// Thread methods.
+	//
+
+	//! The thread's body.
+	virtual void run() = 0;
+
+private:
+	//
+	// Members.
+	//
+	HANDLE	m_handle;	//!< The thread handle.
+	bool	m_failed;	//!< Did the thread terminate abnormally?
+	tstring	m_error;	//!< The exception message.
+
+	//
+	// Internal methods.
+	//
+
+	//! The thread entry point.
+	static unsigned __stdcall threadMain(void* parameter);
+
+	// NotCopyable.
+	Thread(const Thread&);
+	Thread& operator=(const Thread&);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//! Check if the thread terminated because of an exception.
+
+inline bool Thread::failed() const
+{
+	return m_failed;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Get the message of the exception that terminated the thread.
+
+inline const tstring& Thread::error() const
+{
+	return m_error;
+}
+
+#endif // APP_THREADING_HPP
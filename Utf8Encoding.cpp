@@ -0,0 +1,144 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   Utf8Encoding.cpp
+//! \brief  Helper functions for encoding text as UTF-8.
+//! \author Chris Oldwood
+
+#include "Common.hpp"
+#include "Utf8Encoding.hpp"
+#include <WCL/Win32Exception.hpp>
+#include <emmintrin.h>
+#include <algorithm>
+
+//! Can the SSE2 instructions be used?
+static const bool s_haveSse2 = (::IsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE) != FALSE);
+
+//! The number of code units encoded at once on the fast path.
+static const size_t UNITS_PER_BLOCK = 8;
+
+////////////////////////////////////////////////////////////////////////////////
+//! Encode a run of ASCII code units 8 at a time by narrowing each block of 16
+//! bit units to bytes. Stops at the first block containing a unit above 0x7F
+//! and returns the number of units encoded, which are also the bytes written.
+
+static size_t encodeAsciiBlocks(const wchar_t* text, size_t length, byte* output)
+{
+	const __m128i nonAscii = _mm_set1_epi16(static_cast<short>(0xFF80));
+	const __m128i zero = _mm_setzero_si128();
+
+	size_t encoded = 0;
+
+	while ((length - encoded) >= UNITS_PER_BLOCK)
+	{
+		const __m128i units = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + encoded));
+		const __m128i ascii = _mm_cmpeq_epi16(_mm_and_si128(units, nonAscii), zero);
+
+		if (_mm_movemask_epi8(ascii) != 0xFFFF)
+			break;
+
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(output + encoded), _mm_packus_epi16(units, units));
+
+		encoded += UNITS_PER_BLOCK;
+	}
+
+	return encoded;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Encode the UTF-16 text as UTF-8 into the output buffer, which must have room
+//! for MAX_UTF8_BYTES_PER_UNIT bytes per code unit. Runs of ASCII text are
+//! encoded in blocks when the processor supports SSE2, otherwise one code unit
+//! at a time. An unpaired surrogate is encoded as U+FFFD. Returns the number of
+//! bytes written.
+
+size_t encodeUtf8(const wchar_t* text, size_t length, byte* output)
+{
+	const byte* start = output;
+	size_t      i = 0;
+
+	while (i != length)
+	{
+		if (s_haveSse2)
+		{
+			const size_t encoded = encodeAsciiBlocks(text + i, length - i, output);
+
+			i += encoded;
+			output += encoded;
+
+			if (i == length)
+				break;
+		}
+
+		// Encode the rest of the block, or just the next unit without SSE2.
+		const size_t blockEnd = std::min(length, i + UNITS_PER_BLOCK);
+
+		while (i < blockEnd)
+		{
+			uint32 codePoint = text[i++];
+
+			if (codePoint < 0x80)
+			{
+				*output++ = static_cast<byte>(codePoint);
+				continue;
+			}
+
+			if (codePoint < 0x800)
+			{
+				*output++ = static_cast<byte>(0xC0 | (codePoint >> 6));
+				*output++ = static_cast<byte>(0x80 | (codePoint & 0x3F));
+				continue;
+			}
+
+			if ( (codePoint >= 0xD800) && (codePoint <= 0xDFFF) )
+			{
+				const bool isPair = (codePoint <= 0xDBFF) && (i != length) && (text[i] >= 0xDC00) && (text[i] <= 0xDFFF);
+
+				if (isPair)
+				{
+					codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (text[i++] - 0xDC00);
+
+					*output++ = static_cast<byte>(0xF0 | (codePoint >> 18));
+					*output++ = static_cast<byte>(0x80 | ((codePoint >> 12) & 0x3F));
+					*output++ = static_cast<byte>(0x80 | ((codePoint >> 6) & 0x3F));
+					*output++ = static_cast<byte>(0x80 | (codePoint & 0x3F));
+					continue;
+				}
+
+				codePoint = 0xFFFD;
+			}
+
+			*output++ = static_cast<byte>(0xE0 | (codePoint >> 12));
+			*output++ = static_cast<byte>(0x80 | ((codePoint >> 6) & 0x3F));
+			*output++ = static_cast<byte>(0x80 | (codePoint & 0x3F));
+		}
+	}
+
+	return output - start;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Append the text to the buffer encoded as UTF-8. The text is encoded straight
+//! into the buffer, which is grown to fit the worst case and then trimmed. ANSI
+//! text has to be widened first.
+
+void appendUtf8(const tstring& text, std::vector<byte>& output)
+{
+	const size_t used = output.size();
+
+	if (text.empty())
+		return;
+
+#ifdef _UNICODE
+	output.resize(used + (text.length() * MAX_UTF8_BYTES_PER_UNIT));
+	output.resize(used + encodeUtf8(text.data(), text.length(), &output[used]));
+#else
+	std::vector<wchar_t> wide(text.length());
+
+	const int chars = ::MultiByteToWideChar(CP_ACP, 0, text.data(), static_cast<int>(text.length()), &wide[0], static_cast<int>(wide.size()));
+
+	if (chars == 0)
+		throw WCL::Win32Exception(::GetLastError(), TXT("Failed to encode the output as UTF-8"));
+
+	output.resize(used + (chars * MAX_UTF8_BYTES_PER_UNIT));
+	output.resize(used + encodeUtf8(&wide[0], chars, &output[used]));
+#endif
+}
@@ -0,0 +1,31 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   Utf8Encoding.hpp
+//! \brief  Helper functions for encoding text as UTF-8.
+//! \author Chris Oldwood
+
+// Check for previous inclusion
+#ifndef APP_UTF8ENCODING_HPP
+#define APP_UTF8ENCODING_HPP
+
+#if _MSC_VER > 1000
+#pragma once
+#endif
+
+#include <vector>
+
+//! The most bytes a single UTF-16 code unit can be encoded as.
+const size_t MAX_UTF8_BYTES_PER_UNIT = 3;
+
+////////////////////////////////////////////////////////////////////////////////
+// Encode the UTF-16 text as UTF-8 into the output buffer, which must have room
+// for MAX_UTF8_BYTES_PER_UNIT bytes per code unit. An unpaired surrogate is
+// encoded as U+FFFD. Returns the number of bytes written.
+
+size_t encodeUtf8(const wchar_t* text, size_t length, byte* output);
+
+////////////////////////////////////////////////////////////////////////////////
+// Append the text to the buffer encoded as UTF-8.
+
+void appendUtf8(const tstring& text, std::vector<byte>& output);
+
+#endif // APP_UTF8ENCODING_HPP
@@ -0,0 +1,146 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   Utf8StreamBuf.cpp
+//! \brief  The Utf8StreamBuf class definition.
+//! \author Chris Oldwood
+
+#include "Common.hpp"
+#include "Utf8StreamBuf.hpp"
+#include "AsyncFileWriter.hpp"
+#include <WCL/Win32Exception.hpp>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+//! Is the character the first half of a surrogate pair?
+
+static bool isHighSurrogate(tchar c)
+{
+#ifdef _UNICODE
+	return (c >= 0xD800) && (c <= 0xDBFF);
+#else
+	UNREFERENCED_PARAMETER(c);
+	return false;
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Constructor.
+
+Utf8StreamBuf::Utf8StreamBuf(AsyncFileWriter& writer)
+	: m_writer(writer)
+{
+	setp(m_buffer, m_buffer + BUFFER_SIZE);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Destructor.
+
+Utf8StreamBuf::~Utf8StreamBuf()
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Send the buffer and then buffer the character.
+
+Utf8StreamBuf::int_type Utf8StreamBuf::overflow(int_type c)
+{
+	send();
+
+	if (!traits_type::eq_int_type(c, traits_type::eof()))
+	{
+		*pptr() = traits_type::to_char_type(c);
+		pbump(1);
+	}
+
+	return traits_type::not_eof(c);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Send any buffered text.
+
+int Utf8StreamBuf::sync()
+{
+	send();
+
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Buffer the text or, if it's large, encode it directly into the writer's
+//! buffer to avoid copying it first. Any buffered text is sent beforehand, and
+//! a high surrogate left over from it is completed from the new text, so that
+//! the output stays in order.
+
+std::streamsize Utf8StreamBuf::xsputn(const char_type* text, std::streamsize count)
+{
+	if (static_cast<size_t>(count) < DIRECT_WRITE_SIZE)
+		return std::basic_streambuf<tchar>::xsputn(text, count);
+
+	const char_type* begin = text;
+	const char_type* end = text + count;
+
+	send();
+
+	while ( (pptr() != pbase()) && (begin != end) )
+	{
+		*pptr() = *begin++;
+		pbump(1);
+		send();
+	}
+
+	if ( (begin != end) && isHighSurrogate(*(end-1)) )
+		--end;
+
+	encode(begin, end - begin);
+
+	if (end != text + count)
+	{
+		*pptr() = *end;
+		pbump(1);
+	}
+
+	return count;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Encode the buffered text and pass it to the writer. A trailing high
+//! surrogate is kept back so that a pair is always encoded together.
+
+void Utf8StreamBuf::send()
+{
+	const size_t length = pptr() - pbase();
+	size_t       carried = 0;
+
+	if ( (length != 0) && isHighSurrogate(m_buffer[length-1]) )
+		carried = 1;
+
+	encode(m_buffer, length - carried);
+
+	if (carried != 0)
+		m_buffer[0] = m_buffer[length-1];
+
+	setp(m_buffer, m_buffer + BUFFER_SIZE);
+	pbump(static_cast<int>(carried));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//! Encode the text and pass it to the writer. Unicode text is encoded straight
+//! into the writer's buffer, ANSI text is first widened.
+
+void Utf8StreamBuf::encode(const tchar* text, size_t length)
+{
+	if (length == 0)
+		return;
+
+#ifdef _UNICODE
+	m_writer.writeUtf8(text, length);
+#else
+	std::vector<wchar_t> wide(length);
+
+	const int chars = ::MultiByteToWideChar(CP_ACP, 0, text, static_cast<int>(length), &wide[0], static_cast<int>(wide.size()));
+
+	if (chars == 0)
+		throw WCL::Win32Exception(::GetLastError(), TXT("Failed to encode the output as UTF-8"));
+
+	m_writer.writeUtf8(&wide[0], chars);
+#endif
+}
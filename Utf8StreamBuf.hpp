@@ -0,0 +1,75 @@
+////////////////////////////////////////////////////////////////////////////////
+//! \file   Utf8StreamBuf.hpp
+//! \brief  The Utf8StreamBuf class declaration.
+//! \author Chris Oldwood
+
+// Check for previous inclusion
+#ifndef APP_UTF8STREAMBUF_HPP
+#define APP_UTF8STREAMBUF_HPP
+
+#if _MSC_VER > 1000
+#pragma once
+#endif
+
+#include <streambuf>
+
+class AsyncFileWriter;
+
+////////////////////////////////////////////////////////////////////////////////
+//! A stream buffer that encodes the text written to it as UTF-8 and passes it
+//! on to a file writer whenever the buffer fills or is flushed. Large writes,
+//! such as a whole formatted object, bypass the buffer and are encoded directly
+//! into the file writer's buffer.
+
+class Utf8StreamBuf : public std::basic_streambuf<tchar>
+{
+public:
+	//! Constructor.
+	explicit Utf8StreamBuf(AsyncFileWriter& writer);
+
+	//! Destructor.
+	virtual ~Utf8StreamBuf();
+
+protected:
+	//
+	// std::basic_streambuf methods.
+	//
+
+	//! Send the buffer and then buffer the character.
+	virtual int_type overflow(int_type c);
+
+	//! Send any buffered text.
+	virtual int sync();
+
+	//! Buffer the text or, if it's large, encode it directly.
+	virtual std::streamsize xsputn(const char_type* text, std::streamsize count);
+
+private:
+	//! The number of characters buffered before they are encoded.
+	static const size_t BUFFER_SIZE = 4096;
+
+	//! The number of characters at which a write bypasses the buffer.
+	static const size_t DIRECT_WRITE_SIZE = 256;
+
+	//
+	// Members.
+	//
+	AsyncFileWriter&	m_writer;				//!< The file to write to.
+	tchar				m_buffer[BUFFER_SIZE];	//!< The unsent text.
+
+	//
+	// Internal methods.
+	//
+
+	//! Encode the buffered text and pass it to the writer.
+	void send();
+
+	//! Encode the text and pass it to the writer.
+	void encode(const tchar* text, size_t length);
+
+	// NotCopyable.
+	Utf8StreamBuf(const Utf8StreamBuf&);
+	Utf8StreamBuf& operator=(const Utf8StreamBuf&);
+};
+
+#endif // APP_UTF8STREAMBUF_HPP
@@ -10,6 +10,10 @@
 #include <Core/StringUtils.hpp>
 #include <WCL/AutoCom.hpp>
 #include "QueryCmd.hpp"
+#include "NamespacesCmd.hpp"
+#include "ServeCmd.hpp"
+#include "DiffCmd.hpp"
+#include "PipeClient.hpp"
 
 ////////////////////////////////////////////////////////////////////////////////
 // Global variables.
@@ -49,6 +53,10 @@ WmiCmd::~WmiCmd()
 
 int WmiCmd::run(int argc, tchar* argv[], tistream& /*in*/, tostream& out, tostream& err)
 {
+	// Forward the command to a resident server?
+	if ( (argc > 1) && (tstricmp(argv[1], TXT("client")) == 0) )
+		return runClient(argc, argv, out, err);
+
 	// Command specified?
 	if ( (argc > 1) && ((argv[1][0] != TXT('/')) && (argv[1][0] != TXT('-'))) )
 	{
@@ -108,10 +116,52 @@ WCL::ConsoleCmdPtr WmiCmd::createCommand(int argc, tchar* argv[])
 	{
 		return WCL::ConsoleCmdPtr(new QueryCmd(argc, argv));
 	}
+	else if ( (tstricmp(command, TXT("namespaces")) == 0) || (tstricmp(command, TXT("classes")) == 0) )
+	{
+		return WCL::ConsoleCmdPtr(new NamespacesCmd(argc, argv));
+	}
+	else if (tstricmp(command, TXT("serve")) == 0)
+	{
+		return WCL::ConsoleCmdPtr(new ServeCmd(argc, argv));
+	}
+	else if (tstricmp(command, TXT("diff")) == 0)
+	{
+		return WCL::ConsoleCmdPtr(new DiffCmd(argc, argv));
+	}
 
 	throw Core::CmdLineException(Core::fmt(TXT("Unknown command: '%s'"), command));
 }
 
+////////////////////////////////////////////////////////////////////////////////
+//! Forward the rest of the command line to a resident server. The command line
+//! is not parsed here, other than for the optional pipe name, as that is done
+//! by the server. Any paths are made absolute first though as the server does
+//! not share our working folder.
+
+int WmiCmd::runClient(int argc, tchar* argv[], tostream& out, tostream& err)
+{
+	ASSERT(tstricmp(argv[1], TXT("client")) == 0);
+
+	tstring pipeName = DEFAULT_PIPE_NAME;
+	int     first = 2;
+
+	if ( (argc > 3) && ( (tstricmp(argv[2], TXT("--pipe")) == 0) || (tstricmp(argv[2], TXT("/pipe")) == 0)
+	                  || (tstricmp(argv[2], TXT("-pn")) == 0) || (tstricmp(argv[2], TXT("/pn")) == 0) ) )
+	{
+		pipeName = argv[3];
+		first = 4;
+	}
+
+	if (first >= argc)
+		throw Core::CmdLineException(TXT("No command specified to forward to the server"));
+
+	RequestArgs args(argv+first, argv+argc);
+
+	makePathsAbsolute(args);
+
+	return forwardCommand(pipeName, args, out, err);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 //! Get the name of the application.
 
@@ -134,6 +184,11 @@ void WmiCmd::showUsage(tostream& out) const
 	out << TXT("where <command> is one of:-") << std::endl;
 	out << std::endl;
 	out << TXT("query") << tstring(width-5, TXT(' ')) << ("Execute a query") << std::endl;
+	out << TXT("namespaces") << tstring(width-10, TXT(' ')) << ("List the namespaces") << std::endl;
+	out << TXT("classes") << tstring(width-7, TXT(' ')) << ("List the classes in each namespace") << std::endl;
+	out << TXT("diff") << tstring(width-4, TXT(' ')) << ("Compare the saved output of two queries") << std::endl;
+	out << TXT("serve") << tstring(width-5, TXT(' ')) << ("Run a resident query server") << std::endl;
+	out << TXT("client") << tstring(width-6, TXT(' ')) << ("Forward a command to the server, e.g. client [--pipe <name>] query ...") << std::endl;
 	out << std::endl;
 
 	out << TXT("For help on an individual command use:-") << std::endl;
@@ -52,6 +52,9 @@ private:
 
 	//! Create the Comand object.
 	WCL::ConsoleCmdPtr createCommand(int argc, tchar* argv[]); // throw(CmdLineException)
+
+	//! Forward the command line to a resident server.
+	int runClient(int argc, tchar* argv[], tostream& out, tostream& err);
 };
 
 //! The application object.